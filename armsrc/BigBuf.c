@@ -25,6 +25,8 @@ static uint8_t *BigBuf = (uint8_t *)__bss_end__;
 Pointer to highest available memory: s_bigbuf_hi
     high s_bigbuf_size
     reserved = BigBuf_malloc()  subtracts amount from s_bigbuf_hi,
+    ...
+    trace    = [0, trace_len) is kept out of allocations
     low  0x00
 */
 
@@ -33,6 +35,23 @@ static uint32_t s_bigbuf_size = 0;
 // High memory mark
 static uint32_t s_bigbuf_hi = 0;
 
+// lowest high memory mark and longest trace since power up
+static uint32_t s_bigbuf_lowest_hi = 0;
+static uint32_t s_trace_peak = 0;
+
+// allocated chunks, in allocation order. The last one is the lowest in memory.
+// Chunks beyond BIGBUF_MAX_CHUNKS are allocated but can only go with BigBuf_free()
+typedef struct {
+    const char *name;
+    uint32_t offset;
+    uint32_t size;
+    bool released;
+} bigbuf_chunk_t;
+
+static bigbuf_chunk_t s_chunks[BIGBUF_MAX_CHUNKS];
+static uint8_t s_chunk_cnt = 0;
+static uint16_t s_untracked = 0;
+
 // pointer to the emulator memory.
 static uint8_t *emulator_memory = NULL;
 
@@ -71,7 +90,11 @@ static bool tracing = true;
 void BigBuf_initialize(void) {
     s_bigbuf_size = (uint32_t)_stack_start - (uint32_t)__bss_end__;
     s_bigbuf_hi = s_bigbuf_size;
+    s_bigbuf_lowest_hi = s_bigbuf_size;
+    s_chunk_cnt = 0;
+    s_untracked = 0;
     trace_len = 0;
+    s_trace_peak = 0;
 }
 
 // get the address of BigBuf
@@ -87,7 +110,7 @@ uint32_t BigBuf_get_size(void) {
 uint8_t *BigBuf_get_EM_addr(void) {
     // not yet allocated
     if (emulator_memory == NULL)
-        emulator_memory = BigBuf_malloc(CARD_MEMORY_SIZE);
+        emulator_memory = BigBuf_malloc_ext(CARD_MEMORY_SIZE, "emulator");
 
     return emulator_memory;
 }
@@ -118,20 +141,60 @@ void BigBuf_Clear_keep_EM(void) {
     memset(BigBuf, 0, s_bigbuf_hi);
 }
 
+// drop the trace records not ending below `limit`
+static void trace_truncate(uint32_t limit) {
+    uint32_t len = 0;
+    while (len + TRACELOG_HDR_LEN <= trace_len) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(BigBuf + len);
+        uint32_t next = len + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (next > limit || next > trace_len)
+            break;
+        len = next;
+    }
+    trace_len = len;
+}
+
 // allocate a chunk of memory from BigBuf. We allocate high memory first. The unallocated memory
 // at the beginning of BigBuf is always for traces/samples
-uint8_t *BigBuf_malloc(uint16_t chunksize) {
-    if (s_bigbuf_hi < chunksize)
+uint8_t *BigBuf_malloc(uint32_t chunksize) {
+    return BigBuf_malloc_ext(chunksize, NULL);
+}
+
+// same, the chunk is listed under `name` in `hw status`
+uint8_t *BigBuf_malloc_ext(uint32_t chunksize, const char *name) {
+    if (chunksize > s_bigbuf_hi)
         return NULL; // no memory left
 
-    chunksize = (chunksize + 3) & 0xfffc; // round to next multiple of 4
+    chunksize = (chunksize + 3) & ~3; // round to next multiple of 4
+    if (chunksize > s_bigbuf_hi)
+        return NULL;
+
+    // the logged trace is not handed out. A chunk that does not fit above it cuts the trace
+    if (s_bigbuf_hi - chunksize < trace_len) {
+        trace_truncate(s_bigbuf_hi - chunksize);
+        if (g_dbglevel >= DBG_INFO)
+            Dbprintf("BigBuf: %s (%u bytes) cuts the trace to %u bytes", name ? name : "chunk", chunksize, trace_len);
+    }
+
     s_bigbuf_hi -= chunksize;  // aligned to 4 Byte boundary
+    if (s_bigbuf_hi < s_bigbuf_lowest_hi)
+        s_bigbuf_lowest_hi = s_bigbuf_hi;
+
+    if (s_chunk_cnt < BIGBUF_MAX_CHUNKS) {
+        bigbuf_chunk_t *c = &s_chunks[s_chunk_cnt++];
+        c->name = name;
+        c->offset = s_bigbuf_hi;
+        c->size = chunksize;
+        c->released = false;
+    } else {
+        s_untracked++;
+    }
     return (uint8_t *)BigBuf + s_bigbuf_hi;
 }
 
 // allocate a chunk of memory from BigBuf, and returns a pointer to it.
 // sets the memory to zero
-uint8_t *BigBuf_calloc(uint16_t chunksize) {
+uint8_t *BigBuf_calloc(uint32_t chunksize) {
     uint8_t *mem = BigBuf_malloc(chunksize);
     if (mem != NULL) {
         memset(mem, 0x00, chunksize);
@@ -139,9 +202,45 @@ uint8_t *BigBuf_calloc(uint16_t chunksize) {
     return mem;
 }
 
+// forget the buffers living in the memory above `offset`
+static void BigBuf_drop_buffers(uint32_t offset) {
+    if (emulator_memory != NULL && (uint32_t)(emulator_memory - BigBuf) < offset)
+        emulator_memory = NULL;
+    if (toSend.buf != NULL && (uint32_t)(toSend.buf - BigBuf) < offset)
+        toSend.buf = NULL;
+    if (dma_16.buf != NULL && (uint32_t)((uint8_t *)dma_16.buf - BigBuf) < offset)
+        dma_16.buf = NULL;
+    if (dma_8.buf != NULL && (uint32_t)(dma_8.buf - BigBuf) < offset)
+        dma_8.buf = NULL;
+}
+
+// give back one chunk. Its memory returns to the trace/sample area once the chunks
+// allocated after it are released too, there is no reuse of holes.
+void BigBuf_release(uint8_t *mem) {
+    if (mem == NULL || s_untracked)
+        return;
+
+    uint32_t offset = mem - BigBuf;
+    for (uint8_t i = 0; i < s_chunk_cnt; i++) {
+        if (s_chunks[i].offset == offset) {
+            s_chunks[i].released = true;
+            break;
+        }
+    }
+
+    while (s_chunk_cnt && s_chunks[s_chunk_cnt - 1].released) {
+        s_chunk_cnt--;
+        s_bigbuf_hi = s_chunks[s_chunk_cnt].offset + s_chunks[s_chunk_cnt].size;
+    }
+
+    BigBuf_drop_buffers(s_bigbuf_hi);
+}
+
 // free ALL allocated chunks. The whole BigBuf is available for traces or samples again.
 void BigBuf_free(void) {
     s_bigbuf_hi = s_bigbuf_size;
+    s_chunk_cnt = 0;
+    s_untracked = 0;
     emulator_memory = NULL;
     // shouldn't this empty BigBuf also?
     toSend.buf = NULL;
@@ -156,6 +255,10 @@ void BigBuf_free_keep_EM(void) {
     else
         s_bigbuf_hi = s_bigbuf_size;
 
+    while (s_chunk_cnt && s_chunks[s_chunk_cnt - 1].offset < s_bigbuf_hi)
+        s_chunk_cnt--;
+    s_untracked = 0;
+
     toSend.buf = NULL;
     dma_16.buf = NULL;
     dma_8.buf = NULL;
@@ -163,11 +266,19 @@ void BigBuf_free_keep_EM(void) {
 
 void BigBuf_print_status(void) {
     DbpString(_CYAN_("Memory"));
-    Dbprintf("  BigBuf_size............. %d", s_bigbuf_size);
-    Dbprintf("  Available memory........ %d", s_bigbuf_hi);
+    Dbprintf("  BigBuf_size............. %u", s_bigbuf_size);
+    Dbprintf("  Available memory........ %u", s_bigbuf_hi);
+    Dbprintf("  Allocated............... %u ( peak %u )", s_bigbuf_size - s_bigbuf_hi, s_bigbuf_size - s_bigbuf_lowest_hi);
+    for (uint8_t i = 0; i < s_chunk_cnt; i++) {
+        const bigbuf_chunk_t *c = &s_chunks[i];
+        Dbprintf("    %-12s %6u bytes at %6u%s", c->name ? c->name : "-", c->size, c->offset, c->released ? "  released" : "");
+    }
+    if (s_untracked)
+        Dbprintf("    %u more chunks", s_untracked);
+
     DbpString(_CYAN_("Tracing"));
     Dbprintf("  tracing ................ %d", tracing);
-    Dbprintf("  traceLen ............... %d", trace_len);
+    Dbprintf("  traceLen ............... %u ( peak %u )", trace_len, s_trace_peak);
 
     if (g_dbglevel >= DBG_DEBUG) {
         DbpString(_CYAN_("Sending buffers"));
@@ -191,7 +302,7 @@ void BigBuf_print_status(void) {
 }
 
 // return the maximum trace length (i.e. the unallocated size of BigBuf)
-uint16_t BigBuf_max_traceLen(void) {
+uint32_t BigBuf_max_traceLen(void) {
     return s_bigbuf_hi;
 }
 
@@ -201,6 +312,8 @@ void clear_trace(void) {
 
 void set_tracelen(uint32_t value) {
     trace_len = value;
+    if (trace_len > s_trace_peak)
+        s_trace_peak = trace_len;
 }
 
 void set_tracing(bool enable) {
@@ -278,6 +391,9 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
         }
         trace_len += num_paritybytes;
     }
+
+    if (trace_len > s_trace_peak)
+        s_trace_peak = trace_len;
     return true;
 }
 
@@ -307,7 +423,7 @@ uint8_t emlSet(uint8_t *data, uint32_t offset, uint32_t length) {
 tosend_t *get_tosend(void) {
 
     if (toSend.buf == NULL)
-        toSend.buf = BigBuf_malloc(TOSEND_BUFFER_SIZE);
+        toSend.buf = BigBuf_malloc_ext(TOSEND_BUFFER_SIZE, "toSend");
 
     return &toSend;
 }
@@ -342,14 +458,14 @@ void tosend_stuffbit(int b) {
 
 dmabuf16_t *get_dma16(void) {
     if (dma_16.buf == NULL)
-        dma_16.buf = (uint16_t *)BigBuf_malloc(DMA_BUFFER_SIZE * sizeof(uint16_t));
+        dma_16.buf = (uint16_t *)BigBuf_malloc_ext(DMA_BUFFER_SIZE * sizeof(uint16_t), "dma16");
 
     return &dma_16;
 }
 
 dmabuf8_t *get_dma8(void) {
     if (dma_8.buf == NULL)
-        dma_8.buf = BigBuf_malloc(DMA_BUFFER_SIZE);
+        dma_8.buf = BigBuf_malloc_ext(DMA_BUFFER_SIZE, "dma8");
 
     return &dma_8;
 }
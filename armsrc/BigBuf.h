@@ -20,6 +20,7 @@
 #define MAX_MIFARE_PARITY_SIZE  3   // need 18 parity bits for the 18 Byte above. 3 Bytes are enough to store these
 #define CARD_MEMORY_SIZE        4096
 #define DMA_BUFFER_SIZE         512
+#define BIGBUF_MAX_CHUNKS       16  // allocations tracked by name for BigBuf_release() and `hw status`
 
 // 8 data bits and 1 parity bit per payload byte, 1 correction bit, 1 SOC bit, 2 EOC bits
 #define TOSEND_BUFFER_SIZE (9 * MAX_FRAME_SIZE + 1 + 1 + 2)
@@ -27,14 +28,16 @@
 uint8_t *BigBuf_get_addr(void);
 uint32_t BigBuf_get_size(void);
 uint8_t *BigBuf_get_EM_addr(void);
-uint16_t BigBuf_max_traceLen(void);
+uint32_t BigBuf_max_traceLen(void);
 void BigBuf_initialize(void);
 void BigBuf_Clear(void);
 void BigBuf_Clear_ext(bool verbose);
 void BigBuf_Clear_keep_EM(void);
 void BigBuf_Clear_EM(void);
-uint8_t *BigBuf_malloc(uint16_t);
-uint8_t *BigBuf_calloc(uint16_t);
+uint8_t *BigBuf_malloc(uint32_t);
+uint8_t *BigBuf_malloc_ext(uint32_t chunksize, const char *name);
+uint8_t *BigBuf_calloc(uint32_t);
+void BigBuf_release(uint8_t *mem);
 void BigBuf_free(void);
 void BigBuf_free_keep_EM(void);
 void BigBuf_print_status(void);
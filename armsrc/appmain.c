@@ -37,6 +37,7 @@
 //#include "cryptorfsim.h"
 #include "epa.h"
 #include "hfsnoop.h"
+#include "hfsearch.h"
 #include "lfops.h"
 #include "lfsampling.h"
 #include "mifarecmd.h"
@@ -48,6 +49,7 @@
 #include "ticks.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "lz4.h"            // compressed downloads
 
 
 #ifdef WITH_LCD
@@ -539,9 +541,58 @@ static void SendCapabilities(void) {
 #else
     capabilities.compiled_with_lcd = false;
 #endif
+    capabilities.compressed_download = true;
     reply_ng(CMD_CAPABILITIES, PM3_SUCCESS, (uint8_t *)&capabilities, sizeof(capabilities));
 }
 
+// Sends len bytes at src as download chunks of cmd,  offset is the position of src in the download.
+// Uncompressed as fixed size frames (arg0 = offset, arg1 = len, arg2 = arg2),  or with
+// DL_FLAG_COMPRESSED as NG frames,  each one holding as much input as fits LZ4 compressed.
+static void reply_download(uint16_t cmd, uint32_t offset, const uint8_t *src, uint32_t len, uint64_t arg2, uint8_t flags) {
+
+    if ((flags & DL_FLAG_COMPRESSED) == 0) {
+        for (size_t i = 0; i < len; i += PM3_CMD_DATA_SIZE) {
+            size_t n = MIN((len - i), PM3_CMD_DATA_SIZE);
+            int result = reply_old(cmd, offset + i, n, arg2, (uint8_t *)src + i, n);
+            if (result != PM3_SUCCESS)
+                Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", offset + i, offset + i + n, n, result);
+        }
+        return;
+    }
+
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+    download_chunk_t *chunk = (download_chunk_t *)buf;
+    const int max_payload = sizeof(buf) - sizeof(download_chunk_t);
+
+    for (uint32_t i = 0; i < len;) {
+        int n = len - i;
+        int clen = LZ4_compress_destSize((const char *)src + i, (char *)chunk->data, &n, max_payload);
+
+        // incompressible,  store it
+        if (clen <= 0 || clen >= n) {
+            n = MIN(len - i, (uint32_t)max_payload);
+            memcpy(chunk->data, src + i, n);
+            clen = n;
+        }
+
+        chunk->offset = offset + i;
+        chunk->len = n;
+        chunk->clen = clen;
+        int result = reply_ng(cmd, PM3_SUCCESS, buf, sizeof(download_chunk_t) + clen);
+        if (result != PM3_SUCCESS)
+            Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", offset + i, offset + i + n, n, result);
+        i += n;
+    }
+}
+
+#ifdef WITH_FLASH
+static uint8_t spiffs_dl_flags = 0;
+
+static void spiffs_download_chunk(uint32_t offset, const uint8_t *data, uint32_t len) {
+    reply_download(CMD_SPIFFS_DOWNLOADED, offset, data, len, 0, spiffs_dl_flags);
+}
+#endif
+
 // Show some leds in a pattern to identify StandAlone mod is running
 void StandAloneMode(void) {
     DbpString("");
@@ -842,6 +893,13 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_LF_SNIFF_RAW_ADC, PM3_SUCCESS, (uint8_t *)&bits, sizeof(bits));
             break;
         }
+        case CMD_LF_STREAM_ADC: {
+            lf_stream_t *payload = (lf_stream_t *)packet->data.asBytes;
+            lf_stream_result_t retval;
+            int res = StreamLF(payload->reader_field, payload->samples, &retval);
+            reply_ng(CMD_LF_STREAM_ADC, res, (uint8_t *)&retval, sizeof(retval));
+            break;
+        }
         case CMD_LF_HID_WATCH: {
             uint32_t high, low;
             int res = lf_hid_watch(0, &high, &low);
@@ -972,6 +1030,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             T55xx_ChkPwds(packet->data.asBytes[0] & 0xff);
             break;
         }
+        case CMD_LF_T55XX_BRUTE: {
+            T55xx_BruteForce((t55xx_bf_t *)packet->data.asBytes);
+            break;
+        }
         case CMD_LF_PCF7931_READ: {
             ReadPCF7931();
             break;
@@ -1601,6 +1663,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareSendCommand(packet->data.asBytes);
             break;
         }
+        case CMD_HF_DESFIRE_CHKKEYS: {
+            MifareDesfireChkKeys(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_NACK_DETECT: {
             DetectNACKbug();
             break;
@@ -1716,6 +1782,12 @@ static void PacketReceived(PacketCommandNG *packet) {
             reply_ng(CMD_HF_SNIFF, res, (uint8_t *)&retval, sizeof(retval));
             break;
         }
+        case CMD_HF_SNIFF_RAW: {
+            hf_sniff_raw_result_t retval;
+            int res = HfSniffRaw(packet->data.asBytes[0], &retval.chunks, &retval.lost, &retval.stalls);
+            reply_ng(CMD_HF_SNIFF_RAW, res, (uint8_t *)&retval, sizeof(retval));
+            break;
+        }
 #endif
 
 #ifdef WITH_HFPLOT
@@ -1724,6 +1796,13 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
 #endif
+        case CMD_HF_SEARCH: {
+            hf_search_req_t *payload = (hf_search_req_t *)packet->data.asBytes;
+            hf_search_result_t retval;
+            int res = HfSearch(payload->techs, payload->flags, &retval);
+            reply_ng(CMD_HF_SEARCH, res, (uint8_t *)&retval, sizeof(retval));
+            break;
+        }
 
 #ifdef WITH_SMARTCARD
         case CMD_SMART_ATR: {
@@ -1966,15 +2045,10 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = BigBuf tracelen
+            // arg2 = flags (DL_FLAG_*)
             //Dbprintf("transfer to client parameters: %" PRIu32 " | %" PRIu32 " | %" PRIu32, startidx, numofbytes, packet->oldarg[2]);
 
-            for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
-                int result = reply_old(CMD_DOWNLOADED_BIGBUF, i, len, BigBuf_get_traceLen(), mem + startidx + i, len);
-                if (result != PM3_SUCCESS)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
-            }
+            reply_download(CMD_DOWNLOADED_BIGBUF, 0, mem + startidx, numofbytes, BigBuf_get_traceLen(), packet->oldarg[2]);
             // Trigger a finish downloading signal with an ACK frame
             // iceman,  when did sending samplingconfig array got attached here?!?
             // arg0 = status of download transfer
@@ -2029,14 +2103,9 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = RFU
+            // arg2 = flags (DL_FLAG_*)
 
-            for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
-                int result = reply_old(CMD_DOWNLOADED_EML_BIGBUF, i, len, 0, mem + startidx + i, len);
-                if (result != PM3_SUCCESS)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
-            }
+            reply_download(CMD_DOWNLOADED_EML_BIGBUF, 0, mem + startidx, numofbytes, 0, packet->oldarg[2]);
             // Trigger a finish downloading signal with an ACK frame
             reply_mix(CMD_ACK, 1, 0, 0, 0, 0);
             LED_B_OFF();
@@ -2082,19 +2151,17 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             uint32_t size = packet->oldarg[1];
 
-            uint8_t *buff = BigBuf_malloc(size);
-            rdv40_spiffs_read_as_filetype((char *)filename, (uint8_t *)buff, size, RDV40_SPIFFS_SAFETY_SAFE);
-
             // arg0 = filename
             // arg1 = size
-            // arg2 = RFU
+            // arg2 = flags (DL_FLAG_*)
+
+            // the file is sent while it is read,  its size is not limited by BigBuf
+            spiffs_dl_flags = packet->oldarg[2];
+            size_t blocksize = (spiffs_dl_flags & DL_FLAG_COMPRESSED) ? 4096 : PM3_CMD_DATA_SIZE;
+            uint8_t *buff = BigBuf_malloc(blocksize);
+            rdv40_spiffs_read_as_stream((char *)filename, buff, blocksize, size, spiffs_download_chunk, RDV40_SPIFFS_SAFETY_SAFE);
+            BigBuf_free();
 
-            for (size_t i = 0; i < size; i += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((size - i), PM3_CMD_DATA_SIZE);
-                int result = reply_old(CMD_SPIFFS_DOWNLOADED, i, len, 0, buff + i, len);
-                if (result != PM3_SUCCESS)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
-            }
             // Trigger a finish downloading signal with an ACK frame
             reply_ng(CMD_SPIFFS_DOWNLOAD, PM3_SUCCESS, NULL, 0);
             LED_B_OFF();
@@ -2268,27 +2335,38 @@ static void PacketReceived(PacketCommandNG *packet) {
         case CMD_FLASHMEM_DOWNLOAD: {
 
             LED_B_ON();
-            uint8_t *mem = BigBuf_malloc(PM3_CMD_DATA_SIZE);
             uint32_t startidx = packet->oldarg[0];
             uint32_t numofbytes = packet->oldarg[1];
+            uint8_t flags = packet->oldarg[2];
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = RFU
+            // arg2 = flags (DL_FLAG_*)
+
+            // larger reads give the compressor something to work with
+            size_t blocksize = (flags & DL_FLAG_COMPRESSED) ? 4096 : PM3_CMD_DATA_SIZE;
+            // ping-pong buffers,  the next block is read by the SPI PDC while the current one is sent
+            uint8_t *mem[2] = { BigBuf_malloc(blocksize), BigBuf_malloc(blocksize) };
 
             if (FlashInit() == false) {
                 break;
             }
 
-            for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
-                Flash_CheckBusy(BUSY_TIMEOUT);
-                bool isok = Flash_ReadDataCont(startidx + i, mem, len);
-                if (isok == false)
-                    Dbprintf("reading flash memory failed ::  | bytes between %d - %d", i, len);
+            Flash_CheckBusy(BUSY_TIMEOUT);
+
+            size_t len = MIN(numofbytes, blocksize);
+            Flash_ReadDataStart(startidx, mem[0], len);
+
+            for (size_t i = 0, cur = 0; i < numofbytes; i += blocksize, cur ^= 1) {
+                Flash_ReadDataWait(mem[cur], len);
+
+                size_t next = 0;
+                if (i + blocksize < numofbytes) {
+                    next = MIN((numofbytes - i - blocksize), blocksize);
+                    Flash_ReadDataStart(startidx + i + blocksize, mem[cur ^ 1], next);
+                }
 
-                isok = reply_old(CMD_FLASHMEM_DOWNLOADED, i, len, 0, mem, len);
-                if (isok != 0)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d", i, len);
+                reply_download(CMD_FLASHMEM_DOWNLOADED, i, mem[cur], len, 0, flags);
+                len = next;
             }
             FlashStop();
 
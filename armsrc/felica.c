@@ -490,6 +490,14 @@ static void felica_reset_frame_mode(void) {
     AT91C_BASE_SSC->SSC_RFMR = SSC_FRAME_MODE_BITS_IN_WORD(8) | AT91C_SSC_MSBF | SSC_FRAME_MODE_WORDS_PER_TRANSFER(0);
 }
 
+// Polls for a card on a freshly set up field, the field is switched off afterwards
+int felica_poll(felica_card_select_t *card) {
+    iso18092_setup(FPGA_HF_ISO18092_FLAG_READER | FPGA_HF_ISO18092_FLAG_NOMOD);
+    uint8_t res = felica_select_card(card);
+    felica_reset_frame_mode();
+    return (res == 0) ? PM3_SUCCESS : PM3_ENODATA;
+}
+
 
 //-----------------------------------------------------------------------------
 // RAW FeliCa commands. Send out commands and store answers.
@@ -13,8 +13,10 @@
 
 #include "common.h"
 #include "cmd.h"
+#include "iso18.h"
 
 void felica_sendraw(PacketCommandNG *c);
+int felica_poll(felica_card_select_t *card);
 void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip);
 void felica_sim_lite(uint8_t *uid);
 void felica_dump_lite_s(void);
@@ -308,6 +308,46 @@ uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len) {
     return len;
 }
 
+/* Same as Flash_ReadDataCont, but all bytes except the last one are moved by the SPI PDC
+ * so the CPU is free (i.e. to send the previous block to the client) until Flash_ReadDataWait.
+ * No other flash access is allowed in between. */
+uint16_t Flash_ReadDataStart(uint32_t address, uint8_t *out, uint16_t len) {
+
+    // length should never be zero
+    if (!len) return 0;
+
+    uint8_t cmd = (FASTFLASH) ? FASTREAD : READDATA;
+
+    FlashSendByte(cmd);
+    Flash_TransferAdresse(address);
+
+    if (FASTFLASH) {
+        FlashSendByte(DUMMYBYTE);
+    }
+
+    // the flash ignores MOSI while it shifts data out, so the receive buffer doubles as
+    // transmit buffer. A byte is always sent before it gets overwritten by its answer.
+    AT91C_BASE_SPI->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+    AT91C_BASE_SPI->SPI_RPR = (uint32_t)out;
+    AT91C_BASE_SPI->SPI_RCR = len - 1;
+    AT91C_BASE_SPI->SPI_TPR = (uint32_t)out;
+    AT91C_BASE_SPI->SPI_TCR = len - 1;
+    AT91C_BASE_SPI->SPI_PTCR = AT91C_PDC_RXTEN | AT91C_PDC_TXTEN;
+    return len;
+}
+
+// waits for a read started with Flash_ReadDataStart, clocks in the last byte and releases the chip select
+uint16_t Flash_ReadDataWait(uint8_t *out, uint16_t len) {
+
+    if (!len) return 0;
+
+    while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDRX) == 0) {};
+    AT91C_BASE_SPI->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+
+    out[len - 1] = FlashSendLastByte(0xFF);
+    return len;
+}
+
 
 ////////////////////////////////////////
 // Write data can only program one page. A page has 256 bytes.
@@ -482,17 +482,27 @@ void FpgaDownloadAndGo(int bitstream_version) {
 
     bool verbose = (g_dbglevel > 3);
 
-    // make sure that we have enough memory to decompress
-    BigBuf_free();
-    BigBuf_Clear_ext(verbose);
+    // The ring buffer goes on top of what is allocated. It is the LZ4 block size of
+    // the compressed image and takes almost all of BigBuf, so only the first records
+    // of a trace stay below it (BigBuf_malloc_ext cuts the rest). When the existing
+    // allocations leave no room at all, everything is freed and cleared.
+    uint8_t *output_buffer = BigBuf_malloc_ext(FPGA_RING_BUFFER_BYTES, "fpga");
+    if (output_buffer == NULL) {
+        if (g_dbglevel >= DBG_INFO)
+            Dbprintf("fpga: no room for the %u bytes image buffer, BigBuf and trace cleared", FPGA_RING_BUFFER_BYTES);
+        BigBuf_free();
+        BigBuf_Clear_ext(verbose);
+        output_buffer = BigBuf_malloc_ext(FPGA_RING_BUFFER_BYTES, "fpga");
+    }
 
     lz4_stream_t compressed_fpga_stream;
     LZ4_streamDecode_t lz4StreamDecode_body = {{ 0 }};
     compressed_fpga_stream.lz4StreamDecode = &lz4StreamDecode_body;
-    uint8_t *output_buffer = BigBuf_malloc(FPGA_RING_BUFFER_BYTES);
 
-    if (!reset_fpga_stream(bitstream_version, &compressed_fpga_stream, output_buffer))
+    if (!reset_fpga_stream(bitstream_version, &compressed_fpga_stream, output_buffer)) {
+        BigBuf_release(output_buffer);
         return;
+    }
 
     uint32_t bitstream_length;
     if (bitparse_find_section(bitstream_version, 'e', &bitstream_length, &compressed_fpga_stream, output_buffer)) {
@@ -509,9 +519,7 @@ void FpgaDownloadAndGo(int bitstream_version) {
     // turn off antenna
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
 
-    // free eventually allocated BigBuf memory
-    BigBuf_free();
-    BigBuf_Clear_ext(false);
+    BigBuf_release(output_buffer);
 }
 
 //-----------------------------------------------------------------------------
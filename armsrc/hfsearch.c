@@ -0,0 +1,278 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Multi protocol HF search on the device.
+//
+// The probes of `hf search` run in one command. They are grouped by the fpga
+// image they need and the group of the image already loaded goes first, so a
+// sweep downloads every other image it needs once. From an HF image that is at
+// most one download. From the LF image, the usual state after an `lf` command,
+// builds with a separate FeliCa image download two: the HF image and then the
+// FeliCa one,  unless HF_SEARCH_FLAG_FIRST stops the sweep before FeliCa.
+// Probes sharing a field setup (ThinFilm and 14a, 15693 and iCLASS) run on the
+// same field without powering it down.
+//-----------------------------------------------------------------------------
+#include "hfsearch.h"
+#include "proxmark3_arm.h"
+#include "fpgaloader.h"
+#include "ticks.h"
+#include "dbprint.h"
+#include "util.h"
+#include "BigBuf.h"
+#include "appmain.h"
+#include "cmd.h"
+#include "string.h"
+#include "iso14443a.h"
+#include "iso14443b.h"
+#include "iso15693.h"
+#include "iclass.h"
+#include "legicrf.h"
+#include "felica.h"
+#include "mifare.h"
+#include "iso14b.h"
+#include "iso18.h"
+
+// field off time between probes so the tags of the previous probe reset
+#define HF_SEARCH_FIELD_OFF_MS  5
+
+#if defined XC3
+# define HF_SEARCH_FELICA_IMAGE  FPGA_BITSTREAM_HF
+#else
+# define HF_SEARCH_FELICA_IMAGE  FPGA_BITSTREAM_HF_FELICA
+#endif
+
+typedef enum {
+    FIELD_14A,
+    FIELD_15,
+    FIELD_LEGIC,
+    FIELD_14B,
+    FIELD_FELICA,
+} hf_search_field_t;
+
+typedef struct {
+    uint16_t tech;
+    int image;
+    hf_search_field_t field;
+    void (*setup)(void);
+    int (*probe)(hf_search_result_t *r);
+} hf_search_probe_t;
+
+static void set_uid(hf_search_result_t *r, uint16_t tech, const uint8_t *uid, uint8_t len) {
+    uint8_t i = 0;
+    while ((tech >> i) != 1)
+        i++;
+
+    if (len > HF_SEARCH_UID_SIZE)
+        len = HF_SEARCH_UID_SIZE;
+
+    r->uid[i].len = len;
+    memcpy(r->uid[i].uid, uid, len);
+}
+
+#if defined WITH_ISO14443a || defined WITH_NFCBARCODE
+static void setup_14a(void) {
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+}
+#endif
+
+#ifdef WITH_NFCBARCODE
+static int probe_thinfilm(hf_search_result_t *r) {
+    uint8_t len = 0;
+    uint8_t buf[36] = {0x00};
+    if (GetIso14443aAnswerFromTag_Thinfilm(buf, &len) == false || len == 0)
+        return PM3_ENODATA;
+
+    set_uid(r, HF_SEARCH_THINFILM, buf, len);
+    return PM3_SUCCESS;
+}
+#endif
+
+#ifdef WITH_ISO14443a
+static int probe_14a(hf_search_result_t *r) {
+    iso14a_card_select_t card;
+    memset(&card, 0, sizeof(card));
+
+    // no RATS, the client asks for the ATS when it wants the details
+    int res = iso14443a_select_card(NULL, &card, NULL, true, 0, true);
+    FpgaDisableTracing();
+    if (res == 0)
+        return PM3_ENODATA;
+
+    r->select_status = res;
+    memcpy(r->atqa, card.atqa, sizeof(r->atqa));
+    r->sak = card.sak;
+    set_uid(r, HF_SEARCH_14A, card.uid, card.uidlen);
+    return PM3_SUCCESS;
+}
+#endif
+
+#if defined WITH_ISO15693 || defined WITH_ICLASS
+static void setup_15(void) {
+    Iso15693InitReader();
+}
+#endif
+
+#ifdef WITH_ISO15693
+static int probe_15(hf_search_result_t *r) {
+    uint8_t uid[8];
+    int res = Iso15693Inventory(uid);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    set_uid(r, HF_SEARCH_15, uid, sizeof(uid));
+    return PM3_SUCCESS;
+}
+#endif
+
+#ifdef WITH_ICLASS
+static int probe_iclass(hf_search_result_t *r) {
+    picopass_hdr_t hdr;
+    uint32_t eof_time = 0;
+    if (select_iclass_tag(&hdr, false, &eof_time) == false)
+        return PM3_ENODATA;
+
+    set_uid(r, HF_SEARCH_ICLASS, hdr.csn, sizeof(hdr.csn));
+    return PM3_SUCCESS;
+}
+#endif
+
+#ifdef WITH_LEGICRF
+static int probe_legic(hf_search_result_t *r) {
+    legic_card_select_t card;
+    int res = LegicRfSelect(&card);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    set_uid(r, HF_SEARCH_LEGIC, card.uid, sizeof(card.uid));
+    return PM3_SUCCESS;
+}
+#endif
+
+#ifdef WITH_ISO14443b
+static int probe_14b(hf_search_result_t *r) {
+    iso14b_card_select_t card;
+    memset(&card, 0, sizeof(card));
+
+    iso14443b_setup();
+    int res = iso14443b_select_card(&card);
+    if (res != 0) {
+        // SRx tags do not answer REQB
+        switch_off();
+        SpinDelay(HF_SEARCH_FIELD_OFF_MS);
+        iso14443b_setup();
+        res = iso14443b_select_srx_card(&card);
+    }
+    if (res != 0)
+        return PM3_ENODATA;
+
+    set_uid(r, HF_SEARCH_14B, card.uid, card.uidlen);
+    return PM3_SUCCESS;
+}
+#endif
+
+#ifdef WITH_FELICA
+static int probe_felica(hf_search_result_t *r) {
+    felica_card_select_t card;
+    int res = felica_poll(&card);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    set_uid(r, HF_SEARCH_FELICA, card.IDm, sizeof(card.IDm));
+    return PM3_SUCCESS;
+}
+#endif
+
+// same order as the client side `hf search`,  14b is the slowest
+static const hf_search_probe_t probes[] = {
+#ifdef WITH_NFCBARCODE
+    { HF_SEARCH_THINFILM, FPGA_BITSTREAM_HF, FIELD_14A, setup_14a, probe_thinfilm },
+#endif
+#ifdef WITH_ISO14443a
+    { HF_SEARCH_14A, FPGA_BITSTREAM_HF, FIELD_14A, setup_14a, probe_14a },
+#endif
+#ifdef WITH_ISO15693
+    { HF_SEARCH_15, FPGA_BITSTREAM_HF, FIELD_15, setup_15, probe_15 },
+#endif
+#ifdef WITH_ICLASS
+    { HF_SEARCH_ICLASS, FPGA_BITSTREAM_HF, FIELD_15, setup_15, probe_iclass },
+#endif
+#ifdef WITH_LEGICRF
+    { HF_SEARCH_LEGIC, FPGA_BITSTREAM_HF, FIELD_LEGIC, NULL, probe_legic },
+#endif
+#ifdef WITH_ISO14443b
+    { HF_SEARCH_14B, FPGA_BITSTREAM_HF, FIELD_14B, NULL, probe_14b },
+#endif
+#ifdef WITH_FELICA
+    { HF_SEARCH_FELICA, HF_SEARCH_FELICA_IMAGE, FIELD_FELICA, NULL, probe_felica },
+#endif
+};
+
+#define HF_SEARCH_PROBES  (sizeof(probes) / sizeof(probes[0]))
+
+int HfSearch(uint16_t techs, uint8_t flags, hf_search_result_t *r) {
+
+    memset(r, 0, sizeof(hf_search_result_t));
+    uint32_t start = GetTickCount();
+
+    clear_trace();
+    set_tracing(true);
+
+    int res = PM3_SUCCESS;
+    bool field_on = false;
+    hf_search_field_t field = FIELD_14A;
+    int initial = FpgaGetCurrent();
+    int loaded = initial;
+
+    // pass 0 runs the probes on the loaded image, pass 1 the others in table order,
+    // where the probes of one image are next to each other and FeliCa comes last
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        for (uint8_t i = 0; i < HF_SEARCH_PROBES; i++) {
+            const hf_search_probe_t *p = &probes[i];
+
+            if ((techs & p->tech) == 0)
+                continue;
+
+            if ((pass == 0) != (p->image == initial))
+                continue;
+
+            WDT_HIT();
+            if (BUTTON_PRESS() || data_available()) {
+                res = PM3_EOPABORTED;
+                goto OUT;
+            }
+
+            if (field_on == false || p->field != field) {
+                if (field_on) {
+                    switch_off();
+                    SpinDelay(HF_SEARCH_FIELD_OFF_MS);
+                }
+                set_tracing(true);
+                if (p->setup)
+                    p->setup();
+                field = p->field;
+                field_on = true;
+            }
+
+            r->probed |= p->tech;
+            if (p->probe(r) == PM3_SUCCESS)
+                r->found |= p->tech;
+
+            int now = FpgaGetCurrent();
+            if (now != loaded) {
+                r->reloads++;
+                loaded = now;
+            }
+
+            if (r->found && (flags & HF_SEARCH_FLAG_FIRST))
+                goto OUT;
+        }
+    }
+
+OUT:
+    switch_off();
+    BigBuf_free();
+    r->elapsed = GetTickCount() - start;
+    return res;
+}
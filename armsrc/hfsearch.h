@@ -0,0 +1,17 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Multi protocol HF search on the device
+//-----------------------------------------------------------------------------
+#ifndef __HFSEARCH_H
+#define __HFSEARCH_H
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+// techs is a mask of hf_search_tech_t,  flags HF_SEARCH_FLAG_*
+int HfSearch(uint16_t techs, uint8_t flags, hf_search_result_t *r);
+
+#endif
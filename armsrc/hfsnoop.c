@@ -17,6 +17,7 @@
 #include "fpga.h"
 #include "appmain.h"
 #include "cmd.h"
+#include "string.h"
 
 static void RAMFUNC optimizedSniff(uint16_t *dest, uint16_t dsize) {
     while (dsize > 0) {
@@ -49,7 +50,7 @@ int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len) {
     FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_SNIFF);
     SpinDelay(100);
 
-    *len = (BigBuf_max_traceLen() & 0xFFFE);
+    *len = (MIN(BigBuf_max_traceLen(), 0xFFFF) & 0xFFFE);
     uint8_t *mem = BigBuf_malloc(*len);
 
     uint32_t trigger_cnt = 0;
@@ -152,3 +153,136 @@ void HfPlotDownload(void) {
     reply_mix(CMD_ACK, 1, 0, FPGA_TRACE_SIZE, 0, 0);
     LED_B_OFF();
 }
+
+// Streams the demodulated samples of a protocol sniffer to the client instead of
+// decoding them on the ARM. The PDC fills a ring of chunks in BigBuf while the
+// completed ones go out as CMD_HF_SNIFF_RAW_DATA. When the client does not keep up
+// the oldest unsent chunk is dropped; the gap shows as a missing sequence number.
+// A stall means the PDC ran out of buffers, the samples in between are gone and
+// the capture has a time gap.
+#define HF_SNIFF_RAW_CHUNKS  48
+
+int HfSniffRaw(uint8_t proto, uint32_t *chunks, uint32_t *lost, uint32_t *stalls) {
+
+    *chunks = 0;
+    *lost = 0;
+    *stalls = 0;
+
+    LEDsoff();
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+    SetAdcMuxFor(GPIO_MUXSEL_HIPKD);
+
+    // the PDC counts samples, not bytes
+    uint16_t count = HF_SNIFF_RAW_CHUNK / sizeof(uint16_t);
+
+    switch (proto) {
+        case HF_SNIFF_RAW_14A:
+            FpgaSetupSsc(FPGA_MAJOR_MODE_HF_ISO14443A);
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_ISO14443A | FPGA_HF_ISO14443A_SNIFFER);
+            count = HF_SNIFF_RAW_CHUNK;
+            break;
+        case HF_SNIFF_RAW_14B:
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_SUBCARRIER_848_KHZ | FPGA_HF_READER_MODE_SNIFF_IQ);
+            FpgaSetupSsc(FPGA_MAJOR_MODE_HF_READER);
+            break;
+        case HF_SNIFF_RAW_15:
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SNIFF_AMPLITUDE);
+            FpgaSetupSsc(FPGA_MAJOR_MODE_HF_READER);
+            break;
+        default:
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+            return PM3_EINVARG;
+    }
+    SpinDelay(50);
+
+    uint8_t *ring = BigBuf_malloc(HF_SNIFF_RAW_CHUNK * HF_SNIFF_RAW_CHUNKS);
+    if (ring == NULL) {
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        return PM3_EMALLOC;
+    }
+
+    hf_sniff_raw_chunk_t payload;
+
+    // chunk n lives in slot n % HF_SNIFF_RAW_CHUNKS. Chunks [sent, done) are complete
+    // and wait for the client, the PDC fills chunk done and has done + 1 queued.
+    uint32_t sent = 0, done = 0, armed = 2;
+
+    FpgaDisableSscDma();
+    AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) ring;
+    AT91C_BASE_PDC_SSC->PDC_RCR = count;
+    AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)(ring + HF_SNIFF_RAW_CHUNK);
+    AT91C_BASE_PDC_SSC->PDC_RNCR = count;
+    FpgaEnableSscDma();
+
+    LED_A_ON();
+
+    int res = PM3_SUCCESS;
+    for (;;) {
+
+        // the PDC switched to its queued chunk, queue the next one
+        if (AT91C_BASE_PDC_SSC->PDC_RNCR == 0) {
+
+            // both chunks filled before we got here, the PDC stopped and has to be restarted
+            bool stopped = (AT91C_BASE_PDC_SSC->PDC_RCR == 0);
+
+            for (int i = stopped ? 2 : 1; i > 0; i--) {
+                done++;
+                if (armed - sent >= HF_SNIFF_RAW_CHUNKS) {
+                    // ring is full, the client does not keep up
+                    sent++;
+                    (*lost)++;
+                }
+                if (stopped && i == 2) {
+                    AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t)(ring + (armed % HF_SNIFF_RAW_CHUNKS) * HF_SNIFF_RAW_CHUNK);
+                    AT91C_BASE_PDC_SSC->PDC_RCR = count;
+                } else {
+                    AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)(ring + (armed % HF_SNIFF_RAW_CHUNKS) * HF_SNIFF_RAW_CHUNK);
+                    AT91C_BASE_PDC_SSC->PDC_RNCR = count;
+                }
+                armed++;
+            }
+            if (stopped)
+                (*stalls)++;
+        }
+
+        if (sent < done) {
+            LED_B_ON();
+            payload.seq = sent;
+            memcpy(payload.data, ring + (sent % HF_SNIFF_RAW_CHUNKS) * HF_SNIFF_RAW_CHUNK, HF_SNIFF_RAW_CHUNK);
+            reply_ng(CMD_HF_SNIFF_RAW_DATA, PM3_SUCCESS, (uint8_t *)&payload, sizeof(payload));
+            sent++;
+            (*chunks)++;
+            LED_B_OFF();
+        }
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        // cancel w usb command.
+        if (data_available()) {
+            break;
+        }
+    }
+
+    FpgaDisableSscDma();
+
+    // the chunks completed so far still go out
+    for (; sent < done; sent++) {
+        payload.seq = sent;
+        memcpy(payload.data, ring + (sent % HF_SNIFF_RAW_CHUNKS) * HF_SNIFF_RAW_CHUNK, HF_SNIFF_RAW_CHUNK);
+        reply_ng(CMD_HF_SNIFF_RAW_DATA, PM3_SUCCESS, (uint8_t *)&payload, sizeof(payload));
+        (*chunks)++;
+    }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    BigBuf_free();
+    return res;
+}
@@ -16,4 +16,5 @@
 
 int HfSniff(uint32_t samplesToSkip, uint32_t triggersToSkip, uint16_t *len);
 void HfPlotDownload(void);
+int HfSniffRaw(uint8_t proto, uint32_t *chunks, uint32_t *lost, uint32_t *stalls);
 #endif
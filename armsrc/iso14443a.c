@@ -104,6 +104,11 @@ static uint32_t NextTransferTime;
 static uint32_t LastTimeProxToAirStart;
 static uint32_t LastProxToAirDuration;
 
+// answers of a simulated tag which went on air later than a card answers,
+// frame delay time n * 128 + 20 / 84 carrier cycles with n > 9
+#define EM_FDT_LATE  (9 * 128 + 84)
+static uint32_t EmLateAnswers;
+
 // CARD TO READER - manchester
 // Sequence D: 11110000 modulation with subcarrier during first half
 // Sequence E: 00001111 modulation with subcarrier during second half
@@ -227,325 +232,48 @@ void GetParity(const uint8_t *pbtCmd, uint16_t len, uint8_t *par) {
 
 
 //=============================================================================
-// ISO 14443 Type A - Miller decoder
+// ISO 14443 Type A - Miller decoder, see iso14443a_decode.c
 //=============================================================================
-// Basics:
-// This decoder is used when the PM3 acts as a tag.
-// The reader will generate "pauses" by temporarily switching of the field.
-// At the PM3 antenna we will therefore measure a modulated antenna voltage.
-// The FPGA does a comparison with a threshold and would deliver e.g.:
-// ........  1 1 1 1 1 1 0 0 1 1 1 1 1 1 1 1 1 1 0 0 1 1 1 1 1 1 1 1 1 1  .......
-// The Miller decoder needs to identify the following sequences:
-// 2 (or 3) ticks pause followed by 6 (or 5) ticks unmodulated: pause at beginning - Sequence Z ("start of communication" or a "0")
-// 8 ticks without a modulation:                                no pause - Sequence Y (a "0" or "end of communication" or "no information")
-// 4 ticks unmodulated followed by 2 (or 3) ticks pause:        pause in second half - Sequence X (a "1")
-// Note 1: the bitstream may start at any time. We therefore need to sync.
-// Note 2: the interpretation of Sequence Y and Z depends on the preceding sequence.
-//-----------------------------------------------------------------------------
 static tUart14a Uart;
 
-// Lookup-Table to decide if 4 raw bits are a modulation.
-// We accept the following:
-// 0001  -   a 3 tick wide pause
-// 0011  -   a 2 tick wide pause, or a three tick wide pause shifted left
-// 0111  -   a 2 tick wide pause shifted left
-// 1001  -   a 2 tick wide pause shifted right
-static const bool Mod_Miller_LUT[] = {
-    false,  true, false, true,  false, false, false, true,
-    false,  true, false, false, false, false, false, false
-};
-#define IsMillerModulationNibble1(b) (Mod_Miller_LUT[(b & 0x000000F0) >> 4])
-#define IsMillerModulationNibble2(b) (Mod_Miller_LUT[(b & 0x0000000F)])
-
 tUart14a *GetUart14a(void) {
     return &Uart;
 }
 
 void Uart14aReset(void) {
-    Uart.state = STATE_14A_UNSYNCD;
-    Uart.bitCount = 0;
-    Uart.len = 0;                       // number of decoded data bytes
-    Uart.parityLen = 0;                 // number of decoded parity bytes
-    Uart.shiftReg = 0;                  // shiftreg to hold decoded data bits
-    Uart.parityBits = 0;                // holds 8 parity bits
-    Uart.startTime = 0;
-    Uart.endTime = 0;
-    Uart.fourBits = 0x00000000;         // clear the buffer for 4 Bits
-    Uart.posCnt = 0;
-    Uart.syncBit = 9999;
+    Uart14aStateReset(&Uart);
 }
 
 void Uart14aInit(uint8_t *data, uint8_t *par) {
-    Uart.output = data;
-    Uart.parity = par;
-    Uart14aReset();
+    Uart14aStateInit(&Uart, data, par);
 }
 
-// use parameter non_real_time to provide a timestamp. Set to 0 if the decoder should measure real time
 RAMFUNC bool MillerDecoding(uint8_t bit, uint32_t non_real_time) {
-    Uart.fourBits = (Uart.fourBits << 8) | bit;
-
-    if (Uart.state == STATE_14A_UNSYNCD) {                                           // not yet synced
-        Uart.syncBit = 9999;                                                 // not set
-
-        // 00x11111 2|3 ticks pause followed by 6|5 ticks unmodulated         Sequence Z (a "0" or "start of communication")
-        // 11111111 8 ticks unmodulation                                      Sequence Y (a "0" or "end of communication" or "no information")
-        // 111100x1 4 ticks unmodulated followed by 2|3 ticks pause           Sequence X (a "1")
-
-        // The start bit is one ore more Sequence Y followed by a Sequence Z (... 11111111 00x11111). We need to distinguish from
-        // Sequence X followed by Sequence Y followed by Sequence Z     (111100x1 11111111 00x11111)
-        // we therefore look for a ...xx1111 11111111 00x11111xxxxxx... pattern
-        // (12 '1's followed by 2 '0's, eventually followed by another '0', followed by 5 '1's)
-#define ISO14443A_STARTBIT_MASK       0x07FFEF80                            // mask is    00000111 11111111 11101111 10000000
-#define ISO14443A_STARTBIT_PATTERN    0x07FF8F80                            // pattern is 00000111 11111111 10001111 10000000
-        if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 0)) == ISO14443A_STARTBIT_PATTERN >> 0) Uart.syncBit = 7;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 1)) == ISO14443A_STARTBIT_PATTERN >> 1) Uart.syncBit = 6;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 2)) == ISO14443A_STARTBIT_PATTERN >> 2) Uart.syncBit = 5;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 3)) == ISO14443A_STARTBIT_PATTERN >> 3) Uart.syncBit = 4;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 4)) == ISO14443A_STARTBIT_PATTERN >> 4) Uart.syncBit = 3;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 5)) == ISO14443A_STARTBIT_PATTERN >> 5) Uart.syncBit = 2;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 6)) == ISO14443A_STARTBIT_PATTERN >> 6) Uart.syncBit = 1;
-        else if ((Uart.fourBits & (ISO14443A_STARTBIT_MASK >> 7)) == ISO14443A_STARTBIT_PATTERN >> 7) Uart.syncBit = 0;
-
-        if (Uart.syncBit != 9999) {                                              // found a sync bit
-            Uart.startTime = non_real_time ? non_real_time : (GetCountSspClk() & 0xfffffff8);
-            Uart.startTime -= Uart.syncBit;
-            Uart.endTime = Uart.startTime;
-            Uart.state = STATE_14A_START_OF_COMMUNICATION;
-        }
-    } else {
-
-        if (IsMillerModulationNibble1(Uart.fourBits >> Uart.syncBit)) {
-            if (IsMillerModulationNibble2(Uart.fourBits >> Uart.syncBit)) {      // Modulation in both halves - error
-                Uart14aReset();
-            } else {                                                             // Modulation in first half = Sequence Z = logic "0"
-                if (Uart.state == STATE_14A_MILLER_X) {                              // error - must not follow after X
-                    Uart14aReset();
-                } else {
-                    Uart.bitCount++;
-                    Uart.shiftReg = (Uart.shiftReg >> 1);                        // add a 0 to the shiftreg
-                    Uart.state = STATE_14A_MILLER_Z;
-                    Uart.endTime = Uart.startTime + 8 * (9 * Uart.len + Uart.bitCount + 1) - 6;
-                    if (Uart.bitCount >= 9) {                                    // if we decoded a full byte (including parity)
-                        Uart.output[Uart.len++] = (Uart.shiftReg & 0xff);
-                        Uart.parityBits <<= 1;                                   // make room for the parity bit
-                        Uart.parityBits |= ((Uart.shiftReg >> 8) & 0x01);        // store parity bit
-                        Uart.bitCount = 0;
-                        Uart.shiftReg = 0;
-                        if ((Uart.len & 0x0007) == 0) {                          // every 8 data bytes
-                            Uart.parity[Uart.parityLen++] = Uart.parityBits;     // store 8 parity bits
-                            Uart.parityBits = 0;
-                        }
-                    }
-                }
-            }
-        } else {
-            if (IsMillerModulationNibble2(Uart.fourBits >> Uart.syncBit)) {      // Modulation second half = Sequence X = logic "1"
-                Uart.bitCount++;
-                Uart.shiftReg = (Uart.shiftReg >> 1) | 0x100;                    // add a 1 to the shiftreg
-                Uart.state = STATE_14A_MILLER_X;
-                Uart.endTime = Uart.startTime + 8 * (9 * Uart.len + Uart.bitCount + 1) - 2;
-                if (Uart.bitCount >= 9) {                                        // if we decoded a full byte (including parity)
-                    Uart.output[Uart.len++] = (Uart.shiftReg & 0xff);
-                    Uart.parityBits <<= 1;                                       // make room for the new parity bit
-                    Uart.parityBits |= ((Uart.shiftReg >> 8) & 0x01);            // store parity bit
-                    Uart.bitCount = 0;
-                    Uart.shiftReg = 0;
-                    if ((Uart.len & 0x0007) == 0) {                              // every 8 data bytes
-                        Uart.parity[Uart.parityLen++] = Uart.parityBits;         // store 8 parity bits
-                        Uart.parityBits = 0;
-                    }
-                }
-            } else {                                                             // no modulation in both halves - Sequence Y
-                if (Uart.state == STATE_14A_MILLER_Z || Uart.state == STATE_14A_MILLER_Y) {    // Y after logic "0" - End of Communication
-                    Uart.state = STATE_14A_UNSYNCD;
-                    Uart.bitCount--;                                             // last "0" was part of EOC sequence
-                    Uart.shiftReg <<= 1;                                         // drop it
-                    if (Uart.bitCount > 0) {                                     // if we decoded some bits
-                        Uart.shiftReg >>= (9 - Uart.bitCount);                   // right align them
-                        Uart.output[Uart.len++] = (Uart.shiftReg & 0xff);        // add last byte to the output
-                        Uart.parityBits <<= 1;                                   // add a (void) parity bit
-                        Uart.parityBits <<= (8 - (Uart.len & 0x0007));           // left align parity bits
-                        Uart.parity[Uart.parityLen++] = Uart.parityBits;         // and store it
-                        return true;
-                    } else if (Uart.len & 0x0007) {                              // there are some parity bits to store
-                        Uart.parityBits <<= (8 - (Uart.len & 0x0007));           // left align remaining parity bits
-                        Uart.parity[Uart.parityLen++] = Uart.parityBits;         // and store them
-                    }
-                    if (Uart.len) {
-                        return true;                                             // we are finished with decoding the raw data sequence
-                    } else {
-                        Uart14aReset();                                             // Nothing received - start over
-                        return false;
-                    }
-                }
-                if (Uart.state == STATE_14A_START_OF_COMMUNICATION) {                // error - must not follow directly after SOC
-                    Uart14aReset();
-                } else {                                                         // a logic "0"
-                    Uart.bitCount++;
-                    Uart.shiftReg = (Uart.shiftReg >> 1);                        // add a 0 to the shiftreg
-                    Uart.state = STATE_14A_MILLER_Y;
-                    if (Uart.bitCount >= 9) {                                    // if we decoded a full byte (including parity)
-                        Uart.output[Uart.len++] = (Uart.shiftReg & 0xff);
-                        Uart.parityBits <<= 1;                                   // make room for the parity bit
-                        Uart.parityBits |= ((Uart.shiftReg >> 8) & 0x01);        // store parity bit
-                        Uart.bitCount = 0;
-                        Uart.shiftReg = 0;
-                        if ((Uart.len & 0x0007) == 0) {                          // every 8 data bytes
-                            Uart.parity[Uart.parityLen++] = Uart.parityBits;     // store 8 parity bits
-                            Uart.parityBits = 0;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    return false;    // not finished yet, need more data
+    return Miller14aDecode(&Uart, bit, non_real_time);
 }
 
 //=============================================================================
-// ISO 14443 Type A - Manchester decoder
+// ISO 14443 Type A - Manchester decoder, see iso14443a_decode.c
 //=============================================================================
-// Basics:
-// This decoder is used when the PM3 acts as a reader.
-// The tag will modulate the reader field by asserting different loads to it. As a consequence, the voltage
-// at the reader antenna will be modulated as well. The FPGA detects the modulation for us and would deliver e.g. the following:
-// ........ 0 0 1 1 1 1 0 0 0 0 0 0 0 0 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0 0 0 0 0 .......
-// The Manchester decoder needs to identify the following sequences:
-// 4 ticks modulated followed by 4 ticks unmodulated:     Sequence D = 1 (also used as "start of communication")
-// 4 ticks unmodulated followed by 4 ticks modulated:     Sequence E = 0
-// 8 ticks unmodulated:                                   Sequence F = end of communication
-// 8 ticks modulated:                                     A collision. Save the collision position and treat as Sequence D
-// Note 1: the bitstream may start at any time. We therefore need to sync.
-// Note 2: parameter offset is used to determine the position of the parity bits (required for the anticollision command only)
 static tDemod14a Demod;
 
-// Lookup-Table to decide if 4 raw bits are a modulation.
-// We accept three or four "1" in any position
-static const bool Mod_Manchester_LUT[] = {
-    false, false, false, false, false, false, false, true,
-    false, false, false, true,  false, true,  true,  true
-};
-
-#define IsManchesterModulationNibble1(b) (Mod_Manchester_LUT[(b & 0x00F0) >> 4])
-#define IsManchesterModulationNibble2(b) (Mod_Manchester_LUT[(b & 0x000F)])
-
 tDemod14a *GetDemod14a(void) {
     return &Demod;
 }
+
 void Demod14aReset(void) {
-    Demod.state = DEMOD_14A_UNSYNCD;
-    Demod.len = 0;                       // number of decoded data bytes
-    Demod.parityLen = 0;
-    Demod.shiftReg = 0;                  // shiftreg to hold decoded data bits
-    Demod.parityBits = 0;                //
-    Demod.collisionPos = 0;              // Position of collision bit
-    Demod.twoBits = 0xFFFF;              // buffer for 2 Bits
-    Demod.highCnt = 0;
-    Demod.startTime = 0;
-    Demod.endTime = 0;
-    Demod.bitCount = 0;
-    Demod.syncBit = 0xFFFF;
-    Demod.samples = 0;
+    Demod14aStateReset(&Demod);
 }
 
 void Demod14aInit(uint8_t *data, uint8_t *par) {
-    Demod.output = data;
-    Demod.parity = par;
-    Demod14aReset();
+    Demod14aStateInit(&Demod, data, par);
 }
 
-// use parameter non_real_time to provide a timestamp. Set to 0 if the decoder should measure real time
 RAMFUNC int ManchesterDecoding(uint8_t bit, uint16_t offset, uint32_t non_real_time) {
-    Demod.twoBits = (Demod.twoBits << 8) | bit;
-
-    if (Demod.state == DEMOD_14A_UNSYNCD) {
-
-        if (Demod.highCnt < 2) {                                            // wait for a stable unmodulated signal
-            if (Demod.twoBits == 0x0000) {
-                Demod.highCnt++;
-            } else {
-                Demod.highCnt = 0;
-            }
-        } else {
-            Demod.syncBit = 0xFFFF;            // not set
-            if ((Demod.twoBits & 0x7700) == 0x7000) Demod.syncBit = 7;
-            else if ((Demod.twoBits & 0x3B80) == 0x3800) Demod.syncBit = 6;
-            else if ((Demod.twoBits & 0x1DC0) == 0x1C00) Demod.syncBit = 5;
-            else if ((Demod.twoBits & 0x0EE0) == 0x0E00) Demod.syncBit = 4;
-            else if ((Demod.twoBits & 0x0770) == 0x0700) Demod.syncBit = 3;
-            else if ((Demod.twoBits & 0x03B8) == 0x0380) Demod.syncBit = 2;
-            else if ((Demod.twoBits & 0x01DC) == 0x01C0) Demod.syncBit = 1;
-            else if ((Demod.twoBits & 0x00EE) == 0x00E0) Demod.syncBit = 0;
-            if (Demod.syncBit != 0xFFFF) {
-                Demod.startTime = non_real_time ? non_real_time : (GetCountSspClk() & 0xfffffff8);
-                Demod.startTime -= Demod.syncBit;
-                Demod.bitCount = offset;            // number of decoded data bits
-                Demod.state = DEMOD_14A_MANCHESTER_DATA;
-            }
-        }
-    } else {
-
-        if (IsManchesterModulationNibble1(Demod.twoBits >> Demod.syncBit)) {      // modulation in first half
-            if (IsManchesterModulationNibble2(Demod.twoBits >> Demod.syncBit)) {  // ... and in second half = collision
-                if (!Demod.collisionPos) {
-                    Demod.collisionPos = (Demod.len << 3) + Demod.bitCount;
-                }
-            }                                                           // modulation in first half only - Sequence D = 1
-            Demod.bitCount++;
-            Demod.shiftReg = (Demod.shiftReg >> 1) | 0x100;             // in both cases, add a 1 to the shiftreg
-            if (Demod.bitCount == 9) {                                  // if we decoded a full byte (including parity)
-                Demod.output[Demod.len++] = (Demod.shiftReg & 0xff);
-                Demod.parityBits <<= 1;                                 // make room for the parity bit
-                Demod.parityBits |= ((Demod.shiftReg >> 8) & 0x01);     // store parity bit
-                Demod.bitCount = 0;
-                Demod.shiftReg = 0;
-                if ((Demod.len & 0x0007) == 0) {                        // every 8 data bytes
-                    Demod.parity[Demod.parityLen++] = Demod.parityBits; // store 8 parity bits
-                    Demod.parityBits = 0;
-                }
-            }
-            Demod.endTime = Demod.startTime + 8 * (9 * Demod.len + Demod.bitCount + 1) - 4;
-        } else {                                                        // no modulation in first half
-            if (IsManchesterModulationNibble2(Demod.twoBits >> Demod.syncBit)) {    // and modulation in second half = Sequence E = 0
-                Demod.bitCount++;
-                Demod.shiftReg = (Demod.shiftReg >> 1);                 // add a 0 to the shiftreg
-                if (Demod.bitCount >= 9) {                              // if we decoded a full byte (including parity)
-                    Demod.output[Demod.len++] = (Demod.shiftReg & 0xff);
-                    Demod.parityBits <<= 1;                             // make room for the new parity bit
-                    Demod.parityBits |= ((Demod.shiftReg >> 8) & 0x01); // store parity bit
-                    Demod.bitCount = 0;
-                    Demod.shiftReg = 0;
-                    if ((Demod.len & 0x0007) == 0) {                    // every 8 data bytes
-                        Demod.parity[Demod.parityLen++] = Demod.parityBits;    // store 8 parity bits1
-                        Demod.parityBits = 0;
-                    }
-                }
-                Demod.endTime = Demod.startTime + 8 * (9 * Demod.len + Demod.bitCount + 1);
-            } else {                                                    // no modulation in both halves - End of communication
-                if (Demod.bitCount > 0) {                               // there are some remaining data bits
-                    Demod.shiftReg >>= (9 - Demod.bitCount);            // right align the decoded bits
-                    Demod.output[Demod.len++] = Demod.shiftReg & 0xff;  // and add them to the output
-                    Demod.parityBits <<= 1;                             // add a (void) parity bit
-                    Demod.parityBits <<= (8 - (Demod.len & 0x0007));    // left align remaining parity bits
-                    Demod.parity[Demod.parityLen++] = Demod.parityBits; // and store them
-                    return true;
-                } else if (Demod.len & 0x0007) {                        // there are some parity bits to store
-                    Demod.parityBits <<= (8 - (Demod.len & 0x0007));    // left align remaining parity bits
-                    Demod.parity[Demod.parityLen++] = Demod.parityBits; // and store them
-                }
-                if (Demod.len) {
-                    return true;                                        // we are finished with decoding the raw data sequence
-                } else {                                                // nothing received. Start over
-                    Demod14aReset();
-                }
-            }
-        }
-    }
-    return false;    // not finished yet, need more data
+    return Manchester14aDecode(&Demod, bit, offset, non_real_time);
 }
 
-
+//=============================================================================
 // Thinfilm, Kovio mangels ISO14443A in the way that they don't use start bit nor parity bits.
 static RAMFUNC int ManchesterDecoding_Thinfilm(uint8_t bit) {
     Demod.twoBits = (Demod.twoBits << 8) | bit;
@@ -724,7 +452,7 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
 
             if (!TagIsActive) {        // no need to try decoding reader data if the tag is sending
                 uint8_t readerdata = (previous_data & 0xF0) | (*data >> 4);
-                if (MillerDecoding(readerdata, (rx_samples - 1) * 4)) {
+                if (Miller14aDecode(&Uart, readerdata, (rx_samples - 1) * 4)) {
                     LED_C_ON();
 
                     // check - if there is a short 7bit request from reader
@@ -751,7 +479,7 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
             // no need to try decoding tag data if the reader is sending - and we cannot afford the time
             if (!ReaderIsActive) {
                 uint8_t tagdata = (previous_data << 4) | (*data & 0x0F);
-                if (ManchesterDecoding(tagdata, 0, (rx_samples - 1) * 4)) {
+                if (Manchester14aDecode(&Demod, tagdata, 0, (rx_samples - 1) * 4)) {
                     LED_B_ON();
 
                     if (!LogTrace(receivedResp,
@@ -940,7 +668,7 @@ bool GetIso14443aCommandFromReader(uint8_t *received, uint8_t *par, int *len) {
 
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
-            if (MillerDecoding(b, 0)) {
+            if (Miller14aDecode(&Uart, b, 0)) {
                 *len = Uart.len;
                 return true;
             }
@@ -981,6 +709,32 @@ bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffe
     return true;
 }
 
+// The modulation of prepare_tag_modulation() built one byte at a time with the parity passed in,
+// lets a simulation encode an encrypted answer in small steps. The modulation buffer needs
+// TAG_MODULATION_SIZE(len) bytes
+void prepare_tag_modulation_begin(tag_response_info_t *response_info) {
+    // correction bit and start bit,  see CodeIso14443aAsTagPar()
+    response_info->modulation[0] = 0x08;
+    response_info->modulation[1] = SEC_D;
+}
+
+void prepare_tag_modulation_byte(tag_response_info_t *response_info, uint16_t i, uint8_t b, bool parity) {
+    uint8_t *m = response_info->modulation + 2 + 9 * i;
+    for (uint8_t j = 0; j < 8; j++) {
+        m[j] = (b & 1) ? SEC_D : SEC_E;
+        b >>= 1;
+    }
+    m[8] = parity ? SEC_D : SEC_E;
+}
+
+void prepare_tag_modulation_end(tag_response_info_t *response_info, uint16_t len) {
+    uint16_t last = 9 * len + 1;
+    response_info->modulation[last + 1] = SEC_F;
+    response_info->modulation_n = TAG_MODULATION_SIZE(len);
+    response_info->ProxToAirDuration = 8 * last - ((response_info->modulation[last] == SEC_D) ? 4 : 0);
+    response_info->response_n = len;
+}
+
 bool prepare_allocated_tag_modulation(tag_response_info_t *response_info, uint8_t **buffer, size_t *max_buffer_size) {
 
     tosend_t *ts = get_tosend();
@@ -1953,6 +1707,12 @@ static void CodeIso14443aAsReaderPar(const uint8_t *cmd, uint16_t len, const uin
 // Or return 0 when command is captured
 //-----------------------------------------------------------------------------
 int EmGetCmd(uint8_t *received, uint16_t *len, uint8_t *par) {
+    return EmGetCmdEx(received, len, par, NULL);
+}
+
+// idle is called whenever no sample is pending and no reader frame is on its way,
+// it must return well within the 128 carrier cycles of one sample
+int EmGetCmdEx(uint8_t *received, uint16_t *len, uint8_t *par, void (*idle)(void)) {
     *len = 0;
 
     uint32_t timer = 0;
@@ -2030,10 +1790,12 @@ int EmGetCmd(uint8_t *received, uint16_t *len, uint8_t *par) {
         // receive and test the miller decoding
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
-            if (MillerDecoding(b, 0)) {
+            if (Miller14aDecode(&Uart, b, 0)) {
                 *len = Uart.len;
                 return 0;
             }
+        } else if (idle != NULL && Uart.state == STATE_14A_UNSYNCD) {
+            idle();
         }
     }
 }
@@ -2092,9 +1854,22 @@ int EmSendCmd14443aRaw(uint8_t *resp, uint16_t respLen) {
         }
     }
     LastTimeProxToAirStart = ThisTransferTime + (correction_needed ? 8 : 0);
+
+    uint32_t fdt = (LastTimeProxToAirStart * 16 + DELAY_ARM2AIR_AS_TAG) - (Uart.endTime * 16 - DELAY_AIR2ARM_AS_TAG);
+    if (((fdt - 20 + 32) / 64 * 64 + 20) > EM_FDT_LATE) {
+        EmLateAnswers++;
+    }
     return 0;
 }
 
+void EmResetLateAnswers(void) {
+    EmLateAnswers = 0;
+}
+
+uint32_t EmGetLateAnswers(void) {
+    return EmLateAnswers;
+}
+
 int EmSend4bit(uint8_t resp) {
     Code4bitAnswerAsTag(resp);
     tosend_t *ts = get_tosend();
@@ -2146,10 +1921,16 @@ int EmSendCmdEx(uint8_t *resp, uint16_t respLen, bool collision) {
 
 int EmSendPrecompiledCmd(tag_response_info_t *p_response) {
     if (p_response == NULL) return 0;
-    int ret = EmSendCmd14443aRaw(p_response->modulation, p_response->modulation_n);
-    // do the tracing for the previous reader request and this tag answer:
     uint8_t par[MAX_PARITY_SIZE] = {0x00};
     GetParity(p_response->response, p_response->response_n, par);
+    return EmSendPrecompiledCmdPar(p_response, par);
+}
+
+// par is only used for the trace,  encrypted answers do not have the parity of their data
+int EmSendPrecompiledCmdPar(tag_response_info_t *p_response, uint8_t *par) {
+    if (p_response == NULL) return 0;
+    int ret = EmSendCmd14443aRaw(p_response->modulation, p_response->modulation_n);
+    // do the tracing for the previous reader request and this tag answer:
 
     EmLogTrace(Uart.output,
                Uart.len,
@@ -2265,7 +2046,7 @@ static int GetIso14443aAnswerFromTag(uint8_t *receivedResponse, uint8_t *receive
 
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
-            if (ManchesterDecoding(b, offset, 0)) {
+            if (Manchester14aDecode(&Demod, b, offset, 0)) {
                 NextTransferTime = MAX(NextTransferTime, Demod.endTime - (DELAY_AIR2ARM_AS_READER + DELAY_ARM2AIR_AS_READER) / 16 + FRAME_DELAY_TIME_PICC_TO_PCD);
                 return true;
             } else if (c++ > timeout && Demod.state == DEMOD_14A_UNSYNCD) {
@@ -17,6 +17,7 @@
 #include "mifare.h" // struct
 #include "pm3_cmd.h"
 #include "crc16.h"  // compute_crc
+#include "iso14443a_decode.h"
 
 // When the PM acts as tag and is receiving it takes
 // 2 ticks delay in the RF part (for the first falling edge),
@@ -29,61 +30,6 @@
 // - 8*16 ticks because we measure the time of the previous transfer
 #define DELAY_AIR2ARM_AS_TAG (2 + 3 + 8 + 8 + 7*16 + 8 + 4*16 - 8*16)
 
-typedef struct {
-    enum {
-        DEMOD_14A_UNSYNCD,
-        // DEMOD_14A_HALF_SYNCD,
-        // DEMOD_14A_MOD_FIRST_HALF,
-        // DEMOD_14A_NOMOD_FIRST_HALF,
-        DEMOD_14A_MANCHESTER_DATA
-    } state;
-    uint16_t twoBits;
-    uint16_t highCnt;
-    uint16_t bitCount;
-    uint16_t collisionPos;
-    uint16_t syncBit;
-    uint8_t  parityBits;
-    uint8_t  parityLen;
-    uint16_t shiftReg;
-    uint16_t samples;
-    uint16_t len;
-    uint32_t startTime, endTime;
-    uint8_t  *output;
-    uint8_t  *parity;
-} tDemod14a;
-/*
-typedef enum {
-    MOD_NOMOD = 0,
-    MOD_SECOND_HALF,
-    MOD_FIRST_HALF,
-    MOD_BOTH_HALVES
-    } Modulation_t;
-*/
-
-typedef struct {
-    enum {
-        STATE_14A_UNSYNCD,
-        STATE_14A_START_OF_COMMUNICATION,
-        STATE_14A_MILLER_X,
-        STATE_14A_MILLER_Y,
-        STATE_14A_MILLER_Z,
-        // DROP_NONE,
-        // DROP_FIRST_HALF,
-    } state;
-    uint16_t shiftReg;
-    int16_t bitCount;
-    uint16_t len;
-    //uint16_t byteCntMax;
-    uint16_t posCnt;
-    uint16_t syncBit;
-    uint8_t  parityBits;
-    uint8_t  parityLen;
-    uint32_t fourBits;
-    uint32_t startTime, endTime;
-    uint8_t *output;
-    uint8_t *parity;
-} tUart14a;
-
 // indices into responses array:
 typedef enum {
     RESP_INDEX_ATQA,
@@ -150,13 +96,23 @@ int EmSend4bit(uint8_t resp);
 int EmSendCmd(uint8_t *resp, uint16_t respLen);
 int EmSendCmdEx(uint8_t *resp, uint16_t respLen, bool collision);
 int EmGetCmd(uint8_t *received, uint16_t *len, uint8_t *par);
+int EmGetCmdEx(uint8_t *received, uint16_t *len, uint8_t *par, void (*idle)(void));
 int EmSendCmdPar(uint8_t *resp, uint16_t respLen, uint8_t *par);
 int EmSendCmdParEx(uint8_t *resp, uint16_t respLen, uint8_t *par, bool collision);
 int EmSendPrecompiledCmd(tag_response_info_t *p_response);
+int EmSendPrecompiledCmdPar(tag_response_info_t *p_response, uint8_t *par);
+void EmResetLateAnswers(void);
+uint32_t EmGetLateAnswers(void);
 
 bool prepare_allocated_tag_modulation(tag_response_info_t *response_info, uint8_t **buffer, size_t *max_buffer_size);
 bool prepare_tag_modulation(tag_response_info_t *response_info, size_t max_buffer_size);
 
+// correction bit, start bit, 9 per byte, stop bit
+#define TAG_MODULATION_SIZE(len)  (2 + 9 * (len) + 1)
+void prepare_tag_modulation_begin(tag_response_info_t *response_info);
+void prepare_tag_modulation_byte(tag_response_info_t *response_info, uint16_t i, uint8_t b, bool parity);
+void prepare_tag_modulation_end(tag_response_info_t *response_info, uint16_t len);
+
 bool EmLogTrace(uint8_t *reader_data, uint16_t reader_len, uint32_t reader_StartTime, uint32_t reader_EndTime, uint8_t *reader_Parity,
                 uint8_t *tag_data, uint16_t tag_len, uint32_t tag_StartTime, uint32_t tag_EndTime, uint8_t *tag_Parity);
 
@@ -25,6 +25,7 @@
 #include "dbprint.h"
 #include "ticks.h"
 #include "iso14b.h"       // defines for ETU conversions
+#include "iso14443b_decode.h"
 
 /*
 * Current timing issues with ISO14443-b implementation
@@ -399,33 +400,14 @@ static void CodeIso14443bAsTag(const uint8_t *cmd, int len) {
 // The software UART that receives commands from the reader, and its state
 // variables.
 //-----------------------------------------------------------------------------
-static struct {
-    enum {
-        STATE_14B_UNSYNCD,
-        STATE_14B_GOT_FALLING_EDGE_OF_SOF,
-        STATE_14B_AWAITING_START_BIT,
-        STATE_14B_RECEIVING_DATA
-    }       state;
-    uint16_t shiftReg;
-    int      bitCnt;
-    int      byteCnt;
-    int      byteCntMax;
-    int      posCnt;
-    uint8_t  *output;
-} Uart;
-
-static void Uart14bReset(void) {
-    Uart.state = STATE_14B_UNSYNCD;
-    Uart.shiftReg = 0;
-    Uart.bitCnt = 0;
-    Uart.byteCnt = 0;
-    Uart.byteCntMax = MAX_FRAME_SIZE;
-    Uart.posCnt = 0;
+static tUart14b Uart;
+
+static inline void Uart14bReset(void) {
+    Uart14bStateReset(&Uart);
 }
 
-static void Uart14bInit(uint8_t *data) {
-    Uart.output = data;
-    Uart14bReset();
+static inline void Uart14bInit(uint8_t *data) {
+    Uart14bStateInit(&Uart, data);
 }
 
 // param timeout accepts ETU
@@ -460,178 +442,15 @@ static void iso14b_set_maxframesize(uint16_t size) {
 // The software Demod that receives commands from the tag, and its state variables.
 //-----------------------------------------------------------------------------
 
-#define NOISE_THRESHOLD          80                   // don't try to correlate noise
-#define MAX_PREVIOUS_AMPLITUDE   (-1 - NOISE_THRESHOLD)
-
-static struct {
-    enum {
-        DEMOD_UNSYNCD,
-        DEMOD_PHASE_REF_TRAINING,
-        WAIT_FOR_RISING_EDGE_OF_SOF,
-        DEMOD_AWAITING_START_BIT,
-        DEMOD_RECEIVING_DATA
-    }       state;
-    uint16_t bitCount;
-    int      posCount;
-    int      thisBit;
-    uint16_t shiftReg;
-    uint16_t max_len;
-    uint8_t  *output;
-    uint16_t len;
-    int      sumI;
-    int      sumQ;
-} Demod;
+static tDemod14b Demod;
 
 // Clear out the state of the "UART" that receives from the tag.
-static void Demod14bReset(void) {
-    Demod.state = DEMOD_UNSYNCD;
-    Demod.bitCount = 0;
-    Demod.posCount = 0;
-    Demod.thisBit = 0;
-    Demod.shiftReg = 0;
-    Demod.len = 0;
-    Demod.sumI = 0;
-    Demod.sumQ = 0;
+static inline void Demod14bReset(void) {
+    Demod14bStateReset(&Demod);
 }
 
-static void Demod14bInit(uint8_t *data, uint16_t max_len) {
-    Demod.output = data;
-    Demod.max_len = max_len;
-    Demod14bReset();
-}
-
-/* Receive & handle a bit coming from the reader.
- *
- * This function is called 4 times per bit (every 2 subcarrier cycles).
- * Subcarrier frequency fs is 848kHz, 1/fs = 1,18us, i.e. function is called every 2,36us
- *
- * LED handling:
- * LED A -> ON once we have received the SOF and are expecting the rest.
- * LED A -> OFF once we have received EOF or are in error state or unsynced
- *
- * Returns: true if we received a EOF
- *          false if we are still waiting for some more
- */
-static RAMFUNC int Handle14443bSampleFromReader(uint8_t bit) {
-    switch (Uart.state) {
-        case STATE_14B_UNSYNCD:
-            if (bit == false) {
-                // we went low, so this could be the beginning of an SOF
-                Uart.state = STATE_14B_GOT_FALLING_EDGE_OF_SOF;
-                Uart.posCnt = 0;
-                Uart.bitCnt = 0;
-            }
-            break;
-
-        case STATE_14B_GOT_FALLING_EDGE_OF_SOF:
-            Uart.posCnt++;
-
-            if (Uart.posCnt == 2) { // sample every 4 1/fs in the middle of a bit
-
-                if (bit) {
-                    if (Uart.bitCnt > 9) {
-                        // we've seen enough consecutive
-                        // zeros that it's a valid SOF
-                        Uart.posCnt = 0;
-                        Uart.byteCnt = 0;
-                        Uart.state = STATE_14B_AWAITING_START_BIT;
-                        LED_A_ON(); // Indicate we got a valid SOF
-                    } else {
-                        // didn't stay down long enough before going high, error
-                        Uart.state = STATE_14B_UNSYNCD;
-                    }
-                } else {
-                    // do nothing, keep waiting
-                }
-                Uart.bitCnt++;
-            }
-
-            if (Uart.posCnt >= 4) {
-                Uart.posCnt = 0;
-            }
-
-            if (Uart.bitCnt > 12) {
-                // Give up if we see too many zeros without a one, too.
-                LED_A_OFF();
-                Uart.state = STATE_14B_UNSYNCD;
-            }
-            break;
-
-        case STATE_14B_AWAITING_START_BIT:
-            Uart.posCnt++;
-
-            if (bit) {
-
-                // max 57us between characters = 49 1/fs,
-                // max 3 etus after low phase of SOF = 24 1/fs
-                if (Uart.posCnt > 50 / 2) {
-                    // stayed high for too long between characters, error
-                    Uart.state = STATE_14B_UNSYNCD;
-                }
-
-            } else {
-                // falling edge, this starts the data byte
-                Uart.posCnt = 0;
-                Uart.bitCnt = 0;
-                Uart.shiftReg = 0;
-                Uart.state = STATE_14B_RECEIVING_DATA;
-            }
-            break;
-
-        case STATE_14B_RECEIVING_DATA:
-
-            Uart.posCnt++;
-
-            if (Uart.posCnt == 2) {
-                // time to sample a bit
-                Uart.shiftReg >>= 1;
-                if (bit) {
-                    Uart.shiftReg |= 0x200;
-                }
-                Uart.bitCnt++;
-            }
-
-            if (Uart.posCnt >= 4) {
-                Uart.posCnt = 0;
-            }
-
-            if (Uart.bitCnt == 10) {
-                if ((Uart.shiftReg & 0x200) && !(Uart.shiftReg & 0x001)) {
-                    // this is a data byte, with correct
-                    // start and stop bits
-                    Uart.output[Uart.byteCnt] = (Uart.shiftReg >> 1) & 0xFF;
-                    Uart.byteCnt++;
-
-                    if (Uart.byteCnt >= Uart.byteCntMax) {
-                        // Buffer overflowed, give up
-                        LED_A_OFF();
-                        Uart.state = STATE_14B_UNSYNCD;
-                    } else {
-                        // so get the next byte now
-                        Uart.posCnt = 0;
-                        Uart.state = STATE_14B_AWAITING_START_BIT;
-                    }
-                } else if (Uart.shiftReg == 0x000) {
-                    // this is an EOF byte
-                    LED_A_OFF(); // Finished receiving
-                    Uart.state = STATE_14B_UNSYNCD;
-                    if (Uart.byteCnt != 0)
-                        return true;
-
-                } else {
-                    // this is an error
-                    LED_A_OFF();
-                    Uart.state = STATE_14B_UNSYNCD;
-                }
-            }
-            break;
-
-        default:
-            LED_A_OFF();
-            Uart.state = STATE_14B_UNSYNCD;
-            break;
-    }
-    return false;
+static inline void Demod14bInit(uint8_t *data, uint16_t max_len) {
+    Demod14bStateInit(&Demod, data, max_len);
 }
 
 //-----------------------------------------------------------------------------
@@ -659,7 +478,7 @@ static int GetIso14443bCommandFromReader(uint8_t *received, uint16_t *len) {
         if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
             uint8_t b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
             for (uint8_t mask = 0x80; mask != 0x00; mask >>= 1) {
-                if (Handle14443bSampleFromReader(b & mask)) {
+                if (Handle14443bSampleFromReader(&Uart, b & mask)) {
                     *len = Uart.byteCnt;
                     return true;
                 }
@@ -1090,198 +909,6 @@ void Simulate_iso14443b_srx_tag(uint8_t *uid) {
 // xxxxxxxxxxxxxxxx111111111111111111111-0........1-0........1-0........1-1-0........1-0........1-000000000000xxxxxxx
 //                 SOF?                  start-stop  ^^^^^^^^byte         ^ occasional stuff bit  EOF
 
-/*
- * Handles reception of a bit from the tag
- *
- * This function is called 2 times per bit (every 4 subcarrier cycles).
- * Subcarrier frequency fs is 848kHz, 1/fs = 1,18us, i.e. function is called every 4,72us
- *
- * LED handling:
- * LED C -> ON once we have received the SOF and are expecting the rest.
- * LED C -> OFF once we have received EOF or are unsynced
- *
- * Returns: true if we received a EOF
- *          false if we are still waiting for some more
- *
- */
-static RAMFUNC int Handle14443bSamplesFromTag(int ci, int cq) {
-
-    int v = 0;
-
-// The soft decision on the bit uses an estimate of just the
-// quadrant of the reference angle, not the exact angle.
-#define MAKE_SOFT_DECISION() { \
-        if(Demod.sumI > 0) { \
-            v = ci; \
-        } else { \
-            v = -ci; \
-        } \
-        if(Demod.sumQ > 0) { \
-            v += cq; \
-        } else { \
-            v -= cq; \
-        } \
-    }
-
-#define SUBCARRIER_DETECT_THRESHOLD  8
-// Subcarrier amplitude v = sqrt(ci^2 + cq^2), approximated here by max(abs(ci),abs(cq)) + 1/2*min(abs(ci),abs(cq)))
-#define AMPLITUDE(ci,cq) (MAX(ABS(ci),ABS(cq)) + (MIN(ABS(ci),ABS(cq))/2))
-
-    switch (Demod.state) {
-
-        case DEMOD_UNSYNCD: {
-            if (AMPLITUDE(ci, cq) > SUBCARRIER_DETECT_THRESHOLD) {  // subcarrier detected
-                Demod.state = DEMOD_PHASE_REF_TRAINING;
-                Demod.sumI = ci;
-                Demod.sumQ = cq;
-                Demod.posCount = 1;
-            }
-            break;
-        }
-        case DEMOD_PHASE_REF_TRAINING: {
-            // While we get a constant signal
-            if (AMPLITUDE(ci, cq) > SUBCARRIER_DETECT_THRESHOLD) {
-                if (((ABS(Demod.sumI) > ABS(Demod.sumQ)) && (((ci > 0) && (Demod.sumI > 0)) || ((ci < 0) && (Demod.sumI < 0)))) ||  // signal closer to horizontal, polarity check based on on I
-                        ((ABS(Demod.sumI) <= ABS(Demod.sumQ)) && (((cq > 0) && (Demod.sumQ > 0)) || ((cq < 0) && (Demod.sumQ < 0))))) { // signal closer to vertical, polarity check based on on Q
-
-                    if (Demod.posCount < 10) {  // refine signal approximation during first 10 samples
-                        Demod.sumI += ci;
-                        Demod.sumQ += cq;
-                    }
-                    Demod.posCount += 1;
-                } else {
-                    // transition
-                    if (Demod.posCount < 10) {
-                        // subcarrier lost
-                        Demod.state = DEMOD_UNSYNCD;
-                        break;
-                    } else {
-                        // at this point it can be start of 14b' data or start of 14b SOF
-                        MAKE_SOFT_DECISION();
-                        Demod.posCount = 1;             // this was the first half
-                        Demod.thisBit = v;
-                        Demod.shiftReg = 0;
-                        Demod.state = DEMOD_RECEIVING_DATA;
-                    }
-                }
-            } else {
-                // subcarrier lost
-                Demod.state = DEMOD_UNSYNCD;
-            }
-            break;
-        }
-        case DEMOD_AWAITING_START_BIT: {
-            Demod.posCount++;
-            MAKE_SOFT_DECISION();
-            if (v > 0) {
-                if (Demod.posCount > 3 * 2) {       // max 19us between characters = 16 1/fs, max 3 etu after low phase of SOF = 24 1/fs
-                    LED_C_OFF();
-                    if (Demod.bitCount == 0 && Demod.len == 0) { // received SOF only, this is valid for iClass/Picopass
-                        return true;
-                    } else {
-                        Demod.state = DEMOD_UNSYNCD;
-                    }
-                }
-            } else {                            // start bit detected
-                Demod.posCount = 1;             // this was the first half
-                Demod.thisBit = v;
-                Demod.shiftReg = 0;
-                Demod.state = DEMOD_RECEIVING_DATA;
-            }
-            break;
-        }
-        case WAIT_FOR_RISING_EDGE_OF_SOF: {
-
-            Demod.posCount++;
-            MAKE_SOFT_DECISION();
-            if (v > 0) {
-                if (Demod.posCount < 9 * 2) { // low phase of SOF too short (< 9 etu). Note: spec is >= 10, but FPGA tends to "smear" edges
-                    Demod.state = DEMOD_UNSYNCD;
-                } else {
-                    LED_C_ON(); // Got SOF
-                    Demod.posCount = 0;
-                    Demod.bitCount = 0;
-                    Demod.len = 0;
-                    Demod.state = DEMOD_AWAITING_START_BIT;
-                }
-            } else {
-                if (Demod.posCount > 12 * 2) { // low phase of SOF too long (> 12 etu)
-                    Demod.state = DEMOD_UNSYNCD;
-                    LED_C_OFF();
-                }
-            }
-            break;
-        }
-        case DEMOD_RECEIVING_DATA: {
-
-            MAKE_SOFT_DECISION();
-
-            if (Demod.posCount == 0) {          // first half of bit
-                Demod.thisBit = v;
-                Demod.posCount = 1;
-            } else {                            // second half of bit
-                Demod.thisBit += v;
-
-                Demod.shiftReg >>= 1;
-                if (Demod.thisBit > 0) {    // logic '1'
-                    Demod.shiftReg |= 0x200;
-                }
-
-                Demod.bitCount++;
-                if (Demod.bitCount == 10) {
-
-                    uint16_t s = Demod.shiftReg;
-
-                    if ((s & 0x200) && !(s & 0x001)) { // stop bit == '1', start bit == '0'
-                        Demod.output[Demod.len] = (s >> 1);
-                        Demod.len++;
-                        Demod.bitCount = 0;
-                        Demod.state = DEMOD_AWAITING_START_BIT;
-                    } else {
-                        if (s == 0x000) {
-                            if (Demod.len > 0) {
-                                LED_C_OFF();
-                                // This is EOF (start, stop and all data bits == '0'
-                                return true;
-                            } else {
-                                // Zeroes but no data acquired yet?
-                                // => Still in SOF of 14b, wait for raising edge
-                                Demod.posCount = 10 * 2;
-                                Demod.bitCount = 0;
-                                Demod.len = 0;
-                                Demod.state = WAIT_FOR_RISING_EDGE_OF_SOF;
-                                break;
-                            }
-                        }
-                        if (AMPLITUDE(ci, cq) < SUBCARRIER_DETECT_THRESHOLD) {
-                            LED_C_OFF();
-                            // subcarrier lost
-                            Demod.state = DEMOD_UNSYNCD;
-                            if (Demod.len > 0) { // no EOF but no signal anymore and we got data, e.g. ASK CTx
-                                return true;
-                            }
-                        }
-                        // we have still signal but no proper byte or EOF? this shouldn't happen
-                        //Demod.posCount = 10 * 2;
-                        Demod.bitCount = 0;
-                        Demod.len = 0;
-                        Demod.state = WAIT_FOR_RISING_EDGE_OF_SOF;
-                        break;
-                    }
-                }
-                Demod.posCount = 0;
-            }
-            break;
-        }
-        default: {
-            Demod.state = DEMOD_UNSYNCD;
-            LED_C_OFF();
-            break;
-        }
-    }
-    return false;
-}
-
 /*
  *  Demodulate the samples we received from the tag, also log to tracebuffer
  */
@@ -1350,7 +977,7 @@ static int Get14443bAnswerFromTag(uint8_t *response, uint16_t max_len, uint32_t
             }
         }
 
-        if (Handle14443bSamplesFromTag(ci, cq)) {
+        if (Handle14443bSamplesFromTag(&Demod, ci, cq)) {
 
             *eof_time = GetCountSspClkDelta(dma_start_time) - DELAY_TAG_TO_ARM;  // end of EOF
 
@@ -1688,7 +1315,7 @@ static int iso14443b_select_cts_card(iso14b_cts_card_select_t *card) {
 /**
 * SRx Initialise.
 */
-static int iso14443b_select_srx_card(iso14b_card_select_t *card) {
+int iso14443b_select_srx_card(iso14b_card_select_t *card) {
     // INITIATE command: wake up the tag using the INITIATE
     static const uint8_t init_srx[] = { ISO14443B_INITIATE, 0x00, 0x97, 0x5b };
     uint8_t r_init[3] = {0x0};
@@ -2083,7 +1710,7 @@ void SniffIso14443b(void) {
         // no need to try decoding reader data if the tag is sending
         if (tag_is_active == false) {
 
-            if (Handle14443bSampleFromReader(ci & 0x01)) {
+            if (Handle14443bSampleFromReader(&Uart, ci & 0x01)) {
                 uint32_t eof_time = dma_start_time + (samples * 16) + 8; // - DELAY_READER_TO_ARM_SNIFF; // end of EOF
                 if (Uart.byteCnt > 0) {
                     uint32_t sof_time = eof_time
@@ -2098,7 +1725,7 @@ void SniffIso14443b(void) {
                 expect_tag_answer = true;
             }
 
-            if (Handle14443bSampleFromReader(cq & 0x01)) {
+            if (Handle14443bSampleFromReader(&Uart, cq & 0x01)) {
 
                 uint32_t eof_time = dma_start_time + (samples * 16) + 16; // - DELAY_READER_TO_ARM_SNIFF; // end of EOF
                 if (Uart.byteCnt > 0) {
@@ -2120,7 +1747,7 @@ void SniffIso14443b(void) {
         // no need to try decoding tag data if the reader is sending - and we cannot afford the time
         if (reader_is_active == false && expect_tag_answer) {
 
-            if (Handle14443bSamplesFromTag((ci >> 1), (cq >> 1))) {
+            if (Handle14443bSamplesFromTag(&Demod, (ci >> 1), (cq >> 1))) {
 
                 uint32_t eof_time = dma_start_time + (samples * 16); // - DELAY_TAG_TO_ARM_SNIFF; // end of EOF
                 uint32_t sof_time = eof_time
@@ -58,6 +58,7 @@
 #include "util.h"
 #include "string.h"
 #include "iso15693tools.h"
+#include "iso15693_decode.h"
 #include "protocols.h"
 #include "cmd.h"
 #include "appmain.h"
@@ -355,292 +356,6 @@ void TransmitTo15693Reader(const uint8_t *cmd, size_t len, uint32_t *start_time,
     LED_C_OFF();
 }
 
-//=============================================================================
-// An ISO 15693 decoder for tag responses (one subcarrier only).
-// Uses cross correlation to identify each bit and EOF.
-// This function is called 8 times per bit (every 2 subcarrier cycles).
-// Subcarrier frequency fs is 424kHz, 1/fs = 2,36us,
-// i.e. function is called every 4,72us
-// LED handling:
-//    LED C -> ON once we have received the SOF and are expecting the rest.
-//    LED C -> OFF once we have received EOF or are unsynced
-//
-// Returns: true if we received a EOF
-//          false if we are still waiting for some more
-//=============================================================================
-
-#define NOISE_THRESHOLD          80                   // don't try to correlate noise
-#define MAX_PREVIOUS_AMPLITUDE   (-1 - NOISE_THRESHOLD)
-
-typedef struct {
-    enum {
-        STATE_TAG_SOF_LOW,
-        STATE_TAG_SOF_RISING_EDGE,
-        STATE_TAG_SOF_HIGH,
-        STATE_TAG_SOF_HIGH_END,
-        STATE_TAG_RECEIVING_DATA,
-        STATE_TAG_EOF,
-        STATE_TAG_EOF_TAIL
-    } state;
-    int bitCount;
-    int posCount;
-    enum {
-        LOGIC0,
-        LOGIC1,
-        SOF_PART1,
-        SOF_PART2
-    } lastBit;
-    uint16_t shiftReg;
-    uint16_t max_len;
-    uint8_t *output;
-    int len;
-    int sum1;
-    int sum2;
-    int threshold_sof;
-    int threshold_half;
-    uint16_t  previous_amplitude;
-} DecodeTag_t;
-
-//-----------------------------------------------------------------------------
-// DEMODULATE tag answer
-//-----------------------------------------------------------------------------
-static RAMFUNC int Handle15693SamplesFromTag(uint16_t amplitude, DecodeTag_t *tag) {
-
-    switch (tag->state) {
-
-        case STATE_TAG_SOF_LOW: {
-            // waiting for a rising edge
-            if (amplitude > NOISE_THRESHOLD + tag->previous_amplitude) {
-                if (tag->posCount > 10) {
-                    tag->threshold_sof = amplitude - tag->previous_amplitude; // to be divided by 2
-                    tag->threshold_half = 0;
-                    tag->state = STATE_TAG_SOF_RISING_EDGE;
-                } else {
-                    tag->posCount = 0;
-                }
-            } else {
-                tag->posCount++;
-                tag->previous_amplitude = amplitude;
-            }
-            break;
-        }
-
-        case STATE_TAG_SOF_RISING_EDGE: {
-            if (amplitude > tag->threshold_sof + tag->previous_amplitude) { // edge still rising
-                if (amplitude > tag->threshold_sof + tag->threshold_sof) { // steeper edge, take this as time reference
-                    tag->posCount = 1;
-                } else {
-                    tag->posCount = 2;
-                }
-                tag->threshold_sof = (amplitude - tag->previous_amplitude) / 2;
-            } else {
-                tag->posCount = 2;
-                tag->threshold_sof = tag->threshold_sof / 2;
-            }
-            tag->state = STATE_TAG_SOF_HIGH;
-            break;
-        }
-
-        case STATE_TAG_SOF_HIGH: {
-            // waiting for 10 times high. Take average over the last 8
-            if (amplitude > tag->threshold_sof) {
-                tag->posCount++;
-                if (tag->posCount > 2) {
-                    tag->threshold_half += amplitude; // keep track of average high value
-                }
-                if (tag->posCount == 10) {
-                    tag->threshold_half >>= 2; // (4 times 1/2 average)
-                    tag->state = STATE_TAG_SOF_HIGH_END;
-                }
-            } else { // high phase was too short
-                tag->posCount = 1;
-                tag->previous_amplitude = amplitude;
-                tag->state = STATE_TAG_SOF_LOW;
-            }
-            break;
-        }
-
-        case STATE_TAG_SOF_HIGH_END: {
-            // check for falling edge
-            if (tag->posCount == 13 && amplitude < tag->threshold_sof) {
-                tag->lastBit = SOF_PART1;  // detected 1st part of SOF (12 samples low and 12 samples high)
-                tag->shiftReg = 0;
-                tag->bitCount = 0;
-                tag->len = 0;
-                tag->sum1 = amplitude;
-                tag->sum2 = 0;
-                tag->posCount = 2;
-                tag->state = STATE_TAG_RECEIVING_DATA;
-                LED_C_ON();
-            } else {
-                tag->posCount++;
-                if (tag->posCount > 13) { // high phase too long
-                    tag->posCount = 0;
-                    tag->previous_amplitude = amplitude;
-                    tag->state = STATE_TAG_SOF_LOW;
-                    LED_C_OFF();
-                }
-            }
-            break;
-        }
-
-        case STATE_TAG_RECEIVING_DATA: {
-            if (tag->posCount == 1) {
-                tag->sum1 = 0;
-                tag->sum2 = 0;
-            }
-
-            if (tag->posCount <= 4) {
-                tag->sum1 += amplitude;
-            } else {
-                tag->sum2 += amplitude;
-            }
-
-            if (tag->posCount == 8) {
-                if (tag->sum1 > tag->threshold_half && tag->sum2 > tag->threshold_half) { // modulation in both halves
-                    if (tag->lastBit == LOGIC0) {  // this was already part of EOF
-                        tag->state = STATE_TAG_EOF;
-                    } else {
-                        tag->posCount = 0;
-                        tag->previous_amplitude = amplitude;
-                        tag->state = STATE_TAG_SOF_LOW;
-                        LED_C_OFF();
-                    }
-                } else if (tag->sum1 < tag->threshold_half && tag->sum2 > tag->threshold_half) { // modulation in second half
-                    // logic 1
-                    if (tag->lastBit == SOF_PART1) { // still part of SOF
-                        tag->lastBit = SOF_PART2;    // SOF completed
-                    } else {
-                        tag->lastBit = LOGIC1;
-                        tag->shiftReg >>= 1;
-                        tag->shiftReg |= 0x80;
-                        tag->bitCount++;
-                        if (tag->bitCount == 8) {
-                            tag->output[tag->len] = tag->shiftReg & 0xFF;
-                            tag->len++;
-
-                            if (tag->len > tag->max_len) {
-                                // buffer overflow, give up
-                                LED_C_OFF();
-                                return true;
-                            }
-                            tag->bitCount = 0;
-                            tag->shiftReg = 0;
-                        }
-                    }
-                } else if (tag->sum1 > tag->threshold_half && tag->sum2 < tag->threshold_half) { // modulation in first half
-                    // logic 0
-                    if (tag->lastBit == SOF_PART1) { // incomplete SOF
-                        tag->posCount = 0;
-                        tag->previous_amplitude = amplitude;
-                        tag->state = STATE_TAG_SOF_LOW;
-                        LED_C_OFF();
-                    } else {
-                        tag->lastBit = LOGIC0;
-                        tag->shiftReg >>= 1;
-                        tag->bitCount++;
-
-                        if (tag->bitCount == 8) {
-                            tag->output[tag->len] = (tag->shiftReg & 0xFF);
-                            tag->len++;
-
-                            if (tag->len > tag->max_len) {
-                                // buffer overflow, give up
-                                tag->posCount = 0;
-                                tag->previous_amplitude = amplitude;
-                                tag->state = STATE_TAG_SOF_LOW;
-                                LED_C_OFF();
-                            }
-                            tag->bitCount = 0;
-                            tag->shiftReg = 0;
-                        }
-                    }
-                } else { // no modulation
-                    if (tag->lastBit == SOF_PART2) { // only SOF (this is OK for iClass)
-                        LED_C_OFF();
-                        return true;
-                    } else {
-                        tag->posCount = 0;
-                        tag->state = STATE_TAG_SOF_LOW;
-                        LED_C_OFF();
-                    }
-                }
-                tag->posCount = 0;
-            }
-            tag->posCount++;
-            break;
-        }
-
-        case STATE_TAG_EOF: {
-            if (tag->posCount == 1) {
-                tag->sum1 = 0;
-                tag->sum2 = 0;
-            }
-
-            if (tag->posCount <= 4) {
-                tag->sum1 += amplitude;
-            } else {
-                tag->sum2 += amplitude;
-            }
-
-            if (tag->posCount == 8) {
-                if (tag->sum1 > tag->threshold_half && tag->sum2 < tag->threshold_half) { // modulation in first half
-                    tag->posCount = 0;
-                    tag->state = STATE_TAG_EOF_TAIL;
-                } else {
-                    tag->posCount = 0;
-                    tag->previous_amplitude = amplitude;
-                    tag->state = STATE_TAG_SOF_LOW;
-                    LED_C_OFF();
-                }
-            }
-            tag->posCount++;
-            break;
-        }
-
-        case STATE_TAG_EOF_TAIL: {
-            if (tag->posCount == 1) {
-                tag->sum1 = 0;
-                tag->sum2 = 0;
-            }
-
-            if (tag->posCount <= 4) {
-                tag->sum1 += amplitude;
-            } else {
-                tag->sum2 += amplitude;
-            }
-
-            if (tag->posCount == 8) {
-                if (tag->sum1 < tag->threshold_half && tag->sum2 < tag->threshold_half) { // no modulation in both halves
-                    LED_C_OFF();
-                    return true;
-                } else {
-                    tag->posCount = 0;
-                    tag->previous_amplitude = amplitude;
-                    tag->state = STATE_TAG_SOF_LOW;
-                    LED_C_OFF();
-                }
-            }
-            tag->posCount++;
-            break;
-        }
-    }
-
-    return false;
-}
-
-static void DecodeTagReset(DecodeTag_t *tag) {
-    tag->posCount = 0;
-    tag->state = STATE_TAG_SOF_LOW;
-    tag->previous_amplitude = MAX_PREVIOUS_AMPLITUDE;
-}
-
-static void DecodeTagInit(DecodeTag_t *tag, uint8_t *data, uint16_t max_len) {
-    tag->output = data;
-    tag->max_len = max_len;
-    DecodeTagReset(tag);
-}
-
 /*
  *  Receive and decode the tag response, also log to tracebuffer
  */
@@ -766,328 +481,6 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
 }
 
 
-//=============================================================================
-// An ISO15693 decoder for reader commands.
-//
-// This function is called 4 times per bit (every 2 subcarrier cycles).
-// Subcarrier frequency fs is 848kHz, 1/fs = 1,18us, i.e. function is called every 2,36us
-// LED handling:
-//    LED B -> ON once we have received the SOF and are expecting the rest.
-//    LED B -> OFF once we have received EOF or are in error state or unsynced
-//
-// Returns: true  if we received a EOF
-//          false if we are still waiting for some more
-//=============================================================================
-
-typedef struct {
-    enum {
-        STATE_READER_UNSYNCD,
-        STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF,
-        STATE_READER_AWAIT_1ST_RISING_EDGE_OF_SOF,
-        STATE_READER_AWAIT_2ND_FALLING_EDGE_OF_SOF,
-        STATE_READER_AWAIT_2ND_RISING_EDGE_OF_SOF,
-        STATE_READER_AWAIT_END_OF_SOF_1_OUT_OF_4,
-        STATE_READER_RECEIVE_DATA_1_OUT_OF_4,
-        STATE_READER_RECEIVE_DATA_1_OUT_OF_256,
-        STATE_READER_RECEIVE_JAMMING
-    }           state;
-    enum {
-        CODING_1_OUT_OF_4,
-        CODING_1_OUT_OF_256
-    }           Coding;
-    uint8_t     shiftReg;
-    uint8_t     bitCount;
-    int         byteCount;
-    int         byteCountMax;
-    int         posCount;
-    int         sum1, sum2;
-    uint8_t     *output;
-    uint8_t     jam_search_len;
-    uint8_t     *jam_search_string;
-} DecodeReader_t;
-
-static void DecodeReaderInit(DecodeReader_t *reader, uint8_t *data, uint16_t max_len, uint8_t jam_search_len, uint8_t *jam_search_string) {
-    reader->output = data;
-    reader->byteCountMax = max_len;
-    reader->state = STATE_READER_UNSYNCD;
-    reader->byteCount = 0;
-    reader->bitCount = 0;
-    reader->posCount = 1;
-    reader->shiftReg = 0;
-    reader->jam_search_len = jam_search_len;
-    reader->jam_search_string = jam_search_string;
-}
-
-static void DecodeReaderReset(DecodeReader_t *reader) {
-    reader->state = STATE_READER_UNSYNCD;
-}
-
-//static inline __attribute__((always_inline))
-static int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader) {
-    switch (reader->state) {
-        case STATE_READER_UNSYNCD:
-            // wait for unmodulated carrier
-            if (bit) {
-                reader->state = STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF;
-            }
-            break;
-
-        case STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF:
-            if (!bit) {
-                // we went low, so this could be the beginning of a SOF
-                reader->posCount = 1;
-                reader->state = STATE_READER_AWAIT_1ST_RISING_EDGE_OF_SOF;
-            }
-            break;
-
-        case STATE_READER_AWAIT_1ST_RISING_EDGE_OF_SOF:
-            reader->posCount++;
-            if (bit) { // detected rising edge
-                if (reader->posCount < 4) { // rising edge too early (nominally expected at 5)
-                    reader->state = STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF;
-                } else { // SOF
-                    reader->state = STATE_READER_AWAIT_2ND_FALLING_EDGE_OF_SOF;
-                }
-            } else {
-                if (reader->posCount > 5) { // stayed low for too long
-                    DecodeReaderReset(reader);
-                } else {
-                    // do nothing, keep waiting
-                }
-            }
-            break;
-
-        case STATE_READER_AWAIT_2ND_FALLING_EDGE_OF_SOF:
-
-            reader->posCount++;
-
-            if (bit == false) { // detected a falling edge
-
-                if (reader->posCount < 20) {         // falling edge too early (nominally expected at 21 earliest)
-                    DecodeReaderReset(reader);
-                } else if (reader->posCount < 23) {  // SOF for 1 out of 4 coding
-                    reader->Coding = CODING_1_OUT_OF_4;
-                    reader->state = STATE_READER_AWAIT_2ND_RISING_EDGE_OF_SOF;
-                } else if (reader->posCount < 28) {  // falling edge too early (nominally expected at 29 latest)
-                    DecodeReaderReset(reader);
-                } else {                                   // SOF for 1 out of 256 coding
-                    reader->Coding = CODING_1_OUT_OF_256;
-                    reader->state = STATE_READER_AWAIT_2ND_RISING_EDGE_OF_SOF;
-                }
-
-            } else {
-                if (reader->posCount > 29) { // stayed high for too long
-                    reader->state = STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF;
-                } else {
-                    // do nothing, keep waiting
-                }
-            }
-            break;
-
-        case STATE_READER_AWAIT_2ND_RISING_EDGE_OF_SOF:
-
-            reader->posCount++;
-
-            if (bit) { // detected rising edge
-                if (reader->Coding == CODING_1_OUT_OF_256) {
-                    if (reader->posCount < 32) { // rising edge too early (nominally expected at 33)
-                        reader->state = STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF;
-                    } else {
-                        reader->posCount = 1;
-                        reader->bitCount = 0;
-                        reader->byteCount = 0;
-                        reader->sum1 = 1;
-                        reader->state = STATE_READER_RECEIVE_DATA_1_OUT_OF_256;
-                        LED_B_ON();
-                    }
-                } else { // CODING_1_OUT_OF_4
-                    if (reader->posCount < 24) { // rising edge too early (nominally expected at 25)
-                        reader->state = STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF;
-                    } else {
-                        reader->posCount = 1;
-                        reader->state = STATE_READER_AWAIT_END_OF_SOF_1_OUT_OF_4;
-                    }
-                }
-            } else {
-                if (reader->Coding == CODING_1_OUT_OF_256) {
-                    if (reader->posCount > 34) { // signal stayed low for too long
-                        DecodeReaderReset(reader);
-                    } else {
-                        // do nothing, keep waiting
-                    }
-                } else { // CODING_1_OUT_OF_4
-                    if (reader->posCount > 26) { // signal stayed low for too long
-                        DecodeReaderReset(reader);
-                    } else {
-                        // do nothing, keep waiting
-                    }
-                }
-            }
-            break;
-
-        case STATE_READER_AWAIT_END_OF_SOF_1_OUT_OF_4:
-
-            reader->posCount++;
-
-            if (bit) {
-                if (reader->posCount == 9) {
-                    reader->posCount = 1;
-                    reader->bitCount = 0;
-                    reader->byteCount = 0;
-                    reader->sum1 = 1;
-                    reader->state = STATE_READER_RECEIVE_DATA_1_OUT_OF_4;
-                    LED_B_ON();
-                } else {
-                    // do nothing, keep waiting
-                }
-            } else { // unexpected falling edge
-                DecodeReaderReset(reader);
-            }
-            break;
-
-        case STATE_READER_RECEIVE_DATA_1_OUT_OF_4:
-
-            reader->posCount++;
-
-            if (reader->posCount == 1) {
-
-                reader->sum1 = bit ? 1 : 0;
-
-            } else if (reader->posCount <= 4) {
-
-                if (bit)
-                    reader->sum1++;
-
-            } else if (reader->posCount == 5) {
-
-                reader->sum2 = bit ? 1 : 0;
-
-            } else {
-                if (bit)
-                    reader->sum2++;
-            }
-
-            if (reader->posCount == 8) {
-                reader->posCount = 0;
-                if (reader->sum1 <= 1 && reader->sum2 >= 3) { // EOF
-                    LED_B_OFF(); // Finished receiving
-                    DecodeReaderReset(reader);
-                    if (reader->byteCount != 0) {
-                        return true;
-                    }
-
-                } else if (reader->sum1 >= 3 && reader->sum2 <= 1) { // detected a 2bit position
-                    reader->shiftReg >>= 2;
-                    reader->shiftReg |= (reader->bitCount << 6);
-                }
-
-                if (reader->bitCount == 15) { // we have a full byte
-
-                    reader->output[reader->byteCount++] = reader->shiftReg;
-                    if (reader->byteCount > reader->byteCountMax) {
-                        // buffer overflow, give up
-                        LED_B_OFF();
-                        DecodeReaderReset(reader);
-                    }
-
-                    reader->bitCount = 0;
-                    reader->shiftReg = 0;
-                    if (reader->byteCount == reader->jam_search_len) {
-                        if (!memcmp(reader->output, reader->jam_search_string, reader->jam_search_len)) {
-                            LED_D_ON();
-                            FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SEND_JAM);
-                            reader->state = STATE_READER_RECEIVE_JAMMING;
-                        }
-                    }
-
-                } else {
-                    reader->bitCount++;
-                }
-            }
-            break;
-
-        case STATE_READER_RECEIVE_DATA_1_OUT_OF_256:
-
-            reader->posCount++;
-
-            if (reader->posCount == 1) {
-                reader->sum1 = bit ? 1 : 0;
-            } else if (reader->posCount <= 4) {
-                if (bit) reader->sum1++;
-            } else if (reader->posCount == 5) {
-                reader->sum2 = bit ? 1 : 0;
-            } else if (bit) {
-                reader->sum2++;
-            }
-
-            if (reader->posCount == 8) {
-                reader->posCount = 0;
-                if (reader->sum1 <= 1 && reader->sum2 >= 3) { // EOF
-                    LED_B_OFF(); // Finished receiving
-                    DecodeReaderReset(reader);
-                    if (reader->byteCount != 0) {
-                        return true;
-                    }
-
-                } else if (reader->sum1 >= 3 && reader->sum2 <= 1) { // detected the bit position
-                    reader->shiftReg = reader->bitCount;
-                }
-
-                if (reader->bitCount == 255) { // we have a full byte
-                    reader->output[reader->byteCount++] = reader->shiftReg;
-                    if (reader->byteCount > reader->byteCountMax) {
-                        // buffer overflow, give up
-                        LED_B_OFF();
-                        DecodeReaderReset(reader);
-                    }
-
-                    if (reader->byteCount == reader->jam_search_len) {
-                        if (!memcmp(reader->output, reader->jam_search_string, reader->jam_search_len)) {
-                            LED_D_ON();
-                            FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SEND_JAM);
-                            reader->state = STATE_READER_RECEIVE_JAMMING;
-                        }
-                    }
-                }
-                reader->bitCount++;
-            }
-            break;
-
-        case STATE_READER_RECEIVE_JAMMING:
-
-            reader->posCount++;
-
-            if (reader->Coding == CODING_1_OUT_OF_4) {
-                if (reader->posCount == 7 * 16) { // 7 bits jammed
-                    FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SNIFF_AMPLITUDE); // stop jamming
-                    // FpgaDisableTracing();
-                    LED_D_OFF();
-                } else if (reader->posCount == 8 * 16) {
-                    reader->posCount = 0;
-                    reader->output[reader->byteCount++] = 0x00;
-                    reader->state = STATE_READER_RECEIVE_DATA_1_OUT_OF_4;
-                }
-            } else {
-                if (reader->posCount == 7 * 256) { // 7 bits jammend
-                    FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_MODE_SNIFF_AMPLITUDE); // stop jamming
-                    LED_D_OFF();
-                } else if (reader->posCount == 8 * 256) {
-                    reader->posCount = 0;
-                    reader->output[reader->byteCount++] = 0x00;
-                    reader->state = STATE_READER_RECEIVE_DATA_1_OUT_OF_256;
-                }
-            }
-            break;
-
-        default:
-            LED_B_OFF();
-            DecodeReaderReset(reader);
-            break;
-    }
-
-    return false;
-}
-
 //-----------------------------------------------------------------------------
 // Receive a command (from the reader to us, where we are the simulated tag),
 // and store it in the given buffer, up to the given maximum length. Keeps
@@ -1670,6 +1063,27 @@ void ReaderIso15693(uint32_t parameter, iso15_card_select_t *p_card) {
     BigBuf_free();
 }
 
+// Single slot inventory on a field set up by Iso15693InitReader(),  the uid is returned msb first
+int Iso15693Inventory(uint8_t *uid) {
+
+    uint8_t answer[ISO15693_MAX_RESPONSE_LENGTH] = {0};
+    uint8_t cmd[5] = {0};
+    BuildIdentifyRequest(cmd);
+
+    uint32_t eof_time = 0;
+    int recvlen = SendDataTag(cmd, sizeof(cmd), false, true, answer, sizeof(answer), GetCountSspClk(), ISO15693_READER_TIMEOUT, &eof_time);
+    if (recvlen == PM3_ETEAROFF)
+        return PM3_ETEAROFF;
+
+    if (recvlen < 12 || CheckCrc15(answer, 12) == false)
+        return PM3_ENODATA;
+
+    for (uint8_t i = 0; i < 8; i++)
+        uid[i] = answer[9 - i];
+
+    return PM3_SUCCESS;
+}
+
 // When SIM: initialize the Proxmark3 as ISO15693 tag
 void Iso15693InitTag(void) {
 
@@ -409,23 +409,18 @@ legic_card_select_t *getLegicCardInfo(void) {
     return &card;
 }
 
-void LegicRfInfo(void) {
-    // configure ARM and FPGA
-    init_reader();
-
-    // establish shared secret and detect card type
+// establish shared secret, detect card type and read the UID
+static int select_card(void) {
     uint8_t card_type = setup_phase(0x01);
     if (init_card(card_type, &card) != PM3_SUCCESS) {
-        reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
-        goto OUT;
+        return PM3_ESOFT;
     }
 
     // read UID
     for (uint8_t i = 0; i < sizeof(card.uid); ++i) {
         int16_t byte = read_byte(i, card.cmdsize);
         if (byte == -1) {
-            reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
-            goto OUT;
+            return PM3_ESOFT;
         }
         card.uid[i] = byte & 0xFF;
     }
@@ -434,6 +429,16 @@ void LegicRfInfo(void) {
     int16_t mcc = read_byte(4, card.cmdsize);
     int16_t calc_mcc = CRC8Legic(card.uid, 4);
     if (mcc != calc_mcc) {
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+void LegicRfInfo(void) {
+    // configure ARM and FPGA
+    init_reader();
+
+    if (select_card() != PM3_SUCCESS) {
         reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
         goto OUT;
     }
@@ -446,6 +451,20 @@ OUT:
     StopTicks();
 }
 
+// like LegicRfInfo() but returns the card to the caller instead of the client
+int LegicRfSelect(legic_card_select_t *p_card) {
+    init_reader();
+
+    int res = select_card();
+    if (res == PM3_SUCCESS) {
+        memcpy(p_card, &card, sizeof(legic_card_select_t));
+    }
+
+    switch_off();
+    StopTicks();
+    return res;
+}
+
 int LegicRfReaderEx(uint16_t offset, uint16_t len, uint8_t iv) {
 
     int res = PM3_SUCCESS;
@@ -17,6 +17,7 @@
 #include "legic.h"              /* legic_card_select_t struct */
 
 void LegicRfInfo(void);
+int LegicRfSelect(legic_card_select_t *p_card);
 int LegicRfReaderEx(uint16_t offset, uint16_t len, uint8_t iv);
 void LegicRfReader(uint16_t offset, uint16_t len, uint8_t iv);
 void LegicRfWriter(uint16_t offset, uint16_t len, uint8_t iv, uint8_t *data);
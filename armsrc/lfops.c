@@ -520,11 +520,12 @@ void ReadTItag(void) {
 #define FREQHI 134200
 
     signed char *dest = (signed char *)BigBuf_get_addr();
-    uint16_t n = BigBuf_max_traceLen();
+    uint32_t n = BigBuf_max_traceLen();
     // 128 bit shift register [shift3:shift2:shift1:shift0]
     uint32_t shift3 = 0, shift2 = 0, shift1 = 0, shift0 = 0;
 
-    int i, cycles = 0, samples = 0;
+    uint32_t i;
+    int cycles = 0, samples = 0;
     // how many sample points fit in 16 cycles of each frequency
     uint32_t sampleslo = (FSAMPLE << 4) / FREQLO, sampleshi = (FSAMPLE << 4) / FREQHI;
     // when to tell if we're close enough to one freq or another
@@ -2002,8 +2003,8 @@ bool brute_mem = (flags & 0x0100) >> 8;
     }
 }
 */
-// Read one card block in page [page]
-void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode) {
+// Read one card block in page [page], keeping [samples] samples of the answer
+static void T55xxReadBlockEx(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, size_t samples) {
     /*
     flag bits
     xxxx xxxxxxx1 0x0001 PwdMode
@@ -2028,12 +2029,8 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
 
     setDefaultSamplingConfig();
 
-    size_t samples = 12000;
-
     LED_A_ON();
 
-    if (brute_mem) samples = 2048;
-
     //-- Set Read Flag to ensure SendCMD does not add "data" to the packet
     //-- flags |= 0x40;
 
@@ -2070,6 +2067,11 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
     setSamplingConfig(&old_config);
 }
 
+// Read one card block in page [page]
+void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode) {
+    T55xxReadBlockEx(page, pwd_mode, brute_mem, block, pwd, downlink_mode, (brute_mem) ? 2048 : 12000);
+}
+
 
 void T55xx_ChkPwds(uint8_t flags) {
 
@@ -2188,6 +2190,155 @@ OUT:
     BigBuf_free();
 }
 
+// T55x7 supported bitrates, in samples per bit at 125kHz and decimation 1
+static const uint8_t t55xx_bf_clocks[] = {8, 16, 32, 40, 50, 64, 100, 128};
+
+// samples needed to compare two full periods of a 33 bit block read
+#define T55XX_BF_SAMPLES(clk)  ((2 * 33 + 4) * (clk))
+
+/*
+ * Minimal demodulator for the bruteforce loop.
+ * A correct password makes the tag answer the page 0 block 0 read, which it repeats as
+ * one start bit + 32 data bits.  Since the tag bit clock is derived from the reader field,
+ * the samples then repeat exactly every 33 * clk samples, whatever the modulation is.
+ * A wrong password leaves the tag in regular read mode, cycling blocks 1..MAXBLOCK,
+ * which doesn't repeat on that period.
+ * Compares the signal against itself one period later, and half a period later as reference.
+ */
+static bool t55xx_bf_block_repeats(const uint8_t *buf, uint8_t clk) {
+
+    const uint32_t period = 33 * clk;
+    const uint32_t offset = 2 * clk;
+    uint32_t same[3] = {0, 0, 0};
+    uint32_t ref = 0;
+
+    for (uint32_t i = offset; i < offset + period; i++) {
+        int16_t a = buf[i];
+        // allow one sample of jitter around the expected period
+        same[0] += ABS(a - buf[i + period - 1]);
+        same[1] += ABS(a - buf[i + period]);
+        same[2] += ABS(a - buf[i + period + 1]);
+        ref += ABS(a - buf[i + (period >> 1)]);
+    }
+
+    uint32_t best = MIN(same[1], MIN(same[0], same[2]));
+
+    // no modulation at all, ie no tag or the field collapsed
+    if (ref < (period * 8))
+        return false;
+
+    return ((best * 4) < ref);
+}
+
+// check every enabled clock,  clocks is a bitmask over t55xx_bf_clocks
+static bool t55xx_bf_check(uint8_t clocks) {
+    uint8_t *buf = BigBuf_get_addr();
+    for (uint8_t i = 0; i < ARRAYLEN(t55xx_bf_clocks); i++) {
+        if ((clocks & (1 << i)) && t55xx_bf_block_repeats(buf, t55xx_bf_clocks[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Password bruteforce with device side verification.
+ * For every password in [start_pwd, end_pwd], reads page 0 block 0 with that password and
+ * only looks at the answer with t55xx_bf_block_repeats.  Candidates are sent to the client,
+ * which confirms them with its full demodulators and resumes the search on false positives.
+ */
+void T55xx_BruteForce(t55xx_bf_t *bf) {
+
+    t55xx_bf_resp_t resp = {0};
+    int status = PM3_SUCCESS;
+
+    uint8_t dl_first = bf->downlink_mode & 3;
+    uint8_t dl_last = (bf->downlink_mode == 4) ? 3 : dl_first;
+    if (bf->downlink_mode == 4) {
+        dl_first = 0;
+    }
+
+    // clocks to check,  all when unknown
+    uint8_t clocks = 0;
+    uint32_t samples = 0;
+    for (uint8_t i = 0; i < ARRAYLEN(t55xx_bf_clocks); i++) {
+        if (bf->clock == 0 || bf->clock == t55xx_bf_clocks[i]) {
+            clocks |= (1 << i);
+            samples = T55XX_BF_SAMPLES(t55xx_bf_clocks[i]);
+        }
+    }
+
+    if (clocks == 0) {
+        reply_ng(CMD_LF_T55XX_BRUTE, PM3_EINVARG, (uint8_t *)&resp, sizeof(resp));
+        return;
+    }
+
+    LED_A_ON();
+
+    // baseline, the regular read mode data must not look like a block read already
+    sample_config old_config;
+    memcpy(&old_config, getSamplingConfig(), sizeof(sample_config));
+    old_config.verbose = false;
+    setDefaultSamplingConfig();
+    LFSetupFPGAForADC(LF_DIVISOR_125, true);
+    WaitMS(20);
+    BigBuf_Clear_keep_EM();
+    DoPartialAcquisition(0, false, samples, 1000);
+    setSamplingConfig(&old_config);
+
+    uint8_t *buf = BigBuf_get_addr();
+    for (uint8_t i = 0; i < ARRAYLEN(t55xx_bf_clocks); i++) {
+        if ((clocks & (1 << i)) && t55xx_bf_block_repeats(buf, t55xx_bf_clocks[i])) {
+            if (g_dbglevel >= DBG_INFO)
+                Dbprintf("Regular read mode data repeats on RF/%d, can't verify on device", t55xx_bf_clocks[i]);
+            clocks &= ~(1 << i);
+        }
+    }
+
+    if (clocks == 0) {
+        status = PM3_ESOFT;
+        goto out;
+    }
+
+    uint32_t pwd = bf->start_pwd;
+    for (;;) {
+
+        // every password is a full block read per downlink mode,  check for abort on each
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        if ((resp.tried & 0x3FF) == 0 && g_dbglevel >= DBG_INFO) {
+            Dbprintf("Trying: %08X", pwd);
+        }
+
+        for (uint8_t dl = dl_first; dl <= dl_last; dl++) {
+            T55xxReadBlockEx(0, true, true, 0, pwd, dl, samples);
+            if (t55xx_bf_check(clocks)) {
+                resp.found = 1;
+                resp.candidate = pwd;
+                resp.downlink_mode = dl;
+                break;
+            }
+        }
+
+        resp.last = pwd;
+        resp.tried++;
+
+        if (resp.found || pwd == bf->end_pwd)
+            break;
+
+        pwd++;
+    }
+
+out:
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    reply_ng(CMD_LF_T55XX_BRUTE, status, (uint8_t *)&resp, sizeof(resp));
+}
+
 void T55xxWakeUp(uint32_t pwd, uint8_t flags) {
 
     flags |= 0x01 | 0x40 | 0x20; //Password | Read Call (no data) | reg_read no block
@@ -17,6 +17,7 @@
 #include "lfdemod.h"
 #include "string.h"  // memset
 #include "appmain.h" // print stack
+#include "cmd.h"
 
 /*
 Default LF config is set to:
@@ -430,13 +431,14 @@ void doT55x7Acquisition(size_t sample_size) {
 #define T55xx_READ_TOL   5
 
     uint8_t *dest = BigBuf_get_addr();
-    uint16_t bufsize = BigBuf_max_traceLen();
+    uint32_t bufsize = BigBuf_max_traceLen();
 
     if (bufsize > sample_size)
         bufsize = sample_size;
 
     uint8_t lastSample = 0;
-    uint16_t i = 0, skipCnt = 0;
+    uint32_t i = 0;
+    uint16_t skipCnt = 0;
     bool startFound = false;
     bool highFound = false;
     bool lowFound = false;
@@ -515,13 +517,14 @@ void doT55x7Acquisition(size_t sample_size) {
 #endif
 void doCotagAcquisition(void) {
 
-    uint16_t bufsize = BigBuf_max_traceLen();
+    uint32_t bufsize = BigBuf_max_traceLen();
     uint8_t *dest = BigBuf_malloc(bufsize);
 
     dest[0] = 0;
 
     bool firsthigh = false, firstlow = false;
-    uint16_t i = 0, noise_counter = 0;
+    uint32_t i = 0;
+    uint16_t noise_counter = 0;
 
     uint16_t checker = 0;
 
@@ -651,3 +654,219 @@ uint16_t doCotagAcquisitionManchester(uint8_t *dest, uint16_t destlen) {
 
     return i;
 }
+
+// Streaming capture. The PDC fills a small ring of raw ADC samples, every full raw chunk is
+// decimated and packed by the sampling config into a bigger ring of LF_STREAM_CHUNK byte chunks
+// which go to the client as they complete. When the client does not keep up, the oldest packed
+// chunk is dropped.  The capture is only limited by the time the client listens.
+#define LF_STREAM_RAW_CHUNK    DMA_BUFFER_SIZE
+#define LF_STREAM_RAW_CHUNKS   4
+#define LF_STREAM_CHUNKS       40
+#define LF_STREAM_RING_BITS    (LF_STREAM_CHUNKS * LF_STREAM_CHUNK * 8)
+
+typedef struct {
+    BitstreamOut_t out;         // position wraps at LF_STREAM_RING_BITS
+    uint32_t chunk_bits;        // bits in the chunk being filled
+    uint32_t sent;              // packed chunks [sent, done) wait for the client
+    uint32_t done;
+    uint32_t remaining;         // samples to go, 0 = until stopped
+    int32_t to_skip;
+    bool trigger_hit;
+} lf_stream_state_t;
+
+static void lf_stream_send(lf_stream_state_t *st, uint32_t seq, uint16_t bits, lf_stream_chunk_t *payload) {
+    payload->seq = seq;
+    payload->bits = bits;
+    payload->bits_per_sample = config.bits_per_sample;
+    memcpy(payload->data, st->out.buffer + (seq % LF_STREAM_CHUNKS) * LF_STREAM_CHUNK, LF_STREAM_CHUNK);
+    reply_ng(CMD_LF_STREAM_ADC_DATA, PM3_SUCCESS, (uint8_t *)payload, sizeof(lf_stream_chunk_t));
+}
+
+static void lf_stream_pack(lf_stream_state_t *st, const uint8_t *raw, uint16_t len, lf_stream_result_t *result) {
+
+    uint8_t bps = config.bits_per_sample;
+
+    for (uint16_t i = 0; i < len; i++) {
+
+        uint8_t sample = raw[i];
+
+        if (st->trigger_hit == false) {
+            int16_t t = config.trigger_threshold;
+            if ((t > 0) && (sample < (t + 128)) && (sample > (128 - t)))
+                continue;
+            st->trigger_hit = true;
+        }
+
+        if (st->to_skip > 0) {
+            st->to_skip--;
+            continue;
+        }
+
+        if (config.averaging)
+            samples.sum += sample;
+
+        if (config.decimation > 1) {
+            if (++samples.dec_counter < config.decimation)
+                continue;
+            samples.dec_counter = 0;
+            if (config.averaging) {
+                sample = samples.sum / config.decimation;
+                samples.sum = 0;
+            }
+        }
+
+        if (bps == 8) {
+            st->out.buffer[st->out.position >> 3] = sample;
+            st->out.position += 8;
+            if (st->out.position == LF_STREAM_RING_BITS)
+                st->out.position = 0;
+        } else {
+            for (uint8_t b = 0; b < bps; b++) {
+                pushBit(&st->out, sample & (0x80 >> b));
+                if (st->out.position == LF_STREAM_RING_BITS)
+                    st->out.position = 0;
+            }
+        }
+
+        result->samples++;
+
+        // a sample may straddle two chunks, the client reads the chunks as one bit stream
+        st->chunk_bits += bps;
+        if (st->chunk_bits >= LF_STREAM_CHUNK * 8) {
+            st->chunk_bits -= LF_STREAM_CHUNK * 8;
+            st->done++;
+            if (st->done - st->sent >= LF_STREAM_CHUNKS) {
+                // ring is full, the client does not keep up
+                st->sent++;
+                result->lost++;
+            }
+        }
+
+        if (st->remaining && --st->remaining == 0)
+            return;
+    }
+}
+
+/**
+* Streams samples packed by the sampling config to the client until the button is pressed,
+* the client sends a command or the requested number of samples is reached.
+* @return PM3_SUCCESS, PM3_EOPABORTED when stopped by button, PM3_EMALLOC
+**/
+int StreamLF(bool reader_field, uint32_t sample_count, lf_stream_result_t *result) {
+
+    memset(result, 0, sizeof(lf_stream_result_t));
+
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+
+    // may load the LF image, its decompression buffer needs the BigBuf space we are about to take
+    LFSetupFPGAForADC(config.divisor, reader_field);
+
+    uint8_t *raw = BigBuf_malloc_ext(LF_STREAM_RAW_CHUNK * LF_STREAM_RAW_CHUNKS, "lfstream raw");
+    uint8_t *ring = BigBuf_malloc_ext(LF_STREAM_CHUNKS * LF_STREAM_CHUNK, "lfstream");
+    if (raw == NULL || ring == NULL) {
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        BigBuf_free();
+        return PM3_EMALLOC;
+    }
+
+    lf_stream_state_t st = {
+        .out = { ring, 0, 0 },
+        .chunk_bits = 0,
+        .sent = 0,
+        .done = 0,
+        .remaining = sample_count,
+        .to_skip = config.samples_to_skip,
+        .trigger_hit = false,
+    };
+    samples.dec_counter = 0;
+    samples.sum = 0;
+
+    lf_stream_chunk_t payload;
+
+    // raw chunk n lives in slot n % LF_STREAM_RAW_CHUNKS, the PDC fills chunk raw_done and has raw_done + 1 queued
+    uint32_t raw_done = 0, armed = 2;
+
+    FpgaDisableSscDma();
+    AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) raw;
+    AT91C_BASE_PDC_SSC->PDC_RCR = LF_STREAM_RAW_CHUNK;
+    AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)(raw + LF_STREAM_RAW_CHUNK);
+    AT91C_BASE_PDC_SSC->PDC_RNCR = LF_STREAM_RAW_CHUNK;
+    FpgaEnableSscDma();
+
+    LED_A_ON();
+
+    int res = PM3_SUCCESS;
+    for (;;) {
+
+        // the PDC switched to its queued chunk, queue the next one and pack the full ones
+        if (AT91C_BASE_PDC_SSC->PDC_RNCR == 0) {
+
+            // both chunks filled before we got here, the PDC stopped and has to be restarted
+            bool stopped = (AT91C_BASE_PDC_SSC->PDC_RCR == 0);
+
+            for (int i = stopped ? 2 : 1; i > 0; i--) {
+                if (stopped && i == 2) {
+                    AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t)(raw + (armed % LF_STREAM_RAW_CHUNKS) * LF_STREAM_RAW_CHUNK);
+                    AT91C_BASE_PDC_SSC->PDC_RCR = LF_STREAM_RAW_CHUNK;
+                } else {
+                    AT91C_BASE_PDC_SSC->PDC_RNPR = (uint32_t)(raw + (armed % LF_STREAM_RAW_CHUNKS) * LF_STREAM_RAW_CHUNK);
+                    AT91C_BASE_PDC_SSC->PDC_RNCR = LF_STREAM_RAW_CHUNK;
+                }
+                armed++;
+            }
+            if (stopped)
+                result->stalls++;
+
+            for (int i = stopped ? 2 : 1; i > 0; i--) {
+                // remaining 0 means no limit to lf_stream_pack,  don't pack past a reached one
+                if (sample_count && st.remaining == 0)
+                    break;
+                lf_stream_pack(&st, raw + (raw_done % LF_STREAM_RAW_CHUNKS) * LF_STREAM_RAW_CHUNK, LF_STREAM_RAW_CHUNK, result);
+                raw_done++;
+            }
+
+            if (sample_count && st.remaining == 0)
+                break;
+        }
+
+        if (st.sent < st.done) {
+            LED_B_ON();
+            lf_stream_send(&st, st.sent, LF_STREAM_CHUNK * 8, &payload);
+            st.sent++;
+            result->chunks++;
+            LED_B_OFF();
+        }
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        // cancel w usb command.
+        if (data_available()) {
+            break;
+        }
+    }
+
+    FpgaDisableSscDma();
+    StopTicks();
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    // the chunks completed so far still go out, the partly filled one too
+    for (; st.sent < st.done; st.sent++) {
+        lf_stream_send(&st, st.sent, LF_STREAM_CHUNK * 8, &payload);
+        result->chunks++;
+    }
+    if (st.chunk_bits) {
+        lf_stream_send(&st, st.done, st.chunk_bits, &payload);
+        result->chunks++;
+    }
+
+    LEDsoff();
+    BigBuf_release(ring);
+    BigBuf_release(raw);
+    return res;
+}
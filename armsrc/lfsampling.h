@@ -42,6 +42,12 @@ uint32_t SampleLF(bool verbose, uint32_t sample_size);
 **/
 uint32_t SniffLF(bool verbose, uint32_t sample_size);
 
+/**
+* Streams samples to the client while sampling, field on or off, until stopped or sample_count is reached.
+* @return PM3_SUCCESS, PM3_EOPABORTED when the button stopped it
+**/
+int StreamLF(bool reader_field, uint32_t sample_count, lf_stream_result_t *result);
+
 uint32_t DoAcquisition(uint8_t decimation, uint8_t bits_per_sample, bool avg, int16_t trigger_threshold,
                        bool verbose, uint32_t sample_size, uint32_t cancel_after, int32_t samples_to_skip);
 
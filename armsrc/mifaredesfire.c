@@ -609,6 +609,231 @@ void MifareDES_Auth1(uint8_t *datain) {
     LED_B_OFF();
 }
 
+// One authentication attempt for the key check loop.
+// Returns PM3_SUCCESS when the card accepts the key, PM3_EWRONGANSWER when it rejects it,
+// PM3_ENODATA when it refuses the key number / key type and PM3_ECARDEXCHANGE on timeouts.
+static int DesfireChkAuth(uint8_t mode, uint8_t algo, uint16_t keyno, const uint8_t *keydata) {
+
+    uint8_t cmd[40] = {0x00};
+    uint8_t resp[MAX_FRAME_SIZE] = {0x00};
+    uint8_t key[24] = {0x00};
+    uint8_t IV[16] = {0x00};
+    uint8_t RndA[16] = {0x00};
+    uint8_t RndB[16] = {0x00};
+    uint8_t encRnd[16] = {0x00};
+    uint8_t both[32] = {0x00};
+    uint8_t token[32] = {0x00};
+    mbedtls_aes_context ctx;
+
+    bool aes = (algo == MFDES_ALGO_AES);
+    uint8_t rndlen = (aes || algo == MFDES_ALGO_3K3DES) ? 16 : 8;
+    int keymode = (algo == MFDES_ALGO_3K3DES) ? 3 : 2;
+
+    // DES keys are used as 2TDEA with two identical halves
+    if (algo == MFDES_ALGO_DES) {
+        memcpy(key, keydata, 8);
+        memcpy(key + 8, keydata, 8);
+    } else {
+        memcpy(key, keydata, (algo == MFDES_ALGO_3K3DES) ? 24 : 16);
+    }
+
+    for (uint8_t i = 0; i < rndlen; i += 4) {
+        num_to_bytes(prng_successor(GetTickCount(), 32), 4, &RndA[i]);
+    }
+
+    // Part 1,  get ek(RndB)
+    int len;
+    if (mode == MFDES_AUTH_MFP) {
+        cmd[0] = 0x70;  // first authenticate
+        cmd[1] = keyno & 0xFF;
+        cmd[2] = keyno >> 8;
+        cmd[3] = 0x00;
+        len = DesfireAPDU(cmd, 4, resp);
+        if (len == 0)
+            return PM3_ECARDEXCHANGE;
+
+        // PCB + status + ek(RndB) + CRC
+        if (len != 1 + 1 + 16 + 2 || resp[1] != 0x90)
+            return PM3_ENODATA;
+
+        memcpy(encRnd, resp + 2, 16);
+    } else {
+        cmd[0] = 0x90;
+        cmd[1] = (mode == MFDES_AUTH_AES) ? MFDES_AUTHENTICATE_AES : MFDES_AUTHENTICATE_ISO;
+        cmd[2] = 0x00;
+        cmd[3] = 0x00;
+        cmd[4] = 0x01;
+        cmd[5] = keyno;
+        cmd[6] = 0x00;
+        len = DesfireAPDU(cmd, 7, resp);
+        if (len == 0)
+            return PM3_ECARDEXCHANGE;
+
+        // PCB + ek(RndB) + 91 AF + CRC
+        if (len != 1 + rndlen + 2 + 2 || resp[len - 4] != 0x91 || resp[len - 3] != MFDES_ADDITIONAL_FRAME)
+            return PM3_ENODATA;
+
+        memcpy(encRnd, resp + 1, rndlen);
+    }
+
+    // Part 2,  answer ek(RndA + RndB')
+    if (aes) {
+        mbedtls_aes_init(&ctx);
+        mbedtls_aes_setkey_dec(&ctx, key, 128);
+        mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, 16, IV, encRnd, RndB);
+    } else {
+        tdes_nxp_receive(encRnd, RndB, rndlen, key, IV, keymode);
+    }
+
+    rol(RndB, rndlen);
+    memcpy(both, RndA, rndlen);
+    memcpy(both + rndlen, RndB, rndlen);
+
+    // EV1 keeps chaining the IV over the whole exchange,  MIFARE Plus restarts from zero
+    if (mode == MFDES_AUTH_MFP) {
+        memset(IV, 0, sizeof(IV));
+    }
+
+    if (aes) {
+        mbedtls_aes_setkey_enc(&ctx, key, 128);
+        mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_ENCRYPT, 32, IV, both, token);
+    } else {
+        tdes_nxp_send(both, token, 2 * rndlen, key, IV, keymode);
+    }
+
+    if (mode == MFDES_AUTH_MFP) {
+        cmd[0] = 0x72;  // following part of first authenticate
+        memcpy(cmd + 1, token, 32);
+        len = DesfireAPDU(cmd, 33, resp);
+    } else {
+        cmd[0] = 0x90;
+        cmd[1] = MFDES_ADDITIONAL_FRAME;
+        cmd[2] = 0x00;
+        cmd[3] = 0x00;
+        cmd[4] = 2 * rndlen;
+        memcpy(cmd + 5, token, 2 * rndlen);
+        cmd[5 + 2 * rndlen] = 0x00;
+        len = DesfireAPDU(cmd, 5 + 2 * rndlen + 1, resp);
+    }
+
+    if (len == 0) {
+        if (aes)
+            mbedtls_aes_free(&ctx);
+        return PM3_ECARDEXCHANGE;
+    }
+
+    int res = PM3_EWRONGANSWER;
+    if (mode == MFDES_AUTH_MFP) {
+        // PCB + status + ek(TI + RndA' + capabilities) + CRC,  the card only answers 0x90 to a good key
+        if (len == 1 + 1 + 32 + 2 && resp[1] == 0x90) {
+            memset(IV, 0, sizeof(IV));
+            mbedtls_aes_setkey_dec(&ctx, key, 128);
+            mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, 32, IV, resp + 2, both);
+            rol(RndA, 16);
+            if (memcmp(both + 4, RndA, 16) == 0)
+                res = PM3_SUCCESS;
+        }
+    } else if (resp[len - 4] == 0x91 && resp[len - 3] == 0x00) {
+        res = PM3_SUCCESS;
+    }
+
+    if (aes)
+        mbedtls_aes_free(&ctx);
+
+    return res;
+}
+
+static bool DesfireChkSelect(desfire_chk_t *payload) {
+
+    pcb_blocknum = 0;
+
+    iso14a_card_select_t card;
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(true);
+
+    if (iso14443a_select_card(NULL, &card, NULL, true, 0, false) == 0) {
+        if (g_dbglevel >= DBG_ERROR) DbpString("Can't select card");
+        return false;
+    }
+
+    if (payload->mode == MFDES_AUTH_MFP)
+        return true;
+
+    uint8_t cmd[] = {0x90, MFDES_SELECT_APPLICATION, 0x00, 0x00, 0x03, payload->aid[0], payload->aid[1], payload->aid[2], 0x00};
+    uint8_t resp[MAX_FRAME_SIZE] = {0x00};
+    int len = DesfireAPDU(cmd, sizeof(cmd), resp);
+    if (len < 4 || resp[len - 4] != 0x91 || resp[len - 3] != 0x00) {
+        if (g_dbglevel >= DBG_ERROR) DbpString("Can't select application");
+        return false;
+    }
+    return true;
+}
+
+// Checks a batch of keys against a list of key slots.
+// Every slot stops at its first matching key, the client sends the next batch for the remaining slots.
+void MifareDesfireChkKeys(uint8_t *datain) {
+
+    desfire_chk_t *payload = (desfire_chk_t *) datain;
+
+    desfire_chk_resp_t rpayload;
+    memset(rpayload.found, DESFIRE_CHK_NONE, sizeof(rpayload.found));
+    rpayload.tried = 0;
+
+    if ((payload->mode != MFDES_AUTH_ISO && payload->mode != MFDES_AUTH_AES && payload->mode != MFDES_AUTH_MFP) ||
+            payload->slot_count > DESFIRE_CHK_MAX_SLOTS ||
+            (payload->keylen != 8 && payload->keylen != 16 && payload->keylen != 24) ||
+            payload->key_count * payload->keylen > sizeof(payload->keys)) {
+        reply_ng(CMD_HF_DESFIRE_CHKKEYS, PM3_EINVARG, (uint8_t *)&rpayload, sizeof(rpayload));
+        return;
+    }
+
+    LED_A_ON();
+
+    int status = PM3_SUCCESS;
+
+    if ((payload->flags & INIT) && DesfireChkSelect(payload) == false) {
+        status = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+
+    for (uint8_t s = 0; s < payload->slot_count; s++) {
+        for (uint8_t k = 0; k < payload->key_count; k++) {
+
+            WDT_HIT();
+            if (BUTTON_PRESS() || data_available()) {
+                status = PM3_EOPABORTED;
+                goto out;
+            }
+
+            int res = DesfireChkAuth(payload->mode, payload->algo, payload->slots[s], payload->keys + (k * payload->keylen));
+            rpayload.tried++;
+
+            if (res == PM3_SUCCESS) {
+                rpayload.found[s] = k;
+                break;
+            }
+
+            if (res == PM3_ENODATA) {
+                rpayload.found[s] = DESFIRE_CHK_NOKEY;
+                break;
+            }
+
+            if (res == PM3_ECARDEXCHANGE) {
+                status = res;
+                goto out;
+            }
+        }
+    }
+
+out:
+    if ((payload->flags & DISCONNECT) || status != PM3_SUCCESS) {
+        OnSuccess();
+    }
+
+    reply_ng(CMD_HF_DESFIRE_CHKKEYS, status, (uint8_t *)&rpayload, sizeof(rpayload));
+    LEDsoff();
+}
+
 // 3 different ISO ways to send data to a DESFIRE (direct, capsuled, capsuled ISO)
 // cmd  =  cmd bytes to send
 // cmd_len = length of cmd
@@ -38,132 +38,145 @@
 #include "crc16.h"
 #include "dbprint.h"
 #include "ticks.h"
+#include "parity.h"
 
-static bool IsTrailerAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
+// Block data as the reader may see it plus CRC, 18 bytes
+static void MifareSimReadAnswer(uint8_t blockNo, uint8_t keytype, uint8_t *response) {
+
+    emlGetMem(response, blockNo, 1);
+
+    if (g_dbglevel >= DBG_EXTENDED)  {
+        Dbprintf("[MFEMUL_WORK - ISO14443A_CMD_READBLOCK] Data Block[%d]: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", blockNo,
+                 response[0], response[1], response[2], response[3],  response[4],  response[5],  response[6],
+                 response[7], response[8], response[9], response[10], response[11], response[12], response[13],
+                 response[14], response[15]);
+    }
+
+    // If permission is not allowed, data is cleared (00) in emulator memeory.
+    // ex: a0a1a2a3a4a561e789c1b0b1b2b3b4b5 => 00000000000061e789c1b0b1b2b3b4b5
     uint8_t sector_trailer[16];
-    emlGetMem(sector_trailer, blockNo, 1);
-    uint8_t AC = ((sector_trailer[7] >> 5) & 0x04)
-                 | ((sector_trailer[8] >> 2) & 0x02)
-                 | ((sector_trailer[8] >> 7) & 0x01);
-    switch (action) {
-        case AC_KEYA_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYA_READ");
-            return false;
-        }
-        case AC_KEYA_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYA_WRITE");
-            return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x01))
-                    || (keytype == AUTHKEYB && (AC == 0x04 || AC == 0x03)));
-        }
-        case AC_KEYB_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYB_READ");
-            return (keytype == AUTHKEYA && (AC == 0x00 || AC == 0x02 || AC == 0x01));
-        }
-        case AC_KEYB_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYB_WRITE");
-            return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x01))
-                    || (keytype == AUTHKEYB && (AC == 0x04 || AC == 0x03)));
-        }
-        case AC_AC_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_AC_READ");
-            return ((keytype == AUTHKEYA)
-                    || (keytype == AUTHKEYB && !(AC == 0x00 || AC == 0x02 || AC == 0x01)));
-        }
-        case AC_AC_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_AC_WRITE");
-            return ((keytype == AUTHKEYA && (AC == 0x01))
-                    || (keytype == AUTHKEYB && (AC == 0x03 || AC == 0x05)));
-        }
-        default:
-            return false;
+    emlGetMem(sector_trailer, mfc_sector_trailer(blockNo), 1);
+    mfc_read_mask(sector_trailer, blockNo, keytype, response);
+
+    AddCrc14A(response, 16);
+}
+
+//-----------------------------------------------------------------------------
+// READ answers prepared ahead.
+//
+// Once authenticated the Crypto1 cipher of the tag runs without feedback, its
+// keystream does not depend on the frames. The 32 bits which decrypt the next
+// command and the 144 bits which encrypt an 18 byte answer are known as soon
+// as the previous answer is sent. The answers to the blocks a reader likely
+// reads next are encrypted and modulated in small steps while EmGetCmdEx()
+// waits for the reader, and go out without any work when that READ arrives.
+//-----------------------------------------------------------------------------
+#define PRECOMP_BLOCKS    2
+#define PRECOMP_CMD_BITS  (4 * 8)
+#define PRECOMP_ANS_BITS  (MAX_MIFARE_FRAME_SIZE * 8)
+
+typedef struct {
+    uint8_t block;
+    bool ready;
+    uint8_t plain[MAX_MIFARE_FRAME_SIZE];
+    uint8_t response[MAX_MIFARE_FRAME_SIZE];
+    uint8_t par[MAX_MIFARE_PARITY_SIZE];
+    uint8_t modulation[TAG_MODULATION_SIZE(MAX_MIFARE_FRAME_SIZE)];
+    tag_response_info_t info;
+} precomp_answer_t;
+
+typedef struct {
+    struct Crypto1State state;                  // ends as the state after the answer
+    uint8_t ks[MAX_MIFARE_FRAME_SIZE];          // keystream of the answer
+    uint8_t ks_par[MAX_MIFARE_FRAME_SIZE];      // filter output after each byte, encrypts the parity
+    uint16_t bits;
+    uint8_t count;
+    uint8_t next;
+    uint8_t pos;
+    precomp_answer_t answer[PRECOMP_BLOCKS];
+} precomp_t;
+
+static precomp_t *precomp = NULL;
+
+// blocks are read with the key of keytype on the cipher state pcs which is about to decrypt the next command
+static void PrecompPlan(struct Crypto1State *pcs, uint8_t keytype, const uint8_t *blocks, uint8_t n) {
+    if (precomp == NULL)
+        return;
+
+    precomp->state = *pcs;
+    precomp->bits = 0;
+    precomp->next = 0;
+    precomp->pos = 0;
+    memset(precomp->ks, 0, sizeof(precomp->ks));
+
+    precomp->count = 0;
+    for (uint8_t i = 0; i < n && i < PRECOMP_BLOCKS; i++) {
+        precomp_answer_t *a = &precomp->answer[precomp->count++];
+        a->block = blocks[i];
+        a->ready = false;
+        a->info.response = a->response;
+        a->info.modulation = a->modulation;
+        MifareSimReadAnswer(blocks[i], keytype, a->plain);
     }
 }
 
-static bool IsDataAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
+// the prepared answers fit only the frame right after the one they were planned for
+static uint8_t PrecompTake(void) {
+    if (precomp == NULL)
+        return 0;
+    uint8_t n = precomp->count;
+    precomp->count = 0;
+    return n;
+}
 
-    uint8_t sector_trailer[16];
-    emlGetMem(sector_trailer, SectorTrailer(blockNo), 1);
+static precomp_answer_t *PrecompFind(uint8_t n, uint8_t blockNo) {
+    for (uint8_t i = 0; i < n; i++) {
+        if (precomp->answer[i].ready && precomp->answer[i].block == blockNo)
+            return &precomp->answer[i];
+    }
+    return NULL;
+}
 
-    uint8_t sector_block;
-    if (blockNo <= MIFARE_2K_MAXBLOCK) {
-        sector_block = blockNo & 0x03;
-    } else {
-        sector_block = (blockNo & 0x0f) / 5;
+// One step, a cipher bit or a byte of an answer. Called by EmGetCmdEx() between two samples.
+static void PrecompStep(void) {
+    precomp_t *p = precomp;
+    if (p->next >= p->count)
+        return;
+
+    // keystream which decrypts the READ
+    if (p->bits < PRECOMP_CMD_BITS) {
+        crypto1_bit(&p->state, 0, 0);
+        p->bits++;
+        return;
     }
 
-    uint8_t AC;
-    switch (sector_block) {
-        case 0x00: {
-            AC = ((sector_trailer[7] >> 2) & 0x04)
-                 | ((sector_trailer[8] << 1) & 0x02)
-                 | ((sector_trailer[8] >> 4) & 0x01);
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: case 0x00 - %02x", AC);
-            break;
-        }
-        case 0x01: {
-            AC = ((sector_trailer[7] >> 3) & 0x04)
-                 | ((sector_trailer[8] >> 0) & 0x02)
-                 | ((sector_trailer[8] >> 5) & 0x01);
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: case 0x01 - %02x", AC);
-            break;
-        }
-        case 0x02: {
-            AC = ((sector_trailer[7] >> 4) & 0x04)
-                 | ((sector_trailer[8] >> 1) & 0x02)
-                 | ((sector_trailer[8] >> 6) & 0x01);
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: case 0x02  - %02x", AC);
-            break;
-        }
-        default:
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: Error");
-            return false;
+    // keystream of the answer, as mf_crypto1_encrypt() uses it
+    if (p->bits < PRECOMP_CMD_BITS + PRECOMP_ANS_BITS) {
+        uint16_t k = p->bits - PRECOMP_CMD_BITS;
+        p->ks[k >> 3] |= crypto1_bit(&p->state, 0, 0) << (k & 7);
+        if ((k & 7) == 7)
+            p->ks_par[k >> 3] = filter(p->state.odd);
+        p->bits++;
+        return;
     }
 
-    switch (action) {
-        case AC_DATA_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed - AC_DATA_READ: OK");
-            return ((keytype == AUTHKEYA && !(AC == 0x03 || AC == 0x05 || AC == 0x07))
-                    || (keytype == AUTHKEYB && !(AC == 0x07)));
-        }
-        case AC_DATA_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed - AC_DATA_WRITE: OK");
-            return ((keytype == AUTHKEYA && (AC == 0x00))
-                    || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x04 || AC == 0x06 || AC == 0x03)));
-        }
-        case AC_DATA_INC: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed - AC_DATA_INC: OK");
-            return ((keytype == AUTHKEYA && (AC == 0x00))
-                    || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x06)));
-        }
-        case AC_DATA_DEC_TRANS_REST: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("AC_DATA_DEC_TRANS_REST: OK");
-            return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x06 || AC == 0x01))
-                    || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x06 || AC == 0x01)));
-        }
+    precomp_answer_t *a = &p->answer[p->next];
+    uint8_t i = p->pos;
+    if (i == 0) {
+        memset(a->par, 0, sizeof(a->par));
+        prepare_tag_modulation_begin(&a->info);
     }
 
-    return false;
-}
+    a->response[i] = a->plain[i] ^ p->ks[i];
+    bool parity = (p->ks_par[i] ^ oddparity8(a->plain[i])) & 0x01;
+    a->par[i >> 3] |= parity << (7 - (i & 0x07));
+    prepare_tag_modulation_byte(&a->info, i, a->response[i], parity);
 
-static bool IsAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
-    if (IsSectorTrailer(blockNo)) {
-        return IsTrailerAccessAllowed(blockNo, keytype, action);
-    } else {
-        return IsDataAccessAllowed(blockNo, keytype, action);
+    if (++p->pos == MAX_MIFARE_FRAME_SIZE) {
+        prepare_tag_modulation_end(&a->info, MAX_MIFARE_FRAME_SIZE);
+        a->ready = true;
+        p->pos = 0;
+        p->next++;
     }
 }
 
@@ -457,6 +470,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
 
     uint8_t cardWRBL = 0;
     uint8_t cardAUTHSC = 0;
+    uint8_t cardAUTHBLOCK = 0;
     uint8_t cardAUTHKEY = AUTHKEYNONE;  // no authentication
     uint32_t cardRr = 0;
     uint32_t ans = 0;
@@ -468,6 +482,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
     pcs = &mpcs;
 
     uint32_t numReads = 0; //Counts numer of times reader reads a block
+    uint32_t numPrecompReads = 0;
     uint8_t receivedCmd[MAX_MIFARE_FRAME_SIZE] = {0x00};
     uint8_t receivedCmd_dec[MAX_MIFARE_FRAME_SIZE] = {0x00};
     uint8_t receivedCmd_par[MAX_MIFARE_PARITY_SIZE] = {0x00};
@@ -510,6 +525,15 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
         return;
     }
 
+    // the CVE 2021_0430 simulation changes block 4 while it is read, no answers ahead
+    precomp = NULL;
+    if ((flags & FLAG_CVE21_0430) != FLAG_CVE21_0430) {
+        precomp = (precomp_t *)BigBuf_malloc(sizeof(precomp_t));
+        if (precomp)
+            precomp->count = 0;
+    }
+    EmResetLateAnswers();
+
     // We need to listen to the high-frequency, peak-detected path.
     iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
 
@@ -556,7 +580,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
 
         FpgaEnableTracing();
         //Now, get data
-        int res = EmGetCmd(receivedCmd, &receivedCmd_len, receivedCmd_par);
+        int res = EmGetCmdEx(receivedCmd, &receivedCmd_len, receivedCmd_par, precomp ? PrecompStep : NULL);
+        uint8_t precomp_n = PrecompTake();
 
         if (res == 2) { //Field is off!
             //FpgaDisableTracing();
@@ -760,6 +785,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                     // Example: 6X  [00]
                     // 4K tags have 16 blocks per sector 32..39
                     cardAUTHSC = MifareBlockToSector(receivedCmd_dec[1]);
+                    cardAUTHBLOCK = receivedCmd_dec[1];
 
                     // cardAUTHKEY: 60 => Auth use Key A
                     // cardAUTHKEY: 61 => Auth use Key B
@@ -888,60 +914,31 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                         }
                     }
 
-                    emlGetMem(response, blockNo, 1);
-
-                    if (g_dbglevel >= DBG_EXTENDED)  {
-                        Dbprintf("[MFEMUL_WORK - ISO14443A_CMD_READBLOCK] Data Block[%d]: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", blockNo,
-                                 response[0], response[1], response[2], response[3],  response[4],  response[5],  response[6],
-                                 response[7], response[8], response[9], response[10], response[11], response[12], response[13],
-                                 response[14], response[15]);
-                    }
-
-                    // Access permission managment:
-                    //
-                    // Sector Trailer:
-                    // - KEY A access
-                    // - KEY B access
-                    // - AC bits access
-                    //
-                    // Data block:
-                    // - Data access
-
-                    // If permission is not allowed, data is cleared (00) in emulator memeory.
-                    // ex: a0a1a2a3a4a561e789c1b0b1b2b3b4b5 => 00000000000061e789c1b0b1b2b3b4b5
-
-
-                    // Check if selected Block is a Sector Trailer
-                    if (IsSectorTrailer(blockNo)) {
-
-                        if (IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYA_READ) == false) {
-                            memset(response, 0x00, 6); // keyA can never be read
-                            if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsSectorTrailer] keyA can never be read - block %d (0x%02x)", blockNo, blockNo);
-                        }
-                        if (IsAccessAllowed(blockNo, cardAUTHKEY, AC_KEYB_READ) == false) {
-                            memset(response + 10, 0x00, 6); // keyB cannot be read
-                            if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsSectorTrailer] keyB cannot be read - block %d (0x%02x)", blockNo, blockNo);
-                        }
-                        if (IsAccessAllowed(blockNo, cardAUTHKEY, AC_AC_READ) == false) {
-                            memset(response + 6, 0x00, 4); // AC bits cannot be read
-                            if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsAccessAllowed] AC bits cannot be read - block %d (0x%02x)", blockNo, blockNo);
-                        }
+                    precomp_answer_t *pa = PrecompFind(precomp_n, blockNo);
+                    if (pa) {
+                        // decrypting the READ and encrypting the answer is done already
+                        EmSendPrecompiledCmdPar(&pa->info, pa->par);
+                        FpgaDisableTracing();
+                        mpcs = precomp->state;
+                        numPrecompReads++;
                     } else {
-                        if (IsAccessAllowed(blockNo, cardAUTHKEY, AC_DATA_READ) == false) {
-                            memset(response, 0x00, 16); // datablock cannot be read
-                            if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK - IsAccessAllowed] Data block %d (0x%02x) cannot be read", blockNo, blockNo);
+                        MifareSimReadAnswer(blockNo, cardAUTHKEY, response);
+                        mf_crypto1_encrypt(pcs, response, MAX_MIFARE_FRAME_SIZE, response_par);
+                        EmSendCmdPar(response, MAX_MIFARE_FRAME_SIZE, response_par);
+                        FpgaDisableTracing();
+
+                        if (g_dbglevel >= DBG_EXTENDED) {
+                            Dbprintf("[MFEMUL_WORK - EmSendCmdPar] Data Block[%d]: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", blockNo,
+                                     response[0], response[1], response[2], response[3],  response[4],  response[5],  response[6],
+                                     response[7], response[8], response[9], response[10], response[11], response[12], response[13],
+                                     response[14], response[15]);
                         }
                     }
-                    AddCrc14A(response, 16);
-                    mf_crypto1_encrypt(pcs, response, MAX_MIFARE_FRAME_SIZE, response_par);
-                    EmSendCmdPar(response, MAX_MIFARE_FRAME_SIZE, response_par);
-                    FpgaDisableTracing();
 
-                    if (g_dbglevel >= DBG_EXTENDED) {
-                        Dbprintf("[MFEMUL_WORK - EmSendCmdPar] Data Block[%d]: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", blockNo,
-                                 response[0], response[1], response[2], response[3],  response[4],  response[5],  response[6],
-                                 response[7], response[8], response[9], response[10], response[11], response[12], response[13],
-                                 response[14], response[15]);
+                    // readers go through a sector block by block
+                    if (blockNo + 1 < FirstBlockOfSector(cardAUTHSC) + NumBlocksPerSector(cardAUTHSC)) {
+                        uint8_t next = blockNo + 1;
+                        PrecompPlan(pcs, cardAUTHKEY, &next, 1);
                     }
                     numReads++;
 
@@ -1197,6 +1194,10 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 LED_C_ON();
                 cardSTATE = MFEMUL_WORK;
                 if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_AUTH1] cardSTATE = MFEMUL_WORK");
+
+                // after an authentication readers mostly read the block they authenticated for or the first of the sector
+                uint8_t blocks[2] = { cardAUTHBLOCK, FirstBlockOfSector(cardAUTHSC) };
+                PrecompPlan(pcs, cardAUTHKEY, blocks, (blocks[0] == blocks[1]) ? 1 : 2);
                 break;
             }
 
@@ -1205,22 +1206,11 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 if (receivedCmd_len == MAX_MIFARE_FRAME_SIZE) {
                     mf_crypto1_decryptEx(pcs, receivedCmd, receivedCmd_len, receivedCmd_dec);
                     if (CheckCrc14A(receivedCmd_dec, receivedCmd_len)) {
-                        if (IsSectorTrailer(cardWRBL)) {
-                            emlGetMem(response, cardWRBL, 1);
-                            if (!IsAccessAllowed(cardWRBL, cardAUTHKEY, AC_KEYA_WRITE)) {
-                                memcpy(receivedCmd_dec, response, 6); // don't change KeyA
-                            }
-                            if (!IsAccessAllowed(cardWRBL, cardAUTHKEY, AC_KEYB_WRITE)) {
-                                memcpy(receivedCmd_dec + 10, response + 10, 6); // don't change KeyA
-                            }
-                            if (!IsAccessAllowed(cardWRBL, cardAUTHKEY, AC_AC_WRITE)) {
-                                memcpy(receivedCmd_dec + 6, response + 6, 4); // don't change AC bits
-                            }
-                        } else {
-                            if (!IsAccessAllowed(cardWRBL, cardAUTHKEY, AC_DATA_WRITE)) {
-                                memcpy(receivedCmd_dec, response, 16); // don't change anything
-                            }
-                        }
+                        // keep what the key may not write
+                        uint8_t sector_trailer[16];
+                        emlGetMem(response, cardWRBL, 1);
+                        emlGetMem(sector_trailer, mfc_sector_trailer(cardWRBL), 1);
+                        mfc_write_mask(sector_trailer, cardWRBL, cardAUTHKEY, response, receivedCmd_dec);
                         emlSetMem(receivedCmd_dec, cardWRBL, 1);
                         EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_ACK)); // always ACK?
                         FpgaDisableTracing();
@@ -1336,6 +1326,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
 
     if (g_dbglevel >= DBG_ERROR) {
         Dbprintf("Emulator stopped. Tracing: %d  trace length: %d ", get_tracing(), BigBuf_get_traceLen());
+        Dbprintf("Reads: %d  answered ahead: %d  answers late: %d", numReads, numPrecompReads, EmGetLateAnswers());
     }
 
     if ((flags & FLAG_INTERACTIVE) == FLAG_INTERACTIVE) {  // Interactive mode flag, means we need to send ACK
@@ -14,26 +14,12 @@
 #define __MIFARESIM_H
 
 #include "common.h"
+#include "mfc_model.h"
 
 #ifndef CheckCrc14A
 # define CheckCrc14A(data, len) check_crc(CRC_14443_A, (data), (len))
 #endif
 
-#define AC_DATA_READ             0
-#define AC_DATA_WRITE            1
-#define AC_DATA_INC              2
-#define AC_DATA_DEC_TRANS_REST   3
-#define AC_KEYA_READ             0
-#define AC_KEYA_WRITE            1
-#define AC_KEYB_READ             2
-#define AC_KEYB_WRITE            3
-#define AC_AC_READ               4
-#define AC_AC_WRITE              5
-
-#define AUTHKEYA                 0
-#define AUTHKEYB                 1
-#define AUTHKEYNONE              0xff
-
 void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint16_t atqa, uint8_t sak);
 
 #endif
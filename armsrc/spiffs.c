@@ -198,6 +198,29 @@ void read_from_spiffs(const char *filename, uint8_t *dst, uint32_t size) {
     SPIFFS_close(&fs, fd);
 }
 
+// reads the file chunk by chunk through buf,  up to size bytes
+static void stream_from_spiffs(const char *filename, uint8_t *buf, uint32_t bufsize, uint32_t size, rdv40_spiffs_chunk_cb_t cb) {
+    spiffs_file fd = SPIFFS_open(&fs, filename, SPIFFS_RDONLY, 0);
+    if (fd < 0) {
+        Dbprintf("errno %i\n", SPIFFS_errno(&fs));
+        return;
+    }
+
+    for (uint32_t offset = 0; offset < size;) {
+        s32_t n = SPIFFS_read(&fs, fd, buf, MIN(bufsize, size - offset));
+        if (n < 0) {
+            Dbprintf("errno %i\n", SPIFFS_errno(&fs));
+            break;
+        }
+        if (n == 0)
+            break;
+
+        cb(offset, buf, n);
+        offset += n;
+    }
+    SPIFFS_close(&fs, fd);
+}
+
 static void rename_in_spiffs(const char *old_filename, const char *new_filename) {
     if (SPIFFS_rename(&fs, old_filename, new_filename) < 0)
         Dbprintf("errno %i\n", SPIFFS_errno(&fs));
@@ -534,6 +557,31 @@ int rdv40_spiffs_read_as_filetype(char *filename, uint8_t *dst, uint32_t size, R
     )
 }
 
+// Same as rdv40_spiffs_read_as_filetype, but without a buffer for the whole file:
+// the file is read bufsize bytes at a time and every chunk is handed to cb.
+int rdv40_spiffs_read_as_stream(char *filename, uint8_t *buf, uint32_t bufsize, uint32_t size, rdv40_spiffs_chunk_cb_t cb, RDV40SpiFFSSafetyLevel level) {
+    RDV40_SPIFFS_SAFE_FUNCTION(
+        RDV40SpiFFSFileType filetype = filetype_in_spiffs((char *)filename);
+    switch (filetype) {
+    case RDV40_SPIFFS_FILETYPE_REAL:
+        stream_from_spiffs(filename, buf, bufsize, size, cb);
+            break;
+        case RDV40_SPIFFS_FILETYPE_SYMLINK: {
+            char linkdest[SPIFFS_OBJ_NAME_LEN];
+            char linkfilename[SPIFFS_OBJ_NAME_LEN];
+            sprintf(linkfilename, "%s.lnk", filename);
+            read_from_spiffs(linkfilename, (uint8_t *)linkdest, SPIFFS_OBJ_NAME_LEN);
+            stream_from_spiffs(linkdest, buf, bufsize, size, cb);
+            break;
+        }
+        case RDV40_SPIFFS_FILETYPE_BOTH:
+        case RDV40_SPIFFS_FILETYPE_UNKNOWN:
+        default:
+            ;
+    }
+    )
+}
+
 // TODO regarding reads/write and symlinks :
 // Provide a higher level readFile function which
 //   - don't need a size to be provided, getting it from STAT call and using bigbuff malloc
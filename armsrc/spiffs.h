@@ -32,6 +32,9 @@ typedef struct rdv40_spiffs_fsinfo {
 } rdv40_spiffs_fsinfo;
 
 int rdv40_spiffs_read_as_filetype(char *filename, uint8_t *dst, uint32_t size, RDV40SpiFFSSafetyLevel level);
+// called for every chunk of a streamed file,  offset is the position of data in the file
+typedef void (*rdv40_spiffs_chunk_cb_t)(uint32_t offset, const uint8_t *data, uint32_t len);
+int rdv40_spiffs_read_as_stream(char *filename, uint8_t *buf, uint32_t bufsize, uint32_t size, rdv40_spiffs_chunk_cb_t cb, RDV40SpiFFSSafetyLevel level);
 
 int rdv40_spiffs_check(void);
 int rdv40_spiffs_lazy_unmount(void);
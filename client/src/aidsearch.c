@@ -12,45 +12,12 @@
 #include <string.h>
 #include "fileutils.h"
 #include "pm3_cmd.h"
+#include "resources.h"
 
-static int openAIDFile(json_t **root, bool verbose) {
-    json_error_t error;
-
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "aidlist", ".json", false);
-    if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    if (!json_is_array(*root)) {
-        PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    PrintAndLogEx(DEBUG, "Loaded file " _YELLOW_("%s") " " _GREEN_("%zu") " records ( " _GREEN_("ok") " )", path, json_array_size(*root));
-out:
-    free(path);
-    return retval;
-}
-
-static int closeAIDFile(json_t *root) {
-    json_decref(root);
-    return PM3_SUCCESS;
-}
-
+// the aidlist is cached for the whole session,  see resources.c
 json_t *AIDSearchInit(bool verbose) {
-    json_t *root = NULL;
-    int res = openAIDFile(&root, verbose);
-    if (res != PM3_SUCCESS)
+    json_t *root = resource_json("aidlist", verbose);
+    if (json_is_array(root) == false)
         return NULL;
 
     return root;
@@ -66,7 +33,9 @@ json_t *AIDSearchGetElm(json_t *root, size_t elmindx) {
 }
 
 int AIDSearchFree(json_t *root) {
-    return closeAIDFile(root);
+    // nothing to free,  the cache owns it
+    (void)root;
+    return PM3_SUCCESS;
 }
 
 static const char *jsonStrGet(json_t *data, const char *name) {
@@ -86,17 +55,6 @@ static const char *jsonStrGet(json_t *data, const char *name) {
     return cstr;
 }
 
-static bool aidCompare(const char *aidlarge, const char *aidsmall) {
-    if (strcmp(aidlarge, aidsmall) == 0)
-        return true;
-
-    if (strlen(aidlarge) > strlen(aidsmall))
-        if (strncmp(aidlarge, aidsmall, strlen(aidsmall)) == 0)
-            return true;
-
-    return false;
-}
-
 bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
     *aidlen = 0;
     const char *hexaid = jsonStrGet(data, "AID");
@@ -111,31 +69,12 @@ bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
 }
 
 int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
-    int retval = PM3_SUCCESS;
-
-    json_t *root = xroot;
-    if (root == NULL)
-        root = AIDSearchInit(verbose);
-    if (root == NULL)
-        goto out;
-
-    json_t *elm = NULL;
-    size_t maxaidlen = 0;
-    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
-        json_t *data = AIDSearchGetElm(root, elmindx);
-        if (data == NULL)
-            continue;
-        const char *dictaid = jsonStrGet(data, "AID");
-        if (aidCompare(aid, dictaid)) {  // dictaid may be less length than requested aid
-            if (maxaidlen < strlen(dictaid) && strlen(dictaid) <= strlen(aid)) {
-                maxaidlen = strlen(dictaid);
-                elm = data;
-            }
-        }
-    }
+    // xroot can only be the cached aidlist,  the lookup goes through its index
+    (void)xroot;
 
+    json_t *elm = resource_aid_lookup(aid);
     if (elm == NULL)
-        goto out;
+        return PM3_SUCCESS;
 
     // print here
     const char *vaid = jsonStrGet(elm, "AID");
@@ -162,11 +101,7 @@ int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
         if (description)
             PrintAndLogEx(SUCCESS, "Description... %s", description);
     }
-
-out:
-    if (xroot == NULL)
-        AIDSearchFree(root);
-    return retval;
+    return PM3_SUCCESS;
 }
 
 int PrintAIDDescriptionBuf(json_t *root, uint8_t *aid, size_t aidlen, bool verbose) {
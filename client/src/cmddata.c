@@ -328,6 +328,7 @@ int CmdGetBitStream(const char *Cmd) {
     CLIParserFree(ctx);
 
     CmdHpf("");
+    graphWritable();
     for (uint32_t i = 0; i < g_GraphTraceLen; i++) {
         g_GraphBuffer[i] = (g_GraphBuffer[i] >= 1) ? 1 : 0;
     }
@@ -379,17 +380,12 @@ int ASKDemod_ext(int clk, int invert, int maxErr, size_t maxlen, bool amplify, b
     if (maxlen == 0)
         maxlen = g_pm3_capabilities.bigbuf_size;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
-    if (bits == NULL) {
-        PrintAndLogEx(INFO, "failed to allocate memory");
-        return PM3_EMALLOC;
-    }
-
-    size_t bitlen = getFromGraphBuf(bits);
+    size_t bitlen = 0;
+    uint8_t *bits = getGraphBufCopy(&bitlen);
 
     PrintAndLogEx(DEBUG, "DEBUG: (ASKDemod_ext) #samples from graphbuff: %zu", bitlen);
 
-    if (bitlen < 255) {
+    if (bits == NULL || bitlen < 255) {
         free(bits);
         return PM3_ESOFT;
     }
@@ -671,9 +667,9 @@ static int CmdBiphaseDecodeRaw(const char *Cmd) {
 int ASKbiphaseDemod(int offset, int clk, int invert, int maxErr, bool verbose) {
     //ask raw demod g_GraphBuffer first
 
-    uint8_t bs[MAX_DEMOD_BUF_LEN];
-    size_t size = getFromGraphBuf(bs);
-    if (size == 0) {
+    size_t size = 0;
+    uint8_t *bs = getGraphBufCopy(&size);
+    if (bs == NULL) {
         PrintAndLogEx(DEBUG, "DEBUG: no data in graphbuf");
         return PM3_ESOFT;
     }
@@ -682,6 +678,7 @@ int ASKbiphaseDemod(int offset, int clk, int invert, int maxErr, bool verbose) {
     int errCnt = askdemod_ext(bs, &size, &clk, &invert, maxErr, 0, 0, &startIdx);
     if (errCnt < 0 || errCnt > maxErr) {
         PrintAndLogEx(DEBUG, "DEBUG: no data or error found %d, clock: %d", errCnt, clk);
+        free(bs);
         return PM3_ESOFT;
     }
 
@@ -689,10 +686,12 @@ int ASKbiphaseDemod(int offset, int clk, int invert, int maxErr, bool verbose) {
     errCnt = BiphaseRawDecode(bs, &size, &offset, invert);
     if (errCnt < 0) {
         if (g_debugMode || verbose) PrintAndLogEx(DEBUG, "DEBUG: Error BiphaseRawDecode: %d", errCnt);
+        free(bs);
         return PM3_ESOFT;
     }
     if (errCnt > maxErr) {
         if (g_debugMode || verbose) PrintAndLogEx(DEBUG, "DEBUG: Error BiphaseRawDecode too many errors: %d", errCnt);
+        free(bs);
         return PM3_ESOFT;
     }
 
@@ -701,6 +700,7 @@ int ASKbiphaseDemod(int offset, int clk, int invert, int maxErr, bool verbose) {
     }
     //success set g_DemodBuffer and return
     setDemodBuff(bs, size, 0);
+    free(bs);
     setClockGrid(clk, startIdx + clk * offset / 2);
     if (g_debugMode || verbose) {
         PrintAndLogEx(DEBUG, "Biphase Decoded using offset %d | clock %d | #errors %d | start index %d\ndata\n", offset, clk, errCnt, (startIdx + clk * offset / 2));
@@ -790,7 +790,11 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     // Computed variance
     double variance = compute_variance(in, len);
 
-    int *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    int *correl_buf = calloc(len + 1, sizeof(int));
+    if (correl_buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return 0;
+    }
 
     for (size_t i = 0; i < len - window; ++i) {
 
@@ -892,6 +896,9 @@ static int CmdAutoCorr(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (updateGrph)
+        graphWritable();
+
     AutoCorrelate(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, window, updateGrph, true);
     return PM3_SUCCESS;
 }
@@ -918,6 +925,10 @@ static int CmdBitsamples(const char *Cmd) {
         return PM3_ETIMEOUT;
     }
 
+    ClearGraph(false);
+    if (graphReserve(ARRAYLEN(got) * 8) == false)
+        return PM3_EMALLOC;
+
     for (size_t j = 0; j < ARRAYLEN(got); j++) {
         for (uint8_t k = 0; k < 8; k++) {
             if (got[j] & (1 << (7 - k)))
@@ -968,6 +979,7 @@ static int CmdDecimate(const char *Cmd) {
     int n = arg_get_int_def(ctx, 1, 2);
     CLIParserFree(ctx);
 
+    graphWritable();
     for (size_t i = 0; i < (g_GraphTraceLen / n); ++i)
         g_GraphBuffer[i] = g_GraphBuffer[i * n];
 
@@ -1000,23 +1012,36 @@ static int CmdUndecimate(const char *Cmd) {
     int factor = arg_get_int_def(ctx, 1, 2);
     CLIParserFree(ctx);
 
-    //We have memory, don't we?
-    int swap[MAX_GRAPH_TRACE_LEN] = {0};
-    uint32_t g_index = 0, s_index = 0;
-    while (g_index < g_GraphTraceLen && s_index + factor < MAX_GRAPH_TRACE_LEN) {
+    if (factor < 1 || g_GraphTraceLen == 0)
+        return PM3_EINVARG;
+
+    int *swap = calloc(g_GraphTraceLen * factor, sizeof(int));
+    if (swap == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    size_t g_index = 0, s_index = 0;
+    while (g_index < g_GraphTraceLen) {
+        int next = (g_index + 1 < g_GraphTraceLen) ? g_GraphBuffer[g_index + 1] : g_GraphBuffer[g_index];
         int count = 0;
-        for (count = 0; count < factor && s_index + count < MAX_GRAPH_TRACE_LEN; count++) {
+        for (count = 0; count < factor; count++) {
             swap[s_index + count] = (
                                         (double)(factor - count) / (factor - 1)) * g_GraphBuffer[g_index] +
-                                    ((double)count / factor) * g_GraphBuffer[g_index + 1]
+                                    ((double)count / factor) * next
                                     ;
         }
         s_index += count;
         g_index++;
     }
 
+    if (graphReserve(s_index) == false) {
+        free(swap);
+        return PM3_EMALLOC;
+    }
     memcpy(g_GraphBuffer, swap, s_index * sizeof(int));
     g_GraphTraceLen = s_index;
+    free(swap);
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -1039,6 +1064,7 @@ static int CmdGraphShiftZero(const char *Cmd) {
     int shift = arg_get_int_def(ctx, 1, 0);
     CLIParserFree(ctx);
 
+    graphWritable();
     for (size_t i = 0; i < g_GraphTraceLen; i++) {
         int shiftedVal = g_GraphBuffer[i] + shift;
 
@@ -1085,6 +1111,7 @@ static int CmdAskEdgeDetect(const char *Cmd) {
     CLIParserFree(ctx);
 
     PrintAndLogEx(INFO, "using threshold " _YELLOW_("%i"), threshold);
+    graphWritable();
     int res = AskEdgeDetect(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, threshold);
     RepaintGraphWindow();
     return res;
@@ -1176,16 +1203,10 @@ int FSKrawDemod(uint8_t rfLen, uint8_t invert, uint8_t fchigh, uint8_t fclow, bo
         return PM3_ESOFT;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    size_t bitlen = 0;
+    uint8_t *bits = getGraphBufCopy(&bitlen);
     if (bits == NULL) {
-        PrintAndLogEx(FAILED, "failed to allocate memory");
-        return PM3_EMALLOC;
-    }
-
-    size_t bitlen = getFromGraphBuf(bits);
-    if (bitlen == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: no data in graphbuf");
-        free(bits);
         return PM3_ESOFT;
     }
 
@@ -1279,14 +1300,9 @@ int PSKDemod(int clk, int invert, int maxErr, bool verbose) {
         return PM3_ESOFT;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    size_t bitlen = 0;
+    uint8_t *bits = getGraphBufCopy(&bitlen);
     if (bits == NULL) {
-        PrintAndLogEx(FAILED, "failed to allocate memory");
-        return PM3_EMALLOC;
-    }
-    size_t bitlen = getFromGraphBuf(bits);
-    if (bitlen == 0) {
-        free(bits);
         return PM3_ESOFT;
     }
 
@@ -1329,16 +1345,9 @@ int NRZrawDemod(int clk, int invert, int maxErr, bool verbose) {
         return PM3_ESOFT;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    size_t bitlen = 0;
+    uint8_t *bits = getGraphBufCopy(&bitlen);
     if (bits == NULL) {
-        PrintAndLogEx(FAILED, "failed to allocate memory");
-        return PM3_EMALLOC;
-    }
-
-    size_t bitlen = getFromGraphBuf(bits);
-
-    if (bitlen == 0) {
-        free(bits);
         return PM3_ESOFT;
     }
 
@@ -1698,13 +1707,17 @@ int CmdHpf(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
+    if (bits == NULL)
+        return PM3_ESOFT;
+
     removeSignalOffset(bits, size);
     // push it back to graph
     setGraphBuf(bits, size);
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
+    free(bits);
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -1758,6 +1771,10 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose) {
 
     if (verbose) PrintAndLogEx(SUCCESS, "Data fetched");
 
+    g_GraphTraceLen = 0;
+    if (graphReserve(n) == false)
+        return PM3_EMALLOC;
+
     uint8_t bits_per_sample = 8;
 
     //Old devices without this feature would send 0 at arg[0]
@@ -1788,10 +1805,11 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose) {
         g_GraphTraceLen = n;
     }
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    if (bits)
+        computeSignalProperties(bits, size);
 
     setClockGrid(0, 0);
     g_DemodBufferLen = 0;
@@ -1994,6 +2012,9 @@ int CmdTuneSamples(const char *Cmd) {
     // graph LF measurements
     // even here, these values has 3% error.
     uint16_t test1 = 0;
+    if (graphReserve(MAX(g_GraphTraceLen, 256)) == false)
+        return PM3_EMALLOC;
+
     for (int i = 0; i < 256; i++) {
         g_GraphBuffer[i] = package->results[i] - 128;
         test1 += package->results[i];
@@ -2053,22 +2074,24 @@ static int CmdLoad(const char *Cmd) {
     g_GraphTraceLen = 0;
     char line[80];
     while (fgets(line, sizeof(line), f)) {
+        if (graphReserve(g_GraphTraceLen + 1) == false)
+            break;
+
         g_GraphBuffer[g_GraphTraceLen] = atoi(line);
         g_GraphTraceLen++;
-
-        if (g_GraphTraceLen >= MAX_GRAPH_TRACE_LEN)
-            break;
     }
     fclose(f);
 
     PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%zu") " samples", g_GraphTraceLen);
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
-
-    removeSignalOffset(bits, size);
-    setGraphBuf(bits, size);
-    computeSignalProperties(bits, size);
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
+    if (bits) {
+        removeSignalOffset(bits, size);
+        setGraphBuf(bits, size);
+        computeSignalProperties(bits, size);
+        free(bits);
+    }
 
     setClockGrid(0, 0);
     g_DemodBufferLen = 0;
@@ -2098,10 +2121,7 @@ int CmdLtrim(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    for (uint32_t i = ds; i < g_GraphTraceLen; ++i)
-        g_GraphBuffer[i - ds] = g_GraphBuffer[i];
-
-    g_GraphTraceLen -= ds;
+    graphSlice(ds, g_GraphTraceLen - ds);
     g_DemodStartIdx -= ds;
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2162,10 +2182,7 @@ static int CmdMtrim(const char *Cmd) {
     // leave start position sample
     start++;
 
-    g_GraphTraceLen = stop - start;
-    for (uint32_t i = 0; i < g_GraphTraceLen; i++) {
-        g_GraphBuffer[i] = g_GraphBuffer[start + i];
-    }
+    graphSlice(start, stop - start);
 
     return PM3_SUCCESS;
 }
@@ -2187,22 +2204,28 @@ int CmdNorm(const char *Cmd) {
     int max = INT_MIN, min = INT_MAX;
 
     // Find local min, max
-    for (uint32_t i = 10; i < g_GraphTraceLen; ++i) {
-        if (g_GraphBuffer[i] > max) max = g_GraphBuffer[i];
-        if (g_GraphBuffer[i] < min) min = g_GraphBuffer[i];
-    }
-
-    if (max != min) {
-        for (uint32_t i = 0; i < g_GraphTraceLen; ++i) {
-            g_GraphBuffer[i] = ((long)(g_GraphBuffer[i] - ((max + min) / 2)) * 256) / (max - min);
+    const int *samples = g_GraphBuffer;
+    size_t len = g_GraphTraceLen;
+    for (size_t i = 10; i < len; ++i) {
+        max = (samples[i] > max) ? samples[i] : max;
+        min = (samples[i] < min) ? samples[i] : min;
+    }
+
+    if (max != min && graphWritable()) {
+        int *out = g_GraphBuffer;
+        long mid = (max + min) / 2;
+        long range = (long)max - min;
+        for (size_t i = 0; i < len; ++i) {
+            out[i] = ((out[i] - mid) * 256) / range;
             //marshmelow: adjusted *1000 to *256 to make +/- 128 so demod commands still work
         }
     }
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    if (bits)
+        computeSignalProperties(bits, size);
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2338,13 +2361,14 @@ static int CmdDirectionalThreshold(const char *Cmd) {
 
     PrintAndLogEx(INFO, "Applying up threshold: " _YELLOW_("%i") ", down threshold: " _YELLOW_("%i") "\n", up, down);
 
+    graphWritable();
     directionalThreshold(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, up, down);
 
-    // set signal properties low/high/mean/amplitude and isnoice detection
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
-    // set signal properties low/high/mean/amplitude and is_noice detection
-    computeSignalProperties(bits, size);
+    // set signal properties low/high/mean/amplitude and is_noise detection
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
+    if (bits)
+        computeSignalProperties(bits, size);
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2368,6 +2392,7 @@ static int CmdZerocrossings(const char *Cmd) {
 
     int sign = 1, zc = 0, lastZc = 0;
 
+    graphWritable();
     for (uint32_t i = 0; i < g_GraphTraceLen; ++i) {
         if (g_GraphBuffer[i] * sign >= 0) {
             // No change in sign, reproduce the previous sample count.
@@ -2384,10 +2409,11 @@ static int CmdZerocrossings(const char *Cmd) {
         }
     }
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    if (bits)
+        computeSignalProperties(bits, size);
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -2664,6 +2690,7 @@ static int CmdFSKToNRZ(const char *Cmd) {
 
     setClockGrid(0, 0);
     g_DemodBufferLen = 0;
+    graphWritable();
     int ans = FSKToNRZ(g_GraphBuffer, &g_GraphTraceLen, clk, fc_low, fc_high);
     CmdNorm("");
     RepaintGraphWindow();
@@ -2686,12 +2713,14 @@ static int CmdDataIIR(const char *Cmd) {
     uint8_t k = (arg_get_u32_def(ctx, 1, 0) & 0xFF);
     CLIParserFree(ctx);
 
+    graphWritable();
     iceSimple_Filter(g_GraphBuffer, g_GraphTraceLen, k);
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    if (bits)
+        computeSignalProperties(bits, size);
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -13,6 +13,7 @@
 #include "cliparser.h"
 #include "pmflash.h"           // rdv40validation_t
 #include "fileutils.h"         // saveFile
+#include "util_posix.h"       // msclock
 #include "comms.h"             // getfromdevice
 #include "cmdflashmemspiffs.h" // spiffs commands
 #include "rsa.h"
@@ -349,11 +350,13 @@ static int CmdFlashMemDump(const char *Cmd) {
     }
 
     PrintAndLogEx(INFO, "downloading "_YELLOW_("%u")" bytes from flash memory", len);
+    uint64_t t_start = msclock();
     if (!GetFromDevice(FLASH_MEM, dump, len, offset, NULL, 0, NULL, -1, true)) {
         PrintAndLogEx(FAILED, "ERROR; downloading from flash memory");
         free(dump);
         return PM3_EFLASH;
     }
+    PrintDownloadRate(len, t_start);
 
     if (view) {
         PrintAndLogEx(INFO, "---- " _CYAN_("data") " ---------------");
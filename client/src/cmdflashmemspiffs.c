@@ -12,6 +12,7 @@
 #include "cmdparser.h"  // command_t
 #include "pmflash.h"
 #include "fileutils.h"  //saveFile
+#include "util_posix.h" // msclock
 #include "comms.h"      //getfromdevice
 #include "cliparser.h"
 
@@ -369,11 +370,13 @@ static int CmdFlashMemSpiFFSDump(const char *Cmd) {
     // download from device
     uint32_t start_index = 0;
     PrintAndLogEx(INFO, "downloading "_YELLOW_("%u") " bytes from `" _YELLOW_("%s") "` (spiffs)", len, src);
+    uint64_t t_start = msclock();
     if (!GetFromDevice(SPIFFS, dump, len, start_index, (uint8_t *)src, slen, NULL, -1, true)) {
         PrintAndLogEx(FAILED, "error, downloading from spiffs");
         free(dump);
         return PM3_EFLASH;
     }
+    PrintDownloadRate(len, t_start);
 
     // save to file
     char fn[FILE_PATH_SIZE] = {0};
@@ -41,6 +41,8 @@
 #include "cmdhfst25ta.h"    // ST25TA
 #include "cmdhfwaveshare.h" // Waveshare
 #include "cmdtrace.h"       // trace list
+#include "hfrawdecode.h"     // raw sniff samples
+#include "fileutils.h"
 #include "ui.h"
 #include "proxgui.h"
 #include "cmddata.h"
@@ -49,27 +51,130 @@
 
 static int CmdHelp(const char *Cmd);
 
+// runs the probes of `hf search` on the device in one command
+static int hf_search_device(bool verbose, bool first) {
+
+    // the sweep only tries what the firmware was built with, ask for everything
+    hf_search_req_t payload = {
+        .techs = HF_SEARCH_ALL,
+        .flags = (first) ? HF_SEARCH_FLAG_FIRST : 0,
+    };
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SEARCH, (uint8_t *)&payload, sizeof(payload));
+    if (WaitForResponseTimeout(CMD_HF_SEARCH, &resp, 5000) == false) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(INFO, "aborted by user");
+        return resp.status;
+    }
+
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(hf_search_result_t)) {
+        PrintAndLogEx(WARNING, "search sweep failed");
+        return PM3_EFAILED;
+    }
+
+    static const char *names[HF_SEARCH_TECHS] = {
+        "Thinfilm tag",
+        "ISO 14443-A tag",
+        "ISO 15693 tag",
+        "iCLASS tag / PicoPass tag",
+        "LEGIC Prime tag",
+        "ISO 14443-B tag",
+        "ISO 18092 / FeliCa tag",
+    };
+    static const char *uid_names[HF_SEARCH_TECHS] = {
+        "Data", "UID", "UID", "CSN", "UID", "UID", "IDm"
+    };
+    static const char *short_names[HF_SEARCH_TECHS] = {
+        "ThinFilm", "14a", "15693", "iCLASS", "LEGIC", "14b", "FeliCa"
+    };
+
+    hf_search_result_t *r = (hf_search_result_t *)resp.data.asBytes;
+
+    int res = PM3_ESOFT;
+    for (uint8_t i = 0; i < HF_SEARCH_TECHS; i++) {
+        if ((r->found & (1 << i)) == 0)
+            continue;
+
+        PrintAndLogEx(SUCCESS, "Valid " _GREEN_("%s") " found", names[i]);
+        if (r->uid[i].len)
+            PrintAndLogEx(SUCCESS, " %s: " _GREEN_("%s"), uid_names[i], sprint_hex_inrow(r->uid[i].uid, r->uid[i].len));
+
+        if ((1 << i) == HF_SEARCH_14A)
+            PrintAndLogEx(SUCCESS, "ATQA: %02X %02X  SAK: %02X", r->atqa[1], r->atqa[0], r->sak);
+
+        res = PM3_SUCCESS;
+    }
+
+    // LTO-CM and Topaz skip the anticollision, the client side probes find out which one it is
+    if ((r->found & HF_SEARCH_14A) && r->select_status == 3) {
+        if (infoLTO(false) == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Valid " _GREEN_("LTO-CM tag") " found");
+        } else if (readTopazUid(false) == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Valid " _GREEN_("Topaz tag") " found");
+        }
+    }
+
+    if (verbose) {
+        char probed[80] = {0};
+        for (uint8_t i = 0; i < HF_SEARCH_TECHS; i++) {
+            if (r->probed & (1 << i)) {
+                size_t n = strlen(probed);
+                snprintf(probed + n, sizeof(probed) - n, "%s%s", n ? ", " : "", short_names[i]);
+            }
+        }
+        PrintAndLogEx(INFO, "probed...... %s", probed);
+        PrintAndLogEx(INFO, "reloads..... %u fpga bitstream", r->reloads);
+        PrintAndLogEx(INFO, "time........ %u ms", r->elapsed);
+    }
+    return res;
+}
+
 int CmdHFSearch(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf search",
                   "Will try to find a HF read out of the unknown tag.\n"
-                  "Continues to search for all different HF protocols.",
-                  "hf search"
+                  "Continues to search for all different HF protocols.\n"
+                  "With --fast the device runs all probes in one sweep and only the UIDs are shown.",
+                  "hf search\n"
+                  "hf search --fast\n"
+                  "hf search --first     -> device sweep, stops at the first tag type found"
                  );
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("v", "verbose", "verbose output"),
+        arg_lit0("f", "fast", "search on the device in one sweep"),
+        arg_lit0(NULL, "first", "device sweep, stop at the first tag type found (implies --fast)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
     bool verbose = arg_get_lit(ctx, 1);
+    bool first = arg_get_lit(ctx, 3);
+    bool fast = arg_get_lit(ctx, 2) || first;
 
     CLIParserFree(ctx);
 
     int res = PM3_ESOFT;
 
+    if (fast) {
+        PROMPT_CLEARLINE;
+        PrintAndLogEx(INPLACE, " Searching for HF tags...");
+        res = hf_search_device(verbose, first);
+        PROMPT_CLEARLINE;
+        if (res == PM3_ESOFT) {
+            PrintAndLogEx(WARNING, _RED_("No known/supported 13.56 MHz tags found"));
+        }
+        DropField();
+        return res;
+    }
+
     PROMPT_CLEARLINE;
     PrintAndLogEx(INPLACE, " Searching for ThinFilm tag...");
     if (IfPm3NfcBarcode()) {
@@ -274,6 +379,91 @@ int CmdHFTune(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// streams the samples of a protocol sniffer into a file,  `trace decode` turns them into a trace
+static int hf_sniff_raw(uint8_t proto, const char *filename) {
+
+    char *fn = newfilenamemcopy(filename, ".raw");
+    if (fn == NULL)
+        return PM3_EMALLOC;
+
+    FILE *f = fopen(fn, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", fn);
+        free(fn);
+        return PM3_EFILE;
+    }
+
+    PrintAndLogEx(INFO, "Streaming sniffer samples to " _YELLOW_("%s"), fn);
+    PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " or pm3 button to stop");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_SNIFF_RAW, &proto, sizeof(proto));
+
+    // chunks the device had to drop are filled with idle samples, that keeps the timing
+    size_t ssize = hfraw_sample_size(proto);
+    uint8_t idle[HF_SNIFF_RAW_CHUNK];
+    for (size_t i = 0; i < sizeof(idle); i += ssize)
+        hfraw_idle_sample(proto, idle + i);
+
+    uint32_t next = 0, filled = 0;
+    uint64_t bytes = 0;
+    bool stopping = false;
+    int res = PM3_SUCCESS;
+    PacketResponseNG resp;
+
+    for (;;) {
+
+        if (stopping == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopping = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
+            if (stopping) {
+                PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+                res = PM3_ETIMEOUT;
+                break;
+            }
+            continue;
+        }
+
+        if (resp.cmd == CMD_HF_SNIFF_RAW_DATA) {
+            hf_sniff_raw_chunk_t *chunk = (hf_sniff_raw_chunk_t *)resp.data.asBytes;
+            for (; next < chunk->seq; next++, filled++) {
+                fwrite(idle, 1, sizeof(idle), f);
+                bytes += sizeof(idle);
+            }
+            fwrite(chunk->data, 1, sizeof(chunk->data), f);
+            bytes += sizeof(chunk->data);
+            next = chunk->seq + 1;
+            continue;
+        }
+
+        if (resp.cmd == CMD_HF_SNIFF_RAW) {
+            hf_sniff_raw_result_t *r = (hf_sniff_raw_result_t *)resp.data.asBytes;
+            if (resp.status == PM3_EOPABORTED)
+                PrintAndLogEx(INFO, "Button pressed, user aborted");
+            else if (resp.status != PM3_SUCCESS)
+                res = resp.status;
+
+            PrintAndLogEx(SUCCESS, "chunks " _YELLOW_("%" PRIu32) "  lost " _YELLOW_("%" PRIu32), r->chunks, r->lost);
+            if (r->stalls)
+                PrintAndLogEx(WARNING, "sampling stalled %" PRIu32 " times, the capture has time gaps", r->stalls);
+            if (filled != r->lost)
+                PrintAndLogEx(WARNING, "%" PRIu32 " chunks lost on the way to the client", filled - r->lost);
+            break;
+        }
+    }
+    fclose(f);
+
+    PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%" PRIu64) " bytes to " _YELLOW_("%s"), bytes, fn);
+    if (res == PM3_SUCCESS && bytes)
+        PrintAndLogEx(HINT, "Use `" _YELLOW_("trace decode -f %s -t %s") "` to decode", fn,
+                      (proto == HF_SNIFF_RAW_14A) ? "14a" : (proto == HF_SNIFF_RAW_14B) ? "14b" : "15");
+    free(fn);
+    return res;
+}
+
 // Collects pars of u8,
 // uses 16bit transfers from FPGA for speed
 // Takes all available bigbuff memory
@@ -284,14 +474,21 @@ int CmdHFSniff(const char *Cmd) {
     CLIParserInit(&ctx, "hf sniff",
                   "The high frequency sniffer will assign all available memory on device for sniffed data.\n"
                   "Use `data samples` to download from device and `data plot` to visualize it.\n"
+                  "With a protocol,  the samples of its sniffer are streamed to a file until stopped\n"
+                  "instead. Decode them with `trace decode`.\n"
                   "Press button to quit the sniffing.",
                   "hf sniff\n"
-                  "hf sniff --sp 1000 --st 0   -> skip 1000 pairs, skip 0 triggers"
+                  "hf sniff --sp 1000 --st 0   -> skip 1000 pairs, skip 0 triggers\n"
+                  "hf sniff --14a -f capture   -> stream ISO14443-A sniffer samples to capture.raw"
                  );
     void *argtable[] = {
         arg_param_begin,
         arg_u64_0(NULL, "sp", "<dec>", "skip sample pairs"),
         arg_u64_0(NULL, "st", "<dec>", "skip number of triggers"),
+        arg_lit0(NULL, "14a", "stream ISO14443-A sniffer samples"),
+        arg_lit0(NULL, "14b", "stream ISO14443-B sniffer samples"),
+        arg_lit0(NULL, "15", "stream ISO15693 sniffer samples"),
+        arg_str0("f", "file", "<fn>", "file for the streamed samples"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -303,8 +500,40 @@ int CmdHFSniff(const char *Cmd) {
 
     params.samplesToSkip = arg_get_u32_def(ctx, 1, 0);
     params.triggersToSkip = arg_get_u32_def(ctx, 2, 0);
+
+    uint8_t proto = 0;
+    uint8_t protos = 0;
+    if (arg_get_lit(ctx, 3)) {
+        proto = HF_SNIFF_RAW_14A;
+        protos++;
+    }
+    if (arg_get_lit(ctx, 4)) {
+        proto = HF_SNIFF_RAW_14B;
+        protos++;
+    }
+    if (arg_get_lit(ctx, 5)) {
+        proto = HF_SNIFF_RAW_15;
+        protos++;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 6), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
+    if (protos > 1) {
+        PrintAndLogEx(WARNING, "select only one protocol");
+        return PM3_EINVARG;
+    }
+
+    if (proto) {
+        if (fnlen == 0) {
+            PrintAndLogEx(WARNING, "streaming needs a file name");
+            return PM3_EINVARG;
+        }
+        return hf_sniff_raw(proto, filename);
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_SNIFF, (uint8_t *)&params, sizeof(params));
 
@@ -364,6 +593,9 @@ int handle_hf_plot(void) {
         return PM3_ETIMEOUT;
     }
 
+    if (graphReserve(FPGA_TRACE_SIZE) == false)
+        return PM3_EMALLOC;
+
     for (size_t i = 0; i < FPGA_TRACE_SIZE; i++) {
         g_GraphBuffer[i] = ((int)buf[i]) - 128;
     }
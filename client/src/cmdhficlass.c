@@ -2394,13 +2394,17 @@ static int CmdHFiClass_loclass(const char *Cmd) {
                   "  <8 byte CSN><8 byte CC><4 byte NR><4 byte MAC>\n"
                   "   ... totalling N*24 bytes",
                   "hf iclass loclass -f iclass_dump.bin\n"
-                  "hf iclass loclass --test");
+                  "hf iclass loclass -f iclass_dump.bin --threads 4\n"
+                  "hf iclass loclass --test\n"
+                  "hf iclass loclass --bench");
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("f", "file", "<fn>", "filename with nr/mac data from `hf iclass sim -t 2` "),
         arg_lit0(NULL, "test",        "Perform self-test"),
         arg_lit0(NULL, "long",        "Perform self-test, including long ones"),
+        arg_u64_0(NULL, "threads", "<dec>", "number of bruteforce threads (def: number of cpus)"),
+        arg_lit0(NULL, "bench",       "Perform self-test and benchmark the DES cores"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -2411,14 +2415,16 @@ static int CmdHFiClass_loclass(const char *Cmd) {
 
     bool test = arg_get_lit(ctx, 2);
     bool longtest = arg_get_lit(ctx, 3);
+    uint32_t threads = arg_get_u32_def(ctx, 4, 0);
+    bool bench = arg_get_lit(ctx, 5);
 
     CLIParserFree(ctx);
 
-    if (test || longtest) {
+    if (test || longtest || bench) {
         int errors = testCipherUtils();
         errors += testMAC();
         errors += doKeyTests();
-        errors += testElite(longtest);
+        errors += testElite(longtest, bench);
 
         if (errors != PM3_SUCCESS)
             PrintAndLogEx(ERR, "There were errors!!!");
@@ -2426,7 +2432,7 @@ static int CmdHFiClass_loclass(const char *Cmd) {
         return PM3_ESOFT;
     }
 
-    return bruteforceFileNoKeys(filename);
+    return bruteforceFileNoKeys(filename, threads);
 }
 
 void printIclassDumpContents(uint8_t *iclass_dump, uint8_t startblock, uint8_t endblock, size_t filesize) {
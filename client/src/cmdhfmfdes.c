@@ -792,6 +792,37 @@ static void DesFill2bPattern(
     (*startPattern)++;
 }
 
+static int AuthCheckDesfireOnDevice(uint32_t curaid, uint8_t algo, const char *name,
+                                    uint8_t *keyList, uint8_t keylen, uint32_t keyListLen,
+                                    int *usedkeys, uint8_t foundKeys[0xE][24 + 1], bool *result) {
+
+    uint16_t slots[0xE] = {0};
+    size_t slot_count = 0;
+    for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+        if (usedkeys[keyno] == 1 && foundKeys[keyno][0] == 0)
+            slots[slot_count++] = keyno;
+    }
+
+    if (slot_count == 0 || keyListLen == 0)
+        return PM3_SUCCESS;
+
+    int32_t found[0xE] = {0};
+    uint8_t mode = (algo == MFDES_ALGO_AES) ? MFDES_AUTH_AES : MFDES_AUTH_ISO;
+    int res = DesfireCheckKeysOnDevice(mode, algo, curaid, slots, slot_count, keyList, keylen, keyListLen, found);
+
+    for (size_t i = 0; i < slot_count; i++) {
+        if (found[i] < 0)
+            continue;
+
+        uint8_t *key = keyList + (found[i] * keylen);
+        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found %-5s Key %02u        : " _GREEN_("%s"), curaid, name, slots[i], sprint_hex(key, keylen));
+        foundKeys[slots[i]][0] = 0x01;
+        memcpy(&foundKeys[slots[i]][1], key, keylen);
+        *result = true;
+    }
+    return res;
+}
+
 static int AuthCheckDesfire(DesfireContext_t *dctx,
                             DesfireSecureChannel secureChannel,
                             uint8_t *aid,
@@ -881,6 +912,22 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         PrintAndLogEx(NORMAL, "");
     }
 
+    // without key diversification the device can run the whole dictionary
+    if (cmdKdfAlgo == MFDES_KDF_ALGO_NONE) {
+        DropField();
+        res = PM3_SUCCESS;
+        if (des)
+            res = AuthCheckDesfireOnDevice(curaid, MFDES_ALGO_DES, "DES", deskeyList[0], 8, deskeyListLen, usedkeys, foundKeys[0], result);
+        if (tdes && res != PM3_EOPABORTED)
+            res = AuthCheckDesfireOnDevice(curaid, MFDES_ALGO_3DES, "2TDEA", aeskeyList[0], 16, aeskeyListLen, usedkeys, foundKeys[1], result);
+        if (aes && res != PM3_EOPABORTED)
+            res = AuthCheckDesfireOnDevice(curaid, MFDES_ALGO_AES, "AES", aeskeyList[0], 16, aeskeyListLen, usedkeys, foundKeys[2], result);
+        if (k3kdes && res != PM3_EOPABORTED)
+            res = AuthCheckDesfireOnDevice(curaid, MFDES_ALGO_3K3DES, "3TDEA", k3kkeyList[0], 24, k3kkeyListLen, usedkeys, foundKeys[3], result);
+        DropField();
+        return res;
+    }
+
     bool badlen = false;
 
     if (des) {
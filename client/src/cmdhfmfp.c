@@ -18,6 +18,7 @@
 #include "util.h"
 #include "cmdhf14a.h"
 #include "mifare/mifare4.h"
+#include "mifare/desfirecore.h"  // DesfireCheckKeysOnDevice
 #include "mifare/mad.h"
 #include "nfc/ndef.h"
 #include "cliparser.h"
@@ -988,83 +989,52 @@ static int CmdHFMFPWrbl(const char *Cmd) {
 static int MFPKeyCheck(uint8_t startSector, uint8_t endSector, uint8_t startKeyAB, uint8_t endKeyAB,
                        uint8_t keyList[MAX_KEYS_LIST_LEN][AES_KEY_LEN], size_t keyListLen, uint8_t foundKeys[2][64][AES_KEY_LEN + 1],
                        bool verbose) {
-    int res;
-    bool selectCard = true;
-    uint8_t keyn[2] = {0};
 
-    // sector number from 0
-    for (uint8_t sector = startSector; sector <= endSector; sector++) {
+    // every sector / key combination without key yet,  checked on device
+    uint16_t slots[2 * 64] = {0};
+    size_t slot_count = 0;
+    for (uint8_t sector = startSector; sector <= endSector && sector < 64; sector++) {
         // 0-keyA 1-keyB
         for (uint8_t keyAB = startKeyAB; keyAB <= endKeyAB; keyAB++) {
-            // main cycle with key check
-            for (int i = 0; i < keyListLen; i++) {
-                if (i % 10 == 0) {
-
-                    if (verbose == false)
-                        PrintAndLogEx(NORMAL, "." NOLF);
-
-                    if (kbd_enter_pressed()) {
-                        PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-                        DropField();
-                        return PM3_EOPABORTED;
-                    }
-                }
-
-                uint16_t uKeyNum = 0x4000 + sector * 2 + keyAB;
-                keyn[0] = uKeyNum >> 8;
-                keyn[1] = uKeyNum & 0xff;
-
-                for (int retry = 0; retry < 4; retry++) {
-                    res =  MifareAuth4(NULL, keyn, keyList[i], selectCard, true, false, false, true);
-                    if (res != 2)
-                        break;
-
-                    if (verbose)
-                        PrintAndLogEx(WARNING, "\nretried[%d]...", retry);
-                    else
-                        PrintAndLogEx(NORMAL, "R" NOLF);
-
-                    DropField();
-                    selectCard = true;
-                    msleep(100);
-                }
+            if (foundKeys[keyAB][sector][0] == 0)
+                slots[slot_count++] = 0x4000 + sector * 2 + keyAB;
+        }
+    }
 
-                if (verbose)
-                    PrintAndLogEx(WARNING, "\nsector %02d key %d [%s] res: %d", sector, keyAB, sprint_hex_inrow(keyList[i], 16), res);
+    if (slot_count == 0)
+        return PM3_SUCCESS;
 
-                // key for [sector,keyAB] found
-                if (res == 0) {
-                    if (verbose)
-                        PrintAndLogEx(INFO, "\nFound key for sector %d key %s [%s]", sector, keyAB == 0 ? "A" : "B", sprint_hex_inrow(keyList[i], 16));
-                    else
-                        PrintAndLogEx(NORMAL, "+" NOLF);
+    int32_t found[2 * 64] = {0};
+    int res = DesfireCheckKeysOnDevice(MFDES_AUTH_MFP, MFDES_ALGO_AES, 0, slots, slot_count, keyList[0], AES_KEY_LEN, keyListLen, found);
 
-                    foundKeys[keyAB][sector][0] = 0x01;
-                    memcpy(&foundKeys[keyAB][sector][1], keyList[i], AES_KEY_LEN);
-                    DropField();
-                    selectCard = true;
-                    msleep(50);
-                    break;
-                }
+    for (size_t i = 0; i < slot_count; i++) {
+        uint8_t sector = (slots[i] - 0x4000) / 2;
+        uint8_t keyAB = slots[i] & 1;
 
-                // 5 - auth error (rnd not equal)
-                if (res != 5) {
-                    if (verbose)
-                        PrintAndLogEx(ERR, "\nExchange error. Aborted.");
-                    else
-                        PrintAndLogEx(NORMAL, "E" NOLF);
+        if (found[i] == -2 && verbose)
+            PrintAndLogEx(WARNING, "\nsector %02d key %d not available", sector, keyAB);
 
-                    DropField();
-                    return PM3_ECARDEXCHANGE;
-                }
+        // key for [sector,keyAB] found
+        if (found[i] >= 0) {
+            if (verbose)
+                PrintAndLogEx(INFO, "\nFound key for sector %d key %s [%s]", sector, keyAB == 0 ? "A" : "B", sprint_hex_inrow(keyList[found[i]], 16));
+            else
+                PrintAndLogEx(NORMAL, "+" NOLF);
 
-                selectCard = false;
-            }
+            foundKeys[keyAB][sector][0] = 0x01;
+            memcpy(&foundKeys[keyAB][sector][1], keyList[found[i]], AES_KEY_LEN);
         }
     }
 
+    if (res == PM3_ECARDEXCHANGE) {
+        if (verbose)
+            PrintAndLogEx(ERR, "\nExchange error. Aborted.");
+        else
+            PrintAndLogEx(NORMAL, "E" NOLF);
+    }
+
     DropField();
-    return PM3_SUCCESS;
+    return res;
 }
 
 static void Fill2bPattern(uint8_t keyList[MAX_KEYS_LIST_LEN][AES_KEY_LEN], uint32_t *keyListLen, uint32_t *startPattern) {
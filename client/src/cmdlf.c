@@ -59,6 +59,25 @@
 #include "cmdlfviking.h"    // for viking menu
 #include "cmdlfvisa2000.h"  // for VISA2000 menu
 #include "pm3_cmd.h"        // for LF_CMDREAD_MAX_EXTRA_SYMBOLS
+#include "fileutils.h"      // for streaming to file
+#include "util_posix.h"     // msclock
+#include "jansson.h"        // for `lf batch` results
+#include "proxmark3.h"      // for `lf batch` workers
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
 
 static bool gs_lf_threshold_set = false;
 
@@ -367,13 +386,16 @@ int CmdFlexdemod(const char *Cmd) {
 #endif
     int i, j, start, bit, sum;
 
-    int data[g_GraphTraceLen];
-    memcpy(data, g_GraphBuffer, g_GraphTraceLen);
-
     size_t size = g_GraphTraceLen;
+    if (size <= LONG_WAIT)
+        return PM3_ENODATA;
 
-    for (i = 0; i < g_GraphTraceLen; ++i)
-        data[i] = (data[i] < 0) ? -1 : 1;
+    int *data = calloc(size, sizeof(int));
+    if (data == NULL)
+        return PM3_EMALLOC;
+
+    for (i = 0; i < size; ++i)
+        data[i] = (g_GraphBuffer[i] < 0) ? -1 : 1;
 
     for (start = 0; start < size - LONG_WAIT; start++) {
         int first = data[start];
@@ -388,6 +410,7 @@ int CmdFlexdemod(const char *Cmd) {
 
     if (start == size - LONG_WAIT) {
         PrintAndLogEx(WARNING, "nothing to wait for");
+        free(data);
         return PM3_ENODATA;
     }
 
@@ -397,7 +420,7 @@ int CmdFlexdemod(const char *Cmd) {
     uint8_t bits[64] = {0x00};
 
     i = start;
-    for (bit = 0; bit < 64; bit++) {
+    for (bit = 0; bit < 64 && i + 16 <= size; bit++) {
         sum = 0;
         for (j = 0; j < 16; j++) {
             sum += data[i++];
@@ -406,7 +429,7 @@ int CmdFlexdemod(const char *Cmd) {
         PrintAndLogEx(NORMAL, "bit %d sum %d", bit, sum);
     }
 
-    for (bit = 0; bit < 64; bit++) {
+    for (bit = 0; bit < 64 && i + 16 <= size; bit++) {
         sum = 0;
         for (j = 0; j < 16; j++)
             sum += data[i++];
@@ -417,8 +440,13 @@ int CmdFlexdemod(const char *Cmd) {
 
     }
 
+    free(data);
+
     // iceman,  use g_DemodBuffer?  blue line?
     // HACK writing back to graphbuffer.
+    if (graphReserve(32 * 64) == false)
+        return PM3_EMALLOC;
+
     g_GraphTraceLen = 32 * 64;
     i = 0;
     for (bit = 0; bit < 64; bit++) {
@@ -628,6 +656,156 @@ int CmdLFConfig(const char *Cmd) {
     return lf_config(&config);
 }
 
+typedef struct {
+    FILE *f;
+    size_t dropped;
+    uint64_t samples;
+} lf_stream_sink_t;
+
+static void lf_stream_emit(lf_stream_sink_t *sink, int value) {
+    sink->samples++;
+    if (sink->f) {
+        fprintf(sink->f, "%d\n", value);
+        return;
+    }
+    if (graphReserve(g_GraphTraceLen + 1))
+        g_GraphBuffer[g_GraphTraceLen++] = value;
+    else
+        sink->dropped++;
+}
+
+// Streams samples from the device until <Enter>, the pm3 button or the sample count stops it.
+// The chunks form one bit stream of samples packed by the sampling config, chunks the device
+// had to drop are filled with samples at the midline so the timing is kept.
+static int lf_stream(bool reader_field, uint32_t samples, const char *filename) {
+    if (!g_session.pm3_present) return PM3_ENOTTY;
+
+    lf_stream_sink_t sink = { NULL, 0, 0 };
+    char *fn = NULL;
+    if (filename && filename[0] != '\0') {
+        fn = newfilenamemcopy(filename, ".pm3");
+        if (fn == NULL)
+            return PM3_EMALLOC;
+
+        sink.f = fopen(fn, "w");
+        if (sink.f == NULL) {
+            PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", fn);
+            free(fn);
+            return PM3_EFILE;
+        }
+        PrintAndLogEx(INFO, "Streaming samples to " _YELLOW_("%s"), fn);
+    } else {
+        ClearGraph(false);
+        PrintAndLogEx(INFO, "Streaming samples to graph buffer");
+    }
+    PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " or pm3 button to stop");
+
+    lf_stream_t payload = {
+        .samples = samples,
+        .reader_field = reader_field,
+    };
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_STREAM_ADC, (uint8_t *)&payload, sizeof(payload));
+
+    uint32_t next = 0, filled = 0;
+    uint64_t bitpos = 0;   // bits of the stream consumed so far
+    uint32_t skip = 0;     // bits of a sample cut by a gap
+    uint8_t acc = 0, acc_bits = 0;
+    bool stopping = false;
+    int res = PM3_SUCCESS;
+    PacketResponseNG resp;
+
+    for (;;) {
+
+        if (stopping == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stopping = true;
+        }
+
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 1000) == false) {
+            if (stopping) {
+                PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+                res = PM3_ETIMEOUT;
+                break;
+            }
+            continue;
+        }
+
+        if (resp.cmd == CMD_LF_STREAM_ADC_DATA) {
+            lf_stream_chunk_t *chunk = (lf_stream_chunk_t *)resp.data.asBytes;
+            uint8_t bps = chunk->bits_per_sample;
+            if (bps == 0 || bps > 8 || chunk->bits > LF_STREAM_CHUNK * 8)
+                continue;
+
+            if (chunk->seq > next) {
+                // fill up to the first sample which starts in this chunk
+                uint64_t start = (uint64_t)chunk->seq * LF_STREAM_CHUNK * 8;
+                uint64_t first = (start + bps - 1) / bps;
+                for (uint64_t k = (bitpos - acc_bits) / bps; k < first; k++)
+                    lf_stream_emit(&sink, 0);
+                filled += chunk->seq - next;
+                skip = first * bps - start;
+                bitpos = start;
+                acc = 0;
+                acc_bits = 0;
+            } else if (chunk->seq < next) {
+                continue;
+            }
+
+            for (uint16_t i = 0; i < chunk->bits; i++, bitpos++) {
+                if (skip) {
+                    skip--;
+                    continue;
+                }
+                acc = (acc << 1) | ((chunk->data[i >> 3] >> (7 - (i & 7))) & 1);
+                if (++acc_bits == bps) {
+                    lf_stream_emit(&sink, ((int)(uint8_t)(acc << (8 - bps))) - 127);
+                    acc = 0;
+                    acc_bits = 0;
+                }
+            }
+            next = chunk->seq + 1;
+            continue;
+        }
+
+        if (resp.cmd == CMD_LF_STREAM_ADC) {
+            lf_stream_result_t *r = (lf_stream_result_t *)resp.data.asBytes;
+            if (resp.status == PM3_EOPABORTED)
+                PrintAndLogEx(INFO, "Button pressed, user aborted");
+            else if (resp.status != PM3_SUCCESS)
+                res = resp.status;
+
+            PrintAndLogEx(SUCCESS, "samples " _YELLOW_("%" PRIu32) "  chunks " _YELLOW_("%" PRIu32) "  lost " _YELLOW_("%" PRIu32)
+                          , r->samples, r->chunks, r->lost);
+            if (r->stalls)
+                PrintAndLogEx(WARNING, "sampling stalled %" PRIu32 " times, the capture has time gaps", r->stalls);
+            if (filled != r->lost)
+                PrintAndLogEx(WARNING, "%" PRIu32 " chunks lost on the way to the client", filled - r->lost);
+            break;
+        }
+    }
+
+    if (sink.f) {
+        fclose(sink.f);
+        PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%" PRIu64) " samples to " _YELLOW_("%s"), sink.samples, fn);
+        free(fn);
+        return res;
+    }
+
+    if (sink.dropped)
+        PrintAndLogEx(WARNING, "out of memory, %zu samples dropped. Stream to a file with " _YELLOW_("-f") " for long captures", sink.dropped);
+
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
+    if (bits)
+        computeSignalProperties(bits, size);
+
+    setClockGrid(0, 0);
+    g_DemodBufferLen = 0;
+    RepaintGraphWindow();
+    return res;
+}
+
 int lf_read(bool verbose, uint32_t samples) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
@@ -666,6 +844,7 @@ int CmdLFRead(const char *Cmd) {
                   _CYAN_(" - use ") _YELLOW_("`data plot`") _CYAN_(" to look at it"),
                   "lf read -v -s 12000   --> collect 12000 samples\n"
                   "lf read -s 3000 -@    --> oscilloscope style \n"
+                  "lf read -f long       --> stream samples to long.pm3 until stopped"
                  );
 
     void *argtable[] = {
@@ -673,17 +852,31 @@ int CmdLFRead(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous reading mode"),
+        arg_lit0(NULL, "stream", "stream samples to graph buffer until stopped, not limited by device memory"),
+        arg_str0("f", "file", "<fn>", "stream samples to .pm3 file until stopped"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint32_t samples = arg_get_u32_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    bool stream = arg_get_lit(ctx, 4);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     if (g_session.pm3_present == false)
         return PM3_ENOTTY;
 
+    if (stream || fnlen) {
+        if (cm) {
+            PrintAndLogEx(WARNING, "streaming and continuous mode can't be combined");
+            return PM3_EINVARG;
+        }
+        return lf_stream(true, samples, filename);
+    }
+
     if (cm) {
         PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
     }
@@ -735,6 +928,7 @@ int CmdLFSniff(const char *Cmd) {
                   _CYAN_(" - use ") _YELLOW_("`lf search -1`") _CYAN_(" to see if signal can be automatic decoded\n"),
                   "lf sniff -v\n"
                   "lf sniff -s 3000 -@    --> oscilloscope style \n"
+                  "lf sniff -f long       --> stream samples to long.pm3 until stopped"
                  );
 
     void *argtable[] = {
@@ -742,17 +936,31 @@ int CmdLFSniff(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous sniffing mode"),
+        arg_lit0(NULL, "stream", "stream samples to graph buffer until stopped, not limited by device memory"),
+        arg_str0("f", "file", "<fn>", "stream samples to .pm3 file until stopped"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint32_t samples = arg_get_u32_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    bool stream = arg_get_lit(ctx, 4);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     if (g_session.pm3_present == false)
         return PM3_ENOTTY;
 
+    if (stream || fnlen) {
+        if (cm) {
+            PrintAndLogEx(WARNING, "streaming and continuous mode can't be combined");
+            return PM3_EINVARG;
+        }
+        return lf_stream(false, samples, filename);
+    }
+
     if (cm) {
         PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
     }
@@ -1375,6 +1583,43 @@ out:
     return retval;
 }
 
+typedef struct {
+    const char *name;           // as in `lf <name>`, reported by `lf batch`
+    const char *desc;
+    int (*demod)(bool verbose);
+} lf_demod_t;
+
+// demods of known tags `lf search` and `lf batch` try on the graph buffer, in this order
+static const lf_demod_t lf_demods[] = {
+    // ask / man
+    {"em410x",    "EM410x ID",               demodEM410x},
+    {"destron",   "FDX-A FECAVA Destron ID", demodDestron},  // to do before HID
+    {"gallagher", "GALLAGHER ID",            demodGallagher},
+    {"noralsy",   "Noralsy ID",              demodNoralsy},
+    {"presco",    "Presco ID",               demodPresco},
+    {"securakey", "Securakey ID",            demodSecurakey},
+    {"viking",    "Viking ID",               demodViking},
+    {"visa2000",  "Visa2000 ID",             demodVisa2k},
+    // ask / bi
+    {"fdxb",      "FDX-B ID",                demodFDXB},
+    {"jablotron", "Jablotron ID",            demodJablotron},
+    {"gproxii",   "Guardall G-Prox II ID",   demodGuard},
+    {"nedap",     "NEDAP ID",                demodNedap},
+    // nrz
+    {"pac",       "PAC/Stanley ID",          demodPac},
+    // fsk
+    {"hid",       "HID Prox ID",             demodHID},
+    {"awid",      "AWID ID",                 demodAWID},
+    {"io",        "IO Prox ID",              demodIOProx},
+    {"pyramid",   "Pyramid ID",              demodPyramid},
+    {"paradox",   "Paradox ID",              demodParadox},
+    // psk
+    {"idteck",    "Idteck ID",               demodIdteck},
+    {"keri",      "KERI ID",                 demodKeri},
+    {"nexwatch",  "NexWatch ID",             demodNexWatch},
+    {"indala",    "Indala ID",               demodIndala},
+};
+
 int CmdLFfind(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1484,189 +1729,14 @@ int CmdLFfind(const char *Cmd) {
 
     int retval = PM3_SUCCESS;
 
-    // ask / man
-    if (demodEM410x(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("EM410x ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodDestron(true) == PM3_SUCCESS) { // to do before HID
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-A FECAVA Destron ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodGallagher(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("GALLAGHER ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNoralsy(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Noralsy ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodPresco(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Presco ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodSecurakey(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Securakey ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodViking(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Viking ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodVisa2k(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Visa2000 ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // ask / bi
-    if (demodFDXB(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-B ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodJablotron(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Jablotron ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodGuard(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Guardall G-Prox II ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNedap(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NEDAP ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // nrz
-    if (demodPac(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("PAC/Stanley ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // fsk
-    if (demodHID(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("HID Prox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodAWID(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("AWID ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodIOProx(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("IO Prox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodPyramid(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Pyramid ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodParadox(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Paradox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-
-    // psk
-    if (demodIdteck(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Idteck ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodKeri(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("KERI ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNexWatch(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NexWatch ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodIndala(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Indala ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
+    for (size_t i = 0; i < ARRAYLEN(lf_demods); i++) {
+        if (lf_demods[i].demod(true) == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("%s") " found!", lf_demods[i].desc);
+            if (search_cont) {
+                found++;
+            } else {
+                goto out;
+            }
         }
     }
     /*
@@ -1755,6 +1825,597 @@ out:
     return retval;
 }
 
+#if !defined(_WIN32)
+// `lf batch` - identify a directory tree or a list of .pm3 captures offline.
+// The demods share g_GraphBuffer, g_DemodBuffer and the lfdemod signal state,
+// so the work is spread over worker processes, each with its own copy.  The
+// client may run a device, gui and log thread, so the workers aren't forked but
+// spawned as fresh `proxmark3 --incognito` clients doing `lf batch --part k/n` on
+// a temporary manifest of all files.  Every worker writes its json lines to its
+// own pipe.  The files of a worker that didn't start or died are identified in
+// this client afterwards.
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t cap;
+} lf_batch_list_t;
+
+static int lf_batch_add(lf_batch_list_t *list, const char *path) {
+    if (list->count == list->cap) {
+        size_t cap = (list->cap) ? list->cap * 2 : 256;
+        char **tmp = realloc(list->paths, cap * sizeof(char *));
+        if (tmp == NULL)
+            return PM3_EMALLOC;
+
+        list->paths = tmp;
+        list->cap = cap;
+    }
+
+    list->paths[list->count] = strdup(path);
+    if (list->paths[list->count] == NULL)
+        return PM3_EMALLOC;
+
+    list->count++;
+    return PM3_SUCCESS;
+}
+
+static void lf_batch_free(lf_batch_list_t *list) {
+    for (size_t i = 0; i < list->count; i++)
+        free(list->paths[i]);
+    free(list->paths);
+}
+
+static int lf_batch_scan(lf_batch_list_t *list, const char *dir) {
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open directory " _YELLOW_("%s"), dir);
+        return PM3_EFILE;
+    }
+
+    int res = PM3_SUCCESS;
+    struct dirent *e;
+    while (res == PM3_SUCCESS && (e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+            continue;
+
+        char path[FILE_PATH_SIZE];
+        if (snprintf(path, sizeof(path), "%s/%s", dir, e->d_name) >= (int)sizeof(path))
+            continue;
+
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            res = lf_batch_scan(list, path);
+            continue;
+        }
+
+        if (S_ISREG(st.st_mode) && str_endswith(e->d_name, ".pm3"))
+            res = lf_batch_add(list, path);
+    }
+    closedir(d);
+    return res;
+}
+
+// one path per line, empty lines and lines starting with # are skipped
+static int lf_batch_manifest(lf_batch_list_t *list, const char *fn) {
+    FILE *f = fopen(fn, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open manifest " _YELLOW_("%s"), fn);
+        return PM3_EFILE;
+    }
+
+    int res = PM3_SUCCESS;
+    char line[FILE_PATH_SIZE];
+    while (res == PM3_SUCCESS && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        res = lf_batch_add(list, line);
+    }
+    fclose(f);
+    return res;
+}
+
+// atoi() of one line of a mapped capture
+static int lf_batch_sample(const char *p, const char *end) {
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = (*p == '-');
+        p++;
+    }
+
+    int v = 0;
+    while (p < end && isdigit((unsigned char)*p))
+        v = v * 10 + (*p++ - '0');
+
+    return (neg) ? -v : v;
+}
+
+// same as `data load`, the capture is mapped instead of read line by line
+static int lf_batch_load(const char *path) {
+
+    g_GraphTraceLen = 0;
+    // some demods look past the end of the demod buffer, start every file as a fresh client would
+    memset(g_DemodBuffer, 0, sizeof(g_DemodBuffer));
+    g_DemodBufferLen = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return PM3_EFILE;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return PM3_EFILE;
+    }
+
+    size_t len = st.st_size;
+    const char *buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED)
+        return PM3_EFILE;
+
+    const char *end = buf + len;
+    size_t lines = (end[-1] != '\n');
+    for (const char *p = buf; (p = memchr(p, '\n', end - p)) != NULL; p++)
+        lines++;
+
+    if (graphReserve(lines) == false) {
+        munmap((void *)buf, len);
+        return PM3_EMALLOC;
+    }
+
+    for (const char *p = buf; p < end;) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+
+        g_GraphBuffer[g_GraphTraceLen++] = lf_batch_sample(p, eol);
+        p = eol + 1;
+    }
+    munmap((void *)buf, len);
+
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
+    if (bits) {
+        removeSignalOffset(bits, size);
+        setGraphBuf(bits, size);
+        computeSignalProperties(bits, size);
+        free(bits);
+    }
+    setClockGrid(0, 0);
+    return PM3_SUCCESS;
+}
+
+// the lines a demod printed, without the [+] prefixes
+static json_t *lf_batch_info(const char *text) {
+    json_t *info = json_array();
+    while (*text) {
+        size_t n = strcspn(text, "\n");
+        const char *p = text;
+        if (n >= 4 && p[0] == '[' && p[2] == ']' && p[3] == ' ')
+            p += 4;
+
+        size_t len = n - (p - text);
+        while (len && isspace((unsigned char)*p)) {
+            p++;
+            len--;
+        }
+        while (len && isspace((unsigned char)p[len - 1]))
+            len--;
+
+        if (len)
+            json_array_append_new(info, json_stringn(p, len));
+
+        text += n;
+        if (*text)
+            text++;
+    }
+    return info;
+}
+
+// identify every parts-th file of the list, starting with the one at index first, in this client
+static void lf_batch_part(const lf_batch_list_t *list, size_t first, int parts, FILE *out, size_t *done, size_t *found) {
+
+    // the demods print what they found, kept as plain text for the json lines
+    uint8_t printandlog = g_printAndLog;
+    bool colors = g_session.supports_colors;
+    emojiMode_t emoji = g_session.emoji_mode;
+    g_session.supports_colors = false;
+    g_session.emoji_mode = EMO_ALTTEXT;
+
+    for (size_t i = first; i < list->count; i += parts) {
+
+        const char *path = list->paths[i];
+        const char *status;
+        const char *tag = NULL;
+        char raw[513] = {0};
+        char *text = NULL;
+
+        if (lf_batch_load(path) != PM3_SUCCESS) {
+            status = "error";
+        } else if (g_GraphTraceLen < 2000) {
+            // too small for `lf search`
+            status = "nodata";
+        } else {
+            // noisy captures still get the demods, as with `lf search -1`
+            status = (getSignalProperties()->isnoise) ? "noise" : "notfound";
+
+            g_printAndLog = PRINTANDLOG_PRINT;
+            for (size_t j = 0; j < ARRAYLEN(lf_demods); j++) {
+                PrintCaptureStart();
+                int res = lf_demods[j].demod(false);
+                text = PrintCaptureEnd();
+                if (res == PM3_SUCCESS) {
+                    tag = lf_demods[j].name;
+                    status = "found";
+                    binarraytohex(raw, sizeof(raw), (char *)g_DemodBuffer, g_DemodBufferLen);
+                    (*found)++;
+                    break;
+                }
+                free(text);
+                text = NULL;
+            }
+            g_printAndLog = printandlog;
+        }
+
+        json_t *root = json_object();
+        json_object_set_new(root, "file", json_string(path));
+        json_object_set_new(root, "status", json_string(status));
+        json_object_set_new(root, "samples", json_integer(g_GraphTraceLen));
+        json_object_set_new(root, "tag", (tag) ? json_string(tag) : json_null());
+        if (tag) {
+            json_object_set_new(root, "raw", json_string(raw));
+            json_object_set_new(root, "info", lf_batch_info((text) ? text : ""));
+        }
+        free(text);
+
+        char *line = json_dumps(root, JSON_COMPACT);
+        json_decref(root);
+        if (line) {
+            fprintf(out, "%s\n", line);
+            fflush(out);
+            free(line);
+        }
+        (*done)++;
+    }
+
+    g_session.supports_colors = colors;
+    g_session.emoji_mode = emoji;
+}
+
+typedef struct {
+    int fd;
+    pid_t pid;
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t lines;       // results received,  a worker sends them in list order
+} lf_batch_pipe_t;
+
+// append what a worker sent, write out its complete lines
+static bool lf_batch_collect(lf_batch_pipe_t *w, FILE *out, size_t *done, size_t *found) {
+    if (w->cap - w->len < 4096) {
+        size_t cap = w->cap * 2 + 4096;
+        char *tmp = realloc(w->buf, cap);
+        if (tmp == NULL)
+            return false;
+        w->buf = tmp;
+        w->cap = cap;
+    }
+
+    ssize_t n = read(w->fd, w->buf + w->len, w->cap - w->len);
+    if (n < 0 && errno == EINTR)
+        return true;
+    if (n <= 0)
+        return false;
+
+    w->len += n;
+
+    size_t used = 0;
+    char *eol;
+    while ((eol = memchr(w->buf + used, '\n', w->len - used)) != NULL) {
+        size_t linelen = eol - (w->buf + used) + 1;
+        fwrite(w->buf + used, 1, linelen, out);
+
+        json_t *root = json_loadb(w->buf + used, linelen, 0, NULL);
+        if (root) {
+            const char *status = json_string_value(json_object_get(root, "status"));
+            if (status && strcmp(status, "found") == 0)
+                (*found)++;
+            json_decref(root);
+        }
+        used += linelen;
+        w->lines++;
+        (*done)++;
+    }
+    memmove(w->buf, w->buf + used, w->len - used);
+    w->len -= used;
+    return true;
+}
+
+static int lf_batch_run(const lf_batch_list_t *list, FILE *out, int workers, size_t *done, size_t *found) {
+
+    const char *exe = get_my_executable_path();
+    if (exe == NULL) {
+        PrintAndLogEx(WARNING, "couldn't find the client executable");
+        return PM3_ESOFT;
+    }
+
+    // the workers read the list back, no quoting needed on their command line
+    char manifest[] = "/tmp/pm3_lf_batch_XXXXXX";
+    int mfd = mkstemp(manifest);
+    FILE *f = (mfd < 0) ? NULL : fdopen(mfd, "w");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't create a temporary manifest");
+        if (mfd >= 0) {
+            close(mfd);
+            unlink(manifest);
+        }
+        return PM3_EFILE;
+    }
+    for (size_t i = 0; i < list->count; i++)
+        fprintf(f, "%s\n", list->paths[i]);
+    fclose(f);
+
+    // the workers don't need a display, without DISPLAY they don't start the gui
+    size_t envc = 0;
+    while (environ[envc])
+        envc++;
+
+    char **envp = calloc(envc + 1, sizeof(char *));
+    lf_batch_pipe_t *w = calloc(workers, sizeof(lf_batch_pipe_t));
+    struct pollfd *pfd = calloc(workers, sizeof(struct pollfd));
+    if (envp == NULL || w == NULL || pfd == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(envp);
+        free(w);
+        free(pfd);
+        unlink(manifest);
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0, j = 0; i < envc; i++) {
+        if (strncmp(environ[i], "DISPLAY=", 8) != 0)
+            envp[j++] = environ[i];
+    }
+
+    int started = 0;
+    for (; started < workers; started++) {
+        int p[2];
+        if (pipe(p) != 0)
+            break;
+
+        // only the write end of its own pipe goes to a worker, as fd 3
+        fcntl(p[0], F_SETFD, FD_CLOEXEC);
+        fcntl(p[1], F_SETFD, FD_CLOEXEC);
+
+        char cmd[64 + sizeof(manifest)];
+        snprintf(cmd, sizeof(cmd), "lf batch -m %s --part %i/%i -f /dev/fd/3", manifest, started + 1, workers);
+        char *argv[] = {(char *)exe, (char *)"--incognito", (char *)"-c", cmd, NULL};
+
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, p[1], 3);
+        posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+        pid_t pid;
+        int err = posix_spawn(&pid, exe, &fa, NULL, argv, envp);
+        posix_spawn_file_actions_destroy(&fa);
+        close(p[1]);
+
+        if (err != 0) {
+            close(p[0]);
+            break;
+        }
+        w[started].fd = p[0];
+        w[started].pid = pid;
+    }
+    free(envp);
+
+    PrintAndLogEx(DEBUG, "started %i workers", started);
+
+    uint64_t shown = msclock();
+    int running = started;
+    while (running) {
+        for (int i = 0; i < started; i++) {
+            pfd[i].fd = w[i].fd;
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+
+        if (poll(pfd, started, 1000) < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < started; i++) {
+            if (pfd[i].revents == 0)
+                continue;
+
+            if (lf_batch_collect(&w[i], out, done, found) == false) {
+                close(w[i].fd);
+                w[i].fd = -1;
+                running--;
+            }
+        }
+
+        if (out != stdout && msclock() - shown >= 1000) {
+            PrintAndLogEx(INPLACE, "%zu / %zu files", *done, list->count);
+            shown = msclock();
+        }
+    }
+    fflush(out);
+
+    for (int i = 0; i < started; i++) {
+        if (w[i].fd >= 0)
+            close(w[i].fd);
+        waitpid(w[i].pid, NULL, 0);
+        free(w[i].buf);
+    }
+
+    if (out != stdout)
+        PrintAndLogEx(NORMAL, "");
+
+    // files of workers that didn't start or didn't finish are identified here
+    bool rest = false;
+    for (int i = 0; i < workers; i++) {
+        size_t first = i + w[i].lines * workers;
+        if (first >= list->count)
+            continue;
+
+        if (rest == false) {
+            PrintAndLogEx(WARNING, "not all workers finished, identifying the rest here");
+            save_restoreGB(GRAPH_SAVE);
+            save_restoreDB(GRAPH_SAVE);
+            rest = true;
+        }
+        lf_batch_part(list, first, workers, out, done, found);
+    }
+    if (rest) {
+        save_restoreDB(GRAPH_RESTORE);
+        save_restoreGB(GRAPH_RESTORE);
+    }
+
+    int res = (*done == list->count) ? PM3_SUCCESS : PM3_ESOFT;
+    if (res != PM3_SUCCESS)
+        PrintAndLogEx(WARNING, "%zu files got no result", list->count - *done);
+
+    free(w);
+    free(pfd);
+    unlink(manifest);
+    return res;
+}
+#endif
+
+static int CmdLFBatch(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf batch",
+                  "Identify LF captures offline, as `data load` + `lf search -1` on every file.\n"
+                  "Takes the .pm3 files of a directory tree and/or a manifest with one path per line.\n"
+                  "Prints one json line per file, with the raw bits and the lines the demod printed\n"
+                  "of an identified tag (e.g. HID FC / CN), or saves them to a file.\n"
+                  "The files are spread over worker processes, separate offline clients.\n"
+                  "With --part only a share of the list is identified, in this client",
+                  "lf batch -d traces\n"
+                  "lf batch -m captures.txt -f results.jsonl -w 8\n"
+                  "lf batch -m captures.txt --part 2/4     -> files 2, 6, 10, ... of the list"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("d", "dir", "<path>", "directory, searched recursively for .pm3 files"),
+        arg_str0("m", "manifest", "<fn>", "file with one capture path per line"),
+        arg_str0("f", "file", "<fn>", "save json lines to file"),
+        arg_int0("w", "workers", "<dec>", "worker processes (def number of cpus)"),
+        arg_str0(NULL, "part", "<k/n>", "only every n-th file, starting with the k-th, no workers"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int dlen = 0, mlen = 0, flen = 0;
+    char dir[FILE_PATH_SIZE] = {0};
+    char manifest[FILE_PATH_SIZE] = {0};
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)dir, FILE_PATH_SIZE, &dlen);
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)manifest, FILE_PATH_SIZE, &mlen);
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)filename, FILE_PATH_SIZE, &flen);
+    int workers = arg_get_int_def(ctx, 4, num_CPUs());
+
+    int plen = 0;
+    char partstr[16] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)partstr, sizeof(partstr), &plen);
+    CLIParserFree(ctx);
+
+    int part = 0, parts = 0;
+    if (plen && (sscanf(partstr, "%i/%i", &part, &parts) != 2 || part < 1 || part > parts)) {
+        PrintAndLogEx(WARNING, "Part must be k/n with 1 <= k <= n");
+        return PM3_EINVARG;
+    }
+
+    if (dlen == 0 && mlen == 0) {
+        PrintAndLogEx(WARNING, "Missing directory or manifest");
+        return PM3_EINVARG;
+    }
+
+    if (workers < 1) {
+        PrintAndLogEx(WARNING, "Need at least one worker");
+        return PM3_EINVARG;
+    }
+
+#if defined(_WIN32)
+    (void)flen;
+    PrintAndLogEx(WARNING, "`lf batch` is not supported on Windows");
+    return PM3_ENOTIMPL;
+#else
+    lf_batch_list_t list = {0};
+    int res = PM3_SUCCESS;
+    if (dlen)
+        res = lf_batch_scan(&list, dir);
+
+    if (res == PM3_SUCCESS && mlen)
+        res = lf_batch_manifest(&list, manifest);
+
+    if (res != PM3_SUCCESS) {
+        lf_batch_free(&list);
+        return res;
+    }
+
+    if (list.count == 0) {
+        PrintAndLogEx(WARNING, "No captures found");
+        lf_batch_free(&list);
+        return PM3_ENODATA;
+    }
+
+    if ((size_t)workers > list.count)
+        workers = list.count;
+
+    FILE *out = stdout;
+    if (flen) {
+        out = fopen(filename, "w");
+        if (out == NULL) {
+            PrintAndLogEx(WARNING, "couldn't open " _YELLOW_("%s"), filename);
+            lf_batch_free(&list);
+            return PM3_EFILE;
+        }
+    }
+
+    size_t done = 0, found = 0;
+    uint64_t t = msclock();
+    if (plen) {
+        PrintAndLogEx(INFO, "Identifying part " _YELLOW_("%i/%i") " of " _YELLOW_("%zu") " captures", part, parts, list.count);
+
+        // the demods run in this client, put its buffers back afterwards
+        save_restoreGB(GRAPH_SAVE);
+        save_restoreDB(GRAPH_SAVE);
+        lf_batch_part(&list, part - 1, parts, out, &done, &found);
+        save_restoreDB(GRAPH_RESTORE);
+        save_restoreGB(GRAPH_RESTORE);
+    } else {
+        PrintAndLogEx(INFO, "Identifying " _YELLOW_("%zu") " captures with " _YELLOW_("%i") " workers", list.count, workers);
+        res = lf_batch_run(&list, out, workers, &done, &found);
+    }
+    t = msclock() - t;
+
+    if (out != stdout) {
+        fclose(out);
+        PrintAndLogEx(SUCCESS, "saved to " _YELLOW_("%s"), filename);
+    }
+
+    PrintAndLogEx(SUCCESS, "%zu files, " _GREEN_("%zu") " identified", done, found);
+    PrintAndLogEx(SUCCESS, "time " _YELLOW_("%" PRIu64) " ms", t);
+    lf_batch_free(&list);
+    return res;
+#endif
+}
+
+
 static command_t CommandTable[] = {
     {"help",        CmdHelp,            AlwaysAvailable, "This help"},
     {"-----------", CmdHelp,            AlwaysAvailable, "-------------- " _CYAN_("Low Frequency") " --------------"},
@@ -1791,6 +2452,7 @@ static command_t CommandTable[] = {
     {"cmdread",     CmdLFCommandRead,   IfPm3Lf,         "Modulate LF reader field to send command before read"},
     {"read",        CmdLFRead,          IfPm3Lf,         "Read LF tag"},
     {"search",      CmdLFfind,          AlwaysAvailable, "Read and Search for valid known tag"},
+    {"batch",       CmdLFBatch,         AlwaysAvailable, "Identify captures of a directory or list offline"},
     {"sim",         CmdLFSim,           IfPm3Lf,         "Simulate LF tag from buffer"},
     {"simask",      CmdLFaskSim,        IfPm3Lf,         "Simulate " _YELLOW_("ASK") " tag"},
     {"simfsk",      CmdLFfskSim,        IfPm3Lf,         "Simulate " _YELLOW_("FSK") " tag"},
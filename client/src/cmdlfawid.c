@@ -137,16 +137,10 @@ static int CmdAWIDWatch(const char *Cmd) {
 //print full AWID Prox ID and some bit format details if found
 int demodAWID(bool verbose) {
     (void) verbose; // unused so far
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
     if (bits == NULL) {
-        PrintAndLogEx(DEBUG, "DEBUG: Error - AWID failed to allocate memory");
-        return PM3_EMALLOC;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - AWID not enough samples");
-        free(bits);
         return PM3_ENODATA;
     }
     //get binary from fsk wave
@@ -105,9 +105,9 @@ int demodHID(bool verbose) {
     //raw fsk demod no manchester decoding no start bit finding just get binary from wave
     uint32_t hi2 = 0, hi = 0, lo = 0;
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
+    if (bits == NULL) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - " _RED_("HID not enough samples"));
         return PM3_ESOFT;
     }
@@ -129,6 +129,7 @@ int demodHID(bool verbose) {
         else
             PrintAndLogEx(DEBUG, "DEBUG: Error - " _RED_("HID error demoding fsk %d"), idx);
 
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -137,6 +138,7 @@ int demodHID(bool verbose) {
 
     if (hi2 == 0 && hi == 0 && lo == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - " _RED_("HID no values found"));
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -153,6 +155,7 @@ int demodHID(bool verbose) {
         printDemodBuff(0, false, false, false);
     }
 
+    free(bits);
     return PM3_SUCCESS;
 }
 
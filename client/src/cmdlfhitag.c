@@ -17,6 +17,8 @@
 #include "fileutils.h"   // savefile
 #include "protocols.h"   // defines
 #include "cliparser.h"
+#include "util_posix.h"  // msclock
+#include "hitag2/ht2crack5_core.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -70,7 +72,7 @@ static int CmdLFHitagList(const char *Cmd) {
         return PM3_ETIMEOUT;
     }
 
-    uint16_t traceLen = response.arg[2];
+    uint32_t traceLen = response.arg[2];
     if (traceLen > PM3_CMD_DATA_SIZE) {
         uint8_t *p = realloc(got, traceLen);
         if (p == NULL) {
@@ -942,6 +944,295 @@ void annotateHitag2(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize, bool
 void annotateHitagS(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize, bool is_response) {
 }
 
+// collects the tag UID and up to two distinct {nR}{aR} pairs of Hitag2 authentications in the trace
+static int hitag2_get_nrar_from_trace(const uint8_t *trace, uint32_t tracelen, uint8_t *uid, bool have_uid, uint8_t *nrar, int *nrar_cnt) {
+
+    bool uid_seen = have_uid;
+    bool start_auth = false, expect_nrar = false;
+    uint32_t pos = 0;
+    while ((pos + TRACELOG_HDR_LEN < tracelen) && (*nrar_cnt < 2)) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + pos);
+        uint32_t reclen = TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (reclen > tracelen - pos) {
+            break;
+        }
+        pos += reclen;
+
+        // tag answers START_AUTH with its UID
+        if (hdr->isResponse) {
+            expect_nrar = false;
+            if (start_auth && hdr->data_len == 4) {
+                if (uid_seen == false || (have_uid == false && *nrar_cnt == 0)) {
+                    memcpy(uid, hdr->frame, 4);
+                    uid_seen = true;
+                }
+                // pairs of another tag are of no use
+                expect_nrar = (memcmp(uid, hdr->frame, 4) == 0);
+            }
+            start_auth = false;
+            continue;
+        }
+
+        start_auth = (hdr->data_len == 1);
+
+        // reader authenticates with {nR}{aR}
+        if (expect_nrar && hdr->data_len == 8) {
+            if (*nrar_cnt == 0 || memcmp(nrar, hdr->frame, 4) != 0) {
+                memcpy(nrar + (*nrar_cnt * 8), hdr->frame, 8);
+                (*nrar_cnt)++;
+            }
+        }
+        expect_nrar = false;
+    }
+    return uid_seen ? PM3_SUCCESS : PM3_ENODATA;
+}
+
+// save the checkpoint this often while searching, ms
+#define HT2CRACK5_CP_INTERVAL   30000
+
+typedef struct {
+    const char *cpfile;
+    const uint8_t *uid;
+    const uint8_t *nrar;
+    uint64_t t_start;
+    uint64_t t_report;
+    uint64_t t_cp;
+    uint32_t start;
+} hitag2_crack_state_t;
+
+static void print_duration(char *s, size_t size, uint64_t sec) {
+    snprintf(s, size, "%" PRIu64 "h %02" PRIu64 "m %02" PRIu64 "s", sec / 3600, (sec / 60) % 60, sec % 60);
+}
+
+static void hitag2_checkpoint_save(const hitag2_crack_state_t *st, uint32_t next, uint32_t total) {
+    FILE *fp = fopen(st->cpfile, "w");
+    if (fp == NULL) {
+        PrintAndLogEx(WARNING, "Cannot write checkpoint file " _YELLOW_("%s"), st->cpfile);
+        return;
+    }
+    fprintf(fp, "ht2crack5 %s", sprint_hex_inrow(st->uid, 4));
+    fprintf(fp, " %s", sprint_hex_inrow(st->nrar, 8));
+    fprintf(fp, " %s", sprint_hex_inrow(st->nrar + 8, 8));
+    fprintf(fp, " %u %u\n", next, total);
+    fclose(fp);
+}
+
+// returns the candidate to resume from, 0 when there is no matching checkpoint
+static uint32_t hitag2_checkpoint_load(const hitag2_crack_state_t *st) {
+    FILE *fp = fopen(st->cpfile, "r");
+    if (fp == NULL)
+        return 0;
+
+    char magic[16] = {0}, cp_uid[9] = {0}, cp_nrar1[17] = {0}, cp_nrar2[17] = {0};
+    uint32_t next = 0, total = 0;
+    int n = fscanf(fp, "%15s %8s %16s %16s %u %u", magic, cp_uid, cp_nrar1, cp_nrar2, &next, &total);
+    fclose(fp);
+
+    if (n != 6 || strcmp(magic, "ht2crack5") || next > total) {
+        PrintAndLogEx(WARNING, "Ignoring invalid checkpoint file " _YELLOW_("%s"), st->cpfile);
+        return 0;
+    }
+
+    if (strcmp(cp_uid, sprint_hex_inrow(st->uid, 4)) ||
+            strcmp(cp_nrar1, sprint_hex_inrow(st->nrar, 8)) ||
+            strcmp(cp_nrar2, sprint_hex_inrow(st->nrar + 8, 8))) {
+        PrintAndLogEx(WARNING, "Checkpoint file " _YELLOW_("%s") " belongs to other challenges, starting over", st->cpfile);
+        return 0;
+    }
+
+    PrintAndLogEx(INFO, "Resuming from checkpoint " _YELLOW_("%s") " at " _YELLOW_("%u") " / %u", st->cpfile, next, total);
+    return next;
+}
+
+static bool hitag2_crack_poll(const ht2crack5_progress_t *p, void *arg) {
+    hitag2_crack_state_t *st = (hitag2_crack_state_t *)arg;
+
+    if (kbd_enter_pressed())
+        return false;
+
+    uint64_t now = msclock();
+    if (now - st->t_report >= 1000) {
+        st->t_report = now;
+        char eta[32] = "-";
+        uint32_t finished = p->finished - st->start;
+        if (finished) {
+            print_duration(eta, sizeof(eta), ((now - st->t_start) * (p->total - p->finished) / finished) / 1000);
+        }
+        PrintAndLogEx(INPLACE, "%6.2f%%  %u / %u  ETA %s", (float)p->finished * 100 / p->total, p->finished, p->total, eta);
+    }
+
+    if (st->cpfile && now - st->t_cp >= HT2CRACK5_CP_INTERVAL) {
+        st->t_cp = now;
+        hitag2_checkpoint_save(st, p->next, p->total);
+    }
+    return true;
+}
+
+static int CmdLFHitag2Crack(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf hitag crack",
+                  "Recover the key of a Hitag2 tag from two reader authentications, using the\n"
+                  "bitsliced attack of " _YELLOW_("`tools/hitag2crack/crack5`") ".\n"
+                  "UID and {nR}{aR} pairs are taken from the trace, e.g. after " _YELLOW_("`lf hitag sniff`") ",\n"
+                  "or given on the command line. The search runs on all CPUs and can be stopped with <Enter>,\n"
+                  "the checkpoint file lets the next run with the same challenges continue where it stopped.",
+                  "lf hitag crack                      -> download trace from device\n"
+                  "lf hitag crack -1                   -> use trace buffer, e.g. after `trace load`\n"
+                  "lf hitag crack --uid 49435769 --nrar 656E457228DC8031 --nrar 010203049F868CBE\n"
+                  "lf hitag crack -1 --threads 4 -f mytag"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("1", "buffer", "use data from trace buffer"),
+        arg_str0(NULL, "uid", "<hex>", "tag UID, 4 hex bytes"),
+        arg_strx0(NULL, "nrar", "<hex>", "{nR}{aR} pair, 8 hex bytes, give it twice"),
+        arg_u64_0(NULL, "threads", "<dec>", "number of search threads (def: number of cpus)"),
+        arg_str0("f", "file", "<fn>", "checkpoint file (def: ~/.proxmark3/hitag2_crack_<uid>.txt)"),
+        arg_lit0(NULL, "nocp", "do not use a checkpoint file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    bool use_buffer = arg_get_lit(ctx, 1);
+
+    uint8_t uid[4] = {0};
+    int uidlen = 0;
+    int res = CLIParamHexToBuf(arg_get_str(ctx, 2), uid, sizeof(uid), &uidlen);
+    if (res != 0) {
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    uint8_t nrar[16] = {0};
+    int nrarlen = 0;
+    res = CLIParamHexToBuf(arg_get_str(ctx, 3), nrar, sizeof(nrar), &nrarlen);
+    if (res != 0) {
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    uint32_t threads = arg_get_u32_def(ctx, 4, 0);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool nocp = arg_get_lit(ctx, 6);
+    CLIParserFree(ctx);
+
+    if (uidlen != 0 && uidlen != 4) {
+        PrintAndLogEx(WARNING, "Wrong UID len expected 0 or 4, got %d", uidlen);
+        return PM3_EINVARG;
+    }
+
+    if (nrarlen != 0 && nrarlen != 16) {
+        PrintAndLogEx(WARNING, "Wrong NR/AR len expected two pairs of 8 bytes, got %d bytes", nrarlen);
+        return PM3_EINVARG;
+    }
+
+    if (threads > 0xFF) {
+        PrintAndLogEx(WARNING, "Too many threads, max 255");
+        return PM3_EINVARG;
+    }
+
+    if (nrarlen == 0) {
+        uint8_t *trace = NULL;
+        uint32_t tracelen = 0;
+        res = TraceGetBuffer(use_buffer, &trace, &tracelen);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "Failed to get the trace ( %d )", res);
+            return res;
+        }
+
+        int nrar_cnt = 0;
+        res = hitag2_get_nrar_from_trace(trace, tracelen, uid, (uidlen == 4), nrar, &nrar_cnt);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "No Hitag2 UID found in trace, use " _YELLOW_("--uid"));
+            return res;
+        }
+        if (nrar_cnt < 2) {
+            PrintAndLogEx(FAILED, "Need two authentications in the trace, found %d", nrar_cnt);
+            return PM3_ENODATA;
+        }
+    } else if (uidlen == 0) {
+        PrintAndLogEx(WARNING, "UID is needed with " _YELLOW_("--nrar"));
+        return PM3_EINVARG;
+    }
+
+    if (memcmp(nrar, nrar + 8, 4) == 0) {
+        PrintAndLogEx(WARNING, "Both authentications use the same {nR}, need two different ones");
+        return PM3_EINVARG;
+    }
+
+    PrintAndLogEx(INFO, "UID........ " _YELLOW_("%s"), sprint_hex_inrow(uid, sizeof(uid)));
+    PrintAndLogEx(INFO, "{nR}{aR} 1. " _YELLOW_("%s"), sprint_hex_inrow(nrar, 8));
+    PrintAndLogEx(INFO, "{nR}{aR} 2. " _YELLOW_("%s"), sprint_hex_inrow(nrar + 8, 8));
+
+    // the default checkpoint lives in the user's pm3 directory
+    char *cppath = NULL;
+    if (nocp == false && fnlen == 0) {
+        snprintf(filename, sizeof(filename), "hitag2_crack_%s.txt", sprint_hex_inrow(uid, sizeof(uid)));
+        if (searchHomeFilePath(&cppath, NULL, filename, true) != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "Cannot find the user directory, not using a checkpoint file");
+            nocp = true;
+        }
+    }
+
+    hitag2_crack_state_t st = {
+        .cpfile = (nocp) ? NULL : ((cppath) ? cppath : filename),
+        .uid = uid,
+        .nrar = nrar,
+    };
+
+    if (st.cpfile) {
+        st.start = hitag2_checkpoint_load(&st);
+    }
+
+    if (threads == 0) {
+        threads = num_CPUs();
+    }
+
+    PrintAndLogEx(INFO, "Searching with " _YELLOW_("%u") " threads, press " _GREEN_("<Enter>") " to stop", threads);
+
+    st.t_start = msclock();
+    st.t_report = st.t_start;
+    st.t_cp = st.t_start;
+
+    uint8_t key[6] = {0};
+    ht2crack5_progress_t last = {0};
+    res = ht2crack5_search(uid, nrar, nrar + 8, threads, st.start, hitag2_crack_poll, &st, &last, key);
+    if (res == PM3_EINVARG && st.start) {
+        PrintAndLogEx(WARNING, "Ignoring invalid checkpoint file " _YELLOW_("%s"), st.cpfile);
+        st.start = 0;
+        res = ht2crack5_search(uid, nrar, nrar + 8, threads, 0, hitag2_crack_poll, &st, &last, key);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    char took[32];
+    print_duration(took, sizeof(took), (msclock() - st.t_start) / 1000);
+
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Search took %s", took);
+        PrintAndLogEx(SUCCESS, "found valid key [ " _GREEN_("%s") " ]", sprint_hex_inrow(key, sizeof(key)));
+    } else if (res == PM3_ESOFT) {
+        PrintAndLogEx(INFO, "Searched the whole key space in %s", took);
+        PrintAndLogEx(FAILED, "key not found, check the captured authentications");
+    } else if (res == PM3_EOPABORTED && st.cpfile) {
+        hitag2_checkpoint_save(&st, last.next, last.total);
+        PrintAndLogEx(INFO, "Stopped at " _YELLOW_("%u") " / %u, checkpoint saved to " _YELLOW_("%s"), last.next, last.total, st.cpfile);
+    } else if (res == PM3_EMALLOC) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+    }
+
+    // the checkpoint is of no use once the search has an answer,  other errors keep it for a retry
+    if (st.cpfile && (res == PM3_SUCCESS || res == PM3_ESOFT))
+        remove(st.cpfile);
+
+    free(cppath);
+    return res;
+}
+
 static command_t CommandTable[] = {
     {"help",   CmdHelp,               AlwaysAvailable, "This help"},
     {"eload",  CmdLFHitagEload,       IfPm3Hitag,      "Load Hitag dump file into emulator memory"},
@@ -953,6 +1244,7 @@ static command_t CommandTable[] = {
     {"writer", CmdLFHitagWriter,      IfPm3Hitag,      "Act like a Hitag writer"},
     {"dump",   CmdLFHitag2Dump,       IfPm3Hitag,      "Dump Hitag2 tag"},
     {"cc",     CmdLFHitagCheckChallenges, IfPm3Hitag,  "Test all challenges"},
+    {"crack",  CmdLFHitag2Crack,      AlwaysAvailable, "Recover Hitag2 key from two authentications"},
     { NULL, NULL, 0, NULL }
 };
 
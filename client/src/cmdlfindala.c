@@ -305,8 +305,10 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
 
     // worst case with g_GraphTraceLen=40000 is < 4096
     // under normal conditions it's < 2048
-    uint8_t data[MAX_GRAPH_TRACE_LEN] = {0};
-    size_t datasize = getFromGraphBuf(data);
+    size_t datasize = 0;
+    const uint8_t *data = getGraphBufView(&datasize);
+    if (data == NULL)
+        return PM3_ENODATA;
 
     uint8_t rawbits[4096];
     int rawbit = 0;
@@ -476,6 +478,9 @@ static int CmdIndalaDemodAlt(const char *Cmd) {
     // Remodulating for tag cloning
     // HACK: 2015-01-04 this will have an impact on our new way of seening lf commands (demod)
     // since this changes graphbuffer data.
+    if (graphReserve(32 * uidlen) == false)
+        return PM3_EMALLOC;
+
     g_GraphTraceLen = 32 * uidlen;
     i = 0;
     int phase;
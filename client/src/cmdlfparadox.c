@@ -48,9 +48,9 @@ static const uint8_t paradox_lut[] = {
 int demodParadox(bool verbose) {
     (void) verbose; // unused so far
     //raw fsk demod no manchester decoding no start bit finding just get binary from wave
-    uint8_t bits[MAX_GRAPH_TRACE_LEN] = {0};
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
+    if (bits == NULL) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - Paradox not enough samples");
         return PM3_ESOFT;
     }
@@ -70,6 +70,7 @@ int demodParadox(bool verbose) {
         else
             PrintAndLogEx(DEBUG, "DEBUG: Error - Paradox error demoding fsk %d", idx);
 
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -116,6 +117,7 @@ int demodParadox(bool verbose) {
 
     if (hi2 == 0 && hi == 0 && lo == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - Paradox no value found");
+        free(bits);
         return PM3_ESOFT;
     }
 
@@ -166,6 +168,7 @@ int demodParadox(bool verbose) {
         printDemodBuff(0, false, false, false);
     }
 
+    free(bits);
     return PM3_SUCCESS;
 }
 
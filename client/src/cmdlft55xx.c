@@ -3239,23 +3239,104 @@ out:
     return PM3_SUCCESS;
 }
 
+// Bruteforce on device,  candidates are confirmed here with the full demodulators.
+// returns found (> 0 if found xx1 xx downlink needed, 1 found) and the last password tried in *curr
+static int t55xx_bruteforce_device(uint32_t start_password, uint32_t end_password, uint8_t downlink_mode, bool ra, uint8_t clk, uint8_t *found, uint32_t *curr) {
+
+    t55xx_bf_t payload = {
+        .start_pwd = start_password,
+        .end_pwd = end_password,
+        .downlink_mode = (ra) ? 4 : downlink_mode,
+        .clock = clk,
+    };
+
+    *found = 0;
+    *curr = start_password;
+
+    for (;;) {
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_LF_T55XX_BRUTE, (uint8_t *)&payload, sizeof(payload));
+
+        PacketResponseNG resp;
+        uint64_t break_sent = 0;
+        while (WaitForResponseTimeout(CMD_LF_T55XX_BRUTE, &resp, 2000) == false) {
+            if (break_sent) {
+                // the device checks for abort on every password,  give it time to finish one
+                if (msclock() - break_sent > 10000) {
+                    PrintAndLogEx(WARNING, "\nno response from device");
+                    clearCommandBuffer();
+                    return PM3_ETIMEOUT;
+                }
+                continue;
+            }
+            PrintAndLogEx(NORMAL, "." NOLF);
+            if (kbd_enter_pressed()) {
+                // let the device stop and report how far it got
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                break_sent = msclock();
+            }
+        }
+        PrintAndLogEx(NORMAL, "");
+
+        const t55xx_bf_resp_t *r = (t55xx_bf_resp_t *)resp.data.asBytes;
+        if (resp.status != PM3_SUCCESS && resp.status != PM3_EOPABORTED) {
+            return resp.status;
+        }
+
+        // an abort before the first password of this round leaves *curr where it was
+        if (r->tried)
+            *curr = r->last;
+
+        if (r->found) {
+            PrintAndLogEx(INFO, "Device candidate: [ " _YELLOW_("%08X") " ]", r->candidate);
+            *found = t55xx_try_one_password(r->candidate, r->downlink_mode, false);
+            if (*found) {
+                *curr = r->candidate;
+                return PM3_SUCCESS;
+            }
+            PrintAndLogEx(INFO, "False positive, resuming search");
+        }
+
+        if (resp.status == PM3_EOPABORTED) {
+            PrintAndLogEx(WARNING, "aborted via keyboard!");
+            if (r->tried == 0 || r->last != end_password) {
+                uint32_t next = (r->tried) ? r->last + 1 : payload.start_pwd;
+                PrintAndLogEx(HINT, "Try `" _YELLOW_("lf t55xx bruteforce -s %08X -e %08X") "` to resume", next, end_password);
+            }
+            return resp.status;
+        }
+
+        if (r->last == end_password) {
+            return resp.status;
+        }
+
+        payload.start_pwd = r->last + 1;
+    }
+}
+
 // Bruteforce - incremental password range search
 static int CmdT55xxBruteForce(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf t55xx bruteforce",
                   "This command uses bruteforce to scan a number range.\n"
+                  "Passwords are tried and checked on device, only candidates are verified by the client.\n"
                   "Try reading Page 0, block 7 before.\n\n"
                   _RED_("WARNING") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx bruteforce --r2 -s aaaaaa77 -e aaaaaa99\n"
+                  "lf t55xx bruteforce -s aaaaaa77 -e aaaaaa99 --clk 64   -> known RF/64 bitrate\n"
+                  "lf t55xx bruteforce -s aaaaaa77 -e aaaaaa99 --host     -> verify every password on client side"
                  );
 
-    // 1 (help) + 2 (two user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[3 + 6] = {
+    // 1 (help) + 4 (four user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[5 + 6] = {
         arg_param_begin,
         arg_str1("s", "start", "<hex>", "search start password (4 hex bytes)"),
         arg_str1("e", "end", "<hex>", "search end password (4 hex bytes)"),
+        arg_u64_0("c", "clk", "<dec>", "tag bitrate RF/n, speeds up device search (def all)"),
+        arg_lit0(NULL, "host", "try every password from client (slow)"),
     };
-    uint8_t idx = 3;
+    uint8_t idx = 5;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3275,11 +3356,13 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 3);
-    bool r1 = arg_get_lit(ctx, 4);
-    bool r2 = arg_get_lit(ctx, 5);
-    bool r3 = arg_get_lit(ctx, 6);
-    bool ra = arg_get_lit(ctx, 7);
+    uint32_t clk = arg_get_u32_def(ctx, 3, 0);
+    bool use_host = arg_get_lit(ctx, 4);
+    bool r0 = arg_get_lit(ctx, 5);
+    bool r1 = arg_get_lit(ctx, 6);
+    bool r2 = arg_get_lit(ctx, 7);
+    bool r3 = arg_get_lit(ctx, 8);
+    bool ra = arg_get_lit(ctx, 9);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3287,6 +3370,22 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    switch (clk) {
+        case 0:
+        case 8:
+        case 16:
+        case 32:
+        case 40:
+        case 50:
+        case 64:
+        case 100:
+        case 128:
+            break;
+        default:
+            PrintAndLogEx(FAILED, "Error, clock must be one of 8, 16, 32, 40, 50, 64, 100, 128");
+            return PM3_EINVARG;
+    }
+
     uint8_t downlink_mode = refFixedBit; // if no downlink mode suppliled use fixed bit/default as the is the most common
     // Since we dont know the password the config.downlink mode is of little value.
 //   if (r0 || ra) // if try all (ra) then start at fixed bit for correct try all
@@ -3313,29 +3412,38 @@ static int CmdT55xxBruteForce(const char *Cmd) {
     uint64_t t1 = msclock();
     curr = start_password;
 
-    while (found == 0) {
+    if (use_host == false) {
+        res = t55xx_bruteforce_device(start_password, end_password, downlink_mode, ra, clk, &found, &curr);
+        if (res == PM3_ESOFT) {
+            PrintAndLogEx(WARNING, "Tag data can't be told apart on device, falling back to client side search");
+            use_host = true;
+        } else if (res != PM3_SUCCESS && res != PM3_EOPABORTED) {
+            PrintAndLogEx(WARNING, "Device bruteforce failed ( %d )", res);
+            return res;
+        }
+    }
 
-        PrintAndLogEx(NORMAL, "." NOLF);
+    if (use_host) {
+        for (;;) {
 
-        if (IsCancelled()) {
-            return PM3_EOPABORTED;
-        }
+            PrintAndLogEx(NORMAL, "." NOLF);
+
+            if (IsCancelled()) {
+                return PM3_EOPABORTED;
+            }
 
-        found = t55xx_try_one_password(curr, downlink_mode, ra);
+            found = t55xx_try_one_password(curr, downlink_mode, ra);
 
-        if (curr == end_password)
-            break;
+            if (found || curr == end_password)
+                break;
 
-        curr++;
+            curr++;
+        }
+        PrintAndLogEx(NORMAL, "");
     }
 
-    PrintAndLogEx(NORMAL, "");
-
     if (found) {
-        if (curr != end_password) {
-            PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr - 1);
-        } else
-            PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr);
+        PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr);
         T55xx_Print_DownlinkMode((found >> 1) & 3);
     } else
         PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", curr);
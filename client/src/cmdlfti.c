@@ -90,6 +90,9 @@ int demodTI(bool verbose) {
     int lowTot = 0, highTot = 0;
     int retval = PM3_ESOFT;
 
+    // the saved graph keeps the samples, the ones below get changed
+    graphWritable();
+
     for (i = 0; i < g_GraphTraceLen - convLen; i++) {
         lowSum = 0;
         highSum = 0;
@@ -21,43 +21,12 @@
 #include "ui.h"
 #include "util.h"
 #include "fileutils.h"
+#include "resources.h"          // resource_json
 #include "crc16.h"              // crc
 #include "cliparser.h"          // cliparsing
 
 static int CmdHelp(const char *Cmd);
 
-static int smart_loadjson(const char *preferredName, json_t **root) {
-
-    json_error_t error;
-
-    if (preferredName == NULL) return 1;
-
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, ".json", false);
-    if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    if (!json_is_array(*root)) {
-        PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    PrintAndLogEx(SUCCESS, "Loaded file (%s) OK.", path);
-out:
-    free(path);
-    return retval;
-}
-
 static uint8_t GetATRTA1(uint8_t *atr, size_t atrlen) {
     if (atrlen > 2) {
         uint8_t T0 = atr[1];
@@ -990,8 +959,11 @@ static int CmdSmartBruteforceSFI(const char *Cmd) {
 //  uint8_t VERIFY[] = {0x00, 0x20, 0x00, 0x80};
 
     PrintAndLogEx(INFO, "Importing AID list");
-    json_t *root = NULL;
-    smart_loadjson("aidlist", &root);
+    json_t *root = resource_json("aidlist", true);
+    if (json_is_array(root) == false) {
+        PrintAndLogEx(ERR, "Invalid json format. root must be an array.");
+        return PM3_ESOFT;
+    }
 
     uint8_t *buf = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
     if (!buf)
@@ -1017,14 +989,14 @@ static int CmdSmartBruteforceSFI(const char *Cmd) {
         data = json_array_get(root, i);
         if (json_is_object(data) == false) {
             PrintAndLogEx(ERR, "\ndata %d is not an object\n", i + 1);
-            json_decref(root);
+            free(buf);
             return PM3_ESOFT;
         }
 
         jaid = json_object_get(data, "AID");
         if (json_is_string(jaid) == false) {
             PrintAndLogEx(ERR, "\nAID data [%d] is not a string", i + 1);
-            json_decref(root);
+            free(buf);
             return PM3_ESOFT;
         }
 
@@ -1090,7 +1062,6 @@ static int CmdSmartBruteforceSFI(const char *Cmd) {
         free(caid);
 
     free(buf);
-    json_decref(root);
 
     PrintAndLogEx(SUCCESS, "\nSearch completed.");
     return PM3_SUCCESS;
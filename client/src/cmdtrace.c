@@ -10,6 +10,7 @@
 #include "cmdtrace.h"
 
 #include <ctype.h>
+#include <pthread.h>
 
 #include "cmdparser.h"    // command_t
 #include "protocols.h"
@@ -22,27 +23,130 @@
 #include "cmdlfhitag.h"         // annotate hitag
 #include "pm3_cmd.h"            // tracelog_hdr_t
 #include "cliparser.h"          // args..
+#include "util.h"               // num_CPUs
+#include "util_posix.h"         // msclock
+#include "hfrawdecode.h"        // raw sniffer captures
+#include "crc16.h"              // init_table
 
 static int CmdHelp(const char *Cmd);
 
 // trace pointer
 static uint8_t *gs_trace;
-static long gs_traceLen = 0;
+static uint32_t gs_traceLen = 0;
 
-static bool is_last_record(uint16_t tracepos, uint16_t traceLen) {
+// record index,  one entry per complete record.  Built once when a trace is
+// loaded or downloaded so listing can start anywhere without walking from 0
+typedef struct {
+    uint32_t pos;
+    uint32_t timestamp;
+} trace_index_t;
+
+static trace_index_t *gs_index = NULL;
+static uint32_t gs_index_count = 0;
+// timestamps never go backwards,  false for concatenated traces
+static bool gs_index_sorted = true;
+
+static bool is_last_record(uint32_t tracepos, uint32_t traceLen) {
     return ((tracepos + TRACELOG_HDR_LEN) >= traceLen);
 }
 
-static bool next_record_is_response(uint16_t tracepos, uint8_t *trace) {
+static uint32_t record_len(tracelog_hdr_t *hdr) {
+    return TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+}
+
+static void trace_index_free(void) {
+    free(gs_index);
+    gs_index = NULL;
+    gs_index_count = 0;
+    gs_index_sorted = true;
+}
+
+static int trace_index_build(void) {
+    trace_index_free();
+
+    uint32_t size = 0;
+    uint32_t pos = 0;
+    while (is_last_record(pos, gs_traceLen) == false) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + pos);
+        uint32_t len = record_len(hdr);
+        if (len > gs_traceLen - pos) {
+            PrintAndLogEx(DEBUG, "truncated record at offset %" PRIu32, pos);
+            break;
+        }
+
+        if (gs_index_count == size) {
+            size = (size) ? size * 2 : 1024;
+            trace_index_t *tmp = realloc(gs_index, size * sizeof(trace_index_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "Cannot allocate memory for trace index");
+                trace_index_free();
+                return PM3_EMALLOC;
+            }
+            gs_index = tmp;
+        }
+
+        if (gs_index_count && hdr->timestamp < gs_index[gs_index_count - 1].timestamp)
+            gs_index_sorted = false;
+
+        gs_index[gs_index_count].pos = pos;
+        gs_index[gs_index_count].timestamp = hdr->timestamp;
+        gs_index_count++;
+        pos += len;
+    }
+    return PM3_SUCCESS;
+}
+
+// first record with a timestamp at or after ts
+static uint32_t trace_index_seek(uint32_t ts) {
+    if (gs_index_sorted) {
+        uint32_t lo = 0, hi = gs_index_count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (gs_index[mid].timestamp < ts)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    for (uint32_t i = 0; i < gs_index_count; i++) {
+        if (gs_index[i].timestamp >= ts)
+            return i;
+    }
+    return gs_index_count;
+}
+
+// record number at offset pos
+static uint32_t trace_index_find(uint32_t pos) {
+    uint32_t lo = 0, hi = gs_index_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (gs_index[mid].pos < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static bool skip_record(uint32_t tracepos, bool only_reader, bool only_tag) {
+    if (is_last_record(tracepos, gs_traceLen))
+        return false;
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
+    return (only_reader && hdr->isResponse) || (only_tag && hdr->isResponse == false);
+}
+
+static bool next_record_is_response(uint32_t tracepos, uint8_t *trace) {
     tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
     return (hdr->isResponse);
 }
 
-static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t *tracepos, uint16_t traceLen,
-                                      uint8_t *trace, uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len) {
-
 #define MAX_TOPAZ_READER_CMD_LEN 16
 
+static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint32_t *tracepos, uint32_t traceLen,
+                                      uint8_t *trace, uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len) {
+
     uint32_t last_timestamp = timestamp + *duration;
 
     if ((*data_len != 1) || (frame[0] == TOPAZ_WUPA) || (frame[0] == TOPAZ_REQA)) return false;
@@ -72,13 +176,13 @@ static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, ui
     return true;
 }
 
-static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol) {
+static uint32_t printHexLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) return traceLen;
 
     tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
 
-    if (TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr) > traceLen) {
+    if (record_len(hdr) > traceLen - tracepos) {
         return traceLen;
     }
 
@@ -90,7 +194,7 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
         return tracepos;
     }
 
-    uint16_t ret;
+    uint32_t ret;
 
     switch (protocol) {
         case ISO_14443A: {
@@ -133,31 +237,31 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
     return ret;
 }
 
-static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
-                               const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
-    // sanity check
-    if (is_last_record(tracepos, traceLen)) {
-        PrintAndLogEx(DEBUG, "last record triggered.  t-pos: %u  t-len %u", tracepos, traceLen);
-        return traceLen;
-    }
+// Listing is split in two stages.  trace_decode_record() does everything that
+// only depends on the record itself (CRC check, data column, annotations which
+// keep no state) and runs on a batch of records in parallel.  trace_print_record()
+// runs in trace order and does the rest: CRC / short byte marks, timings, the
+// annotators which follow a session (ISO14443-A / MIFARE auth,  iCLASS),  crypto1
+// decoding and printing.
+#define TRACE_BATCH_SIZE  1024
 
-    uint32_t end_of_transmission_timestamp = 0;
+typedef struct {
+    uint32_t next;              // offset after the record and the topaz frames merged into it
     uint32_t duration;
     uint16_t data_len;
-    uint8_t topaz_reader_command[9];
-    char explanation[40] = {0};
-    uint8_t mfData[32] = {0};
-    size_t mfDataLen = 0;
-    tracelog_hdr_t *first_hdr = (tracelog_hdr_t *)(trace);
-    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
+    uint8_t crc_status;
+    bool merged;
+    uint8_t topaz_reader_command[MAX_TOPAZ_READER_CMD_LEN];
+    char explanation[40];
+    char line[18][120];
+} trace_line_t;
 
-    duration = hdr->duration;
-    data_len = hdr->data_len;
+static void trace_decode_record(uint32_t tracepos, uint8_t protocol, trace_line_t *tl) {
 
-    if (tracepos + TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr) > traceLen) {
-        PrintAndLogEx(DEBUG, "trace pos offset %"PRIu64 " larger than reported tracelen %u", tracepos + TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr), traceLen);
-        return traceLen;
-    }
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
+
+    uint32_t duration = hdr->duration;
+    uint16_t data_len = hdr->data_len;
 
     // adjust for different time scales
     if (protocol == ICLASS || protocol == ISO_15693) {
@@ -167,13 +271,15 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     uint8_t *frame = hdr->frame;
     uint8_t *parityBytes = hdr->frame + data_len;
 
-    tracepos += TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr);
+    tracepos += record_len(hdr);
 
+    tl->merged = false;
     if (protocol == TOPAZ && !hdr->isResponse) {
         // topaz reader commands come in 1 or 9 separate frames with 7 or 8 Bits each.
         // merge them:
-        if (merge_topaz_reader_frames(hdr->timestamp, &duration, &tracepos, traceLen, trace, frame, topaz_reader_command, &data_len)) {
-            frame = topaz_reader_command;
+        if (merge_topaz_reader_frames(hdr->timestamp, &duration, &tracepos, gs_traceLen, gs_trace, frame, tl->topaz_reader_command, &data_len)) {
+            frame = tl->topaz_reader_command;
+            tl->merged = true;
         }
     }
 
@@ -193,7 +299,7 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 crcStatus = !felica_CRC_check(frame + 2, data_len - 4);
                 break;
             case PROTO_MIFARE:
-                crcStatus = mifare_CRC_check(hdr->isResponse, frame, data_len);
+                // depends on the auth state,  checked when printing
                 break;
             case ISO_14443A:
             case MFDES:
@@ -204,15 +310,15 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 crcStatus = iso14443A_CRC_check(hdr->isResponse, frame, data_len) == 1 ? 3 : 0;
                 crcStatus = iso14443B_CRC_check(frame, data_len) == 1 ? 4 : crcStatus;
                 break;
-            case THINFILM:
-                frame[data_len - 1] ^= frame[data_len - 2];
-                frame[data_len - 2] ^= frame[data_len - 1];
-                frame[data_len - 1] ^= frame[data_len - 2];
-                crcStatus = iso14443A_CRC_check(true, frame, data_len);
-                frame[data_len - 1] ^= frame[data_len - 2];
-                frame[data_len - 2] ^= frame[data_len - 1];
-                frame[data_len - 1] ^= frame[data_len - 2];
+            case THINFILM: {
+                // CRC bytes are swapped,  check on a copy since the trace is shared between workers
+                uint8_t tmp[data_len];
+                memcpy(tmp, frame, data_len);
+                tmp[data_len - 2] = frame[data_len - 1];
+                tmp[data_len - 1] = frame[data_len - 2];
+                crcStatus = iso14443A_CRC_check(true, tmp, data_len);
                 break;
+            }
             case ISO_15693:
                 crcStatus = iso15693_CRC_check(frame, data_len);
                 break;
@@ -229,7 +335,8 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     //2 Not crc-command
 
     //--- Draw the data column
-    char line[18][120] = {{0}};
+    char (*line)[120] = tl->line;
+    memset(tl->line, 0, sizeof(tl->line));
 
     if (data_len == 0) {
         if (protocol == ICLASS && duration == 2048) {
@@ -276,6 +383,83 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
 
     }
 
+    char *explanation = tl->explanation;
+    memset(tl->explanation, 0, sizeof(tl->explanation));
+
+    // Always annotate these protocols both reader/tag messages
+    switch (protocol) {
+        case PROTO_HITAG1:
+            annotateHitag1(explanation, sizeof(tl->explanation), frame, data_len, hdr->isResponse);
+            break;
+        case PROTO_HITAG2:
+            annotateHitag2(explanation, sizeof(tl->explanation), frame, data_len, hdr->isResponse);
+            break;
+        case PROTO_HITAGS:
+            annotateHitagS(explanation, sizeof(tl->explanation), frame, data_len, hdr->isResponse);
+            break;
+        default:
+            break;
+    }
+
+    if (hdr->isResponse == false) {
+
+        switch (protocol) {
+            case LEGIC:
+                annotateLegic(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            case ISO_14443B:
+                annotateIso14443b(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            case TOPAZ:
+                annotateTopaz(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            case ISO_15693:
+                annotateIso15693(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            case FELICA:
+                annotateFelica(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            case LTO:
+                annotateLTO(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            case PROTO_CRYPTORF:
+                annotateCryptoRF(explanation, sizeof(tl->explanation), frame, data_len);
+                break;
+            default:
+                break;
+        }
+    }
+
+    tl->next = tracepos;
+    tl->duration = duration;
+    tl->data_len = data_len;
+    tl->crc_status = crcStatus;
+}
+
+static uint32_t trace_print_record(uint32_t tracepos, trace_line_t *tl, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
+                                   const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
+
+    uint32_t end_of_transmission_timestamp = 0;
+    uint32_t duration = tl->duration;
+    uint16_t data_len = tl->data_len;
+    char explanation[40];
+    memcpy(explanation, tl->explanation, sizeof(explanation));
+    char (*line)[120] = tl->line;
+    uint8_t mfData[32] = {0};
+    size_t mfDataLen = 0;
+    tracelog_hdr_t *first_hdr = (tracelog_hdr_t *)(gs_trace);
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
+
+    uint8_t *frame = (tl->merged) ? tl->topaz_reader_command : hdr->frame;
+    uint8_t *parityBytes = hdr->frame + hdr->data_len;
+
+    tracepos = tl->next;
+
+    uint8_t crcStatus = tl->crc_status;
+    if (protocol == PROTO_MIFARE && data_len > 2) {
+        crcStatus = mifare_CRC_check(hdr->isResponse, frame, data_len);
+    }
+
     if (markCRCBytes) {
         //CRC-command
         if (crcStatus == 0 || crcStatus == 1) {
@@ -337,15 +521,6 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
         case PROTO_MIFARE:
             annotateMifare(explanation, sizeof(explanation), frame, data_len, parityBytes, TRACELOG_PARITY_LEN(hdr), hdr->isResponse);
             break;
-        case PROTO_HITAG1:
-            annotateHitag1(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
-        case PROTO_HITAG2:
-            annotateHitag2(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
-        case PROTO_HITAGS:
-            annotateHitagS(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
         case ICLASS:
             annotateIclass(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
             break;
@@ -356,37 +531,16 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     if (hdr->isResponse == false) {
 
         switch (protocol) {
-            case LEGIC:
-                annotateLegic(explanation, sizeof(explanation), frame, data_len);
-                break;
             case ISO_14443A:
                 annotateIso14443a(explanation, sizeof(explanation), frame, data_len);
                 break;
             case MFDES:
                 annotateMfDesfire(explanation, sizeof(explanation), frame, data_len);
                 break;
-            case ISO_14443B:
-                annotateIso14443b(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case TOPAZ:
-                annotateTopaz(explanation, sizeof(explanation), frame, data_len);
-                break;
             case ISO_7816_4:
                 annotateIso14443a(explanation, sizeof(explanation), frame, data_len);
                 annotateIso7816(explanation, sizeof(explanation), frame, data_len);
                 break;
-            case ISO_15693:
-                annotateIso15693(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case FELICA:
-                annotateFelica(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case LTO:
-                annotateLTO(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case PROTO_CRYPTORF:
-                annotateCryptoRF(explanation, sizeof(explanation), frame, data_len);
-                break;
             default:
                 break;
         }
@@ -477,13 +631,13 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
         }
     }
 
-    if (is_last_record(tracepos, traceLen)) {
-        return traceLen;
+    if (is_last_record(tracepos, gs_traceLen)) {
+        return gs_traceLen;
     }
 
-    if (showWaitCycles && hdr->isResponse == false && next_record_is_response(tracepos, trace)) {
+    if (showWaitCycles && hdr->isResponse == false && next_record_is_response(tracepos, gs_trace)) {
 
-        tracelog_hdr_t *next_hdr = (tracelog_hdr_t *)(trace + tracepos);
+        tracelog_hdr_t *next_hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
 
         PrintAndLogEx(NORMAL, " %10u | %10u | %s |fdt (Frame Delay Time): " _YELLOW_("%d"),
                       (end_of_transmission_timestamp - first_hdr->timestamp),
@@ -495,6 +649,124 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
     return tracepos;
 }
 
+typedef struct {
+    uint32_t first;             // index of the first record of the batch
+    uint32_t count;
+    uint32_t stride;            // every stride'th record,  starting at offset
+    uint32_t offset;
+    uint8_t protocol;
+    trace_line_t *lines;
+} trace_batch_t;
+
+static void *trace_decode_worker(void *arg) {
+    trace_batch_t *b = (trace_batch_t *)arg;
+    for (uint32_t i = b->offset; i < b->count; i += b->stride) {
+        trace_decode_record(gs_index[b->first + i].pos, b->protocol, &b->lines[i]);
+    }
+    return NULL;
+}
+
+// CRC the records of a protocol are checked with in trace_decode_record
+static CrcType_t trace_crc_type(uint8_t protocol) {
+    switch (protocol) {
+        case ICLASS:
+            return CRC_ICLASS;
+        case ISO_14443B:
+        case TOPAZ:
+            return CRC_14443_B;
+        case FELICA:
+            return CRC_FELICA;
+        case ISO_14443A:
+        case MFDES:
+        case LTO:
+        case ISO_7816_4:    // and CRC-B,  same table
+        case THINFILM:
+            return CRC_14443_A;
+        case ISO_15693:
+            return CRC_15693;
+        default:
+            return CRC_NONE;
+    }
+}
+
+static void trace_decode_batch(uint32_t first, uint32_t count, uint8_t protocol, trace_line_t *lines) {
+
+    uint32_t threads = MAX(1, MIN(num_CPUs(), 16));
+    // not worth starting threads for a few records
+    if (count < 64)
+        threads = 1;
+
+    // the CRC table is built here,  the workers only read it
+    init_table(trace_crc_type(protocol));
+
+    trace_batch_t batch[threads];
+    pthread_t thread_ids[threads];
+    bool started[threads];
+
+    for (uint32_t i = 0; i < threads; i++) {
+        batch[i].first = first;
+        batch[i].count = count;
+        batch[i].stride = threads;
+        batch[i].offset = i;
+        batch[i].protocol = protocol;
+        batch[i].lines = lines;
+        started[i] = (i > 0) && (pthread_create(&thread_ids[i], NULL, trace_decode_worker, &batch[i]) == 0);
+    }
+
+    trace_decode_worker(&batch[0]);
+
+    for (uint32_t i = 1; i < threads; i++) {
+        if (started[i])
+            pthread_join(thread_ids[i], NULL);
+        else
+            trace_decode_worker(&batch[i]);
+    }
+}
+
+// list up to count records starting at record first,  returns the offset where listing stopped
+static uint32_t trace_list_records(uint32_t first, uint32_t count, uint32_t *listed, uint8_t protocol, bool showWaitCycles, bool markCRCBytes,
+                                   uint32_t *prev_eot, bool use_us, bool only_reader, bool only_tag,
+                                   const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
+
+    uint32_t tracepos = gs_index[first].pos;
+
+    trace_line_t *lines = calloc(MIN(TRACE_BATCH_SIZE, gs_index_count - first), sizeof(trace_line_t));
+    if (lines == NULL) {
+        PrintAndLogEx(WARNING, "Cannot allocate memory for trace lines");
+        return gs_traceLen;
+    }
+
+    uint32_t idx = first;
+    while (idx < gs_index_count && *listed < count) {
+
+        uint32_t n = MIN(TRACE_BATCH_SIZE, gs_index_count - idx);
+        trace_decode_batch(idx, n, protocol, lines);
+
+        uint32_t end = idx + n;
+        while (idx < end && *listed < count) {
+
+            if (skip_record(tracepos, only_reader, only_tag)) {
+                tracepos = lines[idx - (end - n)].next;
+            } else {
+                tracepos = trace_print_record(tracepos, &lines[idx - (end - n)], protocol, showWaitCycles, markCRCBytes, prev_eot, use_us, mfDicKeys, mfDicKeysCount);
+                (*listed)++;
+
+                if (kbd_enter_pressed()) {
+                    free(lines);
+                    return tracepos;
+                }
+            }
+
+            // skip records merged into this one
+            while (idx < gs_index_count && gs_index[idx].pos < tracepos)
+                idx++;
+        }
+    }
+
+    free(lines);
+    return (idx < gs_index_count) ? tracepos : gs_traceLen;
+}
+
 static int download_trace(void) {
 
     if (IfPm3Present() == false) {
@@ -507,6 +779,7 @@ static int download_trace(void) {
         free(gs_trace);
 
     gs_traceLen = 0;
+    trace_index_free();
 
     gs_trace = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
     if (gs_trace == NULL) {
@@ -544,6 +817,23 @@ static int download_trace(void) {
             return PM3_ETIMEOUT;
         }
     }
+    return trace_index_build();
+}
+
+int TraceGetBuffer(bool use_buffer, uint8_t **trace, uint32_t *len) {
+    if (use_buffer == false) {
+        int res = download_trace();
+        if (res != PM3_SUCCESS)
+            return res;
+    }
+
+    if (gs_trace == NULL || gs_traceLen == 0) {
+        PrintAndLogEx(WARNING, "Trace buffer is empty");
+        return PM3_ENODATA;
+    }
+
+    *trace = gs_trace;
+    *len = gs_traceLen;
     return PM3_SUCCESS;
 }
 
@@ -583,6 +873,8 @@ static int CmdTraceLoad(const char *Cmd) {
         free(gs_trace);
         gs_trace = NULL;
     }
+    gs_traceLen = 0;
+    trace_index_free();
 
     size_t len = 0;
     if (loadFile_safe(filename, ".trace", (void **)&gs_trace, &len) != PM3_SUCCESS) {
@@ -590,9 +882,111 @@ static int CmdTraceLoad(const char *Cmd) {
         return PM3_EIO;
     }
 
-    gs_traceLen = (long)len;
+    if (len > UINT32_MAX) {
+        PrintAndLogEx(FAILED, "Trace file too large (%zu bytes)", len);
+        free(gs_trace);
+        gs_trace = NULL;
+        return PM3_EFILE;
+    }
+
+    gs_traceLen = len;
+    int res = trace_index_build();
+    if (res != PM3_SUCCESS)
+        return res;
 
-    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%lu") " bytes)", gs_traceLen);
+    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%" PRIu32) " bytes, " _YELLOW_("%" PRIu32) " records)", gs_traceLen, gs_index_count);
+    return PM3_SUCCESS;
+}
+
+static int CmdTraceDecode(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "trace decode",
+                  "Decode a raw sniffer capture into the trace buffer\n"
+                  "File extension is <.raw>, captures are made with `hf sniff --14a|--14b|--15 -f <fn>`\n"
+                  "The capture is split at idle gaps and the parts are decoded in parallel",
+                  "trace decode -f capture -t 14a           -> w/o file extension\n"
+                  "trace decode -f capture -t 15 --threads 4"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "raw capture file to decode"),
+        arg_str1("t", "type", NULL, "protocol of the capture, 14a / 14b / 15"),
+        arg_u64_0(NULL, "threads", "<dec>", "worker threads (def: one per CPU)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int tlen = 0;
+    char type[5] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)type, sizeof(type), &tlen);
+    str_lower(type);
+
+    uint32_t threads = arg_get_u32_def(ctx, 3, 0);
+    CLIParserFree(ctx);
+
+    uint8_t proto;
+    if (strcmp(type, "14a") == 0) {
+        proto = HF_SNIFF_RAW_14A;
+    } else if (strcmp(type, "14b") == 0) {
+        proto = HF_SNIFF_RAW_14B;
+    } else if (strcmp(type, "15") == 0) {
+        proto = HF_SNIFF_RAW_15;
+    } else {
+        PrintAndLogEx(FAILED, "Unknown protocol \"%s\"", type);
+        return PM3_EINVARG;
+    }
+
+    uint8_t *raw = NULL;
+    size_t len = 0;
+    if (loadFile_safe(filename, ".raw", (void **)&raw, &len) != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Could not open file " _YELLOW_("%s"), filename);
+        return PM3_EIO;
+    }
+
+    uint8_t *trace = NULL;
+    uint32_t tracelen = 0;
+    hfraw_stats_t stats;
+    uint64_t t1 = msclock();
+    int res = hfraw_decode(proto, raw, len, threads, &trace, &tracelen, &stats);
+    t1 = msclock() - t1;
+    free(raw);
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Failed to decode the capture (%d)", res);
+        free(trace);
+        return res;
+    }
+
+    PrintAndLogEx(INFO, "decoded " _YELLOW_("%" PRIu64) " samples, " _YELLOW_("%" PRIu32) " segments on " _YELLOW_("%" PRIu32) " threads in " _YELLOW_("%" PRIu64) " ms",
+                  stats.samples, stats.segments, stats.threads, t1);
+    PrintAndLogEx(INFO, "reader frames " _YELLOW_("%" PRIu32) "  tag frames " _YELLOW_("%" PRIu32), stats.reader_frames, stats.tag_frames);
+
+    if (gs_trace) {
+        free(gs_trace);
+        gs_trace = NULL;
+    }
+    gs_traceLen = 0;
+    trace_index_free();
+
+    if (tracelen == 0) {
+        PrintAndLogEx(WARNING, "no frames found, trace is empty");
+        return PM3_SUCCESS;
+    }
+
+    gs_trace = trace;
+    gs_traceLen = tracelen;
+    res = trace_index_build();
+    if (res != PM3_SUCCESS)
+        return res;
+
+    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%" PRIu32) " bytes, " _YELLOW_("%" PRIu32) " records)", gs_traceLen, gs_index_count);
+    PrintAndLogEx(HINT, "Use `" _YELLOW_("trace list -t %s -1") "` to view,  `" _YELLOW_("trace save -f <fn>") "` to save", type);
     return PM3_SUCCESS;
 }
 
@@ -656,6 +1050,11 @@ int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol)
         arg_lit0("x", NULL, "show hexdump to convert to pcap(ng)\n"
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_strx0(NULL, "dict", "<file>", "use dictionary keys file"),
+        arg_u64_0(NULL, "first", "<dec>", "first record to list"),
+        arg_u64_0(NULL, "count", "<dec>", "number of records to list"),
+        arg_u64_0(NULL, "time", "<dec>", "list from the first record starting at or after this time (as in Start column)"),
+        arg_lit0(NULL, "reader", "only list reader frames"),
+        arg_lit0(NULL, "tag", "only list tag frames"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -691,7 +1090,9 @@ int CmdTraceList(const char *Cmd) {
                   "trace list -t cryptorf -> interpret as " _YELLOW_("CryptoRF") " communitcations\n"
                   "trace list -t mf --dict <mfc_default_keys>    -> use dictionary keys file\n"
                   "trace list -t 14a -f                          -> show frame delay times\n"
-                  "trace list -t 14a -1                          -> use trace buffer "
+                  "trace list -t 14a -1                          -> use trace buffer\n"
+                  "trace list -t 14a -1 --first 1000 --count 50  -> list records 1000 to 1049\n"
+                  "trace list -t 14a -1 --time 2000000 --tag     -> list tag frames from timestamp 2000000"
                  );
 
     void *argtable[] = {
@@ -705,6 +1106,11 @@ int CmdTraceList(const char *Cmd) {
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_strx0("t", "type", NULL, "protocol to annotate the trace"),
         arg_strx0(NULL, "dict", "<file>", "use dictionary keys file"),
+        arg_u64_0(NULL, "first", "<dec>", "first record to list"),
+        arg_u64_0(NULL, "count", "<dec>", "number of records to list"),
+        arg_u64_0(NULL, "time", "<dec>", "list from the first record starting at or after this time (as in Start column)"),
+        arg_lit0(NULL, "reader", "only list reader frames"),
+        arg_lit0(NULL, "tag", "only list tag frames"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -728,8 +1134,19 @@ int CmdTraceList(const char *Cmd) {
         diclen = 0;
     }
 
+    uint32_t first = arg_get_u32_def(ctx, 9, 0);
+    uint32_t count = arg_get_u32_def(ctx, 10, UINT32_MAX);
+    bool use_time = arg_get_u64_count(ctx, 11);
+    uint32_t seek_time = arg_get_u32_def(ctx, 11, 0);
+    bool only_reader = arg_get_lit(ctx, 12);
+    bool only_tag = arg_get_lit(ctx, 13);
     CLIParserFree(ctx);
 
+    if (only_reader && only_tag) {
+        PrintAndLogEx(FAILED, "Select either reader or tag frames");
+        return PM3_EINVARG;
+    }
+
     clearCommandBuffer();
 
     // no crc, no annotations
@@ -761,12 +1178,21 @@ int CmdTraceList(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    PrintAndLogEx(SUCCESS, "Recorded activity (trace len = " _YELLOW_("%lu") " bytes)", gs_traceLen);
+    PrintAndLogEx(SUCCESS, "Recorded activity (trace len = " _YELLOW_("%" PRIu32) " bytes)", gs_traceLen);
     if (gs_traceLen == 0) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    if (use_time && gs_index_count)
+        first = trace_index_seek(gs_index[0].timestamp + seek_time);
+
+    if (first >= gs_index_count) {
+        PrintAndLogEx(INFO, "No records to list,  trace has " _YELLOW_("%" PRIu32) " records", gs_index_count);
+        return PM3_SUCCESS;
+    }
+
+    uint32_t tracepos = gs_index[first].pos;
+    uint32_t listed = 0;
 
     /*
     if (protocol == FELICA) {
@@ -774,8 +1200,13 @@ int CmdTraceList(const char *Cmd) {
     } */
 
     if (show_hex) {
-        while (tracepos < gs_traceLen) {
+        while (tracepos < gs_traceLen && listed < count) {
+            if (skip_record(tracepos, only_reader, only_tag)) {
+                tracepos += record_len((tracelog_hdr_t *)(gs_trace + tracepos));
+                continue;
+            }
             tracepos = printHexLine(tracepos, gs_traceLen, gs_trace, protocol);
+            listed++;
         }
     } else {
 
@@ -877,17 +1308,18 @@ int CmdTraceList(const char *Cmd) {
             prev_EOT = &previous_EOT;
         }
 
-        while (tracepos < gs_traceLen) {
-            tracepos = printTraceLine(tracepos, gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount);
-
-            if (kbd_enter_pressed())
-                break;
-        }
+        tracepos = trace_list_records(first, count, &listed, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, only_reader, only_tag, dicKeys, dicKeysCount);
 
         if (dictionaryLoad)
             free((void *) dicKeys);
     }
 
+    uint32_t next = trace_index_find(tracepos);
+    if (next < gs_index_count) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(HINT, "Listed " _YELLOW_("%" PRIu32) " of " _YELLOW_("%" PRIu32) " records,  use " _YELLOW_("`--first %" PRIu32 "`") " to continue", listed, gs_index_count, next);
+    }
+
     if (show_hex)
         PrintAndLogEx(HINT, "syntax to use: " _YELLOW_("`text2pcap -t \"%%S.\" -l 264 -n <input-text-file> <output-pcapng-file>`"));
 
@@ -896,6 +1328,7 @@ int CmdTraceList(const char *Cmd) {
 
 static command_t CommandTable[] = {
     {"help",    CmdHelp,          AlwaysAvailable, "This help"},
+    {"decode",  CmdTraceDecode,   AlwaysAvailable, "Decode a raw sniffer capture into the trace buffer"},
     {"list",    CmdTraceList,     AlwaysAvailable, "List protocol data in trace buffer"},
     {"load",    CmdTraceLoad,     AlwaysAvailable, "Load trace from file"},
     {"save",    CmdTraceSave,     AlwaysAvailable, "Save trace buffer to file"},
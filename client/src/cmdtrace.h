@@ -17,4 +17,7 @@ int CmdTrace(const char *Cmd);
 int CmdTraceList(const char *Cmd);
 int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol);
 
+// trace buffer for offline decoders, downloaded from the device unless use_buffer is set
+int TraceGetBuffer(bool use_buffer, uint8_t **trace, uint32_t *len);
+
 #endif
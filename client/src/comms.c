@@ -19,6 +19,7 @@
 #include "uart/uart.h"
 #include "ui.h"
 #include "crc16.h"
+#include "lz4/lz4.h"   // compressed downloads
 #include "util.h" // g_pendingPrompt
 #include "util_posix.h" // msclock
 #include "util_darwin.h" // en/dis-ableNapp();
@@ -769,6 +770,57 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response) {
     return WaitForResponseTimeoutW(cmd, response, -1, true);
 }
 
+// Compressing costs device time,  it pays off on links slower than USB-CDC
+static bool compressed_download(void) {
+    if (g_pm3_capabilities.compressed_download == false)
+        return false;
+
+    return g_conn.send_via_fpc_usart
+           || (memcmp(g_conn.serial_port_name, "tcp:", 4) == 0)
+           || (memcmp(g_conn.serial_port_name, "bt:", 3) == 0);
+}
+
+// NG frame with a download_chunk_t,  sent by devices when asked for DL_FLAG_COMPRESSED
+static bool dl_chunk(uint8_t *dest, uint32_t bytes, PacketResponseNG *response) {
+
+    download_chunk_t *chunk = (download_chunk_t *)response->data.asBytes;
+    if (response->length < sizeof(download_chunk_t) || chunk->clen > response->length - sizeof(download_chunk_t)) {
+        PrintAndLogEx(FAILED, "ERROR: Malformed download chunk,  len %u", response->length);
+        return false;
+    }
+
+    if (chunk->offset > bytes || chunk->len > bytes - chunk->offset) {
+        PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | buf_size %u", chunk->offset, chunk->len, bytes);
+        return false;
+    }
+
+    if (chunk->clen == chunk->len) {
+        memcpy(dest + chunk->offset, chunk->data, chunk->len);
+        return true;
+    }
+
+    int res = LZ4_decompress_safe((const char *)chunk->data, (char *)dest + chunk->offset, chunk->clen, chunk->len);
+    if (res < 0 || (uint32_t)res != chunk->len) {
+        PrintAndLogEx(FAILED, "ERROR: Failed to decompress download chunk,  offset %u | len %u", chunk->offset, chunk->len);
+        return false;
+    }
+    return true;
+}
+
+// prints the throughput of a download which started at msclock() == start
+void PrintDownloadRate(uint32_t bytes, uint64_t start) {
+    uint64_t ms = msclock() - start;
+    if (ms == 0) {
+        PrintAndLogEx(SUCCESS, "downloaded " _YELLOW_("%u") " bytes in less than 1 ms", bytes);
+        return;
+    }
+    PrintAndLogEx(SUCCESS, "downloaded " _YELLOW_("%u") " bytes in " _YELLOW_("%" PRIu64) " ms ( " _YELLOW_("%.1f") " kB/s )"
+                  , bytes
+                  , ms
+                  , (double)bytes / ms
+                 );
+}
+
 /**
 * Data transfer from Proxmark to client. This method times out after
 * ms_timeout milliseconds.
@@ -796,21 +848,23 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
     // clear
     clearCommandBuffer();
 
+    uint8_t flags = compressed_download() ? DL_FLAG_COMPRESSED : 0;
+
     switch (memtype) {
         case BIG_BUF: {
-            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
+            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, flags, NULL, 0);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
         }
         case BIG_BUF_EML: {
-            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
+            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, flags, NULL, 0);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
         }
         case SPIFFS: {
-            SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, 0, data, datalen);
+            SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, flags, data, datalen);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED);
         }
         case FLASH_MEM: {
-            SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
+            SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, flags, NULL, 0);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED);
         }
         case SIM_MEM: {
@@ -845,6 +899,12 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             if (response->cmd == CMD_SPIFFS_DOWNLOAD)
                 return true;
 
+            if (response->cmd == rec_cmd && response->ng) {
+                if (dl_chunk(dest, bytes, response) == false)
+                    break;
+                continue;
+            }
+
             // sample_buf is a array pointer, located in data.c
             // arg0 = offset in transfer. Startindex of this chunk
             // arg1 = length bytes to transfer
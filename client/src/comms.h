@@ -87,6 +87,7 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response);
 
 //bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+void PrintDownloadRate(uint32_t bytes, uint64_t start);
 
 #ifdef __cplusplus
 }
@@ -16,15 +16,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <jansson.h>
 #include <mbedtls/asn1.h>
 #include <mbedtls/oid.h>
 #include "emv/emv_tags.h"
-#include "emv/emvjson.h"
 #include "util.h"
 #include "proxmark3.h"
-#include "fileutils.h"
+#include "ui.h"
 #include "pm3_cmd.h"
+#include "resources.h"
 
 enum asn1_tag_t {
     ASN1_TAG_GENERIC,
@@ -234,49 +233,6 @@ static void asn1_tag_dump_integer(const struct tlv *tlv, const struct asn1_tag *
     PrintAndLogEx(NORMAL, "    value: %" PRIu32 " (0x%X)", val, val);
 }
 
-static char *asn1_oid_description(const char *oid, bool with_group_desc) {
-    json_error_t error;
-    json_t *root = NULL;
-    static char res[300];
-    memset(res, 0x00, sizeof(res));
-
-    char *path;
-    if (searchFile(&path, RESOURCES_SUBDIR, "oids", ".json", false) != PM3_SUCCESS) {
-        return NULL;
-    }
-
-    // load `oids.json`
-    root = json_load_file(path, 0, &error);
-    free(path);
-
-    if (!root || !json_is_object(root)) {
-        goto error;
-    }
-
-    json_t *elm = json_object_get(root, oid);
-    if (!elm) {
-        goto error;
-    }
-
-    if (JsonLoadStr(elm, "$.d", res))
-        goto error;
-
-    char strext[300] = {0};
-    if (!JsonLoadStr(elm, "$.c", strext)) {
-        strcat(res, " (");
-        strcat(res, strext);
-        strcat(res, ")");
-    }
-
-    json_decref(root);
-    return res;
-
-error:
-    if (root)
-        json_decref(root);
-    return NULL;
-}
-
 static void asn1_tag_dump_object_id(const struct tlv *tlv, const struct asn1_tag *tag, int level) {
 
     mbedtls_asn1_buf asn1_buf;
@@ -287,7 +243,7 @@ static void asn1_tag_dump_object_id(const struct tlv *tlv, const struct asn1_tag
 
     PrintAndLogEx(INFO, "%*s %s" NOLF, (level * 4), " ", pstr);
 
-    char *jsondesc = asn1_oid_description(pstr, true);
+    const char *jsondesc = resource_oid_description(pstr);
     if (jsondesc) {
         PrintAndLogEx(NORMAL, " -  %s" NOLF, jsondesc);
     } else {
@@ -17,6 +17,7 @@
 #include "emv_tags.h"
 #include "fileutils.h"
 #include "pm3_cmd.h"
+#include "resources.h"
 
 static const ApplicationDataElm_t ApplicationData[] = {
     {0x82,    "AIP"},
@@ -299,22 +300,14 @@ int JsonLoadBufAsHex(json_t *elm, const char *path, uint8_t *data, size_t maxbuf
 }
 
 bool ParamLoadFromJson(struct tlvdb *tlv) {
-    json_t *root;
-    json_error_t error;
 
     if (!tlv) {
         PrintAndLogEx(ERR, "ERROR load params: tlv tree is NULL.");
         return false;
     }
 
-    char *path;
-    if (searchFile(&path, RESOURCES_SUBDIR, "emv_defparams", ".json", false) != PM3_SUCCESS) {
-        return false;
-    }
-    root = json_load_file(path, 0, &error);
-    free(path);
+    json_t *root = resource_json("emv_defparams", false);
     if (!root) {
-        PrintAndLogEx(ERR, "Load params: json error on line " _YELLOW_("%d") ": %s", error.line, error.text);
         return false;
     }
 
@@ -331,14 +324,12 @@ bool ParamLoadFromJson(struct tlvdb *tlv) {
         data = json_array_get(root, i);
         if (!json_is_object(data)) {
             PrintAndLogEx(ERR, "Load params: data [%d] is not an object", i + 1);
-            json_decref(root);
             return false;
         }
 
         jtag = json_object_get(data, "tag");
         if (!json_is_string(jtag)) {
             PrintAndLogEx(ERR, "Load params: data [%d] tag is not a string", i + 1);
-            json_decref(root);
             return false;
         }
         const char *tlvTag = json_string_value(jtag);
@@ -346,7 +337,6 @@ bool ParamLoadFromJson(struct tlvdb *tlv) {
         jvalue = json_object_get(data, "value");
         if (!json_is_string(jvalue)) {
             PrintAndLogEx(ERR, "Load params: data [%d] value is not a string", i + 1);
-            json_decref(root);
             return false;
         }
         const char *tlvValue = json_string_value(jvalue);
@@ -354,14 +344,12 @@ bool ParamLoadFromJson(struct tlvdb *tlv) {
         jlength = json_object_get(data, "length");
         if (!json_is_number(jlength)) {
             PrintAndLogEx(ERR, "Load params: data [%d] length is not a number", i + 1);
-            json_decref(root);
             return false;
         }
 
         int tlvLength = json_integer_value(jlength);
         if (tlvLength > 250) {
             PrintAndLogEx(ERR, "Load params: data [%d] length more than 250", i + 1);
-            json_decref(root);
             return false;
         }
 
@@ -370,7 +358,6 @@ bool ParamLoadFromJson(struct tlvdb *tlv) {
         size_t buflen = 0;
 
         if (!HexToBuffer("TLV Error type:", tlvTag, buf, 4, &buflen)) {
-            json_decref(root);
             return false;
         }
         tlv_tag_t tag = 0;
@@ -379,21 +366,17 @@ bool ParamLoadFromJson(struct tlvdb *tlv) {
         }
 
         if (!HexToBuffer("TLV Error value:", tlvValue, buf, sizeof(buf) - 1, &buflen)) {
-            json_decref(root);
             return false;
         }
 
         if (buflen != tlvLength) {
             PrintAndLogEx(ERR, "Load params: data [%d] length of HEX must(%zu) be identical to length in TLV param(%d)", i + 1, buflen, tlvLength);
-            json_decref(root);
             return false;
         }
 
         tlvdb_change_or_add_node(tlv, tag, tlvLength, (const unsigned char *)buf);
     }
 
-    json_decref(root);
-
     return true;
 }
 
@@ -17,13 +17,124 @@
 #include "cmddata.h" //for g_debugmode
 
 
-int g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
+// The samples live in a reference counted store. A graph saved with save_restoreGB() shares it
+// until the next write, g_GraphBuffer may start inside the store after a slice.
+typedef struct {
+    int *samples;
+    size_t cap;
+    uint32_t refs;
+    uint32_t gen;       // bumped every time the samples may change
+    uint8_t *u8;        // 8 bit view, see getGraphBufView()
+    size_t u8_cap;
+    size_t u8_off;
+    size_t u8_len;
+    uint32_t u8_gen;
+} graph_store_t;
+
+#define GRAPH_MIN_CAP   (40000 * 8)
+
+static graph_store_t *s_store = NULL;
+static size_t s_offset = 0;
+
+int *g_GraphBuffer = NULL;
 size_t g_GraphTraceLen;
 
+static graph_store_t *store_new(size_t cap) {
+    graph_store_t *st = calloc(1, sizeof(graph_store_t));
+    if (st == NULL)
+        return NULL;
+
+    st->samples = calloc(cap, sizeof(int));
+    if (st->samples == NULL) {
+        free(st);
+        return NULL;
+    }
+    st->cap = cap;
+    st->refs = 1;
+    return st;
+}
+
+static void store_put(graph_store_t *st) {
+    if (st == NULL || --st->refs)
+        return;
+    free(st->samples);
+    free(st->u8);
+    free(st);
+}
+
+// room for len samples at g_GraphBuffer, not shared with a saved graph.
+// The samples up to g_GraphTraceLen are kept, g_GraphBuffer may move.
+bool graphReserve(size_t len) {
+
+    if (s_store && s_store->refs == 1 && s_offset + len <= s_store->cap) {
+        s_store->gen++;
+        return true;
+    }
+
+    size_t keep = MIN(g_GraphTraceLen, len);
+
+    if (s_store && s_store->refs == 1) {
+        if (s_offset) {
+            memmove(s_store->samples, s_store->samples + s_offset, keep * sizeof(int));
+            s_offset = 0;
+        }
+        if (len > s_store->cap) {
+            size_t cap = MAX(len, s_store->cap * 2);
+            int *tmp = realloc(s_store->samples, cap * sizeof(int));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory for %zu samples", len);
+                g_GraphBuffer = s_store->samples;
+                return false;
+            }
+            s_store->samples = tmp;
+            s_store->cap = cap;
+        }
+        s_store->gen++;
+        g_GraphBuffer = s_store->samples;
+        return true;
+    }
+
+    // first use, or the store is shared with a saved graph
+    graph_store_t *st = store_new(MAX(len, GRAPH_MIN_CAP));
+    if (st == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory for %zu samples", len);
+        return false;
+    }
+    if (keep)
+        memcpy(st->samples, g_GraphBuffer, keep * sizeof(int));
+
+    store_put(s_store);
+    s_store = st;
+    s_offset = 0;
+    g_GraphBuffer = st->samples;
+    return true;
+}
+
+// call before changing samples in place
+bool graphWritable(void) {
+    return graphReserve(g_GraphTraceLen);
+}
+
+// narrows the graph to [start, start + len) without copying
+void graphSlice(size_t start, size_t len) {
+    if (start > g_GraphTraceLen)
+        start = g_GraphTraceLen;
+    if (len > g_GraphTraceLen - start)
+        len = g_GraphTraceLen - start;
+
+    if (s_store) {
+        s_offset += start;
+        g_GraphBuffer = s_store->samples + s_offset;
+    }
+    g_GraphTraceLen = len;
+}
+
 /* write a manchester bit to the graph
-TODO,  verfy that this doesn't overflow buffer  (iceman)
 */
 void AppendGraph(bool redraw, uint16_t clock, int bit) {
+    if (graphReserve(g_GraphTraceLen + clock) == false)
+        return;
+
     uint8_t half = clock / 2;
     uint8_t i;
     //set first half the clock bit (all 1's or 0's for a 0 or 1 bit)
@@ -41,7 +152,17 @@ void AppendGraph(bool redraw, uint16_t clock, int bit) {
 // clear out our graph window
 size_t ClearGraph(bool redraw) {
     size_t gtl = g_GraphTraceLen;
-    memset(g_GraphBuffer, 0x00, g_GraphTraceLen);
+
+    // a saved graph keeps the samples, otherwise the store is reused
+    if (s_store && s_store->refs > 1) {
+        store_put(s_store);
+        s_store = NULL;
+        g_GraphBuffer = NULL;
+    } else if (s_store) {
+        s_store->gen++;
+        g_GraphBuffer = s_store->samples;
+    }
+    s_offset = 0;
     g_GraphTraceLen = 0;
     g_GraphStart = 0;
     g_GraphStop = 0;
@@ -52,33 +173,44 @@ size_t ClearGraph(bool redraw) {
 
     return gtl;
 }
-// option '1' to save g_GraphBuffer any other to restore
+
+// option '1' to save g_GraphBuffer any other to restore.
+// Saving takes a reference to the samples, they are copied only when the graph is written next.
 void save_restoreGB(uint8_t saveOpt) {
-    static int SavedGB[MAX_GRAPH_TRACE_LEN];
+    static graph_store_t *saved = NULL;
+    static size_t saved_offset = 0;
     static size_t SavedGBlen = 0;
-    static bool GB_Saved = false;
     static int Savedg_GridOffsetAdj = 0;
 
     if (saveOpt == GRAPH_SAVE) { //save
-        memcpy(SavedGB, g_GraphBuffer, sizeof(g_GraphBuffer));
+        store_put(saved);
+        saved = s_store;
+        if (saved)
+            saved->refs++;
+        saved_offset = s_offset;
         SavedGBlen = g_GraphTraceLen;
-        GB_Saved = true;
         Savedg_GridOffsetAdj = g_GridOffset;
-    } else if (GB_Saved) { //restore
-        memcpy(g_GraphBuffer, SavedGB, sizeof(g_GraphBuffer));
+    } else if (saved) { //restore
+        if (saved != s_store) {
+            saved->refs++;
+            store_put(s_store);
+            s_store = saved;
+        }
+        s_offset = saved_offset;
+        g_GraphBuffer = s_store->samples + s_offset;
         g_GraphTraceLen = SavedGBlen;
         g_GridOffset = Savedg_GridOffsetAdj;
         RepaintGraphWindow();
     }
 }
 
-void setGraphBuf(uint8_t *buff, size_t size) {
+void setGraphBuf(const uint8_t *buff, size_t size) {
     if (buff == NULL) return;
 
     ClearGraph(false);
 
-    if (size > MAX_GRAPH_TRACE_LEN)
-        size = MAX_GRAPH_TRACE_LEN;
+    if (graphReserve(size) == false)
+        return;
 
     for (size_t i = 0; i < size; ++i)
         g_GraphBuffer[i] = buff[i] - 128;
@@ -87,18 +219,61 @@ void setGraphBuf(uint8_t *buff, size_t size) {
     RepaintGraphWindow();
 }
 
-size_t getFromGraphBuf(uint8_t *buff) {
-    if (buff == NULL) return 0;
-    if (g_GraphTraceLen == 0) return 0;
+// 8 bit view of the graph samples, clamped to -127..127 and offset by 128.
+// It is built once per change of the graph and stays valid until the graph is written,
+// callers must not change it. Use getGraphBufCopy() for a buffer to work in.
+uint8_t *getGraphBufView(size_t *size) {
+    *size = 0;
+    if (g_GraphTraceLen == 0 || s_store == NULL)
+        return NULL;
+
+    graph_store_t *st = s_store;
+    if (st->u8 && st->u8_gen == st->gen && st->u8_off == s_offset && st->u8_len == g_GraphTraceLen) {
+        *size = st->u8_len;
+        return st->u8;
+    }
 
-    size_t i;
-    for (i = 0; i < g_GraphTraceLen; ++i) {
-        //trim
-        if (g_GraphBuffer[i] > 127) g_GraphBuffer[i] = 127;
-        if (g_GraphBuffer[i] < -127) g_GraphBuffer[i] = -127;
-        buff[i] = (uint8_t)(g_GraphBuffer[i] + 128);
+    if (g_GraphTraceLen > st->u8_cap) {
+        uint8_t *tmp = realloc(st->u8, g_GraphTraceLen);
+        if (tmp == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return NULL;
+        }
+        st->u8 = tmp;
+        st->u8_cap = g_GraphTraceLen;
     }
-    return i;
+
+    // locals so the compiler knows the buffers don't overlap and vectorises the clamp
+    const int *src = g_GraphBuffer;
+    uint8_t *dst = st->u8;
+    size_t len = g_GraphTraceLen;
+    for (size_t i = 0; i < len; ++i) {
+        int v = src[i];
+        v = (v > 127) ? 127 : v;
+        v = (v < -127) ? -127 : v;
+        dst[i] = (uint8_t)(v + 128);
+    }
+    st->u8_gen = st->gen;
+    st->u8_off = s_offset;
+    st->u8_len = g_GraphTraceLen;
+    *size = st->u8_len;
+    return st->u8;
+}
+
+// a copy of the 8 bit view the caller owns, for demodulators which work in place
+uint8_t *getGraphBufCopy(size_t *size) {
+    uint8_t *view = getGraphBufView(size);
+    if (view == NULL)
+        return NULL;
+
+    uint8_t *bits = malloc(*size);
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        *size = 0;
+        return NULL;
+    }
+    memcpy(bits, view, *size);
+    return bits;
 }
 
 // A simple test to see if there is any data inside Graphbuffer.
@@ -125,6 +300,7 @@ void convertGraphFromBitstream(void) {
 }
 
 void convertGraphFromBitstreamEx(int hi, int low) {
+    graphWritable();
     for (int i = 0; i < g_GraphTraceLen; i++) {
         if (g_GraphBuffer[i] == hi)
             g_GraphBuffer[i] = 127;
@@ -134,22 +310,15 @@ void convertGraphFromBitstreamEx(int hi, int low) {
             g_GraphBuffer[i] = 0;
     }
 
-    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     if (bits == NULL) {
-        PrintAndLogEx(DEBUG, "ERR: convertGraphFromBitstreamEx, failed to allocate memory");
-        return;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return;
     }
 
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
-    free(bits);
     RepaintGraphWindow();
 }
 
@@ -164,16 +333,10 @@ int GetAskClock(const char *str, bool verbose) {
 
     // Auto-detect clock
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufCopy(&size);
     if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
@@ -199,21 +362,14 @@ int GetPskCarrier(bool verbose) {
     if (getSignalProperties()->isnoise)
         return -1;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
     uint16_t fc = countFC(bits, size, false);
-    free(bits);
 
     uint8_t carrier = fc & 0xFF;
     if (carrier != 2 && carrier != 4 && carrier != 8) return 0;
@@ -235,16 +391,10 @@ int GetPskClock(const char *str, bool verbose) {
         return clock1;
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
@@ -259,7 +409,6 @@ int GetPskClock(const char *str, bool verbose) {
     if (verbose)
         PrintAndLogEx(SUCCESS, "Auto-detected clock rate: %d", clock1);
 
-    free(bits);
     return clock1;
 }
 
@@ -273,16 +422,10 @@ int GetNrzClock(const char *str, bool verbose) {
         return clock1;
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return -1;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return -1;
     }
 
@@ -293,7 +436,6 @@ int GetNrzClock(const char *str, bool verbose) {
     if (verbose)
         PrintAndLogEx(SUCCESS, "Auto-detected clock rate: %d", clock1);
 
-    free(bits);
     return clock1;
 }
 
@@ -329,23 +471,16 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge) {
     if (getSignalProperties()->isnoise)
         return false;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    size_t size = 0;
+    uint8_t *bits = getGraphBufView(&size);
     if (bits == NULL) {
-        PrintAndLogEx(WARNING, "Failed to allocate memory");
-        return false;
-    }
-
-    size_t size = getFromGraphBuf(bits);
-    if (size == 0) {
         PrintAndLogEx(WARNING, "Failed to copy from graphbuffer");
-        free(bits);
         return false;
     }
 
     uint16_t ans = countFC(bits, size, true);
     if (ans == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: No data found");
-        free(bits);
         return false;
     }
 
@@ -353,8 +488,6 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge) {
     *fc2 = ans & 0xFF;
     *rf1 = detectFSKClk(bits, size, *fc1, *fc2, firstClockEdge);
 
-    free(bits);
-
     if (*rf1 == 0) {
         PrintAndLogEx(DEBUG, "DEBUG: Clock detect error");
         return false;
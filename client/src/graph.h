@@ -20,9 +20,13 @@ extern "C" {
 void AppendGraph(bool redraw, uint16_t clock, int bit);
 size_t ClearGraph(bool redraw);
 bool HasGraphData(void);
-void setGraphBuf(uint8_t *buff, size_t size);
+void setGraphBuf(const uint8_t *buff, size_t size);
 void save_restoreGB(uint8_t saveOpt);
-size_t getFromGraphBuf(uint8_t *buff);
+bool graphReserve(size_t len);
+bool graphWritable(void);
+void graphSlice(size_t start, size_t len);
+uint8_t *getGraphBufView(size_t *size);
+uint8_t *getGraphBufCopy(size_t *size);
 void convertGraphFromBitstream(void);
 void convertGraphFromBitstreamEx(int hi, int low);
 bool isGraphBitstream(void);
@@ -34,11 +38,14 @@ int GetNrzClock(const char *str, bool verbose);
 int GetFskClock(const char *str, bool verbose);
 bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge);
 
-#define MAX_GRAPH_TRACE_LEN (40000 * 8)
 #define GRAPH_SAVE 1
 #define GRAPH_RESTORE 0
 
-extern int g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
+// The graph samples grow as needed and are shared by reference with a saved graph (save_restoreGB).
+// Call graphReserve() before writing past g_GraphTraceLen and graphWritable() before changing
+// samples in place, both may move g_GraphBuffer.  getGraphBufView() is a read only 8 bit view,
+// valid until the graph changes.
+extern int *g_GraphBuffer;
 extern size_t g_GraphTraceLen;
 
 #ifdef __cplusplus
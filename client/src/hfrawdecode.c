@@ -0,0 +1,510 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Offline decoding of raw HF sniff captures into trace records.
+//
+// The capture holds the samples the FPGA sniffer delivers to the ARM, so the
+// firmware decoders in common/iso14443a_decode.c, iso15693_decode.c and
+// iso14443b_decode.c are run on it, and the loops mirror the Sniff*() main
+// loops. Each segment of a capture gets its own decoder state, which makes
+// it decodable on its own.
+//
+// A capture is cut in the middle of long idle gaps (field on, nothing sent).
+// The decoders of both neighbours are back in their idle state there, so the
+// segments decode to the same records as one sequential pass would.
+//-----------------------------------------------------------------------------
+
+#include "hfrawdecode.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pm3_cmd.h"           // tracelog_hdr_t, HF_SNIFF_RAW_*
+#include "util.h"              // num_CPUs
+#include "ui.h"
+#include "iso14443a_decode.h"
+#include "iso14443b_decode.h"
+#include "iso15693_decode.h"
+
+// idle samples needed to cut a capture, the cut goes in the middle
+#define HFRAW_MIN_GAP          2048
+// don't bother splitting below this many samples per segment
+#define HFRAW_MIN_SEGMENT      (256 * 1024)
+
+#define HFRAW_MAX_FRAME        256
+
+// trace records of one segment
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t max;
+    uint32_t reader_frames;
+    uint32_t tag_frames;
+    bool oom;
+} hfraw_trace_t;
+
+static void trace_add(hfraw_trace_t *t, const uint8_t *data, uint16_t len, uint32_t start, uint32_t end, const uint8_t *parity, bool reader) {
+    if (len == 0 || t->oom)
+        return;
+
+    uint32_t num_paritybytes = (len - 1) / 8 + 1;
+    size_t need = TRACELOG_HDR_LEN + len + num_paritybytes;
+
+    if (t->len + need > t->max) {
+        size_t max = MAX(t->max * 2, 4096);
+        uint8_t *buf = realloc(t->buf, max);
+        if (buf == NULL) {
+            t->oom = true;
+            return;
+        }
+        t->buf = buf;
+        t->max = max;
+    }
+
+    // same rules as LogTrace() on the device
+    uint32_t duration = end - start;
+    if (duration > 0xFFFF)
+        duration = 0;
+
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(t->buf + t->len);
+    hdr->timestamp = start;
+    hdr->duration = duration;
+    hdr->data_len = len;
+    hdr->isResponse = !reader;
+    memcpy(hdr->frame, data, len);
+    if (parity)
+        memcpy(hdr->frame + len, parity, num_paritybytes);
+    else
+        memset(hdr->frame + len, 0, num_paritybytes);
+    t->len += need;
+
+    if (reader)
+        t->reader_frames++;
+    else
+        t->tag_frames++;
+}
+
+//=============================================================================
+// ISO14443-A, Miller decoder for the reader, Manchester decoder for the tag
+//=============================================================================
+typedef struct {
+    tUart14a uart;
+    tDemod14a demod;
+    uint8_t cmd[ISO14A_MAX_FRAME_SIZE];
+    uint8_t cmd_par[(ISO14A_MAX_FRAME_SIZE + 7) / 8];
+    uint8_t resp[ISO14A_MAX_FRAME_SIZE];
+    uint8_t resp_par[(ISO14A_MAX_FRAME_SIZE + 7) / 8];
+} hfraw_14a_t;
+
+// SniffIso14443a(), timestamps are 16 carrier cycles per tick, 4 ticks per sample
+static void decode_14a(const uint8_t *raw, size_t first, size_t last, hfraw_trace_t *t) {
+
+    hfraw_14a_t *s = calloc(1, sizeof(hfraw_14a_t));
+    if (s == NULL) {
+        t->oom = true;
+        return;
+    }
+    tUart14a *uart = &s->uart;
+    tDemod14a *demod = &s->demod;
+    Uart14aStateInit(uart, s->cmd, s->cmd_par);
+    Demod14aStateInit(demod, s->resp, s->resp_par);
+
+    uint8_t previous_data = 0xF0;
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+
+    for (size_t i = first; i < last; i++) {
+
+        uint8_t data = raw[i];
+
+        // need two samples to feed the Miller and Manchester decoders
+        if (i & 0x01) {
+
+            if (tag_is_active == false) {
+                uint8_t readerdata = (previous_data & 0xF0) | (data >> 4);
+                if (Miller14aDecode(uart, readerdata, (i - 1) * 4)) {
+                    trace_add(t, uart->output, uart->len, uart->startTime * 16, uart->endTime * 16, uart->parity, true);
+                    Uart14aStateReset(uart);
+                    Demod14aStateReset(demod);
+                }
+                reader_is_active = (uart->state != STATE_14A_UNSYNCD);
+            }
+
+            if (reader_is_active == false) {
+                uint8_t tagdata = (previous_data << 4) | (data & 0x0F);
+                if (Manchester14aDecode(demod, tagdata, 0, (i - 1) * 4)) {
+                    trace_add(t, demod->output, demod->len, demod->startTime * 16, demod->endTime * 16, demod->parity, false);
+                    Demod14aStateReset(demod);
+                    Uart14aStateReset(uart);
+                }
+                tag_is_active = (demod->state != DEMOD_14A_UNSYNCD);
+            }
+        }
+        previous_data = data;
+    }
+    free(s);
+}
+
+//=============================================================================
+// ISO15693, 1 out of 4 / 1 out of 256 from the reader, single subcarrier from the tag
+//=============================================================================
+typedef struct {
+    DecodeTag_t dtag;
+    DecodeReader_t dreader;
+    // the decoders store one byte past max_len before they give up
+    uint8_t response[HFRAW_MAX_FRAME + 1];
+    uint8_t cmd[HFRAW_MAX_FRAME + 1];
+} hfraw_15_t;
+
+// SniffIso15693(), one word every 64 carrier cycles
+static void decode_15(const uint8_t *raw, size_t first, size_t last, hfraw_trace_t *t) {
+
+    hfraw_15_t *s = calloc(1, sizeof(hfraw_15_t));
+    if (s == NULL) {
+        t->oom = true;
+        return;
+    }
+    DecodeTag_t *dtag = &s->dtag;
+    DecodeReader_t *dreader = &s->dreader;
+    DecodeTagInit(dtag, s->response, HFRAW_MAX_FRAME);
+    DecodeReaderInit(dreader, s->cmd, HFRAW_MAX_FRAME, 0, NULL);
+
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+    bool expect_tag_answer = true;
+
+    for (size_t i = first; i < last; i++) {
+
+        uint16_t sniffdata = raw[2 * i] | (raw[2 * i + 1] << 8);
+        uint32_t samples = i + 1;
+
+        if (tag_is_active == false) {
+
+            uint32_t eof_time = 0;
+            if (Handle15693SampleFromReader((sniffdata & 0x02) >> 1, dreader)) {
+                eof_time = (samples * 16) + 8;
+            } else if (Handle15693SampleFromReader(sniffdata & 0x01, dreader)) {
+                eof_time = (samples * 16) + 16;
+            }
+
+            if (eof_time) {
+                uint32_t sof_time = eof_time
+                                    - dreader->byteCount * (dreader->Coding == CODING_1_OUT_OF_4 ? 128 * 16 : 2048 * 16)
+                                    - 32 * 16
+                                    - 16 * 16;
+                trace_add(t, dreader->output, MIN(dreader->byteCount, HFRAW_MAX_FRAME), sof_time * 4, eof_time * 4, NULL, true);
+                DecodeReaderReset(dreader);
+                DecodeTagReset(dtag);
+                reader_is_active = false;
+                expect_tag_answer = true;
+            } else {
+                reader_is_active = (dreader->state >= STATE_READER_RECEIVE_DATA_1_OUT_OF_4);
+            }
+        }
+
+        if (reader_is_active == false && expect_tag_answer) {
+
+            if (Handle15693SamplesFromTag(sniffdata >> 2, dtag)) {
+
+                uint32_t eof_time = samples * 16;
+                if (dtag->lastBit == SOF_PART2)
+                    eof_time -= (8 * 16);               // 8 more samples were needed to confirm a single SOF
+                uint32_t sof_time = eof_time
+                                    - dtag->len * 8 * 8 * 16
+                                    - (32 * 16)
+                                    - (dtag->lastBit != SOF_PART2 ? (32 * 16) : 0);
+
+                trace_add(t, dtag->output, MIN(dtag->len, HFRAW_MAX_FRAME), sof_time * 4, eof_time * 4, NULL, false);
+                DecodeTagReset(dtag);
+                DecodeReaderReset(dreader);
+                expect_tag_answer = false;
+                tag_is_active = false;
+            } else {
+                tag_is_active = (dtag->state >= STATE_TAG_RECEIVING_DATA);
+            }
+        }
+    }
+    free(s);
+}
+
+//=============================================================================
+// ISO14443-B, NRZ-L from the reader, BPSK from the tag
+//=============================================================================
+typedef struct {
+    tUart14b uart;
+    tDemod14b demod;
+    uint8_t ua_buf[HFRAW_MAX_FRAME];
+    uint8_t dm_buf[HFRAW_MAX_FRAME];
+} hfraw_14b_t;
+
+// SniffIso14443b(), one word every 64 carrier cycles. Unlike the device the frame start
+// is computed from the 14b framing, 10 etu per character, 12 etu SOF and 10 etu EOF
+#define ETU14B_TICKS   32
+
+static void decode_14b(const uint8_t *raw, size_t first, size_t last, hfraw_trace_t *t) {
+
+    hfraw_14b_t *s = calloc(1, sizeof(hfraw_14b_t));
+    if (s == NULL) {
+        t->oom = true;
+        return;
+    }
+    tUart14b *uart = &s->uart;
+    tDemod14b *demod = &s->demod;
+    Uart14bStateInit(uart, s->ua_buf);
+    Demod14bStateInit(demod, s->dm_buf, sizeof(s->dm_buf));
+
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+    bool expect_tag_answer = true;
+
+    for (size_t i = first; i < last; i++) {
+
+        int8_t ci = (int8_t)raw[2 * i + 1];
+        int8_t cq = (int8_t)raw[2 * i];
+        uint32_t samples = i + 1;
+
+        if (tag_is_active == false) {
+
+            for (int half = 0; half < 2; half++) {
+                if (Handle14443bSampleFromReader(uart, (half ? cq : ci) & 0x01)) {
+                    uint32_t eof_time = (samples * 16) + (half ? 16 : 8);
+                    uint32_t sof_time = eof_time
+                                        - uart->byteCnt * ETU14B_TICKS * 10
+                                        - ETU14B_TICKS * 12
+                                        - ETU14B_TICKS * 10;
+                    trace_add(t, uart->output, uart->byteCnt, sof_time * 4, eof_time * 4, NULL, true);
+                    Uart14bStateReset(uart);
+                    Demod14bStateReset(demod);
+                    expect_tag_answer = true;
+                }
+            }
+            reader_is_active = (uart->state > STATE_14B_GOT_FALLING_EDGE_OF_SOF);
+        }
+
+        if (reader_is_active == false && expect_tag_answer) {
+
+            if (Handle14443bSamplesFromTag(demod, (ci >> 1), (cq >> 1))) {
+                uint32_t eof_time = samples * 16;
+                uint32_t sof_time = eof_time
+                                    - demod->len * ETU14B_TICKS * 10
+                                    - ETU14B_TICKS * 12
+                                    - ETU14B_TICKS * 10;
+                trace_add(t, demod->output, demod->len, sof_time * 4, eof_time * 4, NULL, false);
+                Uart14bStateReset(uart);
+                Demod14bStateReset(demod);
+                expect_tag_answer = false;
+                tag_is_active = false;
+            } else {
+                tag_is_active = (demod->state > WAIT_FOR_RISING_EDGE_OF_SOF);
+            }
+        }
+    }
+    free(s);
+}
+
+//=============================================================================
+// Segments and worker threads
+//=============================================================================
+size_t hfraw_sample_size(uint8_t proto) {
+    switch (proto) {
+        case HF_SNIFF_RAW_14A:
+            return 1;
+        case HF_SNIFF_RAW_14B:
+        case HF_SNIFF_RAW_15:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+void hfraw_idle_sample(uint8_t proto, uint8_t *sample) {
+    switch (proto) {
+        case HF_SNIFF_RAW_14A:
+            // reader carrier in all 4 ticks, no load modulation
+            sample[0] = 0xF0;
+            break;
+        case HF_SNIFF_RAW_14B:
+            // both reader samples high in I and Q,  no subcarrier
+            sample[0] = 0x01;
+            sample[1] = 0x01;
+            break;
+        case HF_SNIFF_RAW_15:
+            // both reader samples high, no subcarrier amplitude
+            sample[0] = 0x03;
+            sample[1] = 0x00;
+            break;
+        default:
+            break;
+    }
+}
+
+// field on and neither side sending
+static bool is_idle(uint8_t proto, const uint8_t *raw, size_t i) {
+    switch (proto) {
+        case HF_SNIFF_RAW_14A:
+            return raw[i] == 0xF0;
+        case HF_SNIFF_RAW_15: {
+            uint16_t w = raw[2 * i] | (raw[2 * i + 1] << 8);
+            return ((w & 0x03) == 0x03) && ((w >> 2) < NOISE_THRESHOLD);
+        }
+        case HF_SNIFF_RAW_14B: {
+            int8_t ci = (int8_t)raw[2 * i + 1];
+            int8_t cq = (int8_t)raw[2 * i];
+            return (ci & 0x01) && (cq & 0x01) && (AMPLITUDE(ci >> 1, cq >> 1) <= SUBCARRIER_DETECT_THRESHOLD);
+        }
+        default:
+            return false;
+    }
+}
+
+typedef struct {
+    size_t first;
+    size_t last;
+    hfraw_trace_t out;
+} hfraw_segment_t;
+
+typedef struct {
+    uint8_t proto;
+    const uint8_t *raw;
+    hfraw_segment_t *segments;
+    uint32_t count;
+    uint32_t next;
+} hfraw_job_t;
+
+static void *hfraw_worker(void *arg) {
+    hfraw_job_t *job = (hfraw_job_t *)arg;
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+        if (i >= job->count)
+            break;
+
+        hfraw_segment_t *s = &job->segments[i];
+        switch (job->proto) {
+            case HF_SNIFF_RAW_14A:
+                decode_14a(job->raw, s->first, s->last, &s->out);
+                break;
+            case HF_SNIFF_RAW_15:
+                decode_15(job->raw, s->first, s->last, &s->out);
+                break;
+            case HF_SNIFF_RAW_14B:
+                decode_14b(job->raw, s->first, s->last, &s->out);
+                break;
+        }
+    }
+    return NULL;
+}
+
+// cuts the capture in the middle of idle gaps, segments end up at least target samples long
+static uint32_t hfraw_split(uint8_t proto, const uint8_t *raw, size_t samples, size_t target, hfraw_segment_t *segments, uint32_t max) {
+    uint32_t count = 0;
+    size_t first = 0, run = 0;
+
+    for (size_t i = 0; i < samples && count + 1 < max; i++) {
+        run = is_idle(proto, raw, i) ? run + 1 : 0;
+
+        // cut at an even sample, 14a decodes sample pairs
+        if (run == HFRAW_MIN_GAP && (i - first) >= target) {
+            size_t cut = (i + 1 - HFRAW_MIN_GAP / 2) & ~(size_t)1;
+            segments[count].first = first;
+            segments[count].last = cut;
+            count++;
+            first = cut;
+            run = 0;
+        }
+    }
+    segments[count].first = first;
+    segments[count].last = samples;
+    return count + 1;
+}
+
+int hfraw_decode(uint8_t proto, const uint8_t *raw, size_t len, uint32_t threads, uint8_t **trace, uint32_t *tracelen, hfraw_stats_t *stats) {
+
+    *trace = NULL;
+    *tracelen = 0;
+    memset(stats, 0, sizeof(hfraw_stats_t));
+
+    size_t ssize = hfraw_sample_size(proto);
+    if (ssize == 0)
+        return PM3_EINVARG;
+
+    size_t samples = len / ssize;
+    if (samples == 0)
+        return PM3_EINVARG;
+
+    // trace timestamps are 32 bit carrier cycles, 64 per sample
+    if (samples > (UINT32_MAX / 64)) {
+        PrintAndLogEx(WARNING, "capture longer than the 32 bit trace timestamps, decoding the first %u samples", UINT32_MAX / 64);
+        samples = UINT32_MAX / 64;
+    }
+
+    if (threads == 0)
+        threads = num_CPUs();
+    threads = MAX(1, MIN(threads, 64));
+
+    // a few segments per thread even out the work, segments with many frames take longer
+    size_t target = MAX(samples / (threads * 4), HFRAW_MIN_SEGMENT);
+    uint32_t max = (threads == 1) ? 1 : (samples / target) + 1;
+
+    hfraw_segment_t *segments = calloc(max, sizeof(hfraw_segment_t));
+    if (segments == NULL)
+        return PM3_EMALLOC;
+
+    hfraw_job_t job = {
+        .proto = proto,
+        .raw = raw,
+        .segments = segments,
+        .count = hfraw_split(proto, raw, samples, target, segments, max),
+        .next = 0,
+    };
+
+    threads = MIN(threads, job.count);
+    pthread_t thread_ids[threads];
+    bool started[threads];
+    for (uint32_t i = 1; i < threads; i++)
+        started[i] = (pthread_create(&thread_ids[i], NULL, hfraw_worker, &job) == 0);
+
+    hfraw_worker(&job);
+
+    for (uint32_t i = 1; i < threads; i++) {
+        if (started[i])
+            pthread_join(thread_ids[i], NULL);
+    }
+
+    // concatenate the segments in capture order
+    int res = PM3_SUCCESS;
+    size_t total = 0;
+    for (uint32_t i = 0; i < job.count; i++) {
+        if (segments[i].out.oom)
+            res = PM3_EMALLOC;
+        total += segments[i].out.len;
+        stats->reader_frames += segments[i].out.reader_frames;
+        stats->tag_frames += segments[i].out.tag_frames;
+    }
+
+    if (res == PM3_SUCCESS && total > UINT32_MAX)
+        res = PM3_EOVFLOW;
+
+    if (res == PM3_SUCCESS && total) {
+        *trace = malloc(total);
+        if (*trace == NULL) {
+            res = PM3_EMALLOC;
+        } else {
+            for (uint32_t i = 0; i < job.count; i++) {
+                if (segments[i].out.len)
+                    memcpy(*trace + *tracelen, segments[i].out.buf, segments[i].out.len);
+                *tracelen += segments[i].out.len;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < job.count; i++)
+        free(segments[i].out.buf);
+    free(segments);
+
+    stats->samples = samples;
+    stats->segments = job.count;
+    stats->threads = threads;
+    return res;
+}
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Offline decoding of raw HF sniff captures into trace records
+//-----------------------------------------------------------------------------
+
+#ifndef HFRAWDECODE_H__
+#define HFRAWDECODE_H__
+
+#include "common.h"
+
+typedef struct {
+    uint64_t samples;
+    uint32_t segments;
+    uint32_t threads;
+    uint32_t reader_frames;
+    uint32_t tag_frames;
+} hfraw_stats_t;
+
+// bytes per sample of a raw capture,  0 for an unknown protocol
+size_t hfraw_sample_size(uint8_t proto);
+
+// the sample a capture holds while the reader field is on and nothing is sent
+void hfraw_idle_sample(uint8_t proto, uint8_t *sample);
+
+/**
+ * Decodes a raw capture of `hf sniff --14a|--14b|--15` into trace records.
+ * proto   - HF_SNIFF_RAW_14A, HF_SNIFF_RAW_14B or HF_SNIFF_RAW_15
+ * raw     - the capture, 14a one byte per sample, 14b and 15693 one little endian word
+ * threads - number of worker threads, 0 uses one per CPU
+ * trace   - output, malloc'ed trace buffer in the format of `trace load`
+ * The capture is split into segments at idle gaps which are decoded in parallel,
+ * the records are returned in capture order with timestamps in carrier cycles
+ * from the start of the capture.
+ */
+int hfraw_decode(uint8_t proto, const uint8_t *raw, size_t len, uint32_t threads, uint8_t **trace, uint32_t *tracelen, hfraw_stats_t *stats);
+
+#endif
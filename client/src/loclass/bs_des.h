@@ -0,0 +1,50 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced DES, many keys against one plaintext block per call
+//-----------------------------------------------------------------------------
+
+#ifndef BS_DES_H__
+#define BS_DES_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// largest lane count of any kernel,  size your key/output buffers with this
+#define BS_DES_MAX_LANES 256
+
+typedef enum {
+    BS_DES_AUTO = 0,
+    BS_DES_SCALAR,
+    BS_DES_NEON,
+    BS_DES_AVX2,
+} bs_des_kernel_t;
+
+/**
+ * @brief Select the kernel used by bs_des_encrypt.
+ * BS_DES_AUTO picks the widest kernel supported by the running cpu.
+ * @return false if the requested kernel isn't available in this build / cpu
+ */
+bool bs_des_select(bs_des_kernel_t kernel);
+bs_des_kernel_t bs_des_selected(void);
+const char *bs_des_kernel_name(bs_des_kernel_t kernel);
+
+/**
+ * @brief number of keys the selected kernel processes per call
+ */
+size_t bs_des_lanes(void);
+
+/**
+ * @brief DES encrypt one block with up to bs_des_lanes() keys.
+ * Keys, plaintext and output are 64bit big endian numbers, keys in standard (NIST) format.
+ * @param keys  n keys
+ * @param n     number of keys, unused lanes are padded
+ * @param plain plaintext block shared by all keys
+ * @param out   n ciphertext blocks
+ */
+void bs_des_encrypt(const uint64_t *keys, size_t n, uint64_t plain, uint64_t *out);
+
+#endif
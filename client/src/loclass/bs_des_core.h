@@ -0,0 +1,278 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced DES kernel, to be included by bs_des.c once per lane width.
+//
+// The including file defines
+//   BS_WORDS   number of 64bit words per bitslice (1 = 64 lanes, 4 = 256 lanes)
+//   BS_FN(x)   name mangling for this instance, ie  x##_avx2
+//   BS_TARGET  function attributes for this instance, ie  target("avx2")
+//
+// Every lane holds its own key, all lanes encrypt the same plaintext.
+// The key schedule is a fixed bit selection, so it is folded into the
+// bs_des_ks table and costs nothing at runtime.
+// S-boxes are evaluated as 16 minterms of the four column bits, selected
+// by the four row minterms. DES rows are permutations, so every output
+// bit is the OR of exactly eight column minterms per row.
+//-----------------------------------------------------------------------------
+
+typedef uint64_t BS_FN(vec) __attribute__((vector_size(BS_WORDS * 8)));
+#define bs_t BS_FN(vec)
+#define BS_INLINE BS_TARGET inline __attribute__((always_inline))
+
+// row minterms of (b0, b5) and column minterms of (b1 b2 b3 b4) of one S-box input
+static BS_INLINE void BS_FN(minterms)(const bs_t *b, bs_t *m, bs_t *r) {
+    r[0] = ~b[0] & ~b[5];
+    r[1] = ~b[0] &  b[5];
+    r[2] =  b[0] & ~b[5];
+    r[3] =  b[0] &  b[5];
+
+    bs_t hi[4], lo[4];
+    hi[0] = ~b[1] & ~b[2];
+    hi[1] = ~b[1] &  b[2];
+    hi[2] =  b[1] & ~b[2];
+    hi[3] =  b[1] &  b[2];
+    lo[0] = ~b[3] & ~b[4];
+    lo[1] = ~b[3] &  b[4];
+    lo[2] =  b[3] & ~b[4];
+    lo[3] =  b[3] &  b[4];
+    for (int c = 0; c < 16; c++) {
+        m[c] = hi[c >> 2] & lo[c & 3];
+    }
+}
+
+// S1
+static BS_INLINE void BS_FN(sbox1)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[0] | m[2] | m[5] | m[6] | m[7] | m[9] | m[11] | m[13]))
+         | (r[1] & (m[1] | m[4] | m[6] | m[8] | m[10] | m[11] | m[12] | m[15]))
+         | (r[2] & (m[2] | m[3] | m[4] | m[7] | m[8] | m[9] | m[10] | m[13]))
+         | (r[3] & (m[0] | m[1] | m[2] | m[5] | m[9] | m[11] | m[12] | m[15]));
+    o[1] = (r[0] & (m[0] | m[1] | m[2] | m[5] | m[10] | m[11] | m[12] | m[15]))
+         | (r[1] & (m[1] | m[2] | m[3] | m[4] | m[6] | m[9] | m[10] | m[13]))
+         | (r[2] & (m[0] | m[2] | m[4] | m[5] | m[8] | m[9] | m[11] | m[14]))
+         | (r[3] & (m[0] | m[1] | m[4] | m[7] | m[8] | m[11] | m[14] | m[15]));
+    o[2] = (r[0] & (m[0] | m[4] | m[5] | m[6] | m[8] | m[9] | m[10] | m[15]))
+         | (r[1] & (m[1] | m[2] | m[4] | m[5] | m[8] | m[9] | m[11] | m[14]))
+         | (r[2] & (m[2] | m[5] | m[6] | m[7] | m[8] | m[11] | m[12] | m[13]))
+         | (r[3] & (m[0] | m[3] | m[7] | m[9] | m[10] | m[11] | m[12] | m[14]));
+    o[3] = (r[0] & (m[2] | m[3] | m[5] | m[6] | m[8] | m[12] | m[13] | m[15]))
+         | (r[1] & (m[1] | m[2] | m[6] | m[7] | m[11] | m[12] | m[13] | m[14]))
+         | (r[2] & (m[1] | m[4] | m[7] | m[8] | m[10] | m[11] | m[12] | m[14]))
+         | (r[3] & (m[0] | m[5] | m[6] | m[7] | m[8] | m[9] | m[10] | m[15]));
+}
+
+// S2
+static BS_INLINE void BS_FN(sbox2)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[0] | m[2] | m[3] | m[5] | m[8] | m[11] | m[12] | m[15]))
+         | (r[1] & (m[1] | m[4] | m[6] | m[7] | m[8] | m[11] | m[13] | m[14]))
+         | (r[2] & (m[1] | m[3] | m[4] | m[6] | m[9] | m[10] | m[12] | m[15]))
+         | (r[3] & (m[0] | m[1] | m[2] | m[5] | m[8] | m[11] | m[14] | m[15]));
+    o[1] = (r[0] & (m[0] | m[3] | m[4] | m[7] | m[9] | m[11] | m[12] | m[14]))
+         | (r[1] & (m[1] | m[2] | m[3] | m[4] | m[7] | m[8] | m[12] | m[15]))
+         | (r[2] & (m[1] | m[2] | m[5] | m[6] | m[8] | m[10] | m[11] | m[15]))
+         | (r[3] & (m[0] | m[5] | m[6] | m[9] | m[10] | m[11] | m[13] | m[14]));
+    o[2] = (r[0] & (m[0] | m[3] | m[4] | m[5] | m[6] | m[9] | m[10] | m[15]))
+         | (r[1] & (m[0] | m[3] | m[4] | m[5] | m[7] | m[11] | m[12] | m[14]))
+         | (r[2] & (m[1] | m[2] | m[3] | m[4] | m[11] | m[13] | m[14] | m[15]))
+         | (r[3] & (m[2] | m[4] | m[5] | m[7] | m[8] | m[9] | m[10] | m[14]));
+    o[3] = (r[0] & (m[0] | m[1] | m[5] | m[6] | m[8] | m[9] | m[11] | m[14]))
+         | (r[1] & (m[0] | m[1] | m[3] | m[4] | m[10] | m[13] | m[14] | m[15]))
+         | (r[2] & (m[2] | m[3] | m[6] | m[7] | m[8] | m[12] | m[13] | m[15]))
+         | (r[3] & (m[0] | m[3] | m[4] | m[5] | m[8] | m[10] | m[13] | m[15]));
+}
+
+// S3
+static BS_INLINE void BS_FN(sbox3)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[0] | m[2] | m[3] | m[6] | m[9] | m[10] | m[12] | m[15]))
+         | (r[1] & (m[0] | m[3] | m[7] | m[9] | m[11] | m[12] | m[13] | m[14]))
+         | (r[2] & (m[0] | m[3] | m[4] | m[5] | m[8] | m[11] | m[13] | m[14]))
+         | (r[3] & (m[1] | m[2] | m[5] | m[6] | m[9] | m[10] | m[12] | m[15]));
+    o[1] = (r[0] & (m[3] | m[4] | m[6] | m[7] | m[9] | m[10] | m[11] | m[13]))
+         | (r[1] & (m[0] | m[1] | m[5] | m[6] | m[10] | m[11] | m[12] | m[14]))
+         | (r[2] & (m[0] | m[1] | m[2] | m[5] | m[11] | m[12] | m[14] | m[15]))
+         | (r[3] & (m[2] | m[4] | m[7] | m[8] | m[9] | m[10] | m[13] | m[15]));
+    o[2] = (r[0] & (m[0] | m[3] | m[4] | m[5] | m[6] | m[11] | m[12] | m[14]))
+         | (r[1] & (m[1] | m[4] | m[6] | m[7] | m[8] | m[11] | m[13] | m[14]))
+         | (r[2] & (m[1] | m[5] | m[6] | m[8] | m[10] | m[13] | m[14] | m[15]))
+         | (r[3] & (m[1] | m[4] | m[7] | m[9] | m[10] | m[11] | m[12] | m[14]));
+    o[3] = (r[0] & (m[2] | m[5] | m[6] | m[7] | m[8] | m[9] | m[11] | m[12]))
+         | (r[1] & (m[0] | m[1] | m[3] | m[4] | m[10] | m[13] | m[14] | m[15]))
+         | (r[2] & (m[0] | m[3] | m[5] | m[6] | m[8] | m[9] | m[12] | m[15]))
+         | (r[3] & (m[0] | m[2] | m[5] | m[7] | m[9] | m[11] | m[12] | m[13]));
+}
+
+// S4
+static BS_INLINE void BS_FN(sbox4)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[1] | m[2] | m[6] | m[7] | m[10] | m[12] | m[13] | m[15]))
+         | (r[1] & (m[0] | m[1] | m[2] | m[5] | m[11] | m[13] | m[14] | m[15]))
+         | (r[2] & (m[0] | m[2] | m[4] | m[5] | m[7] | m[8] | m[11] | m[14]))
+         | (r[3] & (m[1] | m[4] | m[6] | m[7] | m[8] | m[11] | m[12] | m[15]));
+    o[1] = (r[0] & (m[0] | m[1] | m[2] | m[5] | m[11] | m[13] | m[14] | m[15]))
+         | (r[1] & (m[0] | m[3] | m[4] | m[5] | m[8] | m[9] | m[11] | m[14]))
+         | (r[2] & (m[1] | m[4] | m[6] | m[7] | m[8] | m[11] | m[12] | m[15]))
+         | (r[3] & (m[1] | m[3] | m[6] | m[9] | m[10] | m[12] | m[13] | m[15]));
+    o[2] = (r[0] & (m[0] | m[2] | m[3] | m[5] | m[7] | m[9] | m[12] | m[15]))
+         | (r[1] & (m[2] | m[4] | m[5] | m[7] | m[9] | m[10] | m[13] | m[14]))
+         | (r[2] & (m[0] | m[1] | m[5] | m[6] | m[8] | m[10] | m[11] | m[13]))
+         | (r[3] & (m[0] | m[1] | m[3] | m[4] | m[11] | m[13] | m[14] | m[15]));
+    o[3] = (r[0] & (m[0] | m[1] | m[3] | m[6] | m[8] | m[11] | m[12] | m[15]))
+         | (r[1] & (m[0] | m[2] | m[3] | m[5] | m[7] | m[9] | m[12] | m[15]))
+         | (r[2] & (m[2] | m[5] | m[6] | m[7] | m[8] | m[9] | m[10] | m[12]))
+         | (r[3] & (m[0] | m[1] | m[5] | m[6] | m[8] | m[10] | m[11] | m[13]));
+}
+
+// S5
+static BS_INLINE void BS_FN(sbox5)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[1] | m[5] | m[6] | m[8] | m[11] | m[12] | m[14] | m[15]))
+         | (r[1] & (m[0] | m[1] | m[3] | m[6] | m[10] | m[11] | m[13] | m[14]))
+         | (r[2] & (m[3] | m[4] | m[5] | m[7] | m[8] | m[9] | m[10] | m[15]))
+         | (r[3] & (m[0] | m[1] | m[2] | m[5] | m[7] | m[9] | m[11] | m[12]));
+    o[1] = (r[0] & (m[1] | m[2] | m[4] | m[7] | m[9] | m[11] | m[12] | m[14]))
+         | (r[1] & (m[0] | m[3] | m[4] | m[5] | m[6] | m[8] | m[10] | m[15]))
+         | (r[2] & (m[0] | m[5] | m[6] | m[8] | m[10] | m[11] | m[12] | m[15]))
+         | (r[3] & (m[2] | m[3] | m[5] | m[7] | m[8] | m[9] | m[13] | m[14]));
+    o[2] = (r[0] & (m[0] | m[4] | m[5] | m[6] | m[7] | m[10] | m[11] | m[14]))
+         | (r[1] & (m[0] | m[1] | m[2] | m[5] | m[10] | m[11] | m[12] | m[15]))
+         | (r[2] & (m[1] | m[3] | m[4] | m[6] | m[8] | m[12] | m[13] | m[15]))
+         | (r[3] & (m[0] | m[3] | m[5] | m[6] | m[8] | m[9] | m[12] | m[15]));
+    o[3] = (r[0] & (m[3] | m[4] | m[6] | m[9] | m[10] | m[11] | m[12] | m[15]))
+         | (r[1] & (m[1] | m[5] | m[6] | m[7] | m[8] | m[10] | m[12] | m[13]))
+         | (r[2] & (m[2] | m[3] | m[5] | m[6] | m[8] | m[9] | m[11] | m[13]))
+         | (r[3] & (m[0] | m[3] | m[4] | m[7] | m[9] | m[11] | m[14] | m[15]));
+}
+
+// S6
+static BS_INLINE void BS_FN(sbox6)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[0] | m[2] | m[3] | m[4] | m[7] | m[9] | m[12] | m[15]))
+         | (r[1] & (m[0] | m[1] | m[5] | m[6] | m[10] | m[11] | m[13] | m[15]))
+         | (r[2] & (m[0] | m[1] | m[2] | m[5] | m[6] | m[11] | m[13] | m[14]))
+         | (r[3] & (m[3] | m[4] | m[6] | m[7] | m[8] | m[9] | m[14] | m[15]));
+    o[1] = (r[0] & (m[0] | m[3] | m[6] | m[9] | m[11] | m[12] | m[13] | m[14]))
+         | (r[1] & (m[1] | m[2] | m[4] | m[5] | m[7] | m[8] | m[10] | m[11]))
+         | (r[2] & (m[1] | m[2] | m[3] | m[6] | m[8] | m[10] | m[13] | m[15]))
+         | (r[3] & (m[0] | m[3] | m[5] | m[6] | m[9] | m[11] | m[12] | m[15]));
+    o[2] = (r[0] & (m[2] | m[3] | m[5] | m[6] | m[10] | m[12] | m[13] | m[15]))
+         | (r[1] & (m[0] | m[1] | m[3] | m[4] | m[8] | m[11] | m[13] | m[14]))
+         | (r[2] & (m[1] | m[2] | m[4] | m[7] | m[8] | m[11] | m[14] | m[15]))
+         | (r[3] & (m[1] | m[2] | m[6] | m[7] | m[8] | m[9] | m[11] | m[12]));
+    o[3] = (r[0] & (m[1] | m[3] | m[4] | m[9] | m[10] | m[13] | m[14] | m[15]))
+         | (r[1] & (m[1] | m[4] | m[6] | m[7] | m[9] | m[10] | m[13] | m[14]))
+         | (r[2] & (m[0] | m[2] | m[3] | m[7] | m[8] | m[12] | m[13] | m[14]))
+         | (r[3] & (m[1] | m[4] | m[5] | m[6] | m[8] | m[10] | m[11] | m[15]));
+}
+
+// S7
+static BS_INLINE void BS_FN(sbox7)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[1] | m[3] | m[4] | m[6] | m[7] | m[9] | m[10] | m[13]))
+         | (r[1] & (m[0] | m[2] | m[5] | m[7] | m[8] | m[11] | m[13] | m[14]))
+         | (r[2] & (m[2] | m[3] | m[4] | m[7] | m[8] | m[9] | m[11] | m[14]))
+         | (r[3] & (m[1] | m[2] | m[3] | m[6] | m[8] | m[11] | m[12] | m[15]));
+    o[1] = (r[0] & (m[0] | m[3] | m[4] | m[7] | m[9] | m[11] | m[12] | m[14]))
+         | (r[1] & (m[0] | m[3] | m[4] | m[8] | m[10] | m[11] | m[13] | m[15]))
+         | (r[2] & (m[1] | m[3] | m[4] | m[6] | m[7] | m[9] | m[10] | m[13]))
+         | (r[3] & (m[0] | m[2] | m[5] | m[7] | m[9] | m[11] | m[12] | m[15]));
+    o[2] = (r[0] & (m[1] | m[2] | m[3] | m[4] | m[8] | m[11] | m[13] | m[14]))
+         | (r[1] & (m[2] | m[3] | m[7] | m[8] | m[9] | m[12] | m[13] | m[15]))
+         | (r[2] & (m[2] | m[5] | m[6] | m[7] | m[8] | m[9] | m[10] | m[15]))
+         | (r[3] & (m[0] | m[1] | m[6] | m[7] | m[11] | m[12] | m[13] | m[14]));
+    o[3] = (r[0] & (m[1] | m[4] | m[7] | m[8] | m[10] | m[11] | m[12] | m[15]))
+         | (r[1] & (m[0] | m[2] | m[3] | m[5] | m[6] | m[9] | m[10] | m[13]))
+         | (r[2] & (m[0] | m[2] | m[3] | m[5] | m[6] | m[9] | m[13] | m[14]))
+         | (r[3] & (m[1] | m[2] | m[4] | m[7] | m[8] | m[9] | m[11] | m[14]));
+}
+
+// S8
+static BS_INLINE void BS_FN(sbox8)(bs_t *o, const bs_t *m, const bs_t *r) {
+    o[0] = (r[0] & (m[0] | m[2] | m[5] | m[6] | m[8] | m[9] | m[11] | m[14]))
+         | (r[1] & (m[1] | m[2] | m[3] | m[4] | m[8] | m[11] | m[13] | m[14]))
+         | (r[2] & (m[1] | m[4] | m[5] | m[6] | m[10] | m[11] | m[12] | m[15]))
+         | (r[3] & (m[2] | m[5] | m[6] | m[7] | m[8] | m[9] | m[10] | m[15]));
+    o[1] = (r[0] & (m[0] | m[3] | m[4] | m[5] | m[11] | m[12] | m[14] | m[15]))
+         | (r[1] & (m[1] | m[2] | m[6] | m[7] | m[8] | m[9] | m[10] | m[13]))
+         | (r[2] & (m[0] | m[2] | m[5] | m[6] | m[9] | m[11] | m[12] | m[14]))
+         | (r[3] & (m[2] | m[3] | m[4] | m[7] | m[8] | m[9] | m[13] | m[14]));
+    o[2] = (r[0] & (m[1] | m[4] | m[5] | m[6] | m[8] | m[10] | m[11] | m[15]))
+         | (r[1] & (m[1] | m[4] | m[5] | m[6] | m[10] | m[11] | m[13] | m[15]))
+         | (r[2] & (m[0] | m[1] | m[6] | m[7] | m[9] | m[10] | m[12] | m[13]))
+         | (r[3] & (m[0] | m[2] | m[3] | m[5] | m[8] | m[12] | m[14] | m[15]));
+    o[3] = (r[0] & (m[0] | m[5] | m[6] | m[7] | m[9] | m[10] | m[12] | m[15]))
+         | (r[1] & (m[0] | m[1] | m[2] | m[5] | m[6] | m[9] | m[11] | m[14]))
+         | (r[2] & (m[0] | m[1] | m[3] | m[4] | m[11] | m[12] | m[13] | m[14]))
+         | (r[3] & (m[1] | m[3] | m[7] | m[8] | m[10] | m[12] | m[13] | m[15]));
+}
+#undef BS_INLINE
+
+static BS_TARGET void BS_FN(bs_des_encrypt)(const uint64_t *keys, uint64_t plain, uint64_t *out) {
+
+    bs_t key[64];
+    bs_t lr[2][32];
+    bs_t x[48], so[32];
+    bs_t m[16], r[4];
+    uint64_t t[64];
+
+    const bs_t zero = {0};
+    const bs_t ones = ~zero;
+
+    // transpose keys into bitslices,  key[i] holds DES key bit i+1 of every lane
+    for (int w = 0; w < BS_WORDS; w++) {
+        memcpy(t, keys + w * 64, sizeof(t));
+        bs_transpose64(t);
+        for (int i = 0; i < 64; i++) {
+            key[i][w] = t[63 - i];
+        }
+    }
+
+    // the plaintext is shared between all lanes
+    for (int i = 0; i < 64; i++) {
+        lr[i >> 5][i & 0x1F] = ((plain >> (63 - bs_des_ip[i])) & 1) ? ones : zero;
+    }
+
+    bs_t *L = lr[0];
+    bs_t *R = lr[1];
+
+    for (int round = 0; round < 16; round++) {
+
+        for (int i = 0; i < 48; i++) {
+            x[i] = R[bs_des_e[i]] ^ key[bs_des_ks[round][i]];
+        }
+
+        BS_FN(minterms)(x + 0, m, r);
+        BS_FN(sbox1)(so + 0, m, r);
+        BS_FN(minterms)(x + 6, m, r);
+        BS_FN(sbox2)(so + 4, m, r);
+        BS_FN(minterms)(x + 12, m, r);
+        BS_FN(sbox3)(so + 8, m, r);
+        BS_FN(minterms)(x + 18, m, r);
+        BS_FN(sbox4)(so + 12, m, r);
+        BS_FN(minterms)(x + 24, m, r);
+        BS_FN(sbox5)(so + 16, m, r);
+        BS_FN(minterms)(x + 30, m, r);
+        BS_FN(sbox6)(so + 20, m, r);
+        BS_FN(minterms)(x + 36, m, r);
+        BS_FN(sbox7)(so + 24, m, r);
+        BS_FN(minterms)(x + 42, m, r);
+        BS_FN(sbox8)(so + 28, m, r);
+
+        // L' = R,  R' = L ^ P(S(E(R) ^ K))
+        for (int i = 0; i < 32; i++) {
+            L[i] ^= so[bs_des_p[i]];
+        }
+        bs_t *tmp = L;
+        L = R;
+        R = tmp;
+    }
+
+    // preoutput is R16 L16, apply final permutation and transpose back
+    for (int w = 0; w < BS_WORDS; w++) {
+        for (int i = 0; i < 64; i++) {
+            uint8_t p = bs_des_fp[i];
+            t[63 - i] = (p < 32) ? R[p][w] : L[p - 32][w];
+        }
+        bs_transpose64(t);
+        memcpy(out + w * 64, t, sizeof(t));
+    }
+}
+
+#undef bs_t
@@ -48,6 +48,8 @@
 #include "fileutils.h"
 #include "mbedtls/des.h"
 #include "util_posix.h"
+#include "commonutil.h"
+#include "bs_des.h"
 
 /**
  * @brief Permutes a key from standard NIST format to Iclass specific format
@@ -305,93 +307,109 @@ typedef struct {
     uint8_t values[3];
 } loclass_thread_ret_t;
 
+// upper bound for --threads, thread indices are also stored in loclass_found
+#define LOCLASS_MAX_THREADS  64
+#define LOCLASS_NOT_FOUND    -1
+#define LOCLASS_ABORTED      -2
+
 static size_t loclass_tc = 1;
-static int loclass_found = 0;
+static int loclass_found = LOCLASS_NOT_FOUND;
 
+/*
+ * Each thread takes blocks of bs_des_lanes() consecutive candidates, block n goes to thread (n % loclass_tc).
+ * All candidates of a block share the CSN, so their DES(CSN, K_sel) step runs as one bitsliced call,
+ * only hash0 and the MAC are calculated per candidate.
+ */
 static void *bf_thread(void *thread_arg) {
 
     loclass_thread_arg_t *targ = (loclass_thread_arg_t *)thread_arg;
     const uint32_t endmask = targ->endmask;
     const uint8_t numbytes_to_recover = targ->numbytes_to_recover;
-    uint32_t brute = targ->thread_idx;
+    const uint32_t lanes = bs_des_lanes();
 
-    uint8_t csn[8];
     uint8_t cc_nr[12];
     uint8_t mac[4];
-    uint8_t key_index[8];
     uint8_t bytes_to_recover[3];
-    uint16_t keytable[128];
 
-    memcpy(csn, targ->item.csn, sizeof(csn));
     memcpy(cc_nr, targ->item.cc_nr, sizeof(cc_nr));
     memcpy(mac, targ->item.mac, sizeof(mac));
-    memcpy(key_index, targ->key_index, sizeof(key_index));
     memcpy(bytes_to_recover, targ->bytes_to_recover, sizeof(bytes_to_recover));
-    memcpy(keytable, targ->keytable, sizeof(keytable));
 
-    while (!(brute & endmask)) {
+    const uint64_t csn = x_bytes_to_num(targ->item.csn, sizeof(targ->item.csn));
 
-        int found = __atomic_load_n(&loclass_found, __ATOMIC_SEQ_CST);
+    // key_sel byte i is either a known keytable value, or brute byte brute_pos[i]
+    uint8_t key_sel[8] = {0};
+    int8_t brute_pos[8];
+    for (uint8_t i = 0; i < 8; i++) {
+        key_sel[i] = targ->keytable[targ->key_index[i]] & 0xFF;
+        brute_pos[i] = -1;
+        for (uint8_t j = 0; j < numbytes_to_recover; j++) {
+            if (targ->key_index[i] == bytes_to_recover[j]) {
+                brute_pos[i] = j;
+            }
+        }
+    }
 
-        if (found != 0xFF) return NULL;
+    uint64_t keys[BS_DES_MAX_LANES];
+    uint64_t crypted_csn[BS_DES_MAX_LANES];
 
-        //Update the keytable with the brute-values
-        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] &= 0xFF00;
-            keytable[bytes_to_recover[i]] |= (brute >> (i * 8) & 0xFF);
-        }
+    for (uint32_t block = targ->thread_idx * lanes; block < endmask; block += loclass_tc * lanes) {
 
-        uint8_t key_sel[8] = {0};
+        int found = __atomic_load_n(&loclass_found, __ATOMIC_SEQ_CST);
 
-        // Piece together the key
-        key_sel[0] = keytable[key_index[0]] & 0xFF;
-        key_sel[1] = keytable[key_index[1]] & 0xFF;
-        key_sel[2] = keytable[key_index[2]] & 0xFF;
-        key_sel[3] = keytable[key_index[3]] & 0xFF;
-        key_sel[4] = keytable[key_index[4]] & 0xFF;
-        key_sel[5] = keytable[key_index[5]] & 0xFF;
-        key_sel[6] = keytable[key_index[6]] & 0xFF;
-        key_sel[7] = keytable[key_index[7]] & 0xFF;
+        if (found != LOCLASS_NOT_FOUND) return NULL;
 
-        // Permute from iclass format to standard format
+        uint32_t n = MIN(lanes, endmask - block);
 
-        uint8_t key_sel_p[8] = {0};
-        permutekey_rev(key_sel, key_sel_p);
+        // Piece together the keys, and permute from iclass format to standard format
+        for (uint32_t l = 0; l < n; l++) {
+            uint32_t brute = block + l;
+            uint8_t key[8], key_p[8];
+            for (uint8_t i = 0; i < 8; i++) {
+                key[i] = (brute_pos[i] < 0) ? key_sel[i] : (brute >> (brute_pos[i] * 8)) & 0xFF;
+            }
+            permutekey_rev(key, key_p);
+            keys[l] = x_bytes_to_num(key_p, sizeof(key_p));
+        }
 
-        // Diversify
-        uint8_t div_key[8] = {0};
-        diversifyKey(csn, key_sel_p, div_key);
+        // Diversify,  DES part for all lanes at once
+        bs_des_encrypt(keys, n, csn, crypted_csn);
 
-        // Calc mac
-        uint8_t calculated_MAC[4] = {0};
-        doMAC(cc_nr, div_key, calculated_MAC);
+        for (uint32_t l = 0; l < n; l++) {
 
-        // success
-        if (memcmp(calculated_MAC, mac, 4) == 0) {
+            uint8_t div_key[8] = {0};
+            hash0(crypted_csn[l], div_key);
 
-            loclass_thread_ret_t *r = (loclass_thread_ret_t *)malloc(sizeof(loclass_thread_ret_t));
+            // Calc mac
+            uint8_t calculated_MAC[4] = {0};
+            doMAC(cc_nr, div_key, calculated_MAC);
 
-            for (uint8_t i = 0 ; i < numbytes_to_recover; i++) {
-                r->values[i] = keytable[bytes_to_recover[i]] & 0xFF;
+            // success
+            if (memcmp(calculated_MAC, mac, 4) == 0) {
+
+                loclass_thread_ret_t *r = (loclass_thread_ret_t *)calloc(1, sizeof(loclass_thread_ret_t));
+
+                for (uint8_t i = 0 ; i < numbytes_to_recover; i++) {
+                    r->values[i] = ((block + l) >> (i * 8)) & 0xFF;
+                }
+                __atomic_store_n(&loclass_found, targ->thread_idx, __ATOMIC_SEQ_CST);
+                pthread_exit((void *)r);
             }
-            __atomic_store_n(&loclass_found, targ->thread_idx, __ATOMIC_SEQ_CST);
-            pthread_exit((void *)r);
         }
 
-        brute += loclass_tc;
-
 #define _CLR_ "\x1b[0K"
 
+        // progress, only printed by the first thread
+        if (targ->thread_idx != 0)
+            continue;
+
+        uint32_t brute = block + loclass_tc * lanes;
         if (numbytes_to_recover == 3) {
-            if ((brute > 0) && ((brute & 0xFFFF) == 0)) {
+            if ((brute & 0xFFFF) < (loclass_tc * lanes)) {
                 PrintAndLogEx(INPLACE, "[ %02x %02x %02x ] %8u / %u", bytes_to_recover[0], bytes_to_recover[1], bytes_to_recover[2], brute, 0xFFFFFF);
             }
         } else if (numbytes_to_recover == 2) {
-            if ((brute > 0) && ((brute & 0x3F) == 0))
-                PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, bytes_to_recover[0], bytes_to_recover[1], brute, 0xFFFF);
-        } else {
-            if ((brute > 0) && ((brute & 0x1F) == 0))
-                PrintAndLogEx(INPLACE, "[ %02x ] %3u / %u" _CLR_, bytes_to_recover[0], brute, 0xFF);
+            PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, bytes_to_recover[0], bytes_to_recover[1], MIN(brute, 0xFFFF), 0xFFFF);
         }
     }
     pthread_exit(NULL);
@@ -403,7 +421,7 @@ static void *bf_thread(void *thread_arg) {
 int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
 
     // reset thread signals
-    loclass_found = 0xFF;
+    loclass_found = LOCLASS_NOT_FOUND;
 
     //Get the key index (hash1)
     uint8_t key_index[8] = {0};
@@ -447,7 +465,17 @@ int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
         return PM3_ESOFT;
     }
 
-    loclass_thread_arg_t args[loclass_tc];
+    loclass_thread_arg_t *args = calloc(loclass_tc, sizeof(loclass_thread_arg_t));
+    pthread_t *threads = calloc(loclass_tc, sizeof(pthread_t));
+    void **ptrs = calloc(loclass_tc, sizeof(void *));
+    if (args == NULL || threads == NULL || ptrs == NULL) {
+        PrintAndLogEx(WARNING, "failed to allocate memory");
+        free(args);
+        free(threads);
+        free(ptrs);
+        return PM3_EMALLOC;
+    }
+
     // init thread arguments
     for (int i = 0; i < loclass_tc; i++) {
         args[i].thread_idx = i;
@@ -460,24 +488,29 @@ int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
         memcpy(args[i].keytable, keytable, sizeof(args[i].keytable));
     }
 
-    pthread_t threads[loclass_tc];
     // create threads
-    for (int i = 0; i < loclass_tc; i++) {
-        int res = pthread_create(&threads[i], NULL, bf_thread, (void *)&args[i]);
-        if (res) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
-            return PM3_ESOFT;
+    size_t started = 0;
+    for (; started < loclass_tc; started++) {
+        if (pthread_create(&threads[started], NULL, bf_thread, (void *)&args[started])) {
+            // stop the ones already running
+            __atomic_store_n(&loclass_found, LOCLASS_ABORTED, __ATOMIC_SEQ_CST);
+            break;
         }
     }
     // wait for threads to terminate:
-    void *ptrs[loclass_tc];
-    for (int i = 0; i < loclass_tc; i++)
+    for (size_t i = 0; i < started; i++)
         pthread_join(threads[i], &ptrs[i]);
 
     // was it a success?
     int res = PM3_SUCCESS;
-    if (loclass_found == 0xFF) {
+    if (loclass_found == LOCLASS_ABORTED) {
+        res = PM3_ESOFT;
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
+        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
+            keytable[bytes_to_recover[i]] &= ~LOCLASS_BEING_CRACKED;
+        }
+    } else if (loclass_found == LOCLASS_NOT_FOUND) {
         res = PM3_ESOFT;
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(WARNING, "Failed to recover %d bytes using the following CSN", numbytes_to_recover);
@@ -497,13 +530,14 @@ int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
             keytable[bytes_to_recover[i]] &= 0xFF;
             keytable[bytes_to_recover[i]] |= LOCLASS_CRACKED;
         }
-        for (uint8_t i = 0; i < loclass_tc; i++) {
-            free(ptrs[i]);
-        }
     }
 
-    memset(args, 0x00, sizeof(args));
-    memset(threads, 0x00, sizeof(threads));
+    for (size_t i = 0; i < started; i++) {
+        free(ptrs[i]);
+    }
+    free(ptrs);
+    free(threads);
+    free(args);
     return res;
 }
 
@@ -722,7 +756,7 @@ int calculateMasterKey(uint8_t first16bytes[], uint8_t kcus[]) {
  * @param keytable
  * @return
  */
-int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
+int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[], uint32_t threads) {
     uint8_t i;
     size_t itemsize = sizeof(loclass_dumpdata_t);
     loclass_dumpdata_t *attack = (loclass_dumpdata_t *) calloc(itemsize, sizeof(uint8_t));
@@ -731,8 +765,18 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
         return PM3_EMALLOC;
     }
 
-    loclass_tc = num_CPUs();
-    PrintAndLogEx(INFO, "bruteforce using " _YELLOW_("%zu") " threads", loclass_tc);
+    // thread count is bounded by the available cores
+    size_t cpus = MAX(1, MIN(num_CPUs(), LOCLASS_MAX_THREADS));
+    loclass_tc = (threads) ? MIN(threads, cpus) : cpus;
+    if (threads > loclass_tc) {
+        PrintAndLogEx(INFO, "limiting to " _YELLOW_("%zu") " threads", loclass_tc);
+    }
+    bs_des_select(BS_DES_AUTO);
+    PrintAndLogEx(INFO, "bruteforce using " _YELLOW_("%zu") " threads and " _YELLOW_("%s") " DES core ( %zu lanes )"
+                  , loclass_tc
+                  , bs_des_kernel_name(bs_des_selected())
+                  , bs_des_lanes()
+                 );
 
     int res = 0;
 
@@ -775,7 +819,7 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
  * @param filename
  * @return
  */
-int bruteforceFile(const char *filename, uint16_t keytable[]) {
+int bruteforceFile(const char *filename, uint16_t keytable[], uint32_t threads) {
 
     size_t dumplen = 0;
     uint8_t *dump = NULL;
@@ -783,7 +827,7 @@ int bruteforceFile(const char *filename, uint16_t keytable[]) {
         return PM3_EFILE;
     }
 
-    uint8_t res = bruteforceDump(dump, dumplen, keytable);
+    uint8_t res = bruteforceDump(dump, dumplen, keytable, threads);
     free(dump);
     return res;
 }
@@ -793,9 +837,9 @@ int bruteforceFile(const char *filename, uint16_t keytable[]) {
  * @param filename
  * @return
  */
-int bruteforceFileNoKeys(const char *filename) {
+int bruteforceFileNoKeys(const char *filename, uint32_t threads) {
     uint16_t keytable[128] = {0};
-    return bruteforceFile(filename, keytable);
+    return bruteforceFile(filename, keytable, threads);
 }
 
 // ---------------------------------------------------------------------------------
@@ -824,7 +868,7 @@ static int _testBruteforce(void) {
         **** The 64-bit HS Custom Key Value = 5B7C62C491C11B39 ****
     **/
     uint16_t keytable[128] = {0};
-    int res = bruteforceFile("iclass_dump.bin", keytable);
+    int res = bruteforceFile("iclass_dump.bin", keytable, 0);
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Error: The file " _YELLOW_("iclass_dump.bin") "was not found!");
     }
@@ -872,7 +916,117 @@ static int _testHash1(void) {
     return PM3_SUCCESS;
 }
 
-int testElite(bool slowtests) {
+// DES(CSN, K) with mbedtls, the reference for the bitsliced kernels
+static uint64_t _des_ref(uint64_t key, uint64_t plain) {
+    uint8_t k[8], p[8], c[8];
+    x_num_to_bytes(key, sizeof(k), k);
+    x_num_to_bytes(plain, sizeof(p), p);
+    mbedtls_des_context ctx;
+    mbedtls_des_init(&ctx);
+    mbedtls_des_setkey_enc(&ctx, k);
+    mbedtls_des_crypt_ecb(&ctx, p, c);
+    mbedtls_des_free(&ctx);
+    return x_bytes_to_num(c, sizeof(c));
+}
+
+static int _testBitslicedDES(void) {
+
+    uint64_t keys[BS_DES_MAX_LANES];
+    uint64_t out[BS_DES_MAX_LANES];
+    const uint64_t csn = 0x0102030405060708;
+    int res = PM3_SUCCESS;
+
+    bs_des_kernel_t kernels[] = {BS_DES_SCALAR, BS_DES_NEON, BS_DES_AVX2};
+    for (uint8_t k = 0; k < ARRAYLEN(kernels); k++) {
+        if (bs_des_select(kernels[k]) == false)
+            continue;
+
+        size_t n = bs_des_lanes();
+        uint64_t x = 0x133457799BBCDFF1;
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = x;
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+
+        bs_des_encrypt(keys, n, csn, out);
+
+        bool ok = true;
+        for (size_t i = 0; i < n; i++) {
+            if (out[i] != _des_ref(keys[i], csn)) {
+                ok = false;
+                break;
+            }
+        }
+        PrintAndLogEx(ok ? SUCCESS : WARNING, "    bitsliced DES %-6s (%s)", bs_des_kernel_name(kernels[k]), ok ? _GREEN_("ok") : _RED_("fail"));
+        if (ok == false)
+            res = PM3_ESOFT;
+    }
+    bs_des_select(BS_DES_AUTO);
+    return res;
+}
+
+static int _benchBitslicedDES(void) {
+
+    PrintAndLogEx(INFO, "Benchmarking DES(CSN, K_sel) candidates...");
+
+    const uint32_t count = 0x100000;
+    const uint64_t csn = 0x0102030405060708;
+    uint64_t keys[BS_DES_MAX_LANES];
+    uint64_t out[BS_DES_MAX_LANES];
+    uint64_t sink = 0;
+
+    for (size_t i = 0; i < BS_DES_MAX_LANES; i++) {
+        keys[i] = 0x5B7C62C491C11B39 + i;
+    }
+
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < count; i++) {
+        sink ^= _des_ref(keys[i & 0xFF] ^ i, csn);
+    }
+    t1 = msclock() - t1;
+    double ref = (double)count / (t1 ? t1 : 1);
+    PrintAndLogEx(SUCCESS, "    %-8s %8.0f keys/ms", "mbedtls", ref);
+
+    bs_des_kernel_t kernels[] = {BS_DES_SCALAR, BS_DES_NEON, BS_DES_AVX2};
+    for (uint8_t k = 0; k < ARRAYLEN(kernels); k++) {
+        if (bs_des_select(kernels[k]) == false)
+            continue;
+
+        size_t n = bs_des_lanes();
+        t1 = msclock();
+        for (uint32_t i = 0; i < count; i += n) {
+            keys[0] ^= i;
+            bs_des_encrypt(keys, n, csn, out);
+            sink ^= out[0];
+        }
+        t1 = msclock() - t1;
+        double rate = (double)count / (t1 ? t1 : 1);
+        PrintAndLogEx(SUCCESS, "    %-8s %8.0f keys/ms  ( " _GREEN_("%.1fx") " )", bs_des_kernel_name(kernels[k]), rate, rate / ref);
+    }
+
+    // full candidate test, DES + hash0 + MAC, as done in bf_thread
+    bs_des_select(BS_DES_AUTO);
+    size_t n = bs_des_lanes();
+    uint8_t cc_nr[12] = {0};
+    uint8_t div_key[8] = {0};
+    uint8_t mac[4] = {0};
+    t1 = msclock();
+    for (uint32_t i = 0; i < count; i += n) {
+        keys[0] ^= i;
+        bs_des_encrypt(keys, n, csn, out);
+        for (size_t l = 0; l < n; l++) {
+            hash0(out[l], div_key);
+            doMAC(cc_nr, div_key, mac);
+        }
+        sink ^= mac[0];
+    }
+    t1 = msclock() - t1;
+    PrintAndLogEx(SUCCESS, "    %-8s %8.0f candidates/ms per thread ( DES + hash0 + MAC )", bs_des_kernel_name(bs_des_selected()), (double)count / (t1 ? t1 : 1));
+    PrintAndLogEx(DEBUG, "sink %" PRIx64, sink);
+    return PM3_SUCCESS;
+}
+
+int testElite(bool slowtests, bool benchmark) {
     PrintAndLogEx(INFO, "Testing iClass Elite functionality");
     PrintAndLogEx(INFO, "Testing hash2...");
     uint8_t k_cus[8] = {0x5B, 0x7C, 0x62, 0xC4, 0x91, 0xC1, 0x1B, 0x39};
@@ -908,6 +1062,12 @@ int testElite(bool slowtests) {
     res += _test_iclass_key_permutation();
     PrintAndLogEx((res == PM3_SUCCESS) ? SUCCESS : WARNING, "    key diversification (%s)", (res == PM3_SUCCESS) ? _GREEN_("ok") : _RED_("fail"));
 
+    PrintAndLogEx(INFO, "Testing bitsliced DES...");
+    res += _testBitslicedDES();
+
+    if (benchmark)
+        res += _benchBitslicedDES();
+
     if (slowtests)
         res += _testBruteforce();
 
@@ -70,24 +70,27 @@ void permutekey_rev(uint8_t key[8], uint8_t dest[8]);
  * @param filename
  * @param keytable an arrah (128 x 16 bit ints). This is where the keydata is stored.
  * OBS! the upper part of the 16 bits store crack-status,
+ * @param threads number of worker threads, 0 uses all cpus
  * @return
  */
-int bruteforceFile(const char *filename, uint16_t keytable[]);
+int bruteforceFile(const char *filename, uint16_t keytable[], uint32_t threads);
 /**
  *
  * @brief Same as above, if you don't care about the returned keytable (results only printed on screen)
  * @param filename
+ * @param threads number of worker threads, 0 uses all cpus
  * @return
  */
-int bruteforceFileNoKeys(const char *filename);
+int bruteforceFileNoKeys(const char *filename, uint32_t threads);
 /**
  * @brief Same as bruteforcefile, but uses a an array of loclass_dumpdata_t instead
  * @param dump
  * @param dumpsize
  * @param keytable
+ * @param threads number of worker threads, 0 uses all cpus
  * @return
  */
-int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]);
+int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[], uint32_t threads);
 
 /**
  * @brief Performs brute force attack against a dump-data item, containing csn, cc_nr and mac.
@@ -125,9 +128,11 @@ int calculateMasterKey(uint8_t first16bytes[], uint8_t kcus[]);
 
 /**
  * @brief Test function
+ * @param slowtests include the dumpfile bruteforce
+ * @param benchmark time mbedtls DES against the bitsliced DES kernels
  * @return
  */
-int testElite(bool slowtests);
+int testElite(bool slowtests, bool benchmark);
 
 /**
       Here are some pretty optimal values that can be used to recover necessary data in only
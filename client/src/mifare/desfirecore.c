@@ -1571,6 +1571,106 @@ int DesfireAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChann
     return 100;
 }
 
+// Runs the authentications on device, in batches of as many keys as fit in one packet.
+// found[i] gets the index in keys of the first key that authenticates slots[i],
+// -1 if none did and -2 if the card refused the key number or key type.
+int DesfireCheckKeysOnDevice(uint8_t mode, uint8_t algo, uint32_t aid, const uint16_t *slots, size_t slot_count,
+                             const uint8_t *keys, uint8_t keylen, size_t key_count, int32_t *found) {
+
+    for (size_t i = 0; i < slot_count; i++)
+        found[i] = -1;
+
+    desfire_chk_t payload = {0};
+    payload.mode = mode;
+    payload.algo = algo;
+    payload.keylen = keylen;
+    payload.aid[0] = aid & 0xFF;
+    payload.aid[1] = (aid >> 8) & 0xFF;
+    payload.aid[2] = (aid >> 16) & 0xFF;
+
+    // key indexes must stay below DESFIRE_CHK_NOKEY
+    size_t batch = MIN(sizeof(payload.keys) / keylen, DESFIRE_CHK_NOKEY);
+
+    bool init = true;
+    uint8_t retries = 0;
+
+    for (size_t sstart = 0; sstart < slot_count; sstart += DESFIRE_CHK_MAX_SLOTS) {
+
+        size_t send = MIN(sstart + DESFIRE_CHK_MAX_SLOTS, slot_count);
+
+        for (size_t kstart = 0; kstart < key_count;) {
+
+            // only the slots of this group still without key
+            size_t map[DESFIRE_CHK_MAX_SLOTS];
+            payload.slot_count = 0;
+            for (size_t i = sstart; i < send; i++) {
+                if (found[i] == -1) {
+                    map[payload.slot_count] = i;
+                    payload.slots[payload.slot_count++] = slots[i];
+                }
+            }
+
+            if (payload.slot_count == 0)
+                break;
+
+            payload.flags = (init) ? INIT : 0;
+            payload.key_count = MIN(batch, key_count - kstart);
+            memcpy(payload.keys, keys + (kstart * keylen), payload.key_count * keylen);
+
+            clearCommandBuffer();
+            SendCommandNG(CMD_HF_DESFIRE_CHKKEYS, (uint8_t *)&payload, offsetof(desfire_chk_t, keys) + (payload.key_count * keylen));
+
+            PacketResponseNG resp;
+            bool keypress = false;
+            while (WaitForResponseTimeout(CMD_HF_DESFIRE_CHKKEYS, &resp, 2000) == false) {
+                if (keypress) {
+                    PrintAndLogEx(WARNING, "\nno response from device");
+                    return PM3_ETIMEOUT;
+                }
+                if (kbd_enter_pressed()) {
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    keypress = true;
+                }
+            }
+
+            if (resp.status == PM3_EOPABORTED) {
+                PrintAndLogEx(WARNING, "\naborted via keyboard!");
+                return PM3_EOPABORTED;
+            }
+
+            if (resp.status != PM3_SUCCESS && resp.status != PM3_ECARDEXCHANGE) {
+                return resp.status;
+            }
+
+            // slots done before an exchange error are still valid
+            const desfire_chk_resp_t *r = (desfire_chk_resp_t *)resp.data.asBytes;
+            for (uint8_t s = 0; s < payload.slot_count; s++) {
+                if (r->found[s] == DESFIRE_CHK_NOKEY)
+                    found[map[s]] = -2;
+                else if (r->found[s] != DESFIRE_CHK_NONE)
+                    found[map[s]] = kstart + r->found[s];
+            }
+
+            // the device dropped the field,  select again and retry the batch
+            if (resp.status == PM3_ECARDEXCHANGE) {
+                if (++retries > 3)
+                    return PM3_ECARDEXCHANGE;
+
+                PrintAndLogEx(NORMAL, "R" NOLF);
+                init = true;
+                msleep(100);
+                continue;
+            }
+
+            PrintAndLogEx(NORMAL, "." NOLF);
+            retries = 0;
+            init = false;
+            kstart += payload.key_count;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 bool DesfireCheckAuthCmd(DesfireISOSelectWay way, uint32_t appID, uint8_t keyNum, uint8_t authcmd, bool checklrp) {
     size_t recv_len = 0;
     uint8_t respcode = 0;
@@ -37,13 +37,29 @@
 
 extern "C" int preferences_save(void);
 
-static int s_Buff[MAX_GRAPH_TRACE_LEN];
+static int *s_Buff = NULL;
+static size_t s_BuffLen = 0;
 static bool gs_useOverlays = false;
 static int gs_absVMax = 0;
 static uint32_t startMax; // Maximum offset in the graph (right side of graph)
 static uint32_t PageWidth; // How many samples are currently visible on this 'page' / graph
 static int unlockStart = 0;
 
+// the overlay follows the size of the graph buffer
+static bool overlayReserve(size_t len) {
+    if (len <= s_BuffLen)
+        return true;
+
+    int *tmp = (int *)realloc(s_Buff, len * sizeof(int));
+    if (tmp == NULL)
+        return false;
+
+    memset(tmp + s_BuffLen, 0, (len - s_BuffLen) * sizeof(int));
+    s_Buff = tmp;
+    s_BuffLen = len;
+    return true;
+}
+
 void ProxGuiQT::ShowGraphWindow(void) {
     emit ShowGraphWindowSignal();
 }
@@ -291,7 +307,11 @@ void SliderWidget::moveEvent(QMoveEvent *event) {
 //--------------------
 void ProxWidget::applyOperation() {
     //printf("ApplyOperation()");
+    if (overlayReserve(g_GraphTraceLen) == false)
+        return;
     save_restoreGB(GRAPH_SAVE);
+    if (graphWritable() == false)
+        return;
     memcpy(g_GraphBuffer, s_Buff, sizeof(int) * g_GraphTraceLen);
     RepaintGraphWindow();
 }
@@ -300,6 +320,8 @@ void ProxWidget::stickOperation() {
     //printf("stickOperation()");
 }
 void ProxWidget::vchange_autocorr(int v) {
+    if (overlayReserve(g_GraphTraceLen) == false)
+        return;
     int ans = AutoCorrelate(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, true, false);
     if (g_debugMode) printf("vchange_autocorr(w:%d): %d\n", v, ans);
     gs_useOverlays = true;
@@ -307,6 +329,8 @@ void ProxWidget::vchange_autocorr(int v) {
 }
 void ProxWidget::vchange_askedge(int v) {
     //extern int AskEdgeDetect(const int *in, int *out, int len, int threshold);
+    if (overlayReserve(g_GraphTraceLen) == false)
+        return;
     int ans = AskEdgeDetect(g_GraphBuffer, s_Buff, g_GraphTraceLen, v);
     if (g_debugMode) printf("vchange_askedge(w:%d)%d\n", v, ans);
     gs_useOverlays = true;
@@ -314,6 +338,8 @@ void ProxWidget::vchange_askedge(int v) {
 }
 void ProxWidget::vchange_dthr_up(int v) {
     int down = opsController->horizontalSlider_dirthr_down->value();
+    if (overlayReserve(g_GraphTraceLen) == false)
+        return;
     directionalThreshold(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, down);
     //printf("vchange_dthr_up(%d)", v);
     gs_useOverlays = true;
@@ -322,6 +348,8 @@ void ProxWidget::vchange_dthr_up(int v) {
 void ProxWidget::vchange_dthr_down(int v) {
     //printf("vchange_dthr_down(%d)", v);
     int up = opsController->horizontalSlider_dirthr_up->value();
+    if (overlayReserve(g_GraphTraceLen) == false)
+        return;
     directionalThreshold(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, up);
     gs_useOverlays = true;
     RepaintGraphWindow();
@@ -714,7 +742,7 @@ void Plot::paintEvent(QPaintEvent *event) {
     if (g_DemodBufferLen > 8) {
         PlotDemod(g_DemodBuffer, g_DemodBufferLen, plotRect, infoRect, &painter, 2, g_DemodStartIdx);
     }
-    if (gs_useOverlays) {
+    if (gs_useOverlays && overlayReserve(g_GraphTraceLen)) {
         //init graph variables
         setMaxAndStart(s_Buff, g_GraphTraceLen, plotRect);
         PlotGraph(s_Buff, g_GraphTraceLen, plotRect, infoRect, &painter, 1);
@@ -867,9 +895,7 @@ void Plot::Trim(void) {
         CursorBPos -= lref;
     }
     g_DemodStartIdx -= lref;
-    for (uint32_t i = lref; i < rref; ++i)
-        g_GraphBuffer[i - lref] = g_GraphBuffer[i];
-    g_GraphTraceLen = rref - lref;
+    graphSlice(lref, rref - lref);
     g_GraphStart = 0;
 }
 
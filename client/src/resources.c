@@ -0,0 +1,272 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Cache of the json files in resources/ and lookup indexes on them
+//
+// Every file is parsed once per process.  OIDs,  MAD and DESFire AIDs and the
+// aidlist get sorted indexes,  so a lookup is a binary search instead of a walk
+// over the json tree.
+//-----------------------------------------------------------------------------
+
+#include "resources.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "fileutils.h"
+#include "pm3_cmd.h"
+#include "ui.h"
+
+#define RESOURCE_MAX  16
+
+typedef struct {
+    char *name;
+    json_t *root;     // NULL when the file could not be loaded,  not retried
+} resource_t;
+
+static resource_t resources[RESOURCE_MAX];
+static size_t resource_count = 0;
+
+json_t *resource_json(const char *name, bool verbose) {
+
+    for (size_t i = 0; i < resource_count; i++) {
+        if (strcmp(resources[i].name, name) == 0)
+            return resources[i].root;
+    }
+
+    json_t *root = NULL;
+    char *path;
+    if (searchFile(&path, RESOURCES_SUBDIR, name, ".json", false) == PM3_SUCCESS) {
+        json_error_t error;
+        root = json_load_file(path, 0, &error);
+        if (root == NULL) {
+            PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
+        } else {
+            PrintAndLogEx((verbose) ? SUCCESS : DEBUG, "Loaded file " _YELLOW_("`%s`") " (%s)", path, _GREEN_("ok"));
+        }
+        free(path);
+    }
+
+    if (resource_count < RESOURCE_MAX) {
+        resources[resource_count].name = strdup(name);
+        resources[resource_count].root = root;
+        resource_count++;
+    }
+    return root;
+}
+
+static const char *json_str(json_t *data, const char *name) {
+    json_t *jstr = json_object_get(data, name);
+    if (json_is_string(jstr) == false)
+        return NULL;
+    return json_string_value(jstr);
+}
+
+//-----------------------------------------------------------------------------
+// entries keyed by a number,  MAD and DESFire AIDs
+
+typedef struct {
+    uint32_t key;
+    uint32_t pos;     // position in the file,  first one wins on duplicates
+    json_t *elm;
+} num_entry_t;
+
+typedef struct {
+    bool loaded;
+    size_t count;
+    num_entry_t *entries;
+} num_index_t;
+
+static int num_entry_cmp(const void *a, const void *b) {
+    const num_entry_t *x = a, *y = b;
+    if (x->key != y->key)
+        return (x->key < y->key) ? -1 : 1;
+    return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+static void num_index_build(num_index_t *idx, const char *name, const char *field) {
+    idx->loaded = true;
+
+    json_t *root = resource_json(name, false);
+    if (json_is_array(root) == false)
+        return;
+
+    idx->entries = calloc(json_array_size(root), sizeof(num_entry_t));
+    if (idx->entries == NULL)
+        return;
+
+    for (size_t i = 0; i < json_array_size(root); i++) {
+        json_t *data = json_array_get(root, i);
+        const char *s = json_str(data, field);
+        if (s == NULL || strlen(s) == 0)
+            continue;
+
+        num_entry_t *e = &idx->entries[idx->count++];
+        e->key = strtoul(s, NULL, 16);
+        e->pos = i;
+        e->elm = data;
+    }
+    qsort(idx->entries, idx->count, sizeof(num_entry_t), num_entry_cmp);
+}
+
+static json_t *num_index_find(const num_index_t *idx, uint32_t key) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (idx->entries[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < idx->count && idx->entries[lo].key == key)
+        return idx->entries[lo].elm;
+    return NULL;
+}
+
+static num_index_t mad_index;
+static num_index_t desfire_aid_index;
+
+json_t *resource_mad_lookup(uint16_t aid) {
+    if (mad_index.loaded == false)
+        num_index_build(&mad_index, "mad", "mad");
+    return num_index_find(&mad_index, aid);
+}
+
+json_t *resource_desfire_aid_lookup(uint32_t aid) {
+    if (desfire_aid_index.loaded == false)
+        num_index_build(&desfire_aid_index, "aid_desfire", "AID");
+    return num_index_find(&desfire_aid_index, aid);
+}
+
+//-----------------------------------------------------------------------------
+// entries keyed by a string,  OIDs and the aidlist
+
+typedef struct {
+    const char *key;
+    uint32_t pos;
+    json_t *elm;      // aidlist
+    char *desc;       // oids
+} str_entry_t;
+
+typedef struct {
+    bool loaded;
+    size_t count;
+    str_entry_t *entries;
+} str_index_t;
+
+static int str_entry_cmp(const void *a, const void *b) {
+    const str_entry_t *x = a, *y = b;
+    int res = strcmp(x->key, y->key);
+    if (res)
+        return res;
+    return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+// first entry equal to the first len chars of key
+static const str_entry_t *str_index_find(const str_index_t *idx, const char *key, size_t len) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const char *k = idx->entries[mid].key;
+        int res = strncmp(k, key, len);
+        if (res == 0 && k[len] != '\0')
+            res = 1;
+        if (res < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < idx->count && strncmp(idx->entries[lo].key, key, len) == 0 && idx->entries[lo].key[len] == '\0')
+        return &idx->entries[lo];
+    return NULL;
+}
+
+static str_index_t oid_index;
+static str_index_t aid_index;
+
+static void oid_index_build(void) {
+    oid_index.loaded = true;
+
+    json_t *root = resource_json("oids", false);
+    if (json_is_object(root) == false)
+        return;
+
+    oid_index.entries = calloc(json_object_size(root), sizeof(str_entry_t));
+    if (oid_index.entries == NULL)
+        return;
+
+    const char *oid;
+    json_t *elm;
+    json_object_foreach(root, oid, elm) {
+        const char *d = json_str(elm, "d");
+        if (d == NULL)
+            continue;
+
+        const char *c = json_str(elm, "c");
+        if (c && strlen(c) == 0)
+            c = NULL;
+
+        size_t len = strlen(d) + ((c) ? strlen(c) + 3 : 0) + 1;
+        char *desc = calloc(len, sizeof(char));
+        if (desc == NULL)
+            continue;
+
+        if (c)
+            snprintf(desc, len, "%s (%s)", d, c);
+        else
+            snprintf(desc, len, "%s", d);
+
+        str_entry_t *e = &oid_index.entries[oid_index.count];
+        e->key = oid;
+        e->pos = oid_index.count++;
+        e->desc = desc;
+    }
+    qsort(oid_index.entries, oid_index.count, sizeof(str_entry_t), str_entry_cmp);
+}
+
+const char *resource_oid_description(const char *oid) {
+    if (oid_index.loaded == false)
+        oid_index_build();
+
+    const str_entry_t *e = str_index_find(&oid_index, oid, strlen(oid));
+    return (e) ? e->desc : NULL;
+}
+
+static void aid_index_build(void) {
+    aid_index.loaded = true;
+
+    json_t *root = resource_json("aidlist", false);
+    if (json_is_array(root) == false)
+        return;
+
+    aid_index.entries = calloc(json_array_size(root), sizeof(str_entry_t));
+    if (aid_index.entries == NULL)
+        return;
+
+    for (size_t i = 0; i < json_array_size(root); i++) {
+        json_t *data = json_array_get(root, i);
+        const char *aid = json_str(data, "AID");
+        if (aid == NULL || strlen(aid) == 0)
+            continue;
+
+        str_entry_t *e = &aid_index.entries[aid_index.count++];
+        e->key = aid;
+        e->pos = i;
+        e->elm = data;
+    }
+    qsort(aid_index.entries, aid_index.count, sizeof(str_entry_t), str_entry_cmp);
+}
+
+json_t *resource_aid_lookup(const char *hexaid) {
+    if (aid_index.loaded == false)
+        aid_index_build();
+
+    // longest prefix first
+    for (size_t len = strlen(hexaid); len > 0; len--) {
+        const str_entry_t *e = str_index_find(&aid_index, hexaid, len);
+        if (e)
+            return e->elm;
+    }
+    return NULL;
+}
@@ -0,0 +1,28 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Cache of the json files in resources/ and lookup indexes on them
+//-----------------------------------------------------------------------------
+
+#ifndef RESOURCES_H__
+#define RESOURCES_H__
+
+#include "common.h"
+#include "jansson.h"
+
+// Parsed resource,  loaded on first use and kept until exit.
+// The reference is borrowed,  callers must not json_decref() it.
+json_t *resource_json(const char *name, bool verbose);
+
+// oids.json,  "description (comment)"
+const char *resource_oid_description(const char *oid);
+// mad.json,  entry of a MAD application id
+json_t *resource_mad_lookup(uint16_t aid);
+// aid_desfire.json,  entry of a DESFire AID (as printed,  MSB first)
+json_t *resource_desfire_aid_lookup(uint32_t aid);
+// aidlist.json,  entry with the longest AID which is a prefix of hexaid
+json_t *resource_aid_lookup(const char *hexaid);
+
+#endif
@@ -48,12 +48,17 @@ uint32_t g_CursorCPos = 0, g_CursorDPos = 0, g_GraphStop = 0;
 uint32_t g_GraphStart = 0; // Starting point/offset for the left side of the graph
 double g_GraphPixelsPerPoint = 1.f; // How many visual pixels are between each sample point (x axis)
 static bool flushAfterWrite = 0;
+static bool print_capture = false;
+static char *capture_buf = NULL;
+static size_t capture_len = 0;
+static size_t capture_cap = 0;
 double g_GridOffset = 0;
 bool g_GridLocked = false;
 
 pthread_mutex_t g_print_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void fPrintAndLog(FILE *stream, const char *fmt, ...);
+static size_t filter_ansi_emoji(char *dest, size_t destlen, const char *src, size_t n, bool filter_ansi, emojiMode_t mode);
 
 // needed by flasher, so let's put it here instead of fileutils.c
 int searchHomeFilePath(char **foundpath, const char *subdir, const char *filename, bool create_home) {
@@ -271,26 +276,28 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
 
         token = strtok_r(buffer, delim, &tmp_ptr);
 
-        while (token != NULL) {
-
-            size_t size = strlen(buffer2);
+        size_t size = 0;
+        while (token != NULL && size < sizeof(buffer2)) {
 
+            int n;
             if (strlen(token))
-                snprintf(buffer2 + size, sizeof(buffer2) - size, "%s%s\n", prefix, token);
+                n = snprintf(buffer2 + size, sizeof(buffer2) - size, "%s%s\n", prefix, token);
             else
-                snprintf(buffer2 + size, sizeof(buffer2) - size, "\n");
+                n = snprintf(buffer2 + size, sizeof(buffer2) - size, "\n");
+
+            if (n > 0)
+                size += n;
 
             token = strtok_r(NULL, delim, &tmp_ptr);
         }
         fPrintAndLog(stream, "%s", buffer2);
     } else {
-        snprintf(buffer2, sizeof(buffer2), "%s%s", prefix, buffer);
+        int len = snprintf(buffer2, sizeof(buffer2), "%s%s", prefix, buffer);
         if (level == INPLACE) {
-            char buffer3[sizeof(buffer2)] = {0};
-            char buffer4[sizeof(buffer2)] = {0};
-            memcpy_filter_ansi(buffer3, buffer2, sizeof(buffer2), !g_session.supports_colors);
-            memcpy_filter_emoji(buffer4, buffer3, sizeof(buffer3), g_session.emoji_mode);
-            fprintf(stream, "\r%s", buffer4);
+            char buffer3[sizeof(buffer2)];
+            size_t n = filter_ansi_emoji(buffer3, sizeof(buffer3) - 1, buffer2, MIN((size_t)len, sizeof(buffer2) - 1), !g_session.supports_colors, g_session.emoji_mode);
+            buffer3[n] = '\0';
+            fprintf(stream, "\r%s", buffer3);
             fflush(stream);
         } else {
             fPrintAndLog(stream, "%s", buffer2);
@@ -298,13 +305,137 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 }
 
+// Session log writer.  Lines are queued under g_print_lock and a thread writes and
+// flushes them in batches,  so printing doesn't wait on the log file for every line.
+#define LOG_QUEUE_SIZE      (64 * 1024)
+#define LOG_FLUSH_INTERVAL  100  // ms
+
+static FILE *logfile = NULL;
+static char *log_queue = NULL;
+static char *log_spare = NULL;
+static size_t log_queue_len = 0;
+static bool log_threaded = false;
+static bool log_stop = false;
+static pthread_t log_thread;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t log_space = PTHREAD_COND_INITIALIZER;
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&log_lock);
+    for (;;) {
+        while (log_queue_len == 0 && log_stop == false)
+            pthread_cond_wait(&log_cond, &log_lock);
+
+        // give the queue some time to fill up,  unless it already is
+        if (log_stop == false && log_queue_len < LOG_QUEUE_SIZE / 2) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += LOG_FLUSH_INTERVAL * 1000000L;
+            ts.tv_sec += ts.tv_nsec / 1000000000L;
+            ts.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&log_cond, &log_lock, &ts);
+        }
+
+        char *buf = log_queue;
+        size_t len = log_queue_len;
+        log_queue = log_spare;
+        log_spare = buf;
+        log_queue_len = 0;
+        bool stop = log_stop;
+        pthread_cond_broadcast(&log_space);
+        pthread_mutex_unlock(&log_lock);
+
+        if (len) {
+            fwrite(buf, 1, len, logfile);
+            fflush(logfile);
+        }
+
+        pthread_mutex_lock(&log_lock);
+        if (stop && log_queue_len == 0)
+            break;
+    }
+    pthread_mutex_unlock(&log_lock);
+    return NULL;
+}
+
+static void log_close(void) {
+    if (log_threaded) {
+        pthread_mutex_lock(&log_lock);
+        log_stop = true;
+        pthread_cond_signal(&log_cond);
+        pthread_mutex_unlock(&log_lock);
+        pthread_join(log_thread, NULL);
+        log_threaded = false;
+    }
+    if (logfile) {
+        fclose(logfile);
+        logfile = NULL;
+    }
+    free(log_queue);
+    free(log_spare);
+    log_queue = log_spare = NULL;
+}
+
+static void log_start(void) {
+    log_queue = calloc(LOG_QUEUE_SIZE, sizeof(char));
+    log_spare = calloc(LOG_QUEUE_SIZE, sizeof(char));
+    if (log_queue && log_spare && pthread_create(&log_thread, NULL, log_writer, NULL) == 0)
+        log_threaded = true;
+
+    atexit(log_close);
+}
+
+static void log_append(const char *line, size_t len, bool linefeed) {
+    if (log_threaded == false) {
+        fwrite(line, 1, len, logfile);
+        if (linefeed)
+            fputc('\n', logfile);
+        fflush(logfile);
+        return;
+    }
+
+    size_t need = len + (linefeed ? 1 : 0);
+    pthread_mutex_lock(&log_lock);
+    while (log_queue_len + need > LOG_QUEUE_SIZE) {
+        pthread_cond_signal(&log_cond);
+        pthread_cond_wait(&log_space, &log_lock);
+    }
+
+    bool wake = (log_queue_len == 0);
+    memcpy(log_queue + log_queue_len, line, len);
+    log_queue_len += len;
+    if (linefeed)
+        log_queue[log_queue_len++] = '\n';
+
+    if (wake || log_queue_len >= LOG_QUEUE_SIZE / 2)
+        pthread_cond_signal(&log_cond);
+    pthread_mutex_unlock(&log_lock);
+}
+
+static void capture_append(const char *line, size_t len, bool linefeed) {
+    size_t need = capture_len + len + 2;
+    if (need > capture_cap) {
+        size_t cap = MAX(need, capture_cap * 2);
+        char *tmp = realloc(capture_buf, cap);
+        if (tmp == NULL)
+            return;
+        capture_buf = tmp;
+        capture_cap = cap;
+    }
+    memcpy(capture_buf + capture_len, line, len);
+    capture_len += len;
+    if (linefeed)
+        capture_buf[capture_len++] = '\n';
+    capture_buf[capture_len] = '\0';
+}
+
 static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     va_list argptr;
-    static FILE *logfile = NULL;
     static int logging = 1;
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER];
     // lock this section to avoid interlacing prints from different threads
     pthread_mutex_lock(&g_print_lock);
     bool linefeed = true;
@@ -335,7 +466,7 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
                 } else {
                     printf("[=] Session log %s\n", my_logfile_path);
                 }
-
+                log_start();
             }
             free(my_logfile_path);
         }
@@ -361,19 +492,25 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
 #endif
 
     va_start(argptr, fmt);
-    vsnprintf(buffer, sizeof(buffer), fmt, argptr);
+    int res = vsnprintf(buffer, sizeof(buffer), fmt, argptr);
     va_end(argptr);
-    if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == NOLF[0]) {
+    size_t len = (res < 0) ? 0 : MIN((size_t)res, sizeof(buffer) - 1);
+    buffer[len] = '\0';
+    if (len > 0 && buffer[len - 1] == NOLF[0]) {
         linefeed = false;
-        buffer[strlen(buffer) - 1] = 0;
+        buffer[--len] = '\0';
     }
-    bool filter_ansi = !g_session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
+
+    // only the bytes printed are filtered,  in one pass for each destination
     if (g_printAndLog & PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), g_session.emoji_mode);
-        fprintf(stream, "%s", buffer3);
-        if (linefeed)
-            fprintf(stream, "\n");
+        size_t n = filter_ansi_emoji(buffer2, sizeof(buffer2), buffer, len, !g_session.supports_colors, g_session.emoji_mode);
+        if (print_capture) {
+            capture_append(buffer2, n, linefeed);
+        } else {
+            fwrite(buffer2, 1, n, stream);
+            if (linefeed)
+                fputc('\n', stream);
+        }
     }
 
 #ifdef RL_STATE_READCMD
@@ -388,16 +525,8 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
 #endif
 
     if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), EMO_ALTTEXT);
-        if (filter_ansi) { // already done
-            fprintf(logfile, "%s", buffer3);
-        } else {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
-            fprintf(logfile, "%s", buffer);
-        }
-        if (linefeed)
-            fprintf(logfile, "\n");
-        fflush(logfile);
+        size_t n = filter_ansi_emoji(buffer2, sizeof(buffer2), buffer, len, true, EMO_ALTTEXT);
+        log_append(buffer2, n, linefeed);
     }
 
     if (flushAfterWrite)
@@ -411,6 +540,27 @@ void SetFlushAfterWrite(bool value) {
     flushAfterWrite = value;
 }
 
+// keep what would be printed in a buffer instead,  until PrintCaptureEnd()
+void PrintCaptureStart(void) {
+    pthread_mutex_lock(&g_print_lock);
+    capture_len = 0;
+    if (capture_buf)
+        capture_buf[0] = '\0';
+    print_capture = true;
+    pthread_mutex_unlock(&g_print_lock);
+}
+
+// returns the text kept since PrintCaptureStart(),  caller frees
+char *PrintCaptureEnd(void) {
+    pthread_mutex_lock(&g_print_lock);
+    print_capture = false;
+    char *text = (capture_buf) ? capture_buf : str_dup("");
+    capture_buf = NULL;
+    capture_len = capture_cap = 0;
+    pthread_mutex_unlock(&g_print_lock);
+    return text;
+}
+
 void memcpy_filter_rlmarkers(void *dest, const void *src, size_t n) {
     uint8_t *rdest = (uint8_t *)dest;
     uint8_t *rsrc = (uint8_t *)src;
@@ -561,6 +711,75 @@ void memcpy_filter_emoji(void *dest, const void *src, size_t n, emojiMode_t mode
     }
 }
 
+// Same result as memcpy_filter_ansi() followed by memcpy_filter_emoji(),  in a single
+// pass over the n bytes of src.  Returns the number of bytes written,  no NUL added.
+static size_t filter_ansi_emoji(char *dest, size_t destlen, const char *src, size_t n, bool filter_ansi, emojiMode_t mode) {
+    const uint8_t *rsrc = (const uint8_t *)src;
+    size_t si = 0;
+    // start of the emoji token being collected in dest
+    bool in_token = false;
+    size_t token = 0;
+
+    for (size_t i = 0; i < n && si < destlen; i++) {
+        if (filter_ansi
+                && (i < n - 1)
+                && (rsrc[i] == '\x1b')
+                && (rsrc[i + 1] >= 0x40)
+                && (rsrc[i + 1] <= 0x5F)) {  // entering ANSI sequence
+
+            i++;
+            if ((i < n - 1) && (rsrc[i] == '[')) { // entering CSI sequence
+                i++;
+
+                while ((i < n - 1) && (rsrc[i] >= 0x30) && (rsrc[i] <= 0x3F)) { // parameter bytes
+                    i++;
+                }
+
+                while ((i < n - 1) && (rsrc[i] >= 0x20) && (rsrc[i] <= 0x2F)) { // intermediate bytes
+                    i++;
+                }
+
+                if ((rsrc[i] >= 0x40) && (rsrc[i] <= 0x7F)) { // final byte
+                    continue;
+                }
+            } else {
+                continue;
+            }
+        }
+
+        uint8_t c = rsrc[i];
+        dest[si++] = c;
+
+        if (mode == EMO_ALIAS)
+            continue;
+
+        // tokens are collected in dest and replaced there once complete
+        if (in_token == false) {
+            if (c == ':') {
+                in_token = true;
+                token = si - 1;
+            }
+        } else if (c == ':') {
+            const char *emojified_token = NULL;
+            uint8_t emojified_token_length = 0;
+            size_t token_length = si - token;
+            if ((token_length < 256)
+                    && emojify_token(dest + token, token_length, &emojified_token, &emojified_token_length, mode)
+                    && (token + emojified_token_length <= destlen)) {
+                memcpy(dest + token, emojified_token, emojified_token_length);
+                si = token + emojified_token_length;
+                in_token = false;
+            } else {
+                // the ending ':' might start an upcoming emoji
+                token = si - 1;
+            }
+        } else if (token_charset(c) == false) {
+            in_token = false;
+        }
+    }
+    return si;
+}
+
 /*
 // If reactivated, beware it doesn't compile on Android (DXL)
 void iceIIR_Butterworth(int *data, const size_t len) {
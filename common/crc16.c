@@ -12,19 +12,16 @@
 
 static uint16_t crc_table[256];
 static bool crc_table_init = false;
-static CrcType_t current_crc_type = CRC_NONE;
+// parameters the table was generated with
+static uint16_t crc_table_poly = 0;
+static bool crc_table_refin = false;
 
+// Makes the table fit crctype.  Nothing is written when it already does,  so once the
+// table is set up for an algo,  threads using algos with that table only read it.
 void init_table(CrcType_t crctype) {
 
-    // same crc algo, and initialised already
-    if (crctype == current_crc_type && crc_table_init)
-        return;
-
-    // not the same crc algo. reset table.
-    if (crctype != current_crc_type)
-        reset_table();
-
-    current_crc_type = crctype;
+    uint16_t polynomial;
+    bool refin;
 
     switch (crctype) {
         case CRC_14443_A:
@@ -32,29 +29,40 @@ void init_table(CrcType_t crctype) {
         case CRC_15693:
         case CRC_ICLASS:
         case CRC_CRYPTORF:
-            generate_table(CRC16_POLY_CCITT, true);
+            polynomial = CRC16_POLY_CCITT;
+            refin = true;
             break;
         case CRC_FELICA:
         case CRC_XMODEM:
-            generate_table(CRC16_POLY_CCITT, false);
+            polynomial = CRC16_POLY_CCITT;
+            refin = false;
             break;
         case CRC_LEGIC:
-            generate_table(CRC16_POLY_LEGIC, true);
+            polynomial = CRC16_POLY_LEGIC;
+            refin = true;
             break;
         case CRC_CCITT:
-            generate_table(CRC16_POLY_CCITT, false);
+            polynomial = CRC16_POLY_CCITT;
+            refin = false;
             break;
         case CRC_KERMIT:
-            generate_table(CRC16_POLY_CCITT, true);
+            polynomial = CRC16_POLY_CCITT;
+            refin = true;
             break;
         case CRC_11784:
-            generate_table(CRC16_POLY_CCITT, false);
+            polynomial = CRC16_POLY_CCITT;
+            refin = false;
             break;
         case CRC_NONE:
-            crc_table_init = false;
-            current_crc_type = CRC_NONE;
-            break;
+        default:
+            return;
     }
+
+    // algos sharing a table don't touch it,  e.g. switching between CRC-A and CRC-B
+    if (crc_table_init && polynomial == crc_table_poly && refin == crc_table_refin)
+        return;
+
+    generate_table(polynomial, refin);
 }
 
 void generate_table(uint16_t polynomial, bool refin) {
@@ -80,13 +88,14 @@ void generate_table(uint16_t polynomial, bool refin) {
 
         crc_table[i] = crc;
     }
+    crc_table_poly = polynomial;
+    crc_table_refin = refin;
     crc_table_init = true;
 }
 
 void reset_table(void) {
     memset(crc_table, 0, sizeof(crc_table));
     crc_table_init = false;
-    current_crc_type = CRC_NONE;
 }
 
 // table lookup LUT solution
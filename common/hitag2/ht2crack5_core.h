@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// HiTag2 key recovery from two {nR}{aR} pairs, the bitsliced CPU attack
+// shared by the client and tools/hitag2crack/crack5
+//-----------------------------------------------------------------------------
+
+#ifndef HT2CRACK5_CORE_H__
+#define HT2CRACK5_CORE_H__
+
+#include "common.h"
+
+typedef struct {
+    uint32_t next;      // every layer 0 candidate below this one is searched
+    uint32_t finished;  // layer 0 candidates searched, including the skipped ones
+    uint32_t total;     // layer 0 candidates of the first {aR}
+} ht2crack5_progress_t;
+
+// called from the searching thread about every 100 ms, return false to stop the search
+typedef bool (*ht2crack5_poll_t)(const ht2crack5_progress_t *progress, void *arg);
+
+/**
+ * Searches the key of a HiTag2 tag.
+ * uid   - 4 bytes tag UID as seen over the air
+ * nrar1 - 8 bytes {nR}{aR} of the first authentication
+ * nrar2 - 8 bytes {nR}{aR} of a second authentication, used to confirm candidates
+ * threads - number of worker threads, at least 1
+ * start - layer 0 candidate to start from, 0 or last->next of an earlier stopped search
+ * poll  - progress and stop callback, can be NULL
+ * last  - progress when the search ended, last->next is where a stopped search resumes, can be NULL
+ * key   - 6 bytes key output
+ * Returns PM3_SUCCESS when found, PM3_ESOFT when the search space is exhausted,
+ * PM3_EOPABORTED when poll stopped the search and PM3_EINVARG when start is out of range.
+ */
+int ht2crack5_search(const uint8_t *uid, const uint8_t *nrar1, const uint8_t *nrar2, uint32_t threads,
+                     uint32_t start, ht2crack5_poll_t poll, void *arg, ht2crack5_progress_t *last, uint8_t *key);
+
+#endif
@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// ISO 14443 type A Miller (reader) and Manchester (tag) decoders
+//-----------------------------------------------------------------------------
+
+#ifndef __ISO14443A_DECODE_H
+#define __ISO14443A_DECODE_H
+
+#include "common.h"
+
+// output buffer size the decoders rely on, parity needs (ISO14A_MAX_FRAME_SIZE + 7) / 8
+#define ISO14A_MAX_FRAME_SIZE   256
+
+typedef struct {
+    enum {
+        DEMOD_14A_UNSYNCD,
+        // DEMOD_14A_HALF_SYNCD,
+        // DEMOD_14A_MOD_FIRST_HALF,
+        // DEMOD_14A_NOMOD_FIRST_HALF,
+        DEMOD_14A_MANCHESTER_DATA
+    } state;
+    uint16_t twoBits;
+    uint16_t highCnt;
+    uint16_t bitCount;
+    uint16_t collisionPos;
+    uint16_t syncBit;
+    uint8_t  parityBits;
+    uint8_t  parityLen;
+    uint16_t shiftReg;
+    uint16_t samples;
+    uint16_t len;
+    uint32_t startTime, endTime;
+    uint8_t  *output;
+    uint8_t  *parity;
+} tDemod14a;
+/*
+typedef enum {
+    MOD_NOMOD = 0,
+    MOD_SECOND_HALF,
+    MOD_FIRST_HALF,
+    MOD_BOTH_HALVES
+    } Modulation_t;
+*/
+
+typedef struct {
+    enum {
+        STATE_14A_UNSYNCD,
+        STATE_14A_START_OF_COMMUNICATION,
+        STATE_14A_MILLER_X,
+        STATE_14A_MILLER_Y,
+        STATE_14A_MILLER_Z,
+        // DROP_NONE,
+        // DROP_FIRST_HALF,
+    } state;
+    uint16_t shiftReg;
+    int16_t bitCount;
+    uint16_t len;
+    //uint16_t byteCntMax;
+    uint16_t posCnt;
+    uint16_t syncBit;
+    uint8_t  parityBits;
+    uint8_t  parityLen;
+    uint32_t fourBits;
+    uint32_t startTime, endTime;
+    uint8_t *output;
+    uint8_t *parity;
+} tUart14a;
+
+void Uart14aStateReset(tUart14a *uart);
+void Uart14aStateInit(tUart14a *uart, uint8_t *data, uint8_t *par);
+// feeds 8 raw samples, returns true when a complete reader frame is in uart->output
+RAMFUNC bool Miller14aDecode(tUart14a *uart, uint8_t bit, uint32_t non_real_time);
+
+// Lookup-Table to decide if 4 raw bits are a tag modulation, also used by the firmware Thinfilm decoder
+extern const bool Mod_Manchester_LUT[16];
+#define IsManchesterModulationNibble1(b) (Mod_Manchester_LUT[(b & 0x00F0) >> 4])
+#define IsManchesterModulationNibble2(b) (Mod_Manchester_LUT[(b & 0x000F)])
+
+void Demod14aStateReset(tDemod14a *demod);
+void Demod14aStateInit(tDemod14a *demod, uint8_t *data, uint8_t *par);
+// feeds 8 raw samples, returns true when a complete tag frame is in demod->output
+RAMFUNC int Manchester14aDecode(tDemod14a *demod, uint8_t bit, uint16_t offset, uint32_t non_real_time);
+
+#endif
@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// ISO 14443 type B reader command and tag response decoders
+//-----------------------------------------------------------------------------
+
+#ifndef __ISO14443B_DECODE_H
+#define __ISO14443B_DECODE_H
+
+#include "common.h"
+
+// default maximum reader frame, restored by Uart14bStateReset()
+#define ISO14B_MAX_FRAME_SIZE   256
+
+#define SUBCARRIER_DETECT_THRESHOLD  8
+// Subcarrier amplitude v = sqrt(ci^2 + cq^2), approximated here by max(abs(ci),abs(cq)) + 1/2*min(abs(ci),abs(cq)))
+#define AMPLITUDE(ci,cq) (MAX(ABS(ci),ABS(cq)) + (MIN(ABS(ci),ABS(cq))/2))
+
+typedef struct {
+    enum {
+        STATE_14B_UNSYNCD,
+        STATE_14B_GOT_FALLING_EDGE_OF_SOF,
+        STATE_14B_AWAITING_START_BIT,
+        STATE_14B_RECEIVING_DATA
+    }       state;
+    uint16_t shiftReg;
+    int      bitCnt;
+    int      byteCnt;
+    int      byteCntMax;
+    int      posCnt;
+    uint8_t  *output;
+} tUart14b;
+
+typedef struct {
+    enum {
+        DEMOD_UNSYNCD,
+        DEMOD_PHASE_REF_TRAINING,
+        WAIT_FOR_RISING_EDGE_OF_SOF,
+        DEMOD_AWAITING_START_BIT,
+        DEMOD_RECEIVING_DATA
+    }       state;
+    uint16_t bitCount;
+    int      posCount;
+    int      thisBit;
+    uint16_t shiftReg;
+    uint16_t max_len;
+    uint8_t  *output;
+    uint16_t len;
+    int      sumI;
+    int      sumQ;
+} tDemod14b;
+
+void Uart14bStateReset(tUart14b *uart);
+void Uart14bStateInit(tUart14b *uart, uint8_t *data);
+// feeds one sample bit, returns true once the EOF is received
+RAMFUNC int Handle14443bSampleFromReader(tUart14b *uart, uint8_t bit);
+
+void Demod14bStateReset(tDemod14b *demod);
+void Demod14bStateInit(tDemod14b *demod, uint8_t *data, uint16_t max_len);
+// feeds one I/Q sample pair, returns true once the EOF is received
+RAMFUNC int Handle14443bSamplesFromTag(tDemod14b *demod, int ci, int cq);
+
+#endif
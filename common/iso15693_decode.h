@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// ISO 15693 tag response and reader command decoders
+//-----------------------------------------------------------------------------
+
+#ifndef __ISO15693_DECODE_H
+#define __ISO15693_DECODE_H
+
+#include "common.h"
+
+#define NOISE_THRESHOLD          80                   // don't try to correlate noise
+#define MAX_PREVIOUS_AMPLITUDE   (-1 - NOISE_THRESHOLD)
+
+typedef struct {
+    enum {
+        STATE_TAG_SOF_LOW,
+        STATE_TAG_SOF_RISING_EDGE,
+        STATE_TAG_SOF_HIGH,
+        STATE_TAG_SOF_HIGH_END,
+        STATE_TAG_RECEIVING_DATA,
+        STATE_TAG_EOF,
+        STATE_TAG_EOF_TAIL
+    } state;
+    int bitCount;
+    int posCount;
+    enum {
+        LOGIC0,
+        LOGIC1,
+        SOF_PART1,
+        SOF_PART2
+    } lastBit;
+    uint16_t shiftReg;
+    uint16_t max_len;
+    uint8_t *output;
+    int len;
+    int sum1;
+    int sum2;
+    int threshold_sof;
+    int threshold_half;
+    uint16_t  previous_amplitude;
+} DecodeTag_t;
+
+void DecodeTagReset(DecodeTag_t *tag);
+void DecodeTagInit(DecodeTag_t *tag, uint8_t *data, uint16_t max_len);
+// feeds one amplitude sample, returns true once the EOF is received
+RAMFUNC int Handle15693SamplesFromTag(uint16_t amplitude, DecodeTag_t *tag);
+
+typedef struct {
+    enum {
+        STATE_READER_UNSYNCD,
+        STATE_READER_AWAIT_1ST_FALLING_EDGE_OF_SOF,
+        STATE_READER_AWAIT_1ST_RISING_EDGE_OF_SOF,
+        STATE_READER_AWAIT_2ND_FALLING_EDGE_OF_SOF,
+        STATE_READER_AWAIT_2ND_RISING_EDGE_OF_SOF,
+        STATE_READER_AWAIT_END_OF_SOF_1_OUT_OF_4,
+        STATE_READER_RECEIVE_DATA_1_OUT_OF_4,
+        STATE_READER_RECEIVE_DATA_1_OUT_OF_256,
+        STATE_READER_RECEIVE_JAMMING
+    }           state;
+    enum {
+        CODING_1_OUT_OF_4,
+        CODING_1_OUT_OF_256
+    }           Coding;
+    uint8_t     shiftReg;
+    uint8_t     bitCount;
+    int         byteCount;
+    int         byteCountMax;
+    int         posCount;
+    int         sum1, sum2;
+    uint8_t     *output;
+    uint8_t     jam_search_len;
+    uint8_t     *jam_search_string;
+} DecodeReader_t;
+
+void DecodeReaderInit(DecodeReader_t *reader, uint8_t *data, uint16_t max_len, uint8_t jam_search_len, uint8_t *jam_search_string);
+void DecodeReaderReset(DecodeReader_t *reader);
+// feeds one sample bit, returns true once the EOF is received.
+// A jam_search_string makes the firmware jam the rest of a matching command.
+int RAMFUNC Handle15693SampleFromReader(bool bit, DecodeReader_t *reader);
+
+#endif
@@ -38,7 +38,6 @@
 
 #include "lfdemod.h"
 #include <string.h>  // for memset, memcmp and size_t
-#include <stdlib.h>  // qsort
 #include "parity.h"  // for parity test
 #include "pm3_cmd.h" // error codes
 #include "commonutil.h"  // Arraylen
@@ -86,11 +85,35 @@ static void printSignal(void) {
 }
 
 #ifndef ON_DEVICE
-static int cmp_uint8(const void *a, const void *b) {
-    if (*(const uint8_t *)a < * (const uint8_t *)b)
-        return -1;
-    else
-        return *(const uint8_t *)a > *(const uint8_t *)b;
+// 8 bit samples only take 256 values, a histogram gives the sorted order in one pass.
+// Four partial histograms keep repeated values from stalling on the same counter.
+static void sample_histogram(const uint8_t *samples, uint32_t size, uint32_t *hist) {
+    uint32_t part[4][256];
+    memset(part, 0, sizeof(part));
+
+    uint32_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        part[0][samples[i]]++;
+        part[1][samples[i + 1]]++;
+        part[2][samples[i + 2]]++;
+        part[3][samples[i + 3]]++;
+    }
+    for (; i < size; i++)
+        part[0][samples[i]]++;
+
+    for (int v = 0; v < 256; v++)
+        hist[v] = part[0][v] + part[1][v] + part[2][v] + part[3][v];
+}
+
+// sample value at index <rank> of the sorted samples
+static uint8_t histogram_rank(const uint32_t *hist, uint32_t rank) {
+    uint32_t cnt = 0;
+    for (int v = 0; v < 256; v++) {
+        cnt += hist[v];
+        if (cnt > rank)
+            return v;
+    }
+    return 255;
 }
 #endif
 
@@ -103,23 +126,24 @@ void computeSignalProperties(uint8_t *samples, uint32_t size) {
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
 #ifndef ON_DEVICE
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    sample_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.1)] + tmp[(int)((offset_size - 1) * 0.1)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.9)] + tmp[(int)((offset_size - 1) * 0.9)]);
+    uint8_t low10 = 0.5 * (histogram_rank(hist, (uint32_t)(offset_size * 0.1)) + histogram_rank(hist, (uint32_t)((offset_size - 1) * 0.1)));
+    uint8_t hi90 =  0.5 * (histogram_rank(hist, (uint32_t)(offset_size * 0.9)) + histogram_rank(hist, (uint32_t)((offset_size - 1) * 0.9)));
     uint32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
+    for (int v = 0; v < 256; v++) {
+        if (hist[v] == 0)
+            continue;
 
-        if (samples[i] < signalprop.low) signalprop.low = samples[i];
-        if (samples[i] > signalprop.high) signalprop.high = samples[i];
+        if (v < signalprop.low) signalprop.low = v;
+        if (v > signalprop.high) signalprop.high = v;
 
-        if (samples[i] < low10 || samples[i] > hi90)
+        if (v < low10 || v > hi90)
             continue;
 
-        sum += samples[i];
-        cnt++;
+        sum += v * hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         signalprop.mean = sum / cnt;
@@ -151,21 +175,15 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
 #ifndef ON_DEVICE
+    uint32_t hist[256];
+    sample_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
-
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.05)] + tmp[(int)((offset_size - 1) * 0.05)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.95)] + tmp[(int)((offset_size - 1) * 0.95)]);
+    uint8_t low10 = 0.5 * (histogram_rank(hist, (uint32_t)(offset_size * 0.05)) + histogram_rank(hist, (uint32_t)((offset_size - 1) * 0.05)));
+    uint8_t hi90 =  0.5 * (histogram_rank(hist, (uint32_t)(offset_size * 0.95)) + histogram_rank(hist, (uint32_t)((offset_size - 1) * 0.95)));
     int32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
-
-        if (samples[i] < low10 || samples[i] > hi90)
-            continue;
-
-        acc_off += samples[i] - 128;
-        cnt++;
+    for (int v = low10; v <= hi90; v++) {
+        acc_off += (v - 128) * (int)hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         acc_off /= cnt;
@@ -179,13 +197,13 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
 #endif
 
     // shift and saturate samples to center the mean
-    for (uint32_t i = 0; i < size; i++) {
-        if (acc_off > 0) {
+    if (acc_off > 0) {
+        for (uint32_t i = 0; i < size; i++)
             samples[i] = (samples[i] >= acc_off) ? samples[i] - acc_off : 0;
-        }
-        if (acc_off < 0) {
-            samples[i] = (255 - samples[i] >=  -acc_off) ? samples[i] - acc_off : 255;
-        }
+    }
+    if (acc_off < 0) {
+        for (uint32_t i = 0; i < size; i++)
+            samples[i] = (255 - samples[i] >= -acc_off) ? samples[i] - acc_off : 255;
     }
 }
 
@@ -435,12 +453,12 @@ static int getClosestClock(int testclk) {
 }
 
 void getNextLow(uint8_t *samples, size_t size, int low, size_t *i) {
-    while ((samples[*i] > low) && (*i < size))
+    while ((*i < size) && (samples[*i] > low))
         *i += 1;
 }
 
 void getNextHigh(uint8_t *samples, size_t size, int high, size_t *i) {
-    while ((samples[*i] < high) && (*i < size))
+    while ((*i < size) && (samples[*i] < high))
         *i += 1;
 }
 
@@ -782,7 +800,8 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
         for (; j < loopCnt; j++) {
             errCnt = 0;
             // now that we have the first one lined up test rest of wave array
-            loopEnd = ((size - j - tol) / clk[clkCnt]) - 1;
+            // less than a clock left, nothing to line up
+            loopEnd = (size >= j + tol + clk[clkCnt]) ? ((size - j - tol) / clk[clkCnt]) - 1 : 0;
             for (i = 0; i < loopEnd; ++i) {
                 arrLoc = j + (i * clk[clkCnt]);
                 if (dest[arrLoc] >= peak_hi || dest[arrLoc] <= peak_low) {
@@ -1448,7 +1467,7 @@ bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, s
         for (i = 0; i < datalen; ++i) {
             if (i + newloc < bufsize) {
                 if (i + newloc < dataloc)
-                    buffer[i + newloc] = buffer[dataloc];
+                    buffer[i + newloc] = (dataloc < bufsize) ? buffer[dataloc] : 0;
 
                 dataloc++;
             }
@@ -1458,7 +1477,8 @@ bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, s
         if (g_debugMode == 2) prnt("DEBUG STT: skipping STT at %zu to %zu", dataloc, dataloc + (clk * 4));
         dataloc += clk * 4;
     }
-    *size = newloc;
+    // the last block is counted in full, even when the buffer ended in it
+    *size = MIN(newloc, bufsize);
     return true;
 }
 
@@ -1934,6 +1954,8 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
 //rfLen = clock, fchigh = larger field clock, fclow = smaller field clock
 static size_t aggregate_bits(uint8_t *dest, size_t size, uint8_t clk, uint8_t invert, uint8_t fchigh, uint8_t fclow, int *startIdx) {
 
+    if (size < 2) return 0;
+
     uint8_t lastval = dest[0];
     size_t i = 0;
     size_t numBits = 0;
@@ -0,0 +1,674 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic card model
+//-----------------------------------------------------------------------------
+#include "mfc_model.h"
+
+#include <string.h>
+#include "commonutil.h"
+#include "parity.h"
+#include "crc16.h"
+#include "protocols.h"
+
+// power up state of the PRNG of NXP cards
+#define MFC_PRNG_START   0x01200145
+
+// PRNG repeats after 2^16 - 1 steps
+#define MFC_PRNG_PERIOD  65535
+
+#define MFC_NACK_PARITY  0x05
+
+uint8_t mfc_sector_trailer(uint8_t blockNo) {
+    return (blockNo < 128) ? (blockNo | 0x03) : (blockNo | 0x0f);
+}
+
+uint8_t mfc_block_to_sector(uint8_t blockNo) {
+    return (blockNo < 128) ? (blockNo >> 2) : (32 + ((blockNo - 128) >> 4));
+}
+
+uint8_t mfc_first_block(uint8_t sectorNo) {
+    return (sectorNo < 32) ? (sectorNo * 4) : (128 + (sectorNo - 32) * 16);
+}
+
+uint8_t mfc_blocks_per_sector(uint8_t sectorNo) {
+    return (sectorNo < 32) ? 4 : 16;
+}
+
+bool mfc_is_trailer(uint8_t blockNo) {
+    return (blockNo == mfc_sector_trailer(blockNo));
+}
+
+static bool mfc_trailer_access(const uint8_t *trailer, uint8_t keytype, uint8_t action) {
+    uint8_t AC = ((trailer[7] >> 5) & 0x04)
+                 | ((trailer[8] >> 2) & 0x02)
+                 | ((trailer[8] >> 7) & 0x01);
+    switch (action) {
+        case AC_KEYA_READ:
+            return false;
+        case AC_KEYA_WRITE:
+        case AC_KEYB_WRITE:
+            return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x01))
+                    || (keytype == AUTHKEYB && (AC == 0x04 || AC == 0x03)));
+        case AC_KEYB_READ:
+            return (keytype == AUTHKEYA && (AC == 0x00 || AC == 0x02 || AC == 0x01));
+        case AC_AC_READ:
+            return ((keytype == AUTHKEYA)
+                    || (keytype == AUTHKEYB && !(AC == 0x00 || AC == 0x02 || AC == 0x01)));
+        case AC_AC_WRITE:
+            return ((keytype == AUTHKEYA && (AC == 0x01))
+                    || (keytype == AUTHKEYB && (AC == 0x03 || AC == 0x05)));
+        default:
+            return false;
+    }
+}
+
+static bool mfc_data_access(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, uint8_t action) {
+
+    // 16 block sectors of 4k cards group their data blocks by 5
+    uint8_t group = (blockNo < 128) ? (blockNo & 0x03) : ((blockNo & 0x0f) / 5);
+
+    uint8_t AC;
+    switch (group) {
+        case 0x00:
+            AC = ((trailer[7] >> 2) & 0x04)
+                 | ((trailer[8] << 1) & 0x02)
+                 | ((trailer[8] >> 4) & 0x01);
+            break;
+        case 0x01:
+            AC = ((trailer[7] >> 3) & 0x04)
+                 | ((trailer[8] >> 0) & 0x02)
+                 | ((trailer[8] >> 5) & 0x01);
+            break;
+        case 0x02:
+            AC = ((trailer[7] >> 4) & 0x04)
+                 | ((trailer[8] >> 1) & 0x02)
+                 | ((trailer[8] >> 6) & 0x01);
+            break;
+        default:
+            return false;
+    }
+
+    switch (action) {
+        case AC_DATA_READ:
+            return ((keytype == AUTHKEYA && !(AC == 0x03 || AC == 0x05 || AC == 0x07))
+                    || (keytype == AUTHKEYB && !(AC == 0x07)));
+        case AC_DATA_WRITE:
+            return ((keytype == AUTHKEYA && (AC == 0x00))
+                    || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x04 || AC == 0x06 || AC == 0x03)));
+        case AC_DATA_INC:
+            return ((keytype == AUTHKEYA && (AC == 0x00))
+                    || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x06)));
+        case AC_DATA_DEC_TRANS_REST:
+            return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x06 || AC == 0x01))
+                    || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x06 || AC == 0x01)));
+        default:
+            return false;
+    }
+}
+
+bool mfc_access_allowed(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, uint8_t action) {
+    if (mfc_is_trailer(blockNo))
+        return mfc_trailer_access(trailer, keytype, action);
+    else
+        return mfc_data_access(trailer, blockNo, keytype, action);
+}
+
+void mfc_read_mask(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, uint8_t *data) {
+    if (mfc_is_trailer(blockNo)) {
+        if (mfc_trailer_access(trailer, keytype, AC_KEYA_READ) == false)
+            memset(data, 0x00, 6);
+        if (mfc_trailer_access(trailer, keytype, AC_KEYB_READ) == false)
+            memset(data + 10, 0x00, 6);
+        if (mfc_trailer_access(trailer, keytype, AC_AC_READ) == false)
+            memset(data + 6, 0x00, 4);
+    } else {
+        if (mfc_data_access(trailer, blockNo, keytype, AC_DATA_READ) == false)
+            memset(data, 0x00, MFC_BLOCK_SIZE);
+    }
+}
+
+void mfc_write_mask(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, const uint8_t *old, uint8_t *data) {
+    if (mfc_is_trailer(blockNo)) {
+        if (mfc_trailer_access(trailer, keytype, AC_KEYA_WRITE) == false)
+            memcpy(data, old, 6);
+        if (mfc_trailer_access(trailer, keytype, AC_KEYB_WRITE) == false)
+            memcpy(data + 10, old + 10, 6);
+        if (mfc_trailer_access(trailer, keytype, AC_AC_WRITE) == false)
+            memcpy(data + 6, old + 6, 4);
+    } else {
+        if (mfc_data_access(trailer, blockNo, keytype, AC_DATA_WRITE) == false)
+            memcpy(data, old, MFC_BLOCK_SIZE);
+    }
+}
+
+bool mfc_value_get(const uint8_t *data, int32_t *value, uint8_t *addr) {
+    for (uint8_t i = 0; i < 4; i++) {
+        if ((data[i] ^ data[i + 4]) != 0xff || data[i] != data[i + 8])
+            return false;
+    }
+    if ((data[12] ^ data[13]) != 0xff || data[12] != data[14] || (data[12] ^ data[15]) != 0xff)
+        return false;
+
+    if (value)
+        *value = (int32_t)MemLeToUint4byte((uint8_t *)data);
+    if (addr)
+        *addr = data[12];
+    return true;
+}
+
+void mfc_value_set(uint8_t *data, int32_t value, uint8_t addr) {
+    Uint4byteToMemLe(data, (uint32_t)value);
+    Uint4byteToMemLe(data + 4, ~(uint32_t)value);
+    Uint4byteToMemLe(data + 8, (uint32_t)value);
+    data[12] = addr;
+    data[13] = addr ^ 0xff;
+    data[14] = addr;
+    data[15] = addr ^ 0xff;
+}
+
+//-----------------------------------------------------------------------------
+// Frame engine
+//-----------------------------------------------------------------------------
+
+static bool frame_par(const mfc_frame_t *f, uint8_t i) {
+    return (f->par[i >> 3] >> (7 - (i & 0x07))) & 0x01;
+}
+
+static void frame_set_par(mfc_frame_t *f, uint8_t i, uint8_t bit) {
+    if ((i & 0x07) == 0)
+        f->par[i >> 3] = 0;
+    f->par[i >> 3] |= (bit & 0x01) << (7 - (i & 0x07));
+}
+
+void mfc_frame_plain(mfc_frame_t *f, const uint8_t *data, uint8_t len, bool crc) {
+    memcpy(f->data, data, len);
+    if (crc) {
+        compute_crc(CRC_14443_A, f->data, len, &f->data[len], &f->data[len + 1]);
+        len += 2;
+    }
+    for (uint8_t i = 0; i < len; i++)
+        frame_set_par(f, i, oddparity8(f->data[i]));
+    f->bits = len * 8;
+}
+
+static bool plain_parity_ok(const mfc_frame_t *f, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        if (frame_par(f, i) != oddparity8(f->data[i]))
+            return false;
+    }
+    return true;
+}
+
+// decrypts a reader frame, the parity of an encrypted byte is the plain one xor the next keystream bit
+static bool card_decrypt(mfc_card_t *card, const mfc_frame_t *rx, uint8_t len, uint8_t *out) {
+    bool ok = true;
+    for (uint8_t i = 0; i < len; i++) {
+        out[i] = crypto1_byte(&card->cs, 0x00, 0) ^ rx->data[i];
+        if (frame_par(rx, i) != ((filter(card->cs.odd) ^ oddparity8(out[i])) & 0x01))
+            ok = false;
+    }
+    return ok;
+}
+
+static uint16_t card_send(mfc_card_t *card, const uint8_t *data, uint8_t len, mfc_frame_t *tx) {
+    if (card->auth_key == AUTHKEYNONE) {
+        mfc_frame_plain(tx, data, len, false);
+    } else {
+        for (uint8_t i = 0; i < len; i++) {
+            tx->data[i] = crypto1_byte(&card->cs, 0x00, 0) ^ data[i];
+            frame_set_par(tx, i, filter(card->cs.odd) ^ oddparity8(data[i]));
+        }
+        tx->bits = len * 8;
+    }
+    return tx->bits;
+}
+
+static uint16_t card_send4(mfc_card_t *card, uint8_t nibble, mfc_frame_t *tx) {
+    if (nibble != CARD_ACK)
+        card->stats.nacks++;
+
+    if (card->auth_key != AUTHKEYNONE) {
+        uint8_t bt = 0;
+        for (uint8_t i = 0; i < 4; i++)
+            bt |= (crypto1_bit(&card->cs, 0, 0) ^ BIT(nibble, i)) << i;
+        nibble = bt;
+    }
+    tx->data[0] = nibble;
+    tx->par[0] = 0;
+    tx->bits = 4;
+    return tx->bits;
+}
+
+static uint16_t card_send_crc(mfc_card_t *card, uint8_t *data, uint8_t len, mfc_frame_t *tx) {
+    compute_crc(CRC_14443_A, data, len, &data[len], &data[len + 1]);
+    return card_send(card, data, len + 2, tx);
+}
+
+static uint8_t *card_block(mfc_card_t *card, uint8_t blockNo) {
+    return card->mem + blockNo * MFC_BLOCK_SIZE;
+}
+
+static uint8_t *card_trailer(mfc_card_t *card, uint8_t blockNo) {
+    return card_block(card, mfc_sector_trailer(blockNo));
+}
+
+uint64_t mfc_card_key(const mfc_card_t *card, uint8_t sectorNo, uint8_t keytype) {
+    uint8_t trailer = mfc_first_block(sectorNo) + mfc_blocks_per_sector(sectorNo) - 1;
+    return bytes_to_num((uint8_t *)card->mem + trailer * MFC_BLOCK_SIZE + (keytype ? 10 : 0), 6);
+}
+
+static void card_deauth(mfc_card_t *card, mfc_state_t state) {
+    crypto1_deinit(&card->cs);
+    card->auth_key = AUTHKEYNONE;
+    card->pending_cmd = 0;
+    card->state = state;
+}
+
+// back to idle on a protocol error, a halted card stays halted
+static uint16_t card_error(mfc_card_t *card) {
+    card_deauth(card, (card->state == MFC_STATE_HALT) ? MFC_STATE_HALT : MFC_STATE_IDLE);
+    return 0;
+}
+
+static uint32_t card_nonce(mfc_card_t *card) {
+    switch (card->nt_mode) {
+        case MFC_NT_STATIC:
+            return card->nt_seed;
+        case MFC_NT_HARD: {
+            // a counter through the murmur3 finalizer. A linear generator as
+            // xorshift skews the parity sums the hardnested attack relies on
+            card->nt_seed += 0x9e3779b9;
+            uint32_t z = card->nt_seed;
+            z = (z ^ (z >> 16)) * 0x85ebca6b;
+            z = (z ^ (z >> 13)) * 0xc2b2ae35;
+            return z ^ (z >> 16);
+        }
+        case MFC_NT_WEAK:
+        default:
+            return card->prng;
+    }
+}
+
+void mfc_card_init(mfc_card_t *card, uint16_t blocks, const uint8_t *uid, uint8_t uid_len) {
+    memset(card, 0, sizeof(mfc_card_t));
+
+    if (blocks > MFC_MAX_BLOCKS)
+        blocks = MFC_MAX_BLOCKS;
+    card->blocks = blocks;
+
+    card->uid_len = (uid_len == 7 || uid_len == 10) ? uid_len : 4;
+    memcpy(card->uid, uid, card->uid_len);
+    card->cuid = bytes_to_num(card->uid + card->uid_len - 4, 4);
+
+    card->atqa[0] = (card->uid_len == 4) ? 0x04 : (card->uid_len == 7) ? 0x44 : 0x84;
+    card->sak = (blocks > 128) ? 0x18 : (blocks < 64) ? 0x09 : 0x08;
+
+    // transport configuration, keys FFFFFFFFFFFF and access bits FF0780
+    static const uint8_t transport[MFC_BLOCK_SIZE] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x07, 0x80, 0x69, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    for (uint16_t b = 0; b < blocks; b++) {
+        if (mfc_is_trailer(b))
+            memcpy(card_block(card, b), transport, MFC_BLOCK_SIZE);
+    }
+
+    // manufacturer block
+    uint8_t *b0 = card_block(card, 0);
+    memcpy(b0, card->uid, card->uid_len);
+    if (card->uid_len == 4) {
+        b0[4] = b0[0] ^ b0[1] ^ b0[2] ^ b0[3];
+        b0[5] = card->sak;
+        b0[6] = card->atqa[0];
+        b0[7] = card->atqa[1];
+    }
+
+    card->nt_mode = MFC_NT_WEAK;
+    card->nack_bug = true;
+    card->auth_key = AUTHKEYNONE;
+    card->state = MFC_STATE_OFF;
+}
+
+void mfc_card_field(mfc_card_t *card, bool on) {
+    card_deauth(card, on ? MFC_STATE_IDLE : MFC_STATE_OFF);
+    card->prng = MFC_PRNG_START;
+}
+
+void mfc_card_idle(mfc_card_t *card, uint32_t bit_periods) {
+    if (card->state == MFC_STATE_OFF || card->nt_mode != MFC_NT_WEAK)
+        return;
+    card->prng = prng_successor(card->prng, bit_periods % MFC_PRNG_PERIOD);
+}
+
+// the 4 UID bytes and BCC a cascade level answers with
+static uint8_t card_cascade_uid(const mfc_card_t *card, uint8_t level, uint8_t *out) {
+    uint8_t levels = (card->uid_len == 4) ? 1 : (card->uid_len == 7) ? 2 : 3;
+    if (level >= levels)
+        return 0;
+
+    if (level == levels - 1) {
+        memcpy(out, card->uid + card->uid_len - 4, 4);
+    } else {
+        out[0] = 0x88;
+        memcpy(out + 1, card->uid + level * 3, 3);
+    }
+    out[4] = out[0] ^ out[1] ^ out[2] ^ out[3];
+    return levels;
+}
+
+static uint16_t card_select(mfc_card_t *card, const uint8_t *cmd, uint8_t len, mfc_frame_t *tx) {
+    uint8_t level;
+    switch (cmd[0]) {
+        case ISO14443A_CMD_ANTICOLL_OR_SELECT:
+            level = 0;
+            break;
+        case ISO14443A_CMD_ANTICOLL_OR_SELECT_2:
+            level = 1;
+            break;
+        case ISO14443A_CMD_ANTICOLL_OR_SELECT_3:
+            level = 2;
+            break;
+        default:
+            return card_error(card);
+    }
+
+    uint8_t cl[5];
+    uint8_t levels = card_cascade_uid(card, level, cl);
+    if (levels == 0)
+        return card_error(card);
+
+    // ANTICOLLISION, bit oriented frames are not supported
+    if (len == 2 && cmd[1] == 0x20) {
+        mfc_frame_plain(tx, cl, sizeof(cl), false);
+        return tx->bits;
+    }
+
+    // SELECT
+    if (len == 9 && cmd[1] == 0x70 && check_crc(CRC_14443_A, cmd, len) && memcmp(cmd + 2, cl, sizeof(cl)) == 0) {
+        uint8_t sak = card->sak;
+        if (level + 1 < levels) {
+            sak = 0x04;
+        } else {
+            card->state = MFC_STATE_ACTIVE;
+        }
+        mfc_frame_plain(tx, &sak, 1, true);
+        return tx->bits;
+    }
+
+    return card_error(card);
+}
+
+static uint16_t card_auth(mfc_card_t *card, const uint8_t *cmd, mfc_frame_t *tx) {
+    if (cmd[1] >= card->blocks)
+        return card_send4(card, CARD_NACK_NA, tx);
+
+    bool nested = (card->auth_key != AUTHKEYNONE);
+    uint8_t keytype = cmd[0] & 0x01;
+    uint8_t sector = mfc_block_to_sector(cmd[1]);
+    uint64_t key = mfc_card_key(card, sector, keytype);
+
+    card->nt = card_nonce(card);
+    uint8_t nt[4];
+    num_to_bytes(card->nt, 4, nt);
+
+    crypto1_deinit(&card->cs);
+    crypto1_init(&card->cs, key);
+
+    if (nested) {
+        // the nonce goes out encrypted, cuid ^ nt is shifted in while it is sent
+        uint8_t in[4];
+        num_to_bytes(card->cuid ^ card->nt, 4, in);
+        for (uint8_t i = 0; i < 4; i++) {
+            tx->data[i] = crypto1_byte(&card->cs, in[i], 0) ^ nt[i];
+            frame_set_par(tx, i, filter(card->cs.odd) ^ oddparity8(nt[i]));
+        }
+        tx->bits = 32;
+    } else {
+        crypto1_word(&card->cs, card->cuid ^ card->nt, 0);
+        mfc_frame_plain(tx, nt, 4, false);
+    }
+
+    card->auth_key = AUTHKEYNONE;
+    card->auth_sector = sector;
+    card->pending_cmd = keytype;
+    card->state = MFC_STATE_AUTH;
+    return tx->bits;
+}
+
+// {nr}{ar} of the reader
+static uint16_t card_auth2(mfc_card_t *card, const mfc_frame_t *rx, mfc_frame_t *tx) {
+    if (rx->bits != 64)
+        return card_error(card);
+
+    bool par_ok = true;
+    uint8_t plain[8];
+    for (uint8_t i = 0; i < 8; i++) {
+        // nr is shifted into the cipher, ar only encrypted
+        uint8_t ks = crypto1_byte(&card->cs, (i < 4) ? rx->data[i] : 0x00, (i < 4) ? 1 : 0);
+        plain[i] = rx->data[i] ^ ks;
+        if (frame_par(rx, i) != ((filter(card->cs.odd) ^ oddparity8(plain[i])) & 0x01))
+            par_ok = false;
+    }
+
+    uint32_t ar = bytes_to_num(plain + 4, 4);
+    if (par_ok && ar == prng_successor(card->nt, 64)) {
+        card->stats.auths++;
+        card->auth_key = card->pending_cmd;
+        card->pending_cmd = 0;
+        card->state = MFC_STATE_ACTIVE;
+
+        uint8_t at[4];
+        num_to_bytes(prng_successor(card->nt, 96), 4, at);
+        return card_send(card, at, sizeof(at), tx);
+    }
+
+    card->stats.auth_fails++;
+    if (par_ok == false)
+        card->stats.parity_errors++;
+
+    // the darkside weakness, the NACK goes out encrypted with the next 4 keystream bits
+    if (par_ok && card->nack_bug) {
+        card->auth_key = card->pending_cmd;
+        card_send4(card, MFC_NACK_PARITY, tx);
+        card_deauth(card, MFC_STATE_IDLE);
+        return tx->bits;
+    }
+    return card_error(card);
+}
+
+static uint16_t card_command(mfc_card_t *card, const mfc_frame_t *rx, mfc_frame_t *tx) {
+    uint8_t len = rx->bits / 8;
+    uint8_t cmd[MFC_FRAME_SIZE];
+    bool encrypted = (card->auth_key != AUTHKEYNONE);
+
+    if (encrypted) {
+        if (card_decrypt(card, rx, len, cmd) == false) {
+            card->stats.parity_errors++;
+            return card_error(card);
+        }
+    } else {
+        memcpy(cmd, rx->data, len);
+    }
+
+    if (len < 3 || check_crc(CRC_14443_A, cmd, len) == false)
+        return card_send4(card, CARD_NACK_NA, tx);
+
+    uint8_t blockNo = cmd[1];
+    bool in_sector = encrypted && blockNo < card->blocks && mfc_block_to_sector(blockNo) == card->auth_sector;
+
+    switch (cmd[0]) {
+        case MIFARE_AUTH_KEYA:
+        case MIFARE_AUTH_KEYB:
+            if (len != 4)
+                break;
+            return card_auth(card, cmd, tx);
+
+        case ISO14443A_CMD_READBLOCK: {
+            if (len != 4 || in_sector == false)
+                break;
+            uint8_t data[MFC_FRAME_SIZE];
+            memcpy(data, card_block(card, blockNo), MFC_BLOCK_SIZE);
+            mfc_read_mask(card_trailer(card, blockNo), blockNo, card->auth_key, data);
+            card->stats.reads++;
+            return card_send_crc(card, data, MFC_BLOCK_SIZE, tx);
+        }
+
+        case ISO14443A_CMD_WRITEBLOCK:
+            if (len != 4 || in_sector == false)
+                break;
+            // a trailer may be written partly, the write mask keeps the rest
+            if (mfc_is_trailer(blockNo) == false && mfc_access_allowed(card_trailer(card, blockNo), blockNo, card->auth_key, AC_DATA_WRITE) == false)
+                break;
+            card->pending_block = blockNo;
+            card->state = MFC_STATE_WRITE;
+            return card_send4(card, CARD_ACK, tx);
+
+        case MIFARE_CMD_INC:
+        case MIFARE_CMD_DEC:
+        case MIFARE_CMD_RESTORE: {
+            if (len != 4 || in_sector == false || mfc_is_trailer(blockNo))
+                break;
+            uint8_t action = (cmd[0] == MIFARE_CMD_INC) ? AC_DATA_INC : AC_DATA_DEC_TRANS_REST;
+            if (mfc_access_allowed(card_trailer(card, blockNo), blockNo, card->auth_key, action) == false)
+                break;
+            if (mfc_value_get(card_block(card, blockNo), NULL, NULL) == false)
+                break;
+            card->pending_block = blockNo;
+            card->pending_cmd = cmd[0];
+            card->state = MFC_STATE_VALUE;
+            return card_send4(card, CARD_ACK, tx);
+        }
+
+        case MIFARE_CMD_TRANSFER: {
+            if (len != 4 || in_sector == false || mfc_is_trailer(blockNo) || card->pending_cmd == 0)
+                break;
+            if (mfc_access_allowed(card_trailer(card, blockNo), blockNo, card->auth_key, AC_DATA_DEC_TRANS_REST) == false)
+                break;
+            uint8_t addr = 0;
+            mfc_value_get(card_block(card, card->pending_block), NULL, &addr);
+            mfc_value_set(card_block(card, blockNo), card->value_reg, addr);
+            card->pending_cmd = 0;
+            card->stats.writes++;
+            return card_send4(card, CARD_ACK, tx);
+        }
+
+        case ISO14443A_CMD_HALT:
+            if (len != 4 || cmd[1] != 0x00)
+                break;
+            card_deauth(card, MFC_STATE_HALT);
+            return 0;
+
+        default:
+            break;
+    }
+    return card_send4(card, CARD_NACK_NA, tx);
+}
+
+// second part of WRITE, the 16 bytes
+static uint16_t card_write(mfc_card_t *card, const mfc_frame_t *rx, mfc_frame_t *tx) {
+    uint8_t data[MFC_FRAME_SIZE];
+    if (rx->bits != MFC_FRAME_SIZE * 8 || card_decrypt(card, rx, MFC_FRAME_SIZE, data) == false) {
+        card->stats.parity_errors++;
+        return card_error(card);
+    }
+
+    card->state = MFC_STATE_ACTIVE;
+    if (check_crc(CRC_14443_A, data, MFC_FRAME_SIZE) == false)
+        return card_send4(card, CARD_NACK_NA, tx);
+
+    uint8_t *block = card_block(card, card->pending_block);
+    mfc_write_mask(card_trailer(card, card->pending_block), card->pending_block, card->auth_key, block, data);
+    memcpy(block, data, MFC_BLOCK_SIZE);
+    card->stats.writes++;
+    return card_send4(card, CARD_ACK, tx);
+}
+
+// second part of INC / DEC / RESTORE, the 4 byte operand. The card does not answer it
+static uint16_t card_value(mfc_card_t *card, const mfc_frame_t *rx, mfc_frame_t *tx) {
+    uint8_t data[6];
+    if (rx->bits != sizeof(data) * 8 || card_decrypt(card, rx, sizeof(data), data) == false) {
+        card->stats.parity_errors++;
+        return card_error(card);
+    }
+
+    card->state = MFC_STATE_ACTIVE;
+    if (check_crc(CRC_14443_A, data, sizeof(data)) == false) {
+        card->pending_cmd = 0;
+        return card_send4(card, CARD_NACK_NA, tx);
+    }
+
+    int32_t value = 0;
+    mfc_value_get(card_block(card, card->pending_block), &value, NULL);
+    int32_t operand = (int32_t)MemLeToUint4byte(data);
+
+    if (card->pending_cmd == MIFARE_CMD_INC)
+        card->value_reg = value + operand;
+    else if (card->pending_cmd == MIFARE_CMD_DEC)
+        card->value_reg = value - operand;
+    else
+        card->value_reg = value;
+    return 0;
+}
+
+uint16_t mfc_card_frame(mfc_card_t *card, const mfc_frame_t *rx, mfc_frame_t *tx) {
+    tx->bits = 0;
+    if (card->state == MFC_STATE_OFF)
+        return 0;
+
+    card->stats.frames++;
+
+    // the PRNG keeps running while the frame is on air
+    mfc_card_idle(card, rx->bits);
+
+    // REQA / WUPA
+    if (rx->bits == 7) {
+        uint8_t c = rx->data[0] & 0x7f;
+        if (c == ISO14443A_CMD_WUPA || (c == ISO14443A_CMD_REQA && card->state != MFC_STATE_HALT)) {
+            card_deauth(card, MFC_STATE_SELECT);
+            mfc_frame_plain(tx, card->atqa, sizeof(card->atqa), false);
+            return tx->bits;
+        }
+        return card_error(card);
+    }
+
+    if (rx->bits == 0 || (rx->bits & 0x07) || rx->bits > MFC_FRAME_SIZE * 8)
+        return card_error(card);
+
+    uint8_t len = rx->bits / 8;
+    uint16_t bits = 0;
+    switch (card->state) {
+        case MFC_STATE_SELECT:
+            if (plain_parity_ok(rx, len) == false) {
+                card->stats.parity_errors++;
+                return card_error(card);
+            }
+            bits = card_select(card, rx->data, len, tx);
+            break;
+        case MFC_STATE_ACTIVE:
+            if (card->auth_key == AUTHKEYNONE && plain_parity_ok(rx, len) == false) {
+                card->stats.parity_errors++;
+                return card_error(card);
+            }
+            bits = card_command(card, rx, tx);
+            break;
+        case MFC_STATE_AUTH:
+            bits = card_auth2(card, rx, tx);
+            break;
+        case MFC_STATE_WRITE:
+            bits = card_write(card, rx, tx);
+            break;
+        case MFC_STATE_VALUE:
+            bits = card_value(card, rx, tx);
+            break;
+        case MFC_STATE_IDLE:
+        case MFC_STATE_HALT:
+        case MFC_STATE_OFF:
+        default:
+            break;
+    }
+
+    mfc_card_idle(card, bits);
+    return bits;
+}
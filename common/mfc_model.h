@@ -0,0 +1,140 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic card model
+//
+// The access conditions are shared by the firmware simulator (`hf mf sim`) and
+// the host. The frame driven card engine runs on the host without any RF
+// hardware, one mfc_card_t per virtual card, so many of them can run in
+// parallel threads.
+//-----------------------------------------------------------------------------
+
+#ifndef __MFC_MODEL_H
+#define __MFC_MODEL_H
+
+#include "common.h"
+#include "crapto1/crapto1.h"
+
+#define AC_DATA_READ             0
+#define AC_DATA_WRITE            1
+#define AC_DATA_INC              2
+#define AC_DATA_DEC_TRANS_REST   3
+#define AC_KEYA_READ             0
+#define AC_KEYA_WRITE            1
+#define AC_KEYB_READ             2
+#define AC_KEYB_WRITE            3
+#define AC_AC_READ               4
+#define AC_AC_WRITE              5
+
+#define AUTHKEYA                 0
+#define AUTHKEYB                 1
+#define AUTHKEYNONE              0xff
+
+#define MFC_BLOCK_SIZE           16
+#define MFC_MAX_BLOCKS           256
+#define MFC_FRAME_SIZE           18  // biggest frame is a READ answer, 16 bytes + CRC
+#define MFC_PARITY_SIZE          3
+
+// the trailer of the sector `blockNo` is in
+uint8_t mfc_sector_trailer(uint8_t blockNo);
+uint8_t mfc_block_to_sector(uint8_t blockNo);
+uint8_t mfc_first_block(uint8_t sectorNo);
+uint8_t mfc_blocks_per_sector(uint8_t sectorNo);
+bool mfc_is_trailer(uint8_t blockNo);
+
+// access conditions, `trailer` is the 16 byte trailer of the sector holding `blockNo`
+bool mfc_access_allowed(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, uint8_t action);
+
+// clears what `keytype` may not read from `data`, the 16 bytes of `blockNo`
+void mfc_read_mask(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, uint8_t *data);
+
+// keeps the bytes of `old` in `data` where `keytype` may not write them
+void mfc_write_mask(const uint8_t *trailer, uint8_t blockNo, uint8_t keytype, const uint8_t *old, uint8_t *data);
+
+// value block layout: value, ~value, value, addr, ~addr, addr, ~addr
+bool mfc_value_get(const uint8_t *data, int32_t *value, uint8_t *addr);
+void mfc_value_set(uint8_t *data, int32_t value, uint8_t addr);
+
+// how the card picks its tag nonces
+typedef enum {
+    MFC_NT_WEAK,     // 16 bit PRNG, restarts at field on and steps once per bit period
+    MFC_NT_STATIC,   // the same nonce on every authentication
+    MFC_NT_HARD,     // unpredictable, as hardened cards
+} mfc_nt_mode_t;
+
+typedef enum {
+    MFC_STATE_OFF,
+    MFC_STATE_IDLE,
+    MFC_STATE_SELECT,
+    MFC_STATE_ACTIVE,
+    MFC_STATE_AUTH,
+    MFC_STATE_WRITE,
+    MFC_STATE_VALUE,
+    MFC_STATE_HALT,
+} mfc_state_t;
+
+// one frame on air. Parity bits as sent, MSB of par[0] goes with data[0].
+// bits is 7 for REQA / WUPA, 4 for ACK / NACK, else 8 per byte
+typedef struct {
+    uint8_t data[MFC_FRAME_SIZE];
+    uint8_t par[MFC_PARITY_SIZE];
+    uint16_t bits;
+} mfc_frame_t;
+
+typedef struct {
+    uint64_t frames;
+    uint32_t auths;
+    uint32_t auth_fails;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t nacks;
+    uint32_t parity_errors;
+} mfc_stats_t;
+
+typedef struct {
+    // configuration, set before mfc_card_field()
+    uint8_t uid[10];
+    uint8_t uid_len;                 // 4, 7 or 10
+    uint8_t atqa[2];
+    uint8_t sak;
+    uint16_t blocks;                 // 20 mini, 64 1k, 128 2k, 256 4k
+    uint8_t mem[MFC_MAX_BLOCKS * MFC_BLOCK_SIZE];
+    mfc_nt_mode_t nt_mode;
+    uint32_t nt_seed;                // static nonce, or the start of the hard nonce generator
+    bool nack_bug;                   // answers a failed authentication with correct parity with an encrypted NACK
+
+    // state
+    mfc_state_t state;
+    struct Crypto1State cs;
+    uint32_t cuid;
+    uint32_t prng;
+    uint32_t nt;
+    uint8_t cascade;
+    uint8_t auth_key;
+    uint8_t auth_sector;
+    uint8_t pending_block;
+    uint8_t pending_cmd;
+    int32_t value_reg;
+    mfc_stats_t stats;
+} mfc_card_t;
+
+// a blank card of `blocks` blocks, transport keys and transport access conditions
+void mfc_card_init(mfc_card_t *card, uint16_t blocks, const uint8_t *uid, uint8_t uid_len);
+
+// powers the card up or down, power up restarts the weak PRNG
+void mfc_card_field(mfc_card_t *card, bool on);
+
+// time passing without a frame, in bit periods (128 carrier cycles)
+void mfc_card_idle(mfc_card_t *card, uint32_t bit_periods);
+
+// feeds one reader frame, returns the bits of the answer in `tx`, 0 when the card stays silent
+uint16_t mfc_card_frame(mfc_card_t *card, const mfc_frame_t *rx, mfc_frame_t *tx);
+
+// a plain frame with odd parity
+void mfc_frame_plain(mfc_frame_t *f, const uint8_t *data, uint8_t len, bool crc);
+
+uint64_t mfc_card_key(const mfc_card_t *card, uint8_t sectorNo, uint8_t keytype);
+
+#endif
@@ -76,8 +76,16 @@ extern bool g_tearoff_enabled;
 #endif
 
 
+// host builds of firmware sources (tools/hf_decoders) define their own,
+// common/ sources shared with the client get none
+#ifndef RAMFUNC
+#ifdef ON_DEVICE
 //#define RAMFUNC __attribute((long_call, section(".ramfunc")))
 #define RAMFUNC __attribute((long_call, section(".ramfunc"))) __attribute__((target("arm")))
+#else
+#define RAMFUNC
+#endif
+#endif
 
 #ifndef ROTR
 # define ROTR(x,n) (((uintmax_t)(x) >> (n)) | ((uintmax_t)(x) << ((sizeof(x) * 8) - (n))))
@@ -84,7 +84,8 @@ typedef enum {
     MFDES_AUTH_DES = 1,
     MFDES_AUTH_ISO = 2,
     MFDES_AUTH_AES = 3,
-    MFDES_AUTH_PICC = 4
+    MFDES_AUTH_PICC = 4,
+    MFDES_AUTH_MFP = 5      // MIFARE Plus SL3 AES first authenticate
 } mifare_des_authmode_t;
 
 typedef enum {
@@ -122,6 +122,28 @@ typedef struct {
     bool verbose;
 } PACKED sample_config;
 
+// lf read / lf sniff --stream, samples packed by the sampling config go to the client while sampling runs
+#define LF_STREAM_CHUNK   480
+
+typedef struct {
+    uint32_t samples;           // stop after that many samples, 0 = until stopped
+    bool reader_field;
+} PACKED lf_stream_t;
+
+typedef struct {
+    uint32_t seq;
+    uint16_t bits;              // valid bits in data, less than a full chunk only for the last one
+    uint8_t bits_per_sample;
+    uint8_t data[LF_STREAM_CHUNK];
+} PACKED lf_stream_chunk_t;
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t lost;
+    uint32_t stalls;
+    uint32_t samples;
+} PACKED lf_stream_result_t;
+
 // A struct used to send hf14a-configs over USB
 typedef struct {
     int8_t forceanticol; // 0:auto 1:force executing anticol 2:force skipping anticol
@@ -193,14 +215,26 @@ typedef struct {
     bool compiled_with_nfcbarcode      : 1;
     // misc
     bool compiled_with_lcd             : 1;
+    bool compressed_download           : 1;
 
     // rdv4
     bool hw_available_flash            : 1;
     bool hw_available_smartcard        : 1;
 } PACKED capabilities_t;
-#define CAPABILITIES_VERSION 5
+#define CAPABILITIES_VERSION 6
 extern capabilities_t g_pm3_capabilities;
 
+// download commands (bigbuf, emulator memory, spiffs, flash) take flags in arg2
+#define DL_FLAG_COMPRESSED      0x01
+
+// with DL_FLAG_COMPRESSED the data comes as NG frames of independent LZ4 blocks
+typedef struct {
+    uint32_t offset;            // position of the uncompressed data
+    uint32_t len;               // uncompressed length
+    uint16_t clen;              // length of data,  equal to len when stored uncompressed
+    uint8_t data[];
+} PACKED download_chunk_t;
+
 // For CMD_LF_T55XX_WRITEBL
 typedef struct {
     uint32_t data;
@@ -215,6 +249,44 @@ typedef struct {
     uint32_t time;
 } PACKED t55xx_test_block_t;
 
+// For CMD_LF_T55XX_BRUTE
+typedef struct {
+    uint32_t start_pwd;
+    uint32_t end_pwd;
+    uint8_t downlink_mode;      // 0-3,  4 = try all
+    uint8_t clock;              // tag bitrate RF/n,  0 = try all
+} PACKED t55xx_bf_t;
+
+typedef struct {
+    uint8_t found;
+    uint8_t downlink_mode;
+    uint32_t candidate;
+    uint32_t last;              // last password tried
+    uint32_t tried;
+} PACKED t55xx_bf_resp_t;
+
+// For CMD_HF_DESFIRE_CHKKEYS
+#define DESFIRE_CHK_MAX_SLOTS   16
+#define DESFIRE_CHK_NONE        0xFF    // no key in the batch matched
+#define DESFIRE_CHK_NOKEY       0xFE    // card refused the key number / key type
+
+typedef struct {
+    uint8_t flags;              // INIT selects card and application first, DISCONNECT drops the field after the batch
+    uint8_t mode;               // MFDES_AUTH_ISO, MFDES_AUTH_AES or MFDES_AUTH_MFP
+    uint8_t algo;               // MFDES_ALGO_*
+    uint8_t aid[3];             // DESFire application,  LSB first
+    uint8_t slot_count;
+    uint16_t slots[DESFIRE_CHK_MAX_SLOTS];  // DESFire key numbers or MIFARE Plus key block numbers
+    uint8_t keylen;
+    uint8_t key_count;
+    uint8_t keys[PM3_CMD_DATA_SIZE - 41];
+} PACKED desfire_chk_t;
+
+typedef struct {
+    uint8_t found[DESFIRE_CHK_MAX_SLOTS];   // per slot, index of the first matching key in the batch
+    uint16_t tried;
+} PACKED desfire_chk_resp_t;
+
 // For CMD_LF_HID_SIMULATE (FSK)
 typedef struct {
     uint32_t hi2;
@@ -423,6 +495,66 @@ typedef struct {
     uint8_t data[];
 } PACKED smart_card_raw_t;
 
+// hf sniff raw streaming, protocol sniffer whose samples are sent to the client
+typedef enum {
+    HF_SNIFF_RAW_14A = 1,
+    HF_SNIFF_RAW_14B = 2,
+    HF_SNIFF_RAW_15 = 3,
+} hf_sniff_raw_proto_t;
+
+#define HF_SNIFF_RAW_CHUNK   480
+
+typedef struct {
+    uint32_t seq;
+    uint8_t data[HF_SNIFF_RAW_CHUNK];
+} PACKED hf_sniff_raw_chunk_t;
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t lost;
+    uint32_t stalls;
+} PACKED hf_sniff_raw_result_t;
+
+// hf search sweep, the probes run on the device grouped by fpga image
+typedef enum {
+    HF_SEARCH_THINFILM = (1 << 0),
+    HF_SEARCH_14A = (1 << 1),
+    HF_SEARCH_15 = (1 << 2),
+    HF_SEARCH_ICLASS = (1 << 3),
+    HF_SEARCH_LEGIC = (1 << 4),
+    HF_SEARCH_14B = (1 << 5),
+    HF_SEARCH_FELICA = (1 << 6),
+} hf_search_tech_t;
+
+#define HF_SEARCH_TECHS      7
+#define HF_SEARCH_ALL        ((1 << HF_SEARCH_TECHS) - 1)
+#define HF_SEARCH_UID_SIZE   36
+
+// stop at the first technology that answers
+#define HF_SEARCH_FLAG_FIRST  0x01
+
+typedef struct {
+    uint16_t techs;
+    uint8_t flags;
+} PACKED hf_search_req_t;
+
+typedef struct {
+    uint8_t len;
+    uint8_t uid[HF_SEARCH_UID_SIZE];
+} PACKED hf_search_uid_t;
+
+// uid[n] belongs to the technology of bit n,  ThinFilm returns its barcode,
+// iCLASS the CSN and FeliCa the IDm
+typedef struct {
+    uint16_t found;
+    uint16_t probed;
+    uint8_t reloads;
+    uint32_t elapsed;
+    uint8_t atqa[2];
+    uint8_t sak;
+    uint8_t select_status;
+    hf_search_uid_t uid[HF_SEARCH_TECHS];
+} PACKED hf_search_result_t;
 
 // For the bootloader
 #define CMD_DEVICE_INFO                                                   0x0000
@@ -578,6 +710,7 @@ typedef struct {
 
 #define CMD_LF_T55XX_CHK_PWDS                                             0x0230
 #define CMD_LF_T55XX_DANGERRAW                                            0x0231
+#define CMD_LF_T55XX_BRUTE                                                0x0233
 
 /* CMD_SET_ADC_MUX: ext1 is 0 for lopkd, 1 for loraw, 2 for hipkd, 3 for hiraw */
 
@@ -594,6 +727,8 @@ typedef struct {
 #define CMD_HF_ISO15693_SLIX_L_DISABLE_PRIVACY                            0x0317
 
 #define CMD_LF_SNIFF_RAW_ADC                                              0x0360
+#define CMD_LF_STREAM_ADC                                                 0x0361
+#define CMD_LF_STREAM_ADC_DATA                                            0x0362
 
 // For Hitag2 transponders
 #define CMD_LF_HITAG_SNIFF                                                0x0370
@@ -711,6 +846,7 @@ typedef struct {
 #define CMD_HF_DESFIRE_READER                                             0x072c
 #define CMD_HF_DESFIRE_INFO                                               0x072d
 #define CMD_HF_DESFIRE_COMMAND                                            0x072e
+#define CMD_HF_DESFIRE_CHKKEYS                                            0x072f
 
 #define CMD_HF_MIFARE_NACK_DETECT                                         0x0730
 #define CMD_HF_MIFARE_STATIC_NONCE                                        0x0731
@@ -723,6 +859,11 @@ typedef struct {
 
 #define CMD_HF_SNIFF                                                      0x0800
 #define CMD_HF_PLOT                                                       0x0801
+// protocol sniffer samples streamed to the client
+#define CMD_HF_SNIFF_RAW                                                  0x0804
+#define CMD_HF_SNIFF_RAW_DATA                                             0x0805
+// multi protocol search sweep
+#define CMD_HF_SEARCH                                                     0x0806
 
 // Fpga plot download
 #define CMD_FPGAMEM_DOWNLOAD                                              0x0802
@@ -30,6 +30,7 @@
 #include <algorithm>   // sort, max_element, random_shuffle, remove_if, lower_bound
 #include <functional>  // greater, bind2nd
 #include <thread>      // std::thread
+#include <chrono>
 #include <atomic>
 #include <mutex>
 #include "cryptolib.h"
@@ -164,7 +165,7 @@ void print_cs(const char *text, pcs s) {
     printf("\n");
 }
 
-static inline uint8_t mod(uint8_t a, uint8_t m) {
+static constexpr uint8_t mod(uint8_t a, uint8_t m) {
     // Just return the input when this is less or equal than the modular value
     if (a < m) return a;
 
@@ -191,65 +192,86 @@ static inline uint8_t bit_rotate_r(uint8_t a, uint8_t n_bits) {
 #define BIT_ROL(a)       ((((a) << 1) | ((a) >> 4)) & BIT_ROL_MASK)
 #define BIT_ROR(a)       (((a) >> 1) | (((a) & 1) << 4))
 
+// The cipher only ever looks at two 5 bit cells of a register at once, the lookup tables are
+// indexed by those two cells packed next to each other instead of by the sparse register bits.
+// left:  b3 = bits 15..19, b6 = bits 0..4      right: b16 = bits 10..14, b18 = bits 0..4
+#define LEFT_INDEX(s)    ((((s) >> 10) & 0x3e0) | ((s) & 0x1f))
+#define RIGHT_INDEX(s)   ((((s) >> 5) & 0x3e0) | ((s) & 0x1f))
 
-static uint8_t lookup_left_substraction[0x400];
-static uint8_t lookup_right_subtraction[0x400];
-static lookup_entry lookup_left[0x100000];
-static lookup_entry lookup_right[0x8000];
-static uint8_t left_addition[0x100000];
+typedef struct {
+    lookup_entry e[0x400];
+} lookup_table;
+
+typedef struct {
+    uint8_t e[0x400];
+} subtraction_table;
 
-static inline void init_lookup_left() {
-    uint8_t b3, b6, temp;
-    int i, index;
+static constexpr lookup_table init_lookup_left() {
+    lookup_table t = {};
 
-    for (i = 0; i < 0x400; i++) {
-        b6 = i & 0x1f;
-        b3 = (i >> 5) & 0x1f;
-        index = (b3 << 15) | b6;
+    for (int index = 0; index < 0x400; index++) {
+        uint8_t b6 = index & 0x1f;
+        uint8_t b3 = (index >> 5) & 0x1f;
 
 //      b6 = bit_rotate_l(b6, 5);
         b6 = BIT_ROL(b6);
 
-        temp = mod(b3 + b6, 0x1f);
-        left_addition[index] = temp;
-        lookup_left[index].addition = temp;
-        lookup_left[index].out = ((temp ^ b3) & 0x0f);
+        uint8_t temp = mod(b3 + b6, 0x1f);
+        t.e[index].addition = temp;
+        t.e[index].out = ((temp ^ b3) & 0x0f);
     }
+    return t;
 }
 
-static inline void init_lookup_right() {
-    uint8_t b16, b18, temp;
-    int i, index;
+static constexpr lookup_table init_lookup_right() {
+    lookup_table t = {};
 
-    for (i = 0; i < 0x400; i++) {
-        b18 = i & 0x1f;
-        b16 = (i >> 5) & 0x1f;
-        index = (b16 << 10) | b18;
+    for (int index = 0; index < 0x400; index++) {
+        uint8_t b18 = index & 0x1f;
+        uint8_t b16 = (index >> 5) & 0x1f;
 
-        temp = mod(b18 + b16, 0x1f);
-        lookup_right[index].addition = temp;
-        lookup_right[index].out = ((temp ^ b16) & 0x0f);
+        uint8_t temp = mod(b18 + b16, 0x1f);
+        t.e[index].addition = temp;
+        t.e[index].out = ((temp ^ b16) & 0x0f);
     }
+    return t;
 }
 
-static void init_lookup_left_substraction() {
+static constexpr subtraction_table init_lookup_left_substraction() {
+    subtraction_table t = {};
+
     for (int index = 0; index < 0x400 ; index++) {
         uint8_t b3 = (index >> 5 & 0x1f);
         uint8_t bx = (index & 0x1f);
 
         //lookup_left_substraction[index] = bit_rotate_r(mod((bx+0x1f)-b3,0x1f),5);
-        lookup_left_substraction[index] = BIT_ROR(mod((bx + 0x1F) - b3, 0x1F));
+        t.e[index] = BIT_ROR(mod((bx + 0x1F) - b3, 0x1F));
     }
+    return t;
 }
 
-static void init_lookup_right_substraction() {
+static constexpr subtraction_table init_lookup_right_substraction() {
+    subtraction_table t = {};
+
     for (int index = 0; index < 0x400 ; index++) {
         int b16 = (index >> 5);
         uint8_t bx = (index & 0x1f);
-        lookup_right_subtraction[index] = mod((bx + 0x1F) - b16, 0x1F);
+        t.e[index] = mod((bx + 0x1F) - b16, 0x1F);
     }
+    return t;
 }
 
+// Built by the compiler, nothing to initialize at run time
+static constexpr lookup_table lookup_left_table = init_lookup_left();
+static constexpr lookup_table lookup_right_table = init_lookup_right();
+static constexpr subtraction_table lookup_left_substraction_table = init_lookup_left_substraction();
+static constexpr subtraction_table lookup_right_subtraction_table = init_lookup_right_substraction();
+
+static const lookup_entry *const lookup_left = lookup_left_table.e;
+static const lookup_entry *const lookup_right = lookup_right_table.e;
+static const uint8_t *const lookup_left_substraction = lookup_left_substraction_table.e;
+static const uint8_t *const lookup_right_subtraction = lookup_right_subtraction_table.e;
+
 static inline void previous_left(uint8_t in, vector<cs_t> *candidate_states) {
     pcs state;
     size_t size = candidate_states->size();
@@ -325,21 +347,21 @@ static inline uint8_t next_left_fast(uint8_t in, uint64_t *left) {
     if (in)
         *left ^= ((in & 0x1f) << 20);
 
-    lookup_entry *lookup = &(lookup_left[((*left) & 0xf801f)]);
+    const lookup_entry *lookup = &(lookup_left[LEFT_INDEX(*left)]);
     *left = (((*left) >> 5) | ((uint64_t)lookup->addition << 30));
     return lookup->out;
 }
 
 static inline uint8_t next_left_ksbyte(uint64_t *left) {
-    lookup_entry *lookup;
+    const lookup_entry *lookup;
     uint8_t bt;
 
-    *left = (((*left) >> 5) | ((uint64_t)left_addition[((*left) & 0xf801f)] << 30));
-    lookup = &(lookup_left[((*left) & 0xf801f)]);
+    *left = (((*left) >> 5) | ((uint64_t)lookup_left[LEFT_INDEX(*left)].addition << 30));
+    lookup = &(lookup_left[LEFT_INDEX(*left)]);
     *left = (((*left) >> 5) | ((uint64_t)lookup->addition << 30));
     bt = lookup->out << 4;
-    *left = (((*left) >> 5) | ((uint64_t)left_addition[((*left) & 0xf801f)] << 30));
-    lookup = &(lookup_left[((*left) & 0xf801f)]);
+    *left = (((*left) >> 5) | ((uint64_t)lookup_left[LEFT_INDEX(*left)].addition << 30));
+    lookup = &(lookup_left[LEFT_INDEX(*left)]);
     *left = (((*left) >> 5) | ((uint64_t)lookup->addition << 30));
     bt |= lookup->out;
     return bt;
@@ -347,7 +369,7 @@ static inline uint8_t next_left_ksbyte(uint64_t *left) {
 
 static inline uint8_t next_right_fast(uint8_t in, uint64_t *right) {
     if (in) *right ^= ((in & 0xf8) << 12);
-    lookup_entry *lookup = &(lookup_right[((*right) & 0x7c1f)]);
+    const lookup_entry *lookup = &(lookup_right[RIGHT_INDEX(*right)]);
     *right = (((*right) >> 5) | (lookup->addition << 20));
     return lookup->out;
 }
@@ -370,75 +392,123 @@ static inline void sm_left_mask(const uint8_t *ks, uint8_t *mask, uint64_t rstat
 
 std::atomic<bool> key_found{0};
 std::atomic<uint64_t> key{0};
-std::atomic<size_t> g_topbits{0};
 std::mutex g_ice_mtx;
 static uint32_t g_num_cpus = std::thread::hardware_concurrency();
 
-static void ice_sm_right_thread(
-    uint8_t offset,
-    uint8_t skips,
-    const uint8_t *ks,
-    map<uint64_t, uint64_t> *bincstates,
-    uint8_t *mask
-) {
-
-    uint8_t tmp_mask[16];
-    uint8_t bt;
+// Threads take the next chunk of work from this counter instead of a fixed slice of the
+// state space, so a core that is slower or busy elsewhere does not hold up the others
+std::atomic<uint64_t> g_next_chunk{0};
+
+#define RIGHT_STATES    0x2000000ull
+#define RIGHT_CHUNK     0x10000ull
+#define RIGHT_BATCH     32
+#define LEFT_STATES     0x800000000ull
+#define LEFT_CHUNK      0x100000ull
+#define LEFT_BATCH      32
+// Candidates every thread has room for before its arena has to grow
+#define ARENA_RESERVE   1024
+
+// Results of one thread, merged when all of them are done.  States are stored
+// as (bits << 56) | state so sorting them orders them on the bin first
+typedef struct {
+    vector<uint64_t> states;
+    size_t topbits;
+    uint64_t topstate;
+    uint8_t mask[16];
+} right_arena_t;
 
-    for (uint64_t counter = offset; counter < 0x2000000; counter += skips) {
-        // Reset the current bitcount of correct bits
-        size_t bits = 0;
+typedef struct {
+    vector<uint64_t> states;
+} left_arena_t;
 
-        // Copy the state we are going to test
-        uint64_t rstate = counter;
+#define ARENA_STATE(s)  ((s) & 0x00ffffffffffffffull)
 
-        for (uint8_t pos = 0; pos < 16; pos++) {
+static inline uint8_t count_correct_bits(uint8_t bt) {
+    // When the bit is xored away (=zero), it was the same, so correct ;)
+    bt = bt - ((bt >> 1) & 0x55);
+    bt = (bt & 0x33) + ((bt >> 2) & 0x33);
+    return 8 - ((bt + (bt >> 4)) & 0x0f);
+}
 
-            next_right_fast(0, &rstate);
+// The additions of lookup_left[] and lookup_right[] written out so they vectorise,
+// the sum is at most 62 so the modulo is one subtraction
+static inline uint8_t left_addition(uint8_t b6, uint8_t b3) {
+    uint8_t a = b3 + BIT_ROL(b6);
+    return a - (0x1f * (a >> 5));
+}
 
-            bt = next_right_fast(0, &rstate) << 4;
+static inline uint8_t right_addition(uint8_t b18, uint8_t b16) {
+    uint8_t a = b18 + b16;
+    return a - (0x1f * (a >> 5));
+}
 
-            next_right_fast(0, &rstate);
+// One step of the right register for all lanes of a batch, the cell b18 is replaced by the new cell
+static inline void right_lanes_step(uint8_t *b18, const uint8_t *b16, uint8_t *out) {
+    for (uint8_t i = 0; i < RIGHT_BATCH; i++) {
+        uint8_t a = right_addition(b18[i], b16[i]);
+        out[i] = (a ^ b16[i]) & 0x0f;
+        b18[i] = a;
+    }
+}
 
-            bt |= next_right_fast(0, &rstate);
+// Counts the correct bits of the RIGHT_BATCH states base .. base + 31 side by side, one 8 bit
+// lane per state and one lane array per 5 bit cell.  Step n of the right register reads the
+// cells n and n + 2 and replaces cell n with the new one, so the cells form a ring of five.
+static inline void sm_right_batch(uint64_t base, const uint8_t *ks, right_arena_t *arena) {
+    uint8_t cells[5][RIGHT_BATCH];
+    for (uint8_t i = 0; i < RIGHT_BATCH; i++) {
+        cells[0][i] = i;
+        for (uint8_t c = 1; c < 5; c++) {
+            cells[c][i] = (base >> (5 * c)) & 0x1f;
+        }
+    }
 
-            // xor the bits with the keystream and count the "correct" bits
-            bt ^= ks[pos];
+    uint8_t bits[RIGHT_BATCH] = {0};
+    uint8_t hi[RIGHT_BATCH];
+    uint8_t lo[RIGHT_BATCH];
 
-            // Save the mask for the left produced bits
-            tmp_mask[pos] = bt;
+    for (uint8_t pos = 0; pos < 16; pos++) {
+        uint8_t n = (4 * pos) % 5;
+        right_lanes_step(cells[n], cells[(n + 2) % 5], lo);
+        right_lanes_step(cells[(n + 1) % 5], cells[(n + 3) % 5], hi);
+        right_lanes_step(cells[(n + 2) % 5], cells[(n + 4) % 5], lo);
+        right_lanes_step(cells[(n + 3) % 5], cells[n], lo);
 
-            // When the bit is xored away (=zero), it was the same, so correct ;)
-            if ((bt & 0x01) == 0) bits++;
-            if (((bt >> 1) & 0x01) == 0) bits++;
-            if (((bt >> 2) & 0x01) == 0) bits++;
-            if (((bt >> 3) & 0x01) == 0) bits++;
-            if (((bt >> 4) & 0x01) == 0) bits++;
-            if (((bt >> 5) & 0x01) == 0) bits++;
-            if (((bt >> 6) & 0x01) == 0) bits++;
-            if (((bt >> 7) & 0x01) == 0) bits++;
+        // xor the bits with the keystream and count the "correct" bits
+        for (uint8_t i = 0; i < RIGHT_BATCH; i++) {
+            bits[i] += count_correct_bits(((hi[i] << 4) | lo[i]) ^ ks[pos]);
         }
+    }
 
-        g_ice_mtx.lock();
-        if (bits > g_topbits.load(std::memory_order_relaxed)) {
-            // Copy the winning mask
-            g_topbits = bits;
-            memcpy(mask, tmp_mask, 16);
+    for (uint8_t i = 0; i < RIGHT_BATCH; i++) {
+        // Batches are handed out in order, the first state of a bin is the lowest one
+        if (bits[i] > arena->topbits) {
+            // Save the mask for the left produced bits of the winner
+            arena->topbits = bits[i];
+            arena->topstate = base + i;
+            sm_left_mask(ks, arena->mask, base + i);
         }
-        g_ice_mtx.unlock();
 
         // Ignore states under 90
-        if (bits >= 90) {
+        if (bits[i] >= 90) {
             //  Make sure the bits are used for ordering
-            g_ice_mtx.lock();
-            if (bincstates->find((((uint64_t)bits) << 56) | counter) != bincstates->end())
-                bincstates->at((((uint64_t)bits) << 56) | counter) = counter;
-            else
-                bincstates->insert(std::pair<uint64_t, uint64_t>((((uint64_t)bits) << 56) | counter, counter));
-            g_ice_mtx.unlock();
+            arena->states.push_back((((uint64_t)bits[i]) << 56) | (base + i));
         }
+    }
+}
 
-        if ((counter & 0xfffff) == 0) {
+static void ice_sm_right_thread(const uint8_t *ks, right_arena_t *arena) {
+
+    uint64_t chunk;
+
+    while ((chunk = g_next_chunk.fetch_add(1)) < (RIGHT_STATES / RIGHT_CHUNK)) {
+        uint64_t start = chunk * RIGHT_CHUNK;
+
+        for (uint64_t base = start; base < start + RIGHT_CHUNK; base += RIGHT_BATCH) {
+            sm_right_batch(base, ks, arena);
+        }
+
+        if ((start & 0xfffff) == 0) {
             g_ice_mtx.lock();
             printf(".");
             fflush(stdout);
@@ -446,14 +516,19 @@ static void ice_sm_right_thread(
         }
     }
 }
+
 static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t> *pcrstates) {
 
-    map<uint64_t, uint64_t> bincstates;
-    g_topbits = ATOMIC_VAR_INIT(0);
+    vector<right_arena_t> arenas(g_num_cpus);
+    g_next_chunk = 0;
 
     std::vector<std::thread> threads(g_num_cpus);
-    for (uint8_t m = 0; m < g_num_cpus; m++) {
-        threads[m] = std::thread(ice_sm_right_thread, m, g_num_cpus, ks, &bincstates, mask);
+    for (uint32_t m = 0; m < g_num_cpus; m++) {
+        arenas[m].states.reserve(ARENA_RESERVE);
+        arenas[m].topbits = 0;
+        arenas[m].topstate = 0;
+        memset(arenas[m].mask, 0, sizeof(arenas[m].mask));
+        threads[m] = std::thread(ice_sm_right_thread, ks, &arenas[m]);
     }
     for (auto &t : threads) {
         t.join();
@@ -461,112 +536,155 @@ static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t>
 
     printf("\n");
 
-    // Clear the candidate state vector
-    pcrstates->clear();
-
-    // Copy the order the states from lowest-bin to highest-bin
-    map<uint64_t, uint64_t>::iterator it;
-    for (it = bincstates.begin(); it != bincstates.end(); ++it) {
-        pcrstates->push_back(it->second);
+    // Merge the arenas, on a tie the mask of the lowest state wins, as if searched by a single thread
+    size_t total = 0, topbits = 0;
+    uint64_t topstate = 0;
+    for (auto &arena : arenas) {
+        total += arena.states.size();
+        if ((arena.topbits > topbits) || ((arena.topbits == topbits) && (arena.topstate < topstate))) {
+            topbits = arena.topbits;
+            topstate = arena.topstate;
+            memcpy(mask, arena.mask, 16);
+        }
     }
 
-    // Reverse the vector order (so the higest bin comes first)
-    reverse(pcrstates->begin(), pcrstates->end());
+    vector<uint64_t> bincstates;
+    bincstates.reserve(total);
+    for (auto &arena : arenas) {
+        bincstates.insert(bincstates.end(), arena.states.begin(), arena.states.end());
+    }
 
-    return g_topbits;
-}
+    // Order the states so the highest bin comes first
+    sort(bincstates.begin(), bincstates.end(), greater<uint64_t>());
 
-static void ice_sm_left_thread(
-    uint8_t offset,
-    uint8_t skips,
-    const uint8_t *ks,
-    map<uint64_t, cs_t> *bincstates,
-    uint8_t *mask
-) {
+    // Clear the candidate state vector
+    pcrstates->clear();
+    pcrstates->reserve(bincstates.size());
+    for (auto bstate : bincstates) {
+        pcrstates->push_back(ARENA_STATE(bstate));
+    }
 
-    size_t pos, bits;
-    uint8_t correct_bits[16];
-    uint8_t bt;
-    lookup_entry *lookup;
+    return topbits;
+}
 
-    // Reset and initialize the cryptostate and vector
-    cs_t state;
-    memset(&state, 0x00, sizeof(cs_t));
-    state.invalid = false;
+// One step of the left register for all lanes of a batch, the cell b6 is replaced by the new cell
+static inline void left_lanes_step(uint8_t *b6, const uint8_t *b3, uint8_t *out) {
+    for (uint8_t i = 0; i < LEFT_BATCH; i++) {
+        uint8_t a = left_addition(b6[i], b3[i]);
+        out[i] = (a ^ b3[i]) & 0x0f;
+        b6[i] = a;
+    }
+}
 
-    for (uint64_t counter = offset; counter < 0x800000000ull; counter += skips) {
-        uint64_t lstate = counter;
+// Tests the LEFT_BATCH states base .. base + 31, they only differ in their lowest 5 bit cell.
+//
+// Every step of the left register reads the cells at bits 0..4 and 15..19 and shifts in a
+// new cell.  The lowest cell is only read by the very first step, whose output nibble is
+// thrown away, so the first keystream byte and the high nibble of the second byte are the
+// same for the whole batch and are checked once.  Most batches end there.  The rest is run
+// for all 32 states side by side, one 8 bit lane per state and one lane array per cell,
+// which the compiler turns into SIMD, until every lane has produced a wrong keystream bit.
+static inline void sm_left_batch(uint64_t base, const uint8_t *ks, const uint8_t *mask, left_arena_t *arena) {
+    uint8_t c1 = (base >> 5) & 0x1f;
+    uint8_t c2 = (base >> 10) & 0x1f;
+    uint8_t c3 = (base >> 15) & 0x1f;
+    uint8_t c4 = (base >> 20) & 0x1f;
+    uint8_t c5 = (base >> 25) & 0x1f;
+    uint8_t c6 = (base >> 30) & 0x1f;
+
+    // First keystream byte, produced by the second and fourth step
+    uint8_t bt = (lookup_left[(c4 << 5) | c1].out << 4) | lookup_left[(c6 << 5) | c3].out;
+    if (((bt ^ ks[0]) & mask[0]) != 0) return;
+
+    uint8_t a2 = lookup_left[(c4 << 5) | c1].addition;
+    uint8_t a3 = lookup_left[(c5 << 5) | c2].addition;
+    uint8_t a4 = lookup_left[(c6 << 5) | c3].addition;
+
+    // High nibble of the second byte, the sixth step reads c5 and the addition of the second step
+    if ((((lookup_left[(a2 << 5) | c5].out << 4) ^ ks[1]) & mask[1] & 0xf0) != 0) return;
+
+    // The cells of the register after the first byte, as a ring: step n replaces cell n % 7
+    uint8_t cells[7][LEFT_BATCH];
+    for (uint8_t i = 0; i < LEFT_BATCH; i++) {
+        cells[0][i] = left_addition(i, c3);
+        cells[1][i] = a2;
+        cells[2][i] = a3;
+        cells[3][i] = a4;
+        cells[4][i] = c4;
+        cells[5][i] = c5;
+        cells[6][i] = c6;
+    }
 
-        for (pos = 0; pos < 16; pos++) {
+    uint8_t wrong[LEFT_BATCH] = {0};
+    uint8_t hi[LEFT_BATCH];
+    uint8_t lo[LEFT_BATCH];
+
+    for (uint8_t pos = 1; pos < 16; pos++) {
+        uint8_t n = (4 * pos) % 7;
+        left_lanes_step(cells[n], cells[(n + 3) % 7], lo);
+        left_lanes_step(cells[(n + 1) % 7], cells[(n + 4) % 7], hi);
+        left_lanes_step(cells[(n + 2) % 7], cells[(n + 5) % 7], lo);
+        left_lanes_step(cells[(n + 3) % 7], cells[(n + 6) % 7], lo);
+
+        // When the REQUIRED bits are NOT xored away (=zero), the state in this lane is wrong
+        uint8_t alive = 0;
+        for (uint8_t i = 0; i < LEFT_BATCH; i++) {
+            wrong[i] |= (((hi[i] << 4) | lo[i]) ^ ks[pos]) & mask[pos];
+            alive |= (wrong[i] == 0);
+        }
+        if (alive == 0) return;
+    }
 
-            lstate = (((lstate) >> 5) | ((uint64_t)left_addition[((lstate) & 0xf801f)] << 30));
-            lookup = &(lookup_left[((lstate) & 0xf801f)]);
-            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
-            bt = lookup->out << 4;
-            lstate = (((lstate) >> 5) | ((uint64_t)left_addition[((lstate) & 0xf801f)] << 30));
-            lookup = &(lookup_left[((lstate) & 0xf801f)]);
-            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
-            bt |= lookup->out;
+    // The lanes left parsed all 16 bytes of keystream, they are valid CANDIDATES!
+    for (uint8_t i = 0; i < LEFT_BATCH; i++) {
+        if (wrong[i]) continue;
 
-            // xor the bits with the keystream and count the "correct" bits
-            bt ^= ks[pos];
+        // Count the total correct bits
+        size_t bits = 0;
+        uint64_t lstate = base + i;
+        for (uint8_t pos = 0; pos < 16; pos++) {
+            bits += count_correct_bits(next_left_ksbyte(&lstate) ^ ks[pos]);
+        }
 
-            // When the REQUIRED bits are NOT xored away (=zero), ignore this wrong state
-            if ((bt & mask[pos]) != 0) break;
+        //  Make sure the bits are used for ordering
+        arena->states.push_back((((uint64_t)bits) << 56) | (base + i));
 
-            // Save the correct bits for statistical information
-            correct_bits[pos] = bt;
-        }
+        g_ice_mtx.lock();
+        printf(".");
+        fflush(stdout);
+        g_ice_mtx.unlock();
+    }
+}
 
-        // If we have parsed all 16 bytes of keystream, we have a valid CANDIDATE!
-        if (pos == 16) {
-            // Count the total correct bits
-            bits = 0;
-            for (pos = 0; pos < 16; pos++) {
-                // Get the next byte-value with correct bits
-                bt = correct_bits[pos];
+static void ice_sm_left_thread(const uint8_t *ks, const uint8_t *mask, left_arena_t *arena) {
 
-                // Count all the (correct) bits
-                // When the bit is xored away (=zero), it was the same, so correct ;)
-                if ((bt & 0x01) == 0) bits++;
-                if (((bt >> 1) & 0x01) == 0) bits++;
-                if (((bt >> 2) & 0x01) == 0) bits++;
-                if (((bt >> 3) & 0x01) == 0) bits++;
-                if (((bt >> 4) & 0x01) == 0) bits++;
-                if (((bt >> 5) & 0x01) == 0) bits++;
-                if (((bt >> 6) & 0x01) == 0) bits++;
-                if (((bt >> 7) & 0x01) == 0) bits++;
-            }
+    uint64_t chunk;
 
-            state.l = counter;
+    while ((chunk = g_next_chunk.fetch_add(1)) < (LEFT_STATES / LEFT_CHUNK)) {
+        uint64_t start = chunk * LEFT_CHUNK;
 
-            //  Make sure the bits are used for ordering
+        if ((start & 0xffffffffull) == 0) {
             g_ice_mtx.lock();
-            printf(".");
+            printf("%02.1f%%.", ((float)100 / 8) * (start >> 32));
             fflush(stdout);
-            if (bincstates->find((((uint64_t)bits) << 56) | counter) != bincstates->end())
-                bincstates->at((((uint64_t)bits) << 56) | counter) = state;
-            else
-                bincstates->insert(std::pair<uint64_t, cs_t>((((uint64_t)bits) << 56) | counter, state));
             g_ice_mtx.unlock();
-
         }
 
-        if ((counter & 0xffffffffull) == 0) {
-            g_ice_mtx.lock();
-            printf("%02.1f%%.", ((float)100 / 8) * (counter >> 32));
-            fflush(stdout);
-            g_ice_mtx.unlock();
+        for (uint64_t base = start; base < start + LEFT_CHUNK; base += LEFT_BATCH) {
+            sm_left_batch(base, ks, mask, arena);
         }
     }
 }
 
 static void ice_sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcstates) {
 
-    map<uint64_t, cs_t> bincstates;
+    vector<left_arena_t> arenas(g_num_cpus);
+    g_next_chunk = 0;
+
     std::vector<std::thread> threads(g_num_cpus);
-    for (uint8_t m = 0; m < g_num_cpus; m++) {
-        threads[m] = std::thread(ice_sm_left_thread, m, g_num_cpus, ks, &bincstates, mask);
+    for (uint32_t m = 0; m < g_num_cpus; m++) {
+        arenas[m].states.reserve(ARENA_RESERVE);
+        threads[m] = std::thread(ice_sm_left_thread, ks, mask, &arenas[m]);
     }
 
     for (auto &t : threads) {
@@ -575,16 +693,32 @@ static void ice_sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcstates
 
     printf("100%%\n");
 
+    size_t total = 0;
+    for (auto &arena : arenas) {
+        total += arena.states.size();
+    }
+
+    vector<uint64_t> bincstates;
+    bincstates.reserve(total);
+    for (auto &arena : arenas) {
+        bincstates.insert(bincstates.end(), arena.states.begin(), arena.states.end());
+    }
+
+    // Order the states so the highest bin comes first
+    sort(bincstates.begin(), bincstates.end(), greater<uint64_t>());
+
+    // Reset and initialize the cryptostate and vector
+    cs_t state;
+    memset(&state, 0x00, sizeof(cs_t));
+    state.invalid = false;
+
     // Clear the candidate state vector
     pcstates->clear();
-
-    // Copy the order the states from lowest-bin to highest-bin
-    map<uint64_t, cs_t>::iterator it;
-    for (it = bincstates.begin(); it != bincstates.end(); ++it) {
-        pcstates->push_back(it->second);
+    pcstates->reserve(bincstates.size());
+    for (auto bstate : bincstates) {
+        state.l = ARENA_STATE(bstate);
+        pcstates->push_back(state);
     }
-    // Reverse the vector order (so the higest bin comes first)
-    reverse(pcstates->begin(), pcstates->end());
 }
 
 static inline uint32_t sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t> *pcrstates) {
@@ -661,6 +795,9 @@ static inline void previous_all_input(vector<cs_t> *pcstates, uint32_t gc_byte_i
     vector<cs_t> prev_ncstates;
     vector<cs_t>::iterator itnew;
 
+    // Every candidate gets 32 inputs, rollbacks that split are the exception
+    prev_ncstates.reserve(pcstates->size() * 0x20);
+
     // Loop through the complete entryphy of 5 bits for each candidate
     // We ignore zero (xor 0x00) to avoid duplicates
     for (btGc = 0; btGc < 0x20; btGc++)  {
@@ -686,7 +823,7 @@ static inline void previous_all_input(vector<cs_t> *pcstates, uint32_t gc_byte_i
     }
 
     // Copy the previous states into the vector
-    *pcstates = prev_ncstates;
+    pcstates->swap(prev_ncstates);
 }
 
 static inline void search_gc_candidates_right(const uint64_t rstate_before_gc, const uint64_t rstate_after_gc, const uint8_t *Q, vector<cs_t> *pcstates) {
@@ -749,7 +886,6 @@ static inline void sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcsta
     uint8_t correct_bits[16];
     uint8_t bt;
     cs_t state;
-    lookup_entry *lookup;
 
     // Reset and initialize the cryptostate and vecctor
     memset(&state, 0x00, sizeof(cs_t));
@@ -760,14 +896,7 @@ static inline void sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcsta
 
         for (pos = 0; pos < 16; pos++) {
 
-            lstate = (((lstate) >> 5) | ((uint64_t)left_addition[((lstate) & 0xf801f)] << 30));
-            lookup = &(lookup_left[((lstate) & 0xf801f)]);
-            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
-            bt = lookup->out << 4;
-            lstate = (((lstate) >> 5) | ((uint64_t)left_addition[((lstate) & 0xf801f)] << 30));
-            lookup = &(lookup_left[((lstate) & 0xf801f)]);
-            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
-            bt |= lookup->out;
+            bt = next_left_ksbyte(&lstate);
 
             // xor the bits with the keystream and count the "correct" bits
             bt ^= ks[pos];
@@ -931,10 +1060,7 @@ void combine_valid_left_right_states(vector<cs_t> *plcstates, vector<cs_t> *prcs
 }
 
 static void ice_compare(
-    uint8_t offset,
-    uint8_t skips,
     vector<uint64_t> *candidates,
-    crypto_state_t *ostate,
     uint8_t *Ci,
     uint8_t *Q,
     uint8_t *Ch,
@@ -943,15 +1069,17 @@ static void ice_compare(
     uint8_t Gc_chk[8];
     uint8_t Ch_chk[ 8];
     uint8_t Ci_1_chk[ 8];
+    crypto_state_t ostate;
+    uint64_t i;
 
-    for (std::size_t i = offset; i < candidates->size(); i += skips) {
+    while ((i = g_next_chunk.fetch_add(1)) < candidates->size()) {
         if (key_found.load(std::memory_order_relaxed))
             break;
 
         uint64_t tkey = candidates->at(i);
         num_to_bytes(tkey, 8, Gc_chk);
 
-        sm_auth(Gc_chk, Ci, Q, Ch_chk, Ci_1_chk, ostate);
+        sm_auth(Gc_chk, Ci, Q, Ch_chk, Ci_1_chk, &ostate);
         if ((memcmp(Ch_chk, Ch, 8) == 0) && (memcmp(Ci_1_chk, Ci_1, 8) == 0)) {
             g_ice_mtx.lock();
             key_found = true;
@@ -1046,17 +1174,8 @@ int main(int argc, const char *argv[]) {
     printf("\n");
 
     printf("\nMultithreaded, will use " _YELLOW_("%u") " threads\n", g_num_cpus);
-    printf("Initializing lookup tables for increasing cipher speed\n");
 
-    std::thread foo_left(init_lookup_left);
-    std::thread foo_right(init_lookup_right);
-    std::thread foo_leftsub(init_lookup_left_substraction);
-    std::thread foo_rightsub(init_lookup_right_substraction);
-
-    foo_left.join();
-    foo_right.join();
-    foo_leftsub.join();
-    foo_rightsub.join();
+    auto start_time = std::chrono::steady_clock::now();
 
     // Load in the ci (tag-nonce), together with the first half of Q (reader-nonce)
     rstate_before_gc = 0;
@@ -1112,9 +1231,10 @@ int main(int argc, const char *argv[]) {
 
         key_found = ATOMIC_VAR_INIT(false);
         key = ATOMIC_VAR_INIT(0);
+        g_next_chunk = 0;
         std::vector<std::thread> threads(g_num_cpus);
-        for (uint8_t m = 0; m < g_num_cpus; m++) {
-            threads[m] =  std::thread(ice_compare, m, g_num_cpus, &pgc_candidates, &ostate, ref(Ci), ref(Q), ref(Ch), ref(Ci_1));
+        for (uint32_t m = 0; m < g_num_cpus; m++) {
+            threads[m] =  std::thread(ice_compare, &pgc_candidates, ref(Ci), ref(Q), ref(Ch), ref(Ci_1));
         }
 
         for (auto &t : threads) {
@@ -1128,5 +1248,8 @@ int main(int argc, const char *argv[]) {
 
         printf(_RED_("\nCould not find key using this right cipher state.\n\n"));
     }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    printf("Recovery took " _YELLOW_("%.1f") " seconds\n", elapsed.count());
     return 0;
 }
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// ISO14443-A Miller / Manchester decoders, built from armsrc/iso14443a.c and common/iso14443a_decode.c
+//-----------------------------------------------------------------------------
+#include "hal_shim.h"
+#include "iso14443a.c"
+#include "iso14443a_decode.c"
+
+// same decoder calls and resets as the SniffIso14443a() main loop
+void replay_iso14443a(const uint8_t *samples, size_t count, hf_frame_cb cb, void *ctx) {
+
+    static uint8_t receivedCmd[MAX_FRAME_SIZE];
+    static uint8_t receivedCmdPar[MAX_PARITY_SIZE];
+    static uint8_t receivedResp[MAX_FRAME_SIZE];
+    static uint8_t receivedRespPar[MAX_PARITY_SIZE];
+
+    Demod14aInit(receivedResp, receivedRespPar);
+    Uart14aInit(receivedCmd, receivedCmdPar);
+
+    uint8_t previous_data = 0;
+    bool TagIsActive = false;
+    bool ReaderIsActive = false;
+
+    for (uint32_t rx_samples = 0; rx_samples < count; rx_samples++) {
+
+        hal_word_begin();
+
+        uint8_t data = samples[rx_samples];
+
+        // Need two samples to feed Miller and Manchester-Decoder
+        if (rx_samples & 0x01) {
+
+            if (TagIsActive == false) {
+                uint8_t readerdata = (previous_data & 0xF0) | (data >> 4);
+                if (MillerDecoding(readerdata, (rx_samples - 1) * 4)) {
+                    hal_frame(cb, ctx, true, receivedCmd, Uart.len, Uart.bitCount, Uart.parity);
+                    Uart14aReset();
+                    Demod14aReset();
+                }
+                ReaderIsActive = (Uart.state != STATE_14A_UNSYNCD);
+            }
+
+            if (ReaderIsActive == false) {
+                uint8_t tagdata = (previous_data << 4) | (data & 0x0F);
+                if (ManchesterDecoding(tagdata, 0, (rx_samples - 1) * 4)) {
+                    hal_frame(cb, ctx, false, receivedResp, Demod.len, 0, Demod.parity);
+                    Demod14aReset();
+                    Uart14aReset();
+                }
+                TagIsActive = (Demod.state != DEMOD_14A_UNSYNCD);
+            }
+        }
+
+        previous_data = data;
+
+        hal_word_end();
+    }
+}
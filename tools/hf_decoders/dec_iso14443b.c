@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// ISO14443-B reader / tag decoders, built from armsrc/iso14443b.c and common/iso14443b_decode.c
+//-----------------------------------------------------------------------------
+#include "hal_shim.h"
+#include "iso14443b.c"
+#include "iso14443b_decode.c"
+
+// same decoder calls and resets as the SniffIso14443b() main loop
+void replay_iso14443b(const uint16_t *words, size_t count, hf_frame_cb cb, void *ctx) {
+
+    static uint8_t dm_buf[MAX_FRAME_SIZE];
+    static uint8_t ua_buf[MAX_FRAME_SIZE];
+
+    Demod14bInit(dm_buf, sizeof(dm_buf));
+    Uart14bInit(ua_buf);
+
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+    bool expect_tag_answer = false;
+
+    for (size_t i = 0; i < count; i++) {
+
+        hal_word_begin();
+
+        int8_t ci = words[i] >> 8;
+        int8_t cq = words[i];
+
+        if (tag_is_active == false) {
+
+            if (Handle14443bSampleFromReader(&Uart, ci & 0x01)) {
+                hal_frame(cb, ctx, true, Uart.output, Uart.byteCnt, 0, NULL);
+                Uart14bReset();
+                Demod14bReset();
+                expect_tag_answer = true;
+            }
+
+            if (Handle14443bSampleFromReader(&Uart, cq & 0x01)) {
+                hal_frame(cb, ctx, true, Uart.output, Uart.byteCnt, 0, NULL);
+                Uart14bReset();
+                Demod14bReset();
+                expect_tag_answer = true;
+            }
+
+            reader_is_active = (Uart.state > STATE_14B_GOT_FALLING_EDGE_OF_SOF);
+        }
+
+        if (reader_is_active == false && expect_tag_answer) {
+
+            if (Handle14443bSamplesFromTag(&Demod, (ci >> 1), (cq >> 1))) {
+                hal_frame(cb, ctx, false, Demod.output, Demod.len, 0, NULL);
+                Uart14bReset();
+                Demod14bReset();
+                expect_tag_answer = false;
+                tag_is_active = false;
+            } else {
+                tag_is_active = (Demod.state > WAIT_FOR_RISING_EDGE_OF_SOF);
+            }
+        }
+
+        hal_word_end();
+    }
+}
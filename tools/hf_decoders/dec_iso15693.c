@@ -0,0 +1,78 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// ISO15693 reader / tag decoders, built from armsrc/iso15693.c and common/iso15693_decode.c
+//-----------------------------------------------------------------------------
+#include "hal_shim.h"
+#include "iso15693.c"
+#include "iso15693_decode.c"
+
+// same decoder calls and resets as the SniffIso15693() main loop
+void replay_iso15693(const uint16_t *words, size_t count, hf_frame_cb cb, void *ctx) {
+
+    static uint8_t response[ISO15693_MAX_RESPONSE_LENGTH];
+    static uint8_t cmd[ISO15693_MAX_COMMAND_LENGTH];
+
+    DecodeTag_t dtag = {0};
+    DecodeTagInit(&dtag, response, sizeof(response));
+
+    DecodeReader_t dreader = {0};
+    DecodeReaderInit(&dreader, cmd, sizeof(cmd), 0, NULL);
+
+    bool tag_is_active = false;
+    bool reader_is_active = false;
+    bool expect_tag_answer = false;
+
+    for (size_t i = 0; i < count; i++) {
+
+        hal_word_begin();
+
+        uint16_t sniffdata = words[i];
+
+        if (tag_is_active == false) {
+
+            if (Handle15693SampleFromReader((sniffdata & 0x02) >> 1, &dreader)
+                    || Handle15693SampleFromReader(sniffdata & 0x01, &dreader)) {
+
+                if (dreader.byteCount > 0) {
+                    hal_frame(cb, ctx, true, dreader.output, dreader.byteCount, 0, NULL);
+                }
+                DecodeReaderReset(&dreader);
+                DecodeTagReset(&dtag);
+                reader_is_active = false;
+                expect_tag_answer = true;
+
+            } else {
+                reader_is_active = (dreader.state >= STATE_READER_RECEIVE_DATA_1_OUT_OF_4);
+            }
+        }
+
+        if (reader_is_active == false && expect_tag_answer) {
+
+            if (Handle15693SamplesFromTag(sniffdata >> 2, &dtag)) {
+
+                hal_frame(cb, ctx, false, dtag.output, dtag.len, 0, NULL);
+                DecodeTagReset(&dtag);
+                DecodeReaderReset(&dreader);
+                expect_tag_answer = false;
+                tag_is_active = false;
+            } else {
+                tag_is_active = (dtag.state >= STATE_TAG_RECEIVING_DATA);
+            }
+        }
+
+        hal_word_end();
+    }
+}
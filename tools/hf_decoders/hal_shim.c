@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Host side of the HAL shim: fake peripherals, the firmware functions the
+// decoders call, and the instruction count model.
+//
+// The dec_*.c units are built with -fsanitize-coverage=trace-pc, so the
+// compiler calls __sanitizer_cov_trace_pc() once per executed basic block.
+// This unit is not instrumented; it counts those calls per DMA word. The
+// estimate is blocks * cycles-per-block, a block of the host build standing
+// in for a block of the ARM build of the same C code.
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include "at91sam7s512.h"
+#include "hf_decoders.h"
+
+AT91S_PIO  hal_pioa;
+AT91S_WDTC hal_wdtc;
+AT91S_SSC  hal_ssc;
+AT91S_PDC  hal_pdc_ssc;
+
+static uint64_t hal_blocks;
+static uint64_t hal_word_start;
+static uint64_t hal_window_sum;
+static uint32_t hal_window[HF_DMA_WORDS];
+static hf_cost_t hal_cost;
+
+void __sanitizer_cov_trace_pc(void);
+void __sanitizer_cov_trace_pc(void) {
+    hal_blocks++;
+}
+
+// sniffers take their timestamps from the sample count, this is only
+// reached for the very first sample
+uint32_t GetCountSspClk(void);
+uint32_t GetCountSspClk(void) {
+    return (uint32_t)(hal_cost.words * 16);
+}
+
+// 15693 jamming reconfigures the FPGA, nothing to do here
+void FpgaWriteConfWord(uint16_t v);
+void FpgaWriteConfWord(uint16_t v) {
+    (void)v;
+}
+
+void hal_cost_reset(void) {
+    memset(&hal_cost, 0, sizeof(hal_cost));
+    memset(hal_window, 0, sizeof(hal_window));
+    hal_window_sum = 0;
+    hal_blocks = 0;
+}
+
+void hal_word_begin(void) {
+    hal_word_start = hal_blocks;
+}
+
+void hal_word_end(void) {
+    uint32_t blocks = (uint32_t)(hal_blocks - hal_word_start);
+    uint32_t slot = hal_cost.words % HF_DMA_WORDS;
+
+    hal_window_sum += blocks;
+    hal_window_sum -= hal_window[slot];
+    hal_window[slot] = blocks;
+
+    hal_cost.words++;
+    hal_cost.blocks += blocks;
+    if (blocks > hal_cost.max)
+        hal_cost.max = blocks;
+    if (hal_window_sum > hal_cost.peak_window)
+        hal_cost.peak_window = hal_window_sum;
+}
+
+const hf_cost_t *hal_cost_get(void) {
+    return &hal_cost;
+}
+
+void hal_frame(hf_frame_cb cb, void *ctx, bool reader, const uint8_t *data, uint16_t len, uint8_t bits, const uint8_t *parity) {
+    hf_frame_t f;
+    memset(&f, 0, sizeof(f));
+    if (len > HF_MAX_FRAME)
+        len = HF_MAX_FRAME;
+
+    f.reader = reader;
+    f.len = len;
+    f.bits = bits;
+    memcpy(f.data, data, len);
+    if (parity) {
+        f.has_parity = true;
+        memcpy(f.parity, parity, (len + 7) / 8);
+    }
+    cb(&f, ctx);
+}
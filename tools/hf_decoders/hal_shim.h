@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Thin HAL shim, lets armsrc decoders compile and run on the host.
+//
+// Include this before the firmware source. The LED, watchdog and SSC/PDC
+// macros of proxmark3_arm.h are pointed at host memory instead of the
+// AT91SAM7S peripheral addresses; the include guards keep the overrides
+// when the firmware source includes proxmark3_arm.h again.
+//-----------------------------------------------------------------------------
+#ifndef HAL_SHIM_H__
+#define HAL_SHIM_H__
+
+#include "proxmark3_arm.h"
+#include "hf_decoders.h"
+
+extern AT91S_PIO  hal_pioa;
+extern AT91S_WDTC hal_wdtc;
+extern AT91S_SSC  hal_ssc;
+extern AT91S_PDC  hal_pdc_ssc;
+
+#undef AT91C_BASE_PIOA
+#undef AT91C_BASE_WDTC
+#undef AT91C_BASE_SSC
+#undef AT91C_BASE_PDC_SSC
+#define AT91C_BASE_PIOA     (&hal_pioa)
+#define AT91C_BASE_WDTC     (&hal_wdtc)
+#define AT91C_BASE_SSC      (&hal_ssc)
+#define AT91C_BASE_PDC_SSC  (&hal_pdc_ssc)
+
+#endif
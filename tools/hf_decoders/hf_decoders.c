@@ -0,0 +1,350 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Test and benchmark harness for the firmware HF sniff decoders.
+//
+// Every vector file lists the frames of an exchange. The matching raw sniff
+// stream is synthesised (or read from a recording with -r), replayed through
+// the armsrc decoders, and the decoded frames are checked against the list.
+// The decoders are instrumented to count basic blocks, which gives an
+// estimate of the ARM cycles spent per DMA word against the real time budget.
+//-----------------------------------------------------------------------------
+#define __STDC_FORMAT_MACROS
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <getopt.h>
+#include "hf_decoders.h"
+
+#define MAX_FRAMES   256
+#define MAX_WORDS    (4 * 1024 * 1024)
+
+typedef struct {
+    hf_frame_t *frames;
+    size_t count;
+    size_t max;
+    bool verbose;
+} decoded_t;
+
+static const char *proto_name[] = { "iso14443a", "iso15693", "iso14443b" };
+
+static void usage(const char *prog) {
+    printf("Test and benchmark the firmware HF sniff decoders on the host\n\n");
+    printf("Usage: %s [-v] [-c cycles] [-r raw | -w raw] vector.txt [vector.txt...]\n\n", prog);
+    printf("  -v           print the decoded frames\n");
+    printf("  -c <cycles>  cycles per basic block of the instruction count model (default %d)\n", HF_CYCLES_PER_BLOCK);
+    printf("  -r <file>    replay this recorded sniff stream instead of a synthesised one\n");
+    printf("  -w <file>    write the synthesised sniff stream to file\n\n");
+    printf("Vector file:\n");
+    printf("  proto iso14443a | iso15693 | iso14443b\n");
+    printf("  R <hex>[(bits)]   frame from the reader, bits of the last byte for 14a short frames\n");
+    printf("  T <hex>           frame from the tag\n\n");
+    printf("Raw files hold the DMA stream of the sniff command, 14a one byte per sample,\n");
+    printf("15693 and 14b one little endian 16 bit word per sample.\n");
+}
+
+static void print_frame(const char *prefix, const hf_frame_t *f) {
+    printf("%s%s ", prefix, f->reader ? "R" : "T");
+    for (int i = 0; i < f->len; i++)
+        printf("%02X", f->data[i]);
+    if (f->bits)
+        printf("(%u)", f->bits);
+    printf("\n");
+}
+
+static void on_frame(const hf_frame_t *f, void *ctx) {
+    decoded_t *d = (decoded_t *)ctx;
+    if (d->verbose)
+        print_frame("    ", f);
+    if (d->count < d->max)
+        d->frames[d->count] = *f;
+    d->count++;
+}
+
+static int parse_frame(char *line, hf_frame_t *f) {
+    memset(f, 0, sizeof(hf_frame_t));
+    f->reader = (toupper((unsigned char)line[0]) == 'R');
+
+    int nibbles = 0;
+    for (char *p = line + 1; *p; p++) {
+        if (isspace((unsigned char)*p))
+            continue;
+        if (*p == '(') {
+            f->bits = atoi(p + 1);
+            if (f->bits > 7)
+                return 1;
+            break;
+        }
+        if (!isxdigit((unsigned char)*p) || (nibbles / 2) >= HF_MAX_FRAME)
+            return 1;
+        int v = isdigit((unsigned char)*p) ? *p - '0' : (toupper((unsigned char)*p) - 'A' + 10);
+        f->data[nibbles / 2] = (f->data[nibbles / 2] << 4) | v;
+        nibbles++;
+    }
+    if (nibbles == 0 || (nibbles & 1))
+        return 1;
+    f->len = nibbles / 2;
+    return 0;
+}
+
+static int load_vector(const char *path, hf_proto_t *proto, hf_frame_t *frames, size_t *count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+
+    int res = 0, lineno = 0;
+    bool have_proto = false;
+    char line[1024];
+    *count = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *p = line;
+        while (isspace((unsigned char)*p))
+            p++;
+        p[strcspn(p, "\r\n#")] = 0;
+        if (*p == 0)
+            continue;
+
+        if (strncmp(p, "proto ", 6) == 0) {
+            char *name = p + 6;
+            name[strcspn(name, " \t")] = 0;
+            have_proto = false;
+            for (int i = 0; i < 3; i++) {
+                if (strcmp(name, proto_name[i]) == 0) {
+                    *proto = i;
+                    have_proto = true;
+                }
+            }
+            if (!have_proto) {
+                printf("%s:%d: unknown protocol %s\n", path, lineno, name);
+                res = 1;
+                break;
+            }
+            continue;
+        }
+
+        if ((toupper((unsigned char)*p) != 'R' && toupper((unsigned char)*p) != 'T') ||
+                *count >= MAX_FRAMES || parse_frame(p, &frames[*count])) {
+            printf("%s:%d: cannot parse frame\n", path, lineno);
+            res = 1;
+            break;
+        }
+        (*count)++;
+    }
+    fclose(fp);
+
+    if (res == 0 && !have_proto) {
+        printf("%s: no proto line\n", path);
+        res = 1;
+    }
+    return res;
+}
+
+static size_t read_raw(const char *path, hf_proto_t proto, void *buf, size_t max) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        printf("cannot open %s\n", path);
+        return 0;
+    }
+
+    size_t n = 0;
+    if (proto == HF_ISO14443A) {
+        n = fread(buf, 1, max, fp);
+    } else {
+        uint8_t le[2];
+        uint16_t *w = (uint16_t *)buf;
+        while (n < max && fread(le, 1, 2, fp) == 2)
+            w[n++] = le[0] | (le[1] << 8);
+    }
+    fclose(fp);
+    return n;
+}
+
+static int write_raw(const char *path, hf_proto_t proto, const void *buf, size_t n) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        printf("cannot create %s\n", path);
+        return 1;
+    }
+
+    size_t done = 0;
+    if (proto == HF_ISO14443A) {
+        done = fwrite(buf, 1, n, fp);
+    } else {
+        const uint16_t *w = (const uint16_t *)buf;
+        for (; done < n; done++) {
+            uint8_t le[2] = { w[done] & 0xFF, w[done] >> 8 };
+            if (fwrite(le, 1, 2, fp) != 2)
+                break;
+        }
+    }
+    fclose(fp);
+
+    if (done != n) {
+        printf("cannot write all of the data to %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+static bool oddparity(uint8_t b) {
+    b ^= b >> 4;
+    b ^= b >> 2;
+    b ^= b >> 1;
+    return !(b & 1);
+}
+
+static bool frame_match(const hf_frame_t *want, const hf_frame_t *got) {
+    if (want->reader != got->reader || want->len != got->len || want->bits != got->bits)
+        return false;
+    if (memcmp(want->data, got->data, want->len))
+        return false;
+    if (got->has_parity) {
+        for (int i = 0; i < got->len; i++) {
+            if (i == got->len - 1 && got->bits)
+                break;
+            if (((got->parity[i / 8] >> (7 - (i % 8))) & 1) != oddparity(got->data[i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static int run_vector(const char *path, const char *rawin, const char *rawout, uint32_t cpb, bool verbose) {
+
+    static hf_frame_t want[MAX_FRAMES];
+    static hf_frame_t got[MAX_FRAMES];
+    hf_proto_t proto = HF_ISO14443A;
+    size_t nwant = 0;
+
+    if (load_vector(path, &proto, want, &nwant))
+        return 1;
+
+    void *raw = calloc(MAX_WORDS, sizeof(uint16_t));
+    if (!raw) {
+        printf("cannot malloc\n");
+        return 1;
+    }
+
+    size_t nraw;
+    if (rawin) {
+        nraw = read_raw(rawin, proto, raw, MAX_WORDS);
+    } else if (proto == HF_ISO14443A) {
+        nraw = encode_iso14443a(want, nwant, raw, MAX_WORDS);
+    } else if (proto == HF_ISO15693) {
+        nraw = encode_iso15693(want, nwant, raw, MAX_WORDS);
+    } else {
+        nraw = encode_iso14443b(want, nwant, raw, MAX_WORDS);
+    }
+
+    if (nraw == 0) {
+        printf("%s: no samples\n", rawin ? rawin : path);
+        free(raw);
+        return 1;
+    }
+
+    if (rawout && write_raw(rawout, proto, raw, nraw)) {
+        free(raw);
+        return 1;
+    }
+
+    decoded_t dec = { .frames = got, .count = 0, .max = MAX_FRAMES, .verbose = verbose };
+
+    if (verbose)
+        printf("%s, %s, %zu samples\n", path, proto_name[proto], nraw);
+
+    hal_cost_reset();
+    if (proto == HF_ISO14443A)
+        replay_iso14443a(raw, nraw, on_frame, &dec);
+    else if (proto == HF_ISO15693)
+        replay_iso15693(raw, nraw, on_frame, &dec);
+    else
+        replay_iso14443b(raw, nraw, on_frame, &dec);
+    free(raw);
+
+    size_t matched = 0;
+    for (size_t i = 0; i < nwant && i < dec.count; i++) {
+        if (frame_match(&want[i], &got[i])) {
+            matched++;
+        } else {
+            printf("frame %zu differs\n", i);
+            print_frame("  want ", &want[i]);
+            print_frame("  got  ", &got[i]);
+        }
+    }
+    bool frames_ok = (matched == nwant) && (dec.count == nwant);
+
+    const hf_cost_t *cost = hal_cost_get();
+    double avg = (double)cost->blocks * cpb / (double)cost->words;
+    double window = (double)cost->peak_window * cpb / (double)HF_DMA_WORDS;
+    bool cycles_ok = window <= HF_BUDGET_CYCLES;
+
+    printf("%-10s %-28s frames %zu/%zu decoded %zu  %s\n", proto_name[proto], path, matched, nwant, dec.count, frames_ok ? "( ok )" : "( fail )");
+    printf("%-10s cycles/word  avg %.1f  max %" PRIu32 "  peak %d word window %.1f  budget %" PRIu32 "  %s\n",
+           proto_name[proto], avg, cost->max * cpb, HF_DMA_WORDS, window, HF_BUDGET_CYCLES, cycles_ok ? "( ok )" : "( over budget )");
+
+    return (frames_ok && cycles_ok) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    const char *rawin = NULL, *rawout = NULL;
+    uint32_t cpb = HF_CYCLES_PER_BLOCK;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vc:r:w:h")) != -1) {
+        switch (opt) {
+            case 'v':
+                verbose = true;
+                break;
+            case 'c':
+                cpb = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rawin = optarg;
+                break;
+            case 'w':
+                rawout = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    int nvectors = argc - optind;
+    if (nvectors < 1 || cpb == 0 || (rawin && rawout) || ((rawin || rawout) && nvectors != 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = optind; i < argc; i++)
+        failed += run_vector(argv[i], rawin, rawout, cpb, verbose);
+
+    if (failed) {
+        printf("%d of %d vectors failed\n", failed, nvectors);
+        return 1;
+    }
+    printf("all %d vectors passed\n", nvectors);
+    return 0;
+}
@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Host harness for the firmware HF sniff decoders.
+//
+// This header is shared between the host side (main, encoders) and the
+// translation units that compile the firmware sources, so it must only
+// pull in freestanding headers.
+//-----------------------------------------------------------------------------
+#ifndef HF_DECODERS_H__
+#define HF_DECODERS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HF_MAX_FRAME          256
+
+// all three sniffers get one DMA word every 4.72us, 226 cycles of the 48MHz MCK
+#define HF_MCK_HZ             48000000
+#define HF_WORD_NS            4720
+#define HF_BUDGET_CYCLES      ((uint32_t)(((uint64_t)HF_MCK_HZ * HF_WORD_NS) / 1000000000))
+
+// the firmware DMA ring, a decoder may fall behind by this many words
+#define HF_DMA_WORDS          512
+
+// default instruction count model, cycles per executed basic block on the ARM7TDMI
+#define HF_CYCLES_PER_BLOCK   6
+
+typedef enum {
+    HF_ISO14443A,
+    HF_ISO15693,
+    HF_ISO14443B,
+} hf_proto_t;
+
+typedef struct {
+    bool reader;                   // reader -> tag
+    uint16_t len;                  // bytes in data
+    uint8_t bits;                  // valid bits of the last byte, 0 means 8 (14a short frames)
+    bool has_parity;
+    uint8_t data[HF_MAX_FRAME];
+    uint8_t parity[HF_MAX_FRAME / 8];
+} hf_frame_t;
+
+typedef void (*hf_frame_cb)(const hf_frame_t *frame, void *ctx);
+
+// replay a raw sniff DMA stream through the firmware decoders, mirrors the
+// Sniff* main loops of armsrc. See dec_*.c
+void replay_iso14443a(const uint8_t *samples, size_t count, hf_frame_cb cb, void *ctx);
+void replay_iso15693(const uint16_t *words, size_t count, hf_frame_cb cb, void *ctx);
+void replay_iso14443b(const uint16_t *words, size_t count, hf_frame_cb cb, void *ctx);
+
+// synthesise the raw sniff DMA stream the FPGA would deliver for a list of
+// frames. Returns the number of samples / words written, 0 if out is too small.
+size_t encode_iso14443a(const hf_frame_t *frames, size_t n, uint8_t *out, size_t max);
+size_t encode_iso15693(const hf_frame_t *frames, size_t n, uint16_t *out, size_t max);
+size_t encode_iso14443b(const hf_frame_t *frames, size_t n, uint16_t *out, size_t max);
+
+// instruction count model, see hal_shim.c
+typedef struct {
+    uint64_t words;
+    uint64_t blocks;
+    uint32_t max;                  // worst single word, in blocks
+    uint64_t peak_window;          // worst HF_DMA_WORDS window, in blocks
+} hf_cost_t;
+
+void hal_cost_reset(void);
+void hal_word_begin(void);
+void hal_word_end(void);
+const hf_cost_t *hal_cost_get(void);
+
+// hand a decoded frame to the callback, outside of the measured code
+void hal_frame(hf_frame_cb cb, void *ctx, bool reader, const uint8_t *data, uint16_t len, uint8_t bits, const uint8_t *parity);
+
+#endif
@@ -0,0 +1,299 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Synthesise the sniff DMA streams the FPGA delivers for a frame sequence.
+//
+// 14a:   one byte per 4 ticks of fc/32, reader in the high nibble (1 = carrier),
+//        tag in the low nibble (1 = load modulation), earliest tick first.
+// 15693: one word per 4.72us, two reader samples in bit 1 and bit 0,
+//        tag subcarrier amplitude in bits 15..2.
+// 14b:   one word per 4.72us, I in the high byte and Q in the low byte, the
+//        two reader samples in bit 0 of each, tag I/Q in bits 7..1.
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include "hf_decoders.h"
+
+typedef struct {
+    void *out;
+    size_t max;
+    size_t n;
+    bool overflow;
+    uint8_t pending;               // 14a ticks / 15693 and 14b reader samples not yet written
+    int npending;
+} enc_t;
+
+static void enc_init(enc_t *e, void *out, size_t max) {
+    memset(e, 0, sizeof(enc_t));
+    e->out = out;
+    e->max = max;
+}
+
+static void put8(enc_t *e, uint8_t v) {
+    if (e->n >= e->max) {
+        e->overflow = true;
+        return;
+    }
+    ((uint8_t *)e->out)[e->n++] = v;
+}
+
+static void put16(enc_t *e, uint16_t v) {
+    if (e->n >= e->max) {
+        e->overflow = true;
+        return;
+    }
+    ((uint16_t *)e->out)[e->n++] = v;
+}
+
+static bool oddparity(uint8_t b) {
+    b ^= b >> 4;
+    b ^= b >> 2;
+    b ^= b >> 1;
+    return !(b & 1);
+}
+
+// the gap before frame i varies a little, so frames start at every sample phase
+static int gap(size_t i, int base) {
+    return base + (int)((i * 5) % 11);
+}
+
+//-----------------------------------------------------------------------------
+// ISO14443-A
+//-----------------------------------------------------------------------------
+static void tick14a(enc_t *e, bool reader, bool tag) {
+    e->pending = (e->pending << 1) | (reader ? 0x10 : 0x00) | (tag ? 0x01 : 0x00);
+    e->npending++;
+    if (e->npending == 4) {
+        put8(e, e->pending);
+        e->pending = 0;
+        e->npending = 0;
+    }
+}
+
+// 8 ticks of the reader, MSB first, tag idle
+static void reader14a(enc_t *e, uint8_t pattern) {
+    for (int i = 7; i >= 0; i--)
+        tick14a(e, (pattern >> i) & 1, false);
+}
+
+static void tag14a(enc_t *e, uint8_t pattern) {
+    for (int i = 7; i >= 0; i--)
+        tick14a(e, true, (pattern >> i) & 1);
+}
+
+static void idle14a(enc_t *e, int ticks) {
+    for (int i = 0; i < ticks; i++)
+        tick14a(e, true, false);
+}
+
+#define MILLER_X  0xF3             // pause in the second half, logic 1
+#define MILLER_Y  0xFF             // no pause
+#define MILLER_Z  0x3F             // pause in the first half
+#define MANCH_D   0xF0             // modulation in the first half, logic 1
+#define MANCH_E   0x0F             // modulation in the second half, logic 0
+#define MANCH_F   0x00             // no modulation, end of frame
+
+static int frame_bits14a(const hf_frame_t *f, bool *bits) {
+    int n = 0;
+    for (int i = 0; i < f->len; i++) {
+        int nbits = ((i == f->len - 1) && f->bits) ? f->bits : 8;
+        for (int j = 0; j < nbits; j++)
+            bits[n++] = (f->data[i] >> j) & 1;
+        if (nbits == 8)
+            bits[n++] = oddparity(f->data[i]);
+    }
+    return n;
+}
+
+size_t encode_iso14443a(const hf_frame_t *frames, size_t n, uint8_t *out, size_t max) {
+    enc_t e;
+    enc_init(&e, out, max);
+    static bool bits[HF_MAX_FRAME * 9];
+
+    for (size_t i = 0; i < n; i++) {
+        const hf_frame_t *f = &frames[i];
+        idle14a(&e, gap(i, 96));
+
+        int nbits = frame_bits14a(f, bits);
+        if (f->reader) {
+            bool last = false;
+            reader14a(&e, MILLER_Z);                       // start of communication
+            for (int j = 0; j < nbits; j++) {
+                reader14a(&e, bits[j] ? MILLER_X : (last ? MILLER_Y : MILLER_Z));
+                last = bits[j];
+            }
+            reader14a(&e, last ? MILLER_Y : MILLER_Z);     // logic 0 ...
+            reader14a(&e, MILLER_Y);                       // ... followed by Y, end of communication
+        } else {
+            tag14a(&e, MANCH_D);                           // start of communication
+            for (int j = 0; j < nbits; j++)
+                tag14a(&e, bits[j] ? MANCH_D : MANCH_E);
+            tag14a(&e, MANCH_F);
+        }
+    }
+    idle14a(&e, 96);
+    return e.overflow ? 0 : e.n;
+}
+
+//-----------------------------------------------------------------------------
+// ISO15693, 1 out of 4 coding from the reader, single subcarrier high data rate from the tag
+//-----------------------------------------------------------------------------
+#define AMP15_LOW   20
+#define AMP15_HIGH  400
+
+static void reader15(enc_t *e, bool bit) {
+    e->pending = (e->pending << 1) | bit;
+    e->npending++;
+    if (e->npending == 2) {
+        put16(e, (AMP15_LOW << 2) | (e->pending & 0x03));
+        e->pending = 0;
+        e->npending = 0;
+    }
+}
+
+static void reader15_run(enc_t *e, bool bit, int samples) {
+    for (int i = 0; i < samples; i++)
+        reader15(e, bit);
+}
+
+static void tag15_run(enc_t *e, bool high, int words) {
+    for (int i = 0; i < words; i++)
+        put16(e, ((high ? AMP15_HIGH : AMP15_LOW) << 2) | 0x03);
+}
+
+// tag bits are 8 words, logic 0 is modulated first, logic 1 last
+static void tag15_bit(enc_t *e, bool bit) {
+    tag15_run(e, !bit, 4);
+    tag15_run(e, bit, 4);
+}
+
+size_t encode_iso15693(const hf_frame_t *frames, size_t n, uint16_t *out, size_t max) {
+    enc_t e;
+    enc_init(&e, out, max);
+
+    for (size_t i = 0; i < n; i++) {
+        const hf_frame_t *f = &frames[i];
+        if (f->reader) {
+            reader15_run(&e, true, 2 * gap(i, 96));
+            // SOF
+            reader15_run(&e, false, 4);
+            reader15_run(&e, true, 16);
+            reader15_run(&e, false, 4);
+            reader15_run(&e, true, 8);
+            // every 2 bits, LSB first, select one of 4 slots of 8 samples
+            for (int j = 0; j < f->len; j++) {
+                for (int k = 0; k < 4; k++) {
+                    int sym = (f->data[j] >> (2 * k)) & 0x03;
+                    for (int slot = 0; slot < 4; slot++) {
+                        reader15_run(&e, true, 4);
+                        reader15_run(&e, slot != sym, 4);
+                    }
+                }
+            }
+            // EOF
+            reader15_run(&e, false, 4);
+            reader15_run(&e, true, 4);
+        } else {
+            tag15_run(&e, false, gap(i, 64));
+            // SOF, unmodulated, 24 pulses, logic 1
+            tag15_run(&e, true, 12);
+            tag15_bit(&e, true);
+            for (int j = 0; j < f->len; j++)
+                for (int k = 0; k < 8; k++)
+                    tag15_bit(&e, (f->data[j] >> k) & 1);
+            // EOF, logic 0, 24 pulses, unmodulated
+            tag15_bit(&e, false);
+            tag15_run(&e, true, 12);
+            tag15_run(&e, false, 12);
+        }
+    }
+    reader15_run(&e, true, 2 * 96);
+    return e.overflow ? 0 : e.n;
+}
+
+//-----------------------------------------------------------------------------
+// ISO14443-B, NRZ-L from the reader at 4 samples per etu, BPSK from the tag at 2 words per etu
+//-----------------------------------------------------------------------------
+#define IQ14B_I  40
+#define IQ14B_Q  20
+
+static void word14b(enc_t *e, int i, int q, uint8_t reader) {
+    uint8_t ci = (uint8_t)((i * 2) | ((reader >> 1) & 1));
+    uint8_t cq = (uint8_t)((q * 2) | (reader & 1));
+    put16(e, (ci << 8) | cq);
+}
+
+static void reader14b(enc_t *e, bool bit) {
+    e->pending = (e->pending << 1) | bit;
+    e->npending++;
+    if (e->npending == 2) {
+        word14b(e, 0, 0, e->pending & 0x03);
+        e->pending = 0;
+        e->npending = 0;
+    }
+}
+
+static void reader14b_etu(enc_t *e, bool bit, int etus) {
+    for (int i = 0; i < etus * 4; i++)
+        reader14b(e, bit);
+}
+
+// phase 1 is the phase of the reference subcarrier, phase 0 its inverse, -1 no subcarrier
+static void tag14b_etu(enc_t *e, int phase, int etus) {
+    for (int i = 0; i < etus * 2; i++) {
+        if (phase < 0)
+            word14b(e, 0, 0, 0x03);
+        else if (phase)
+            word14b(e, IQ14B_I, IQ14B_Q, 0x03);
+        else
+            word14b(e, -IQ14B_I, -IQ14B_Q, 0x03);
+    }
+}
+
+size_t encode_iso14443b(const hf_frame_t *frames, size_t n, uint16_t *out, size_t max) {
+    enc_t e;
+    enc_init(&e, out, max);
+
+    for (size_t i = 0; i < n; i++) {
+        const hf_frame_t *f = &frames[i];
+        if (f->reader) {
+            reader14b_etu(&e, true, gap(i, 48));
+            reader14b_etu(&e, false, 10);
+            reader14b_etu(&e, true, 2);
+            for (int j = 0; j < f->len; j++) {
+                reader14b_etu(&e, false, 1);
+                for (int k = 0; k < 8; k++)
+                    reader14b_etu(&e, (f->data[j] >> k) & 1, 1);
+                reader14b_etu(&e, true, 1);
+            }
+            reader14b_etu(&e, false, 10);
+            reader14b_etu(&e, true, 2);
+        } else {
+            tag14b_etu(&e, -1, gap(i, 32));
+            tag14b_etu(&e, 1, 10);                         // TR1, phase reference
+            tag14b_etu(&e, 0, 10);                         // SOF
+            tag14b_etu(&e, 1, 2);
+            for (int j = 0; j < f->len; j++) {
+                tag14b_etu(&e, 0, 1);
+                for (int k = 0; k < 8; k++)
+                    tag14b_etu(&e, (f->data[j] >> k) & 1, 1);
+                tag14b_etu(&e, 1, 1);
+            }
+            tag14b_etu(&e, 0, 10);                         // EOF
+            tag14b_etu(&e, -1, 8);
+        }
+    }
+    reader14b_etu(&e, true, 48);
+    return e.overflow ? 0 : e.n;
+}
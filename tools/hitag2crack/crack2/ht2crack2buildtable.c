@@ -1,37 +1,42 @@
 /*
  * ht2crack2buildtable.c
- * This builds the 1.2TB table and sorts it.
+ * This builds the table and sorts it into compressed buckets (see ht2crack2table.h).
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2table.h"
 #include <stdlib.h>
+#include <getopt.h>
 
-// DATAMAX is the size of each bucket (bytes).  There are 65536 buckets so choose a value such that
-// DATAMAX * 65536 < RAM available.  For ex, if you want to use 12GB of RAM (for a 16GB machine
-// leaving some RAM free for OS and other stuff), DATAMAX = 12GB / 65536 = 196608.  Round this down
-// to a power of 10; DATAMAX = 196600.
-#define DATAMAX 196600 // around 192K rounded down to a power of 10
+// Default RAM (MB) shared by the 65536 bucket buffers,  -m on the command line.  For ex, if you
+// want to use 12GB of RAM (for a 16GB machine leaving some RAM free for OS and other stuff), -m 12288.
+#define DEFAULT_MEMORY_MB 12288
 
-// NUM_BUILD_THREADS and NUM_SORT_THREADS are the number of threads to run concurrently.  These should
-// ideally be equal to the number of virtual cores you have available.  A quad-core machine will
-// likely have 8 virtual cores, so set them to 8.
+// Default number of entries is 2^37, -e on the command line.  Smaller tables are only good for testing.
+#define DEFAULT_ENTRY_BITS 37
+
+// The build and sort threads (-t / -s) should ideally be equal to the number of virtual cores you
+// have available.  A quad-core machine will likely have 8 virtual cores, so set them to 8.
 //
 // If sorting fails with a 'bus error' then that is likely because your disk I/O can't keep up with
 // the read/write demands of the multi-threaded sorting.  In this case, reduce the number of sorting
 // threads.  This will most likely only be a problem with network disks; SATA should be okay;
 // USB2/3 should keep up.
 //
-// These MUST be a power of 2 for the maths to work - you have been warned!
-// Also, sort threads MUST be <= build threads or a horrible buffer overflow will happen!
-#define NUM_BUILD_THREADS 8
-#define NUM_SORT_THREADS 8
+// The number of build threads MUST be a power of 2 for the maths to work.
 
-// DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
-// 6 bytes of PRNG state.
-#define DATASIZE 10
+// DATASIZE is the number of bytes in an unsorted entry.  This is 10; 4 bytes of keystream (2 are in
+// the filepath) + 6 bytes of PRNG state.
+#define DATASIZE HT2TABLE_ENTRYSIZE
 
 int debug = 0;
 
+// runtime settings
+static int num_build_threads = 8;
+static int num_sort_threads = 8;
+static size_t datamax = 196600;   // size of each bucket buffer (bytes)
+static int entry_bits = DEFAULT_ENTRY_BITS;
+
 // table entry for a bucket
 struct table {
     char path[32];
@@ -60,7 +65,7 @@ static void create_table(struct table *tt, int d_1, int d_2) {
     }
 
     // create some space
-    tt->data = (unsigned char *)malloc(DATAMAX);
+    tt->data = (unsigned char *)malloc(datamax);
     if (!(tt->data)) {
         printf("create_table: cannot malloc data\n");
         exit(1);
@@ -163,15 +168,15 @@ static void store(unsigned char *data) {
     if (debug) printf("store, offset = %d, got lock\n", offset);
 
     // store the entry
-    memcpy(t1->ptr, data + 2, 10);
+    memcpy(t1->ptr, data + 2, DATASIZE);
 
     if (debug) printf("store, offset = %d, copied data\n", offset);
 
     // update the ptr
-    t1->ptr += 10;
+    t1->ptr += DATASIZE;
 
     // check if table is full
-    if ((t1->ptr - t1->data) >= DATAMAX) {
+    if ((t1->ptr - t1->data) >= datamax) {
         // write the table to disk
         writetable(t1);
         // reset ptr
@@ -278,7 +283,7 @@ static void *buildtable(void *dd) {
     Hitag_State hstate2;
     unsigned long maxentries = 1;
     int index = (int)(long)dd;
-    int tnum = NUM_BUILD_THREADS;
+    int tnum = num_build_threads;
 
     /* set random state */
     hstate.shiftreg = 0x123456789abc;
@@ -289,14 +294,14 @@ static void *buildtable(void *dd) {
         jumpnsteps(&hstate, 2);
     }
 
-    /* set max entries - this is a fraction of 2^37 depending on how many threads we are running.
+    /* set max entries - this is a fraction of 2^37 (-e) depending on how many threads we are running.
        1 thread  = 2^37
        2 threads = 2^36
        4 threads = 2^35
        8 threads = 2^34
        etc
     */
-    maxentries = maxentries << 37;
+    maxentries = maxentries << entry_bits;
     while (!(tnum & 0x1)) {
         maxentries = maxentries >> 1;
         tnum = tnum >> 1;
@@ -316,8 +321,8 @@ static void *buildtable(void *dd) {
 
         write_ks_s(ks1, ks2, hstate.shiftreg);
 
-        // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
-        // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
+        // jump hstate forward 2048 * num_build_threads states using di table
+        // this is because we're running num_build_threads threads at once, from num_build_threads
         // different offsets that are 2048 states apart.
         jumpnsteps(&hstate, 1);
     }
@@ -362,94 +367,148 @@ static int datacmp(const void *p1, const void *p2, void *dummy) {
 }
 
 static void *sorttable(void *dd) {
-    int i, j;
     int fdin;
-    int fdout;
     char infile[64];
     char outfile[64];
-    unsigned char *data = NULL;
+    unsigned char *table = NULL;
+    size_t tablesize = 0;
     struct stat filestat;
     int index = (int)(long)dd;
-    int space = 0x100 / NUM_SORT_THREADS;
-
-    // create table - 50MB should be enough
-    unsigned char *table = (unsigned char *)malloc(50UL * 1024UL * 1024UL);
-    if (!table) {
-        printf("sorttable: cannot malloc table\n");
-        exit(1);
-    }
 
-    // loop over our first byte values
-    for (i = (index * space); i < ((index + 1) * space); i++) {
-        // loop over all second byte values
-        for (j = 0; j < 0x100; j++) {
+    // buckets are handed out round robin
+    for (int b = index; b < 0x10000; b += num_sort_threads) {
+        int i = b >> 8;
+        int j = b & 0xff;
 
-            printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
+        printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
 
-            // open file, stat it and mmap it
-            sprintf(infile, "table/%02x/%02x.bin", i, j);
+        sprintf(infile, "table/%02x/%02x.bin", i, j);
+        sprintf(outfile, "sorted/%02x/%02x.bin", i, j);
 
-            fdin = open(infile, O_RDONLY);
-            if (fdin <= 0) {
-                printf("cannot open file %s\n", infile);
-                exit(1);
-            }
+        uint64_t numentries = 0;
 
+        // small test tables leave buckets without a single entry
+        fdin = open(infile, O_RDONLY);
+        if (fdin >= 0) {
             if (fstat(fdin, &filestat)) {
                 printf("cannot stat file %s\n", infile);
                 exit(1);
             }
 
-            data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fdin, 0);
-            if (data == MAP_FAILED) {
-                printf("cannot mmap file %s\n", infile);
-                exit(1);
+            if ((size_t)filestat.st_size > tablesize) {
+                free(table);
+                tablesize = filestat.st_size;
+                table = (unsigned char *)malloc(tablesize);
+                if (!table) {
+                    printf("sorttable: cannot malloc table\n");
+                    exit(1);
+                }
             }
 
-            // copy data into table
-            memcpy(table, data, filestat.st_size);
-
-            uint64_t numentries = filestat.st_size / DATASIZE;
-
-            // unmap file and close it
-            if (munmap(data, filestat.st_size)) {
-                printf("cannot munmap %s\n", infile);
-                exit(1);
+            for (off_t done = 0; done < filestat.st_size;) {
+                ssize_t res = read(fdin, table + done, filestat.st_size - done);
+                if (res <= 0) {
+                    printf("cannot read file %s\n", infile);
+                    exit(1);
+                }
+                done += res;
             }
-
             close(fdin);
 
+            numentries = filestat.st_size / DATASIZE;
+
             // sort it
             void *dummy = NULL; // clang
             qsort_r(table, numentries, DATASIZE, datacmp, dummy);
+        }
 
-            // write to file
-            sprintf(outfile, "sorted/%02x/%02x.bin", i, j);
-            fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
-            if (fdout <= 0) {
-                printf("cannot create outfile %s\n", outfile);
-                exit(1);
-            }
-            if (write(fdout, table, numentries * DATASIZE)) {
-                printf("writetable cannot write all of the data\n");
-                exit(1);
-            }
-            close(fdout);
+        if (ht2table_write(outfile, table, numentries)) {
+            exit(1);
+        }
 
-            // remove input file
-            if (unlink(infile)) {
-                printf("cannot remove file %s\n", infile);
-                exit(1);
-            }
+        // remove input file
+        if ((fdin >= 0) && unlink(infile)) {
+            printf("cannot remove file %s\n", infile);
+            exit(1);
         }
     }
 
+    free(table);
     return NULL;
 }
 
+static void usage(char *name) {
+    printf("%s [-t build threads] [-s sort threads] [-m MB] [-e bits]\n", name);
+    printf("  -t  build threads, a power of 2 (default %d)\n", num_build_threads);
+    printf("  -s  sort threads (default %d)\n", num_sort_threads);
+    printf("  -m  RAM in MB for the bucket buffers (default %d)\n", DEFAULT_MEMORY_MB);
+    printf("  -e  table holds 2^bits entries (default %d, less is only good for testing)\n", DEFAULT_ENTRY_BITS);
+    exit(1);
+}
+
 int main(int argc, char *argv[]) {
-    pthread_t threads[NUM_BUILD_THREADS];
+    pthread_t *threads;
     void *status;
+    size_t memory_mb = DEFAULT_MEMORY_MB;
+    int c;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 0) {
+        // largest power of 2 not above the number of cores
+        num_build_threads = 1;
+        while ((num_build_threads * 2) <= cores)
+            num_build_threads *= 2;
+        num_sort_threads = cores;
+    }
+
+    while ((c = getopt(argc, argv, "t:s:m:e:h")) != -1) {
+        switch (c) {
+            case 't':
+                num_build_threads = atoi(optarg);
+                break;
+            case 's':
+                num_sort_threads = atoi(optarg);
+                break;
+            case 'm':
+                memory_mb = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                entry_bits = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if ((num_build_threads <= 0) || (num_build_threads & (num_build_threads - 1))) {
+        printf("build threads must be a power of 2\n");
+        exit(1);
+    }
+
+    if (num_sort_threads <= 0) {
+        printf("need at least one sort thread\n");
+        exit(1);
+    }
+
+    if ((entry_bits < 1) || (entry_bits > DEFAULT_ENTRY_BITS) || ((1UL << entry_bits) < (unsigned long)num_build_threads)) {
+        printf("entry bits must be between log2(build threads) and %d\n", DEFAULT_ENTRY_BITS);
+        exit(1);
+    }
+
+    // whole entries per bucket buffer
+    datamax = ((memory_mb * 1024 * 1024) / 0x10000 / DATASIZE) * DATASIZE;
+    if (datamax < DATASIZE) {
+        printf("not enough memory for the bucket buffers\n");
+        exit(1);
+    }
+
+    printf("build threads %d, sort threads %d, bucket buffer %zu bytes, 2^%d entries\n", num_build_threads, num_sort_threads, datamax, entry_bits);
+
+    threads = (pthread_t *)calloc((num_build_threads > num_sort_threads) ? num_build_threads : num_sort_threads, sizeof(pthread_t));
+    if (!threads) {
+        printf("malloc failed\n");
+        exit(1);
+    }
 
     // make the table of tables
     t = (struct table *)malloc(sizeof(struct table) * 65536);
@@ -465,13 +524,13 @@ int main(int argc, char *argv[]) {
     makedirs();
 
     // build the jump table for incremental steps
-    builddi(2048 * NUM_BUILD_THREADS, 1);
+    builddi(2048 * num_build_threads, 1);
 
     // build the jump table for setting the offset
     builddi(2048, 2);
 
     // start the threads
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
+    for (long i = 0; i < num_build_threads; i++) {
         int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
         if (ret) {
             printf("cannot start buildtable thread %ld\n", i);
@@ -482,7 +541,7 @@ int main(int argc, char *argv[]) {
     if (debug) printf("main, started buildtable threads\n");
 
     // wait for threads to finish
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
+    for (long i = 0; i < num_build_threads; i++) {
         int ret = pthread_join(threads[i], &status);
         if (ret) {
             printf("cannot join buildtable thread %ld\n", i);
@@ -509,7 +568,7 @@ int main(int argc, char *argv[]) {
 
 
     // start the threads
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
+    for (long i = 0; i < num_sort_threads; i++) {
         int ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)(i));
         if (ret) {
             printf("cannot start sorttable thread %ld\n", i);
@@ -520,7 +579,7 @@ int main(int argc, char *argv[]) {
     if (debug) printf("main, started sorttable threads\n");
 
     // wait for threads to finish
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
+    for (long i = 0; i < num_sort_threads; i++) {
         int ret = pthread_join(threads[i], &status);
         if (ret) {
             printf("cannot join sorttable thread %ld\n", i);
@@ -529,6 +588,7 @@ int main(int argc, char *argv[]) {
         printf("sorttable thread %ld finished\n", i);
     }
 
+    free(threads);
     pthread_exit(NULL);
 
     return 0;
@@ -5,23 +5,26 @@
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2table.h"
+#include <getopt.h>
 
-#define INPUTFILE "sorted/%02x/%02x.bin"
-#define DATASIZE 10
+#define INPUTFILE "%s/%02x/%02x.bin"
 
 struct rngdata {
     unsigned char *data;
     int len;
 };
 
+// runtime settings
+static const char *tabledir = "sorted";
+static int num_search_threads = 1;
 
-
-static int datacmp(const void *p1, const void *p2) {
-    unsigned char *d1 = (unsigned char *)p1;
-    unsigned char *d2 = (unsigned char *)p2;
-
-    return memcmp(d1, d2, DATASIZE - 6);
-}
+// shared by the search threads, the match with the lowest bit offset wins
+static pthread_mutex_t match_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int match_offset = -1;
+static unsigned char match_m[6];
+static unsigned char match_s[6];
+static int next_offset = 0;
 
 static int loadrngdata(struct rngdata *r, char *file) {
     int fd;
@@ -116,7 +119,7 @@ static int makecand(unsigned char *c, struct rngdata *r, int bitoffset) {
 
 
 // test the candidate against the next or previous rng data
-static int testcand(unsigned char *f, unsigned char *rt, int fwd) {
+static int testcand(const unsigned char *state, unsigned char *rt, int fwd) {
     Hitag_State hstate;
     int i;
     uint32_t ks1;
@@ -126,7 +129,7 @@ static int testcand(unsigned char *f, unsigned char *rt, int fwd) {
     // build the prng state at the candidate
     hstate.shiftreg = 0;
     for (i = 0; i < 6; i++) {
-        hstate.shiftreg = (hstate.shiftreg << 8) | f[i + 4];
+        hstate.shiftreg = (hstate.shiftreg << 8) | state[i];
     }
     buildlfsr(&hstate);
 
@@ -154,89 +157,68 @@ static int testcand(unsigned char *f, unsigned char *rt, int fwd) {
     }
 }
 
-static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
-    int fd;
-    struct stat filestat;
-    char file[64];
-    unsigned char *data;
-    unsigned char item[10];
-    unsigned char *found = NULL;
+struct candtest {
+    unsigned char *rt;
+    int fwd;
+    unsigned char *s;
+};
 
+static int testentry(uint32_t suffix, const unsigned char *state, void *ctx) {
+    struct candtest *ct = (struct candtest *)ctx;
 
-    if (!c || !rt || !m || !s) {
-        printf("searchcand: invalid params\n");
+    if (!testcand(state, ct->rt, ct->fwd))
         return 0;
-    }
 
-    sprintf(file, INPUTFILE, c[0], c[1]);
+    memcpy(ct->s, state, 6);
+    return 1;
+}
 
-    fd = open(file, O_RDONLY);
-    if (fd <= 0) {
-        printf("cannot open table file %s\n", file);
-        exit(1);
-    }
+static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
+    char file[256];
+    ht2table_bucket bucket;
 
-    if (fstat(fd, &filestat)) {
-        printf("cannot stat file %s\n", file);
-        exit(1);
+    if (!c || !rt || !m || !s) {
+        printf("searchcand: invalid params\n");
+        return 0;
     }
 
-    data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED) {
-        printf("cannot mmap file %s\n", file);
+    snprintf(file, sizeof(file), INPUTFILE, tabledir, c[0], c[1]);
+
+    if (ht2table_open(&bucket, file)) {
         exit(1);
     }
 
-    memcpy(item, c + 2, 4);
-
-    found = (unsigned char *)bsearch(item, data, filestat.st_size / DATASIZE, DATASIZE, datacmp);
+    uint32_t suffix = ((uint32_t)c[2] << 24) | ((uint32_t)c[3] << 16) | ((uint32_t)c[4] << 8) | c[5];
+    struct candtest ct = { rt, fwd, s };
 
+    int found = ht2table_find(&bucket, suffix, testentry, &ct);
     if (found) {
-
-        // our candidate is in the table
-        // go backwards and see if there are other matches
-        while (((found - data) >= DATASIZE) && (!memcmp(found - DATASIZE, item, 4))) {
-            found = found - DATASIZE;
-        }
-
-        // now test all matches
-        while (((found - data) <= (filestat.st_size - DATASIZE)) && (!memcmp(found, item, 4))) {
-            if (testcand(found, rt, fwd)) {
-                memcpy(m, c, 2);
-                memcpy(m + 2, found, 4);
-                memcpy(s, found + 4, 6);
-
-                munmap(data, filestat.st_size);
-                close(fd);
-                return 1;
-            }
-
-            found = found + DATASIZE;
-        }
+        memcpy(m, c, 6);
     }
 
-    munmap(data, filestat.st_size);
-    close(fd);
-
-    return 0;
-
+    ht2table_close(&bucket);
+    return found;
 }
 
-static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
-    int i;
-    int bitlen;
+// search thread, takes the next bit offset until a match at a lower offset is known
+static void *searchthread(void *arg) {
+    struct rngdata *r = (struct rngdata *)arg;
+    int bitlen = r->len * 8;
     unsigned char cand[6];
     unsigned char rngtest[6];
+    unsigned char m[6];
+    unsigned char s[6];
     int fwd;
 
-    if (!r || !outmatch || !outstate || !bitoffset) {
-        printf("findmatch: invalid params\n");
-        return 0;
-    }
+    while (1) {
+        pthread_mutex_lock(&match_mutex);
+        int i = next_offset++;
+        int stop = (i > bitlen - 48) || ((match_offset >= 0) && (i > match_offset));
+        pthread_mutex_unlock(&match_mutex);
 
-    bitlen = r->len * 8;
+        if (stop)
+            break;
 
-    for (i = 0; i <= bitlen - 48; i++) {
         // print progress
         if ((i % 100) == 0) {
             printf("searching on bit %d\n", i);
@@ -244,33 +226,75 @@ static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *
 
         if (!makecand(cand, r, i)) {
             printf("cannot makecand, %d\n", i);
-            return 0;
+            break;
         }
-//        printf("cand: %02x %02x %02x %02x %02x %02x : ", cand[0], cand[1], cand[2], cand[3], cand[4], cand[5]);
-//        printbin(cand);
 
         /* make following or preceding RNG test data to confirm match */
         if (i < (bitlen - 96)) {
             if (!makecand(rngtest, r, i + 48)) {
                 printf("cannot makecand rngtest %d + 48\n", i);
-                return 0;
+                break;
             }
             fwd = 1;
         } else {
             if (!makecand(rngtest, r, i - 48)) {
                 printf("cannot makecand rngtest %d - 48\n", i);
-                return 0;
+                break;
             }
             fwd = 0;
         }
 
-        if (searchcand(cand, rngtest, fwd, outmatch, outstate)) {
-            *bitoffset = i;
-            return 1;
+        if (searchcand(cand, rngtest, fwd, m, s)) {
+            pthread_mutex_lock(&match_mutex);
+            if ((match_offset < 0) || (i < match_offset)) {
+                match_offset = i;
+                memcpy(match_m, m, 6);
+                memcpy(match_s, s, 6);
+            }
+            pthread_mutex_unlock(&match_mutex);
         }
     }
 
-    return 0;
+    return NULL;
+}
+
+static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
+
+    if (!r || !outmatch || !outstate || !bitoffset) {
+        printf("findmatch: invalid params\n");
+        return 0;
+    }
+
+    if (r->len < 12) {
+        printf("findmatch: need at least 96 bits of rng data\n");
+        return 0;
+    }
+
+    pthread_t *threads = (pthread_t *)calloc(num_search_threads, sizeof(pthread_t));
+    if (!threads) {
+        printf("cannot malloc\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < num_search_threads; i++) {
+        if (pthread_create(&threads[i], NULL, searchthread, r)) {
+            printf("cannot start search thread %d\n", i);
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < num_search_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    if (match_offset < 0)
+        return 0;
+
+    memcpy(outmatch, match_m, 6);
+    memcpy(outstate, match_s, 6);
+    *bitoffset = match_offset;
+    return 1;
 }
 
 
@@ -366,27 +390,53 @@ int main(int argc, char *argv[]) {
     uint64_t keyrev;
     uint64_t key;
     int i;
+    int c;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 0) {
+        num_search_threads = cores;
+    }
+
+    while ((c = getopt(argc, argv, "t:d:h")) != -1) {
+        switch (c) {
+            case 't':
+                num_search_threads = atoi(optarg);
+                break;
+            case 'd':
+                tabledir = optarg;
+                break;
+            default:
+                argc = 0;
+        }
+    }
+
+    if ((argc - optind) < 3) {
+        printf("%s [-t threads] [-d tabledir] rngdatafile UID nR\n", argv[0]);
+        printf("  -t  search threads (default number of cores)\n");
+        printf("  -d  directory of the sorted table (default sorted)\n");
+        exit(1);
+    }
 
-    if (argc < 4) {
-        printf("%s rngdatafile UID nR\n", argv[0]);
+    if (num_search_threads <= 0) {
+        printf("need at least one search thread\n");
         exit(1);
     }
 
-    if (!loadrngdata(&rng, argv[1])) {
+    if (!loadrngdata(&rng, argv[optind])) {
         printf("loadrngdata failed\n");
         exit(1);
     }
 
-    if (!strncmp(argv[2], "0x", 2)) {
-        uidstr = argv[2] + 2;
+    if (!strncmp(argv[optind + 1], "0x", 2)) {
+        uidstr = argv[optind + 1] + 2;
     } else {
-        uidstr = argv[2];
+        uidstr = argv[optind + 1];
     }
 
-    if (!strncmp(argv[3], "0x", 2)) {
-        nRstr = argv[3] + 2;
+    if (!strncmp(argv[optind + 2], "0x", 2)) {
+        nRstr = argv[optind + 2] + 2;
     } else {
-        nRstr = argv[3];
+        nRstr = argv[optind + 2];
     }
 
 
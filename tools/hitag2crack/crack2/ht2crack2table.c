@@ -0,0 +1,222 @@
+/*
+ * ht2crack2table.c
+ * write, map and search the compressed bucket files, see ht2crack2table.h
+ */
+
+#include "ht2crack2table.h"
+#include <errno.h>
+
+static void put32(unsigned char *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// suffix of a raw entry, big endian so numeric order is memcmp order
+static uint32_t rawsuffix(const unsigned char *e) {
+    return ((uint32_t)e[0] << 24) | ((uint32_t)e[1] << 16) | ((uint32_t)e[2] << 8) | e[3];
+}
+
+static size_t putvarint(unsigned char *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+static const unsigned char *getvarint(const unsigned char *p, const unsigned char *end, uint32_t *v) {
+    uint32_t res = 0;
+    for (int shift = 0; (p < end) && (shift < 35); shift += 7) {
+        unsigned char c = *p++;
+        res |= (uint32_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            *v = res;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+int ht2table_write(const char *path, const unsigned char *entries, uint64_t count) {
+
+    if (count > 0xffffffffUL) {
+        printf("ht2table_write: too many entries for %s\n", path);
+        return 1;
+    }
+
+    uint32_t nblocks = (count + HT2TABLE_BLOCK - 1) / HT2TABLE_BLOCK;
+    size_t datastart = HT2TABLE_HDRSIZE + ((size_t)nblocks * HT2TABLE_IDXSIZE);
+    // worst case every delta takes a 5 byte varint
+    unsigned char *out = (unsigned char *)malloc(datastart + (count * (5 + HT2TABLE_STATESIZE)));
+    if (!out) {
+        printf("ht2table_write: cannot malloc\n");
+        return 1;
+    }
+
+    put32(out, HT2TABLE_MAGIC);
+    put32(out + 4, HT2TABLE_VERSION);
+    put32(out + 8, count);
+    put32(out + 12, HT2TABLE_BLOCK);
+    put32(out + 16, nblocks);
+
+    unsigned char *idx = out + HT2TABLE_HDRSIZE;
+    unsigned char *p = out + datastart;
+    uint32_t prev = 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        const unsigned char *e = entries + (i * HT2TABLE_ENTRYSIZE);
+        uint32_t suffix = rawsuffix(e);
+
+        if ((i % HT2TABLE_BLOCK) == 0) {
+            put32(idx, suffix);
+            put32(idx + 4, p - (out + datastart));
+            idx += HT2TABLE_IDXSIZE;
+        } else {
+            p += putvarint(p, suffix - prev);
+        }
+        memcpy(p, e + 4, HT2TABLE_STATESIZE);
+        p += HT2TABLE_STATESIZE;
+        prev = suffix;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("ht2table_write: cannot create %s\n", path);
+        free(out);
+        return 1;
+    }
+
+    size_t len = p - out;
+    for (size_t done = 0; done < len;) {
+        ssize_t res = write(fd, out + done, len - done);
+        if (res <= 0) {
+            printf("ht2table_write: cannot write all of the data to %s\n", path);
+            close(fd);
+            free(out);
+            return 1;
+        }
+        done += res;
+    }
+
+    close(fd);
+    free(out);
+    return 0;
+}
+
+int ht2table_open(ht2table_bucket *b, const char *path) {
+
+    memset(b, 0, sizeof(ht2table_bucket));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            return 0;
+        printf("cannot open table file %s\n", path);
+        return 1;
+    }
+
+    struct stat filestat;
+    if (fstat(fd, &filestat)) {
+        printf("cannot stat file %s\n", path);
+        close(fd);
+        return 1;
+    }
+
+    if (filestat.st_size < HT2TABLE_HDRSIZE) {
+        printf("table file %s is too small\n", path);
+        close(fd);
+        return 1;
+    }
+
+    b->size = filestat.st_size;
+    b->map = mmap((caddr_t)0, b->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (b->map == MAP_FAILED) {
+        printf("cannot mmap file %s\n", path);
+        b->map = NULL;
+        return 1;
+    }
+
+    b->count = get32(b->map + 8);
+    b->blocksize = get32(b->map + 12);
+    b->nblocks = get32(b->map + 16);
+    b->index = b->map + HT2TABLE_HDRSIZE;
+    b->data = b->index + ((size_t)b->nblocks * HT2TABLE_IDXSIZE);
+
+    if ((get32(b->map) != HT2TABLE_MAGIC) || (get32(b->map + 4) != HT2TABLE_VERSION) || (b->blocksize == 0) ||
+            (HT2TABLE_HDRSIZE + ((size_t)b->nblocks * HT2TABLE_IDXSIZE) > b->size)) {
+        printf("%s is not a table file of this version, rebuild the table\n", path);
+        ht2table_close(b);
+        return 1;
+    }
+
+    // lookups jump around the file, read-ahead would only waste I/O
+    madvise(b->map, b->size, MADV_RANDOM);
+    return 0;
+}
+
+void ht2table_close(ht2table_bucket *b) {
+    if (b->map)
+        munmap(b->map, b->size);
+    memset(b, 0, sizeof(ht2table_bucket));
+}
+
+int ht2table_find(const ht2table_bucket *b, uint32_t suffix, ht2table_cb cb, void *ctx) {
+
+    if (b->count == 0)
+        return 0;
+
+    // first block starting at or after suffix, duplicates may begin in the one before
+    uint32_t lo = 0, hi = b->nblocks;
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2);
+        if (get32(b->index + ((size_t)mid * HT2TABLE_IDXSIZE)) < suffix)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    uint32_t block = (lo > 0) ? lo - 1 : 0;
+
+    const unsigned char *end = b->map + b->size;
+
+    for (; block < b->nblocks; block++) {
+        const unsigned char *ie = b->index + ((size_t)block * HT2TABLE_IDXSIZE);
+        uint32_t cur = get32(ie);
+        if (cur > suffix)
+            return 0;
+
+        const unsigned char *p = b->data + get32(ie + 4);
+        uint32_t n = b->count - (block * b->blocksize);
+        if (n > b->blocksize)
+            n = b->blocksize;
+
+        for (uint32_t i = 0; i < n; i++) {
+            if (i) {
+                uint32_t delta;
+                p = getvarint(p, end, &delta);
+                if (!p)
+                    return 0;
+                cur += delta;
+            }
+            if (p + HT2TABLE_STATESIZE > end)
+                return 0;
+            if (cur > suffix)
+                return 0;
+            if (cur == suffix) {
+                int res = cb(cur, p, ctx);
+                if (res)
+                    return res;
+            }
+            p += HT2TABLE_STATESIZE;
+        }
+    }
+    return 0;
+}
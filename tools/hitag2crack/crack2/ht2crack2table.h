@@ -0,0 +1,54 @@
+/*
+ * ht2crack2table.h
+ * compressed bucket files of the ht2crack2 table
+ *
+ * The table is split in 65536 buckets by the first two bytes of keystream.  A bucket
+ * holds its entries sorted on the next four bytes of keystream (the suffix), each with
+ * the 6 byte PRNG state that produced it.  All values are little endian:
+ *
+ *   header   magic "HT2T", version, number of entries, entries per block, number of blocks
+ *   index    per block: suffix of its first entry, offset of the block in data
+ *   data     per block: state of the first entry, then for every other entry the
+ *            difference to the previous suffix (LEB128 varint) and its state
+ *
+ * Entries are ~2^11 apart, so a suffix takes 2 bytes instead of 4 and the index lets a
+ * lookup touch a handful of pages instead of bisecting the whole bucket.
+ */
+
+#ifndef HT2CRACK2TABLE_H
+#define HT2CRACK2TABLE_H
+
+#include "ht2crackutils.h"
+
+#define HT2TABLE_MAGIC      0x54325448  // "HT2T"
+#define HT2TABLE_VERSION    1
+#define HT2TABLE_BLOCK      64          // entries per index block
+#define HT2TABLE_HDRSIZE    20
+#define HT2TABLE_IDXSIZE    8
+#define HT2TABLE_STATESIZE  6
+#define HT2TABLE_ENTRYSIZE  10          // raw entry: 4 byte suffix + 6 byte state
+
+typedef struct {
+    unsigned char *map;
+    size_t size;
+    uint32_t count;
+    uint32_t blocksize;
+    uint32_t nblocks;
+    const unsigned char *index;
+    const unsigned char *data;
+} ht2table_bucket;
+
+// called for every entry matching a suffix, a non zero return stops the lookup
+typedef int (*ht2table_cb)(uint32_t suffix, const unsigned char *state, void *ctx);
+
+// write count raw entries, sorted on their suffix, as a bucket file. 0 on success
+int ht2table_write(const char *path, const unsigned char *entries, uint64_t count);
+
+// map a bucket file. 0 on success, a missing file is an empty bucket
+int ht2table_open(ht2table_bucket *b, const char *path);
+void ht2table_close(ht2table_bucket *b);
+
+// call cb for the entries with the given suffix, returns the first non zero cb result
+int ht2table_find(const ht2table_bucket *b, uint32_t suffix, ht2table_cb cb, void *ctx);
+
+#endif /* HT2CRACK2TABLE_H */
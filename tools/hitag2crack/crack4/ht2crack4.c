@@ -32,9 +32,10 @@
  * a table size of about 3000000 and expect it to take around 4 mins to run, but
  * with a high likelihood of success.
  *
- * Setting table size to a large number (~32000000) will likely blow up the stack
- * during the recursive qsort().  This could be fixed by making the stack space
- * larger but really, you need a smaller table and more encrypted nonces.
+ * The guesses are scored by -j threads (defaults to the number of cores) with
+ * precomputed probability tables, and the best half is kept with a stable radix
+ * sort on the scores, so large tables (tens of millions) no longer need a deep
+ * stack; they need about 2 * 144 bytes of RAM per entry.
  *
  * The scoring of the guesses is controversial, having been tweaked over and again
  * to find a measure that provides the best results.  Feel free to tweak it yourself
@@ -55,9 +56,6 @@
  * more than 16.  You can still win with 8 if you're lucky. */
 #define MAX_NONCES 32
 
-/* set this to the number of virtual cores you have */
-#define NUM_THREADS 8
-
 /* encrypted nonce and keystream storage
  * ks is ~enc_aR */
 struct nonce {
@@ -74,19 +72,25 @@ struct nonce {
 struct guess {
     uint64_t key;
     double score;
-    uint64_t b0to31[MAX_NONCES];
+    uint32_t b0to31[MAX_NONCES];
 };
 
+/* scoring threads take CHUNK_SIZE guesses at a time from next_guess */
+#define CHUNK_SIZE 1024
+
 /* thread_data is the data sent to the scoring threads */
 struct thread_data {
-    unsigned int start;
-    unsigned int end;
     unsigned int size;
 };
 
-/* guess table and encrypted nonce/keystream table */
+/* guess table and encrypted nonce/keystream table
+ * the best guesses of a round are gathered into spare_guesses, then the tables are swapped */
 struct guess *guesses = NULL;
+struct guess *spare_guesses = NULL;
 unsigned int num_guesses;
+int num_threads = 0;
+pthread_mutex_t next_guess_mutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned int next_guess;
 struct nonce nonces[MAX_NONCES];
 unsigned int num_nRaR;
 uint64_t uid;
@@ -102,6 +106,7 @@ static void usage(void) {
     printf(" -n NONCEFILE (required)\n");
     printf(" -N number of nRaR pairs to use (defaults to 32)\n");
     printf(" -t TABLESIZE (defaults to 800000\n");
+    printf(" -j number of threads (defaults to the number of cores)\n");
     printf("Increasing the table size will slow it down but will be more\n");
     printf("successful.\n");
 
@@ -223,10 +228,52 @@ static uint64_t packstate(uint64_t s) {
 }
 
 
+/* pack_table maps each byte of a state to its bits in the packed form, packstate() is
+ * just a selection of bits so it is the OR of the six byte lookups */
+uint32_t pack_table[6][256];
+
+/* prob_table[n][packed] is the probability of bit_score getting a 1 from a state with
+ * n relevant bits.  All the probabilities are multiples of 1/64, so a float holds
+ * them exactly */
+float *prob_table[21];
+
+static uint64_t fast_packstate(uint64_t s) {
+    return pack_table[0][s & 0xff] | pack_table[1][(s >> 8) & 0xff] | pack_table[2][(s >> 16) & 0xff] |
+           pack_table[3][(s >> 24) & 0xff] | pack_table[4][(s >> 32) & 0xff] | pack_table[5][(s >> 40) & 0xff];
+}
+
+static double bit_prob(uint64_t packed, unsigned int n);
+
+/* build_score_tables precomputes the packing and probabilities used by bit_score */
+static void build_score_tables(void) {
+    for (unsigned int i = 0; i < 6; i++) {
+        for (uint64_t j = 0; j < 256; j++) {
+            pack_table[i][j] = packstate(j << (i * 8));
+        }
+    }
+
+    for (unsigned int n = 0; n <= 20; n++) {
+        prob_table[n] = (float *)malloc(sizeof(float) << n);
+        if (!prob_table[n]) {
+            printf("cannot malloc probability table\n");
+            exit(1);
+        }
+        for (uint64_t packed = 0; packed < (1UL << n); packed++) {
+            double p = bit_prob(packed, n);
+            prob_table[n][packed] = p;
+            if ((double)prob_table[n][packed] != p) {
+                printf("probability %f is not exact as float\n", p);
+                exit(1);
+            }
+        }
+    }
+}
+
 /* create_guess_table mallocs the tables */
 static void create_guess_table(void) {
     guesses = (struct guess *)malloc(sizeof(struct guess) * maxtablesize);
-    if (!guesses) {
+    spare_guesses = (struct guess *)malloc(sizeof(struct guess) * maxtablesize);
+    if (!guesses || !spare_guesses) {
         printf("cannot malloc guess table\n");
         exit(1);
     }
@@ -311,33 +358,13 @@ static void init_guess_table(char *filename, char *uidstr) {
 }
 
 
-/* bit_score calculates the ratio of partial states that could generate
- * the resulting bit b to all possible states
- * size is the number of confirmed bits in the state */
-static double bit_score(uint64_t s, uint64_t size, uint64_t b) {
-    uint64_t packed;
-    uint64_t chopped;
-    unsigned int n;
-    uint64_t b1;
+/* bit_prob calculates the ratio of partial states that could generate
+ * a 1 to all possible states
+ * packed is the packed state with n relevant bits */
+static double bit_prob(uint64_t packed, unsigned int n) {
     double nibprob1, nibprob0, prob;
     unsigned int fncinput;
 
-
-    // chop away any bits beyond size
-    chopped = s & ((1l << size) - 1);
-    // and pack the remaining bits
-    packed = packstate(chopped);
-
-    // calc size of packed version
-    n = packed_size[size];
-
-    b1 = b & 0x1;
-
-    // calc probability of getting b1
-
-    // start by calculating probability of getting a 1,
-    // then fix if b1==0 (subtract from 1)
-
     if (n == 0) {
         // catch the case where we have no relevant bits and return
         // the default probability
@@ -384,7 +411,19 @@ static double bit_score(uint64_t s, uint64_t size, uint64_t b) {
         prob = f20(packed);
     }
 
-    if (b1) {
+    return prob;
+}
+
+
+/* bit_score calculates the ratio of partial states that could generate
+ * the resulting bit b to all possible states
+ * size is the number of confirmed bits in the state */
+static inline double bit_score(uint64_t s, uint64_t size, uint64_t b) {
+    // chop away any bits beyond size and pack the remaining bits
+    uint64_t packed = fast_packstate(s & ((1l << size) - 1));
+    double prob = prob_table[packed_size[size]][packed];
+
+    if (b & 0x1) {
         return prob;
     } else {
         return (1.0 - prob);
@@ -396,34 +435,29 @@ static double bit_score(uint64_t s, uint64_t size, uint64_t b) {
  * bit_score and then shift and then repeat, adding all
  * bit_scores together until no bits remain. bit_scores are
  * multiplied by the number of relevant bits in the scored state
- * to give weight to more complete states. */
+ * to give weight to more complete states.
+ * The terms are added from the last one, as the former recursive version did. */
 static double score(uint64_t s, unsigned int size, uint64_t ks, unsigned int kssize) {
-    double sc;
+    double terms[48];
+    unsigned int n = (size < kssize) ? size : kssize;
 
-    if ((size == 1) || (kssize == 1)) {
-        sc = bit_score(s, size, ks & 0x1);
-        return (sc * (packed_size[size] + 1));
-    } else {
+    for (unsigned int i = 0; i < n; i++) {
         // I've introduced a weighting for each score to
         // give more significance to bigger windows.
-
-        sc = bit_score(s, size, ks & 0x1);
+        double sc = bit_score(s >> i, size - i, ks >> i);
 
         // if a bit_score returns a probability of 0 then this can't be a winner
         if (sc == 0.0) {
             return 0.0;
-        } else {
-
-            double sc2 = score(s >> 1, size - 1, ks >> 1, kssize - 1);
-
-            // if score returns a probability of 0 then this can't be a winner
-            if (sc2 == 0.0) {
-                return 0.0;
-            } else {
-                return (sc * (packed_size[size] + 1)) + sc2;
-            }
         }
+        terms[i] = sc * (packed_size[size - i] + 1);
+    }
+
+    double sc = terms[n - 1];
+    for (unsigned int i = n - 1; i > 0; i--) {
+        sc = terms[i - 1] + sc;
     }
+    return sc;
 }
 
 
@@ -478,13 +512,24 @@ void score_all_traces(unsigned int size)
 }
 */
 
-/* score_some_traces runs score_traces for every key guess in a section of the table */
+/* score_some_traces runs score_traces for chunks of the table until all are done */
 static void *score_some_traces(void *data) {
-    unsigned int i;
     struct thread_data *tdata = (struct thread_data *)data;
 
-    for (i = tdata->start; i < tdata->end; i++) {
-        score_traces(&(guesses[i]), tdata->size);
+    while (1) {
+        pthread_mutex_lock(&next_guess_mutex);
+        unsigned int start = next_guess;
+        next_guess += CHUNK_SIZE;
+        pthread_mutex_unlock(&next_guess_mutex);
+
+        if (start >= num_guesses) {
+            break;
+        }
+
+        unsigned int end = (num_guesses - start > CHUNK_SIZE) ? start + CHUNK_SIZE : num_guesses;
+        for (unsigned int i = start; i < end; i++) {
+            score_traces(&(guesses[i]), tdata->size);
+        }
     }
 
     return NULL;
@@ -493,57 +538,105 @@ static void *score_some_traces(void *data) {
 
 /* score_all_traces runs score_traces for every key guess in the table */
 static void score_all_traces(unsigned int size) {
-    pthread_t threads[NUM_THREADS];
+    pthread_t *threads;
     void *status;
-    struct thread_data tdata[NUM_THREADS];
-    unsigned int i;
-    unsigned int chunk_size;
+    struct thread_data tdata;
+    int i;
 
-    chunk_size = num_guesses / NUM_THREADS;
+    tdata.size = size;
+    next_guess = 0;
 
-    // create thread data
-    for (i = 0; i < NUM_THREADS; i++) {
-        tdata[i].start = i * chunk_size;
-        tdata[i].end = (i + 1) * chunk_size;
-        tdata[i].size = size;
+    threads = (pthread_t *)calloc(num_threads, sizeof(pthread_t));
+    if (!threads) {
+        printf("cannot malloc threads\n");
+        exit(1);
     }
 
-    // fix last chunk
-    tdata[NUM_THREADS - 1].end = num_guesses;
-
     // start the threads
-    for (i = 0; i < NUM_THREADS; i++) {
-        if (pthread_create(&(threads[i]), NULL, score_some_traces, (void *)(tdata + i))) {
-            printf("cannot start thread %u\n", i);
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&(threads[i]), NULL, score_some_traces, (void *)&tdata)) {
+            printf("cannot start thread %d\n", i);
             exit(1);
         }
     }
 
     // wait for threads to end
-    for (i = 0; i < NUM_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         if (pthread_join(threads[i], &status)) {
-            printf("cannot join thread %u\n", i);
+            printf("cannot join thread %d\n", i);
             exit(1);
         }
     }
+
+    free(threads);
 }
 
 
+/* score_key makes a sortable key of a score, larger scores give smaller keys */
+static uint64_t score_key(double score) {
+    uint64_t bits;
+    memcpy(&bits, &score, sizeof(bits));
+    // map the doubles on increasing unsigned ints, then invert for descending order
+    bits = (bits & 0x8000000000000000UL) ? ~bits : (bits | 0x8000000000000000UL);
+    return ~bits;
+}
 
 
+/* keep_best gathers the best keep guesses, by descending score, into the start of the
+ * spare table and swaps the tables.  A stable LSD radix sort on the score keys keeps
+ * guesses with equal scores in table order, like the merge sort of qsort() did. */
+static void keep_best(unsigned int keep) {
+    struct sortkey {
+        uint64_t key;
+        uint32_t index;
+    };
 
-/* cmp_guess is the comparison function for qsorting the guess table */
-static int cmp_guess(const void *a, const void *b) {
-    struct guess *a1 = (struct guess *)a;
-    struct guess *b1 = (struct guess *)b;
+    struct sortkey *keys = (struct sortkey *)malloc(sizeof(struct sortkey) * num_guesses);
+    struct sortkey *tmp = (struct sortkey *)malloc(sizeof(struct sortkey) * num_guesses);
+    if (!keys || !tmp) {
+        printf("cannot malloc sort keys\n");
+        exit(1);
+    }
 
-    if (a1->score < b1->score) {
-        return 1;
-    } else if (a1->score > b1->score) {
-        return -1;
-    } else {
-        return 0;
+    for (unsigned int i = 0; i < num_guesses; i++) {
+        keys[i].key = score_key(guesses[i].score);
+        keys[i].index = i;
     }
+
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+        unsigned int count[257] = {0};
+
+        for (unsigned int i = 0; i < num_guesses; i++) {
+            count[((keys[i].key >> shift) & 0xff) + 1]++;
+        }
+
+        // all keys share this byte, nothing to do
+        if (count[((keys[0].key >> shift) & 0xff) + 1] == num_guesses) {
+            continue;
+        }
+
+        for (unsigned int i = 0; i < 256; i++) {
+            count[i + 1] += count[i];
+        }
+        for (unsigned int i = 0; i < num_guesses; i++) {
+            tmp[count[(keys[i].key >> shift) & 0xff]++] = keys[i];
+        }
+
+        struct sortkey *swap = keys;
+        keys = tmp;
+        tmp = swap;
+    }
+
+    for (unsigned int i = 0; i < keep; i++) {
+        spare_guesses[i] = guesses[keys[i].index];
+    }
+
+    struct guess *swap = guesses;
+    guesses = spare_guesses;
+    spare_guesses = swap;
+
+    free(keys);
+    free(tmp);
 }
 
 
@@ -583,20 +676,13 @@ static void check_supplied_testkey(unsigned int size) {
 }
 
 
-/* execute_round scores the guesses, sorts them and expands the good half */
+/* execute_round scores the guesses, keeps the best and expands the good half */
 static void execute_round(unsigned int size) {
     unsigned int halfsize;
 
     // score all the current guesses
     score_all_traces(size);
 
-    // sort the guesses by score
-    qsort(guesses, num_guesses, sizeof(struct guess), cmp_guess);
-
-    if (supplied_testkey) {
-        check_supplied_testkey(size);
-    }
-
     // identify limit
     if (num_guesses < (maxtablesize / 2)) {
         halfsize = num_guesses;
@@ -604,6 +690,14 @@ static void execute_round(unsigned int size) {
         halfsize = (maxtablesize / 2);
     }
 
+    // keep the best guesses, sorted by score
+    keep_best(halfsize);
+    num_guesses = halfsize;
+
+    if (supplied_testkey) {
+        check_supplied_testkey(size);
+    }
+
     // expand guesses
     expand_guesses(halfsize, size);
 
@@ -781,7 +875,10 @@ int main(int argc, char *argv[]) {
 //    test();
 //    exit(0);
 
-    while ((c = getopt(argc, argv, "u:n:N:t:T:h")) != -1) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (cores > 0) ? cores : 8;
+
+    while ((c = getopt(argc, argv, "u:n:N:t:j:T:h")) != -1) {
         switch (c) {
             case 'u':
                 uidstr = optarg;
@@ -795,6 +892,9 @@ int main(int argc, char *argv[]) {
             case 't':
                 maxtablesize = atoi(optarg);
                 break;
+            case 'j':
+                num_threads = atoi(optarg);
+                break;
             case 'T':
                 supplied_testkey = rev64(hexreversetoulonglong(optarg));
                 break;
@@ -806,10 +906,11 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if (!uidstr || !noncefilestr || (maxtablesize <= 0)) {
+    if (!uidstr || !noncefilestr || (maxtablesize <= 0) || (num_threads <= 0)) {
         usage();
     }
 
+    build_score_tables();
     create_guess_table();
 
     init_guess_table(noncefilestr, uidstr);
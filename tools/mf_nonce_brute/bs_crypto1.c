@@ -0,0 +1,91 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1,  runs BS_CRYPTO1_LANES independent cipher instances at once
+//
+// Same cipher as crypto1_bit() in common/crapto1/crypto1.c.  Instead of shifting
+// the odd / even halves,  the register is kept as a history of its bits:
+// every clock pushes the feedback bit in front,  so nothing moves in memory.
+//-----------------------------------------------------------------------------
+
+#include "bs_crypto1.h"
+#include <string.h>
+#include "crapto1/crapto1.h"
+
+typedef bs_crypto1_vec_t vec;
+
+// filter sub functions,  see "Dismantling MIFARE Classic"
+static inline vec fa(vec a, vec b, vec c, vec d) {
+    return ((a | b) ^ (a & d)) ^ (c & ((a ^ b) | d));
+}
+
+static inline vec fb(vec a, vec b, vec c, vec d) {
+    return ((a & b) | c) ^ ((a ^ b) & (c | d));
+}
+
+static inline vec fc(vec a, vec b, vec c, vec d, vec e) {
+    return (a | ((b | e) & (d ^ e))) ^ ((a ^ (b & d)) & ((c ^ d) | (b & e)));
+}
+
+// filter() on the odd half,  x[j] is odd bit j
+static inline vec bs_filter(const vec *y) {
+#define X(j) y[2 * (j)]
+    vec r0 = fb(X(3), X(2), X(1), X(0));
+    vec r1 = fa(X(7), X(6), X(5), X(4));
+    vec r2 = fb(X(11), X(10), X(9), X(8));
+    vec r3 = fb(X(15), X(14), X(13), X(12));
+    vec r4 = fa(X(19), X(18), X(17), X(16));
+#undef X
+    return fc(r4, r3, r2, r1, r0);
+}
+
+void bs_crypto1_init(bs_crypto1_t *s, const uint64_t keys[BS_CRYPTO1_LANES]) {
+    s->base = BS_CRYPTO1_CLOCKS;
+    vec *y = s->y + s->base;
+
+    // crypto1_init() puts key bit (n ^ 7) at register bit n
+    for (int n = 0; n < 48; n++) {
+        vec v = {0};
+        for (size_t l = 0; l < BS_CRYPTO1_LANES; l++) {
+            v[l >> 6] |= ((keys[l] >> (n ^ 7)) & 1) << (l & 63);
+        }
+        y[n] = v;
+    }
+}
+
+static inline vec bs_crypto1_bit(bs_crypto1_t *s, vec in, bool is_encrypted) {
+    vec *y = s->y + s->base;
+
+    vec ret = bs_filter(y);
+
+    vec feedin = in;
+    if (is_encrypted)
+        feedin ^= ret;
+
+    for (int j = 0; j < 24; j++) {
+        if ((LF_POLY_ODD >> j) & 1)
+            feedin ^= y[2 * j];
+        if ((LF_POLY_EVEN >> j) & 1)
+            feedin ^= y[2 * j + 1];
+    }
+
+    s->base--;
+    s->y[s->base] = feedin;
+    return ret;
+}
+
+void bs_crypto1_word(bs_crypto1_t *s, uint32_t in, bool is_encrypted) {
+    const vec zero = {0};
+    for (int i = 0; i < 32; i++) {
+        bs_crypto1_bit(s, BEBIT(in, i) ? ~zero : zero, is_encrypted);
+    }
+}
+
+void bs_crypto1_byte(bs_crypto1_t *s, uint8_t in, bool is_encrypted, vec ks[8]) {
+    const vec zero = {0};
+    for (int i = 0; i < 8; i++) {
+        ks[i] = bs_crypto1_bit(s, BIT(in, i) ? ~zero : zero, is_encrypted);
+    }
+}
@@ -0,0 +1,37 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1,  runs BS_CRYPTO1_LANES independent cipher instances at once
+//-----------------------------------------------------------------------------
+
+#ifndef BS_CRYPTO1_H__
+#define BS_CRYPTO1_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BS_CRYPTO1_LANES   128
+// clocks available between two bs_crypto1_init calls
+#define BS_CRYPTO1_CLOCKS  512
+
+// one bit of every lane,  lane l is bit (l % 64) of word (l / 64)
+typedef uint64_t bs_crypto1_vec_t __attribute__((vector_size(BS_CRYPTO1_LANES / 8)));
+
+typedef struct {
+    size_t base;
+    // register history,  y[base + n] is bit n of the 48 bit LFSR (odd bit j = n 2j,  even bit j = n 2j+1)
+    bs_crypto1_vec_t y[48 + BS_CRYPTO1_CLOCKS];
+} bs_crypto1_t;
+
+void bs_crypto1_init(bs_crypto1_t *s, const uint64_t keys[BS_CRYPTO1_LANES]);
+void bs_crypto1_word(bs_crypto1_t *s, uint32_t in, bool is_encrypted);
+void bs_crypto1_byte(bs_crypto1_t *s, uint8_t in, bool is_encrypted, bs_crypto1_vec_t ks[8]);
+
+static inline bool bs_crypto1_lane(const bs_crypto1_vec_t *v, size_t lane) {
+    return ((*v)[lane >> 6] >> (lane & 63)) & 1;
+}
+
+#endif
@@ -12,6 +12,7 @@
 #include "protocol.h"
 #include "iso14443crc.h"
 #include "util_posix.h"
+#include "bs_crypto1.h"
 
 #define AEND  "\x1b[0m"
 #define _RED_(s) "\x1b[31m" s AEND
@@ -19,6 +20,8 @@
 #define _YELLOW_(s) "\x1b[33m" s AEND
 #define _CYAN_(s) "\x1b[36m" s AEND
 
+#define ARRAYLEN(x) (sizeof(x) / sizeof((x)[0]))
+
 #define odd_parity(i) (( (i) ^ (i)>>1 ^ (i)>>2 ^ (i)>>3 ^ (i)>>4 ^ (i)>>5 ^ (i)>>6 ^ (i)>>7 ^ 1) & 0x01)
 
 // a global mutex to prevent interlaced printing from different threads
@@ -37,16 +40,12 @@ uint32_t ar_par_err = 0;
 uint32_t at_par_err = 0;
 
 typedef struct thread_args {
-    uint16_t xored;
     int thread;
-    int idx;
-    bool ev1;
 } targs;
 
 #define ENC_LEN  (200)
 typedef struct thread_key_args {
     int thread;
-    int idx;
     uint32_t uid;
     uint32_t part_key;
     uint32_t nt_enc;
@@ -68,11 +67,23 @@ uint8_t cmds[8][2] = {
     {MIFARE_CMD_TRANSFER, 0}
 };
 
-//static int global_counter = 0;
+// tag nonces passing the parity checks.  The ones passing all of them come first,
+// from cand_ev1_start on the ones only passing the checks left for EV1 tags
+static uint32_t cand_nt[0x10000];
+static uint32_t cand_count = 0;
+static uint32_t cand_ev1_start = 0;
+
+// work counter shared by the threads,  nt candidate index in phase 1 and upper key bits in phase 2
+static uint32_t global_work = 0;
+// lowest candidate index which gave a key
+static uint32_t global_found_idx = UINT32_MAX;
 static int global_found = 0;
-static int global_found_candidate = 0;
 static uint64_t global_candidate_key = 0;
-static int thread_count = 2;
+static uint64_t global_key = 0;
+static int thread_count = 1;
+
+static bool json_mode = false;
+static FILE *json_out = NULL;
 
 static int param_getptr(const char *line, int *bg, int *en, int paramnum) {
     int i;
@@ -361,7 +372,6 @@ static bool checkCRC(uint32_t decrypted) {
 
 static void *brute_thread(void *arguments) {
 
-    //int shift = (int)arg;
     struct thread_args *args = (struct thread_args *) arguments;
 
     struct Crypto1State *revstate = NULL;
@@ -370,38 +380,39 @@ static void *brute_thread(void *arguments) {
     uint32_t ks3;     // keystream used to encrypt tag response
     uint32_t ks4;     // keystream used to encrypt next command
     uint32_t nt;      // current tag nonce
-
     uint32_t p64 = 0;
-    uint32_t count;
-    // TC == 4  (
-    // threads calls 0 ev1 == false
-    // threads calls 0,1,2  ev1 == true
-    for (count = args->idx; count <= 0xFFFF; count += thread_count - 1) {
 
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
+    for (;;) {
+
+        uint32_t idx = __atomic_fetch_add(&global_work, 1, __ATOMIC_RELAXED);
+
+        // candidates are handed out in order,  nothing left to win once a lower one gave a key
+        if (idx >= cand_count || idx > __atomic_load_n(&global_found_idx, __ATOMIC_ACQUIRE)) {
             break;
         }
 
-        nt = count << 16 | prng_successor(count, 16);
-
-        if (candidate_nonce(args->xored, nt, args->ev1) == false)
-            continue;
+        nt = cand_nt[idx];
+        bool ev1 = (idx >= cand_ev1_start);
 
         p64 = prng_successor(nt, 64);
         ks2 = ar_enc ^ p64;
         ks3 = at_enc ^ prng_successor(p64, 32);
         revstate = lfsr_recovery64(ks2, ks3);
+        if (revstate == NULL) {
+            continue;
+        }
+
         ks4 = crypto1_word(revstate, 0, 0);
 
         if (ks4 != 0) {
 
             // lock this section to avoid interlacing prints from different threats
             pthread_mutex_lock(&print_lock);
-            if (args->ev1)
+            if (ev1)
                 printf("\n**** Possible key candidate ****\n");
 
 #if 0
-            printf("thread #%d idx %d %s\n", args->thread, args->idx, (args->ev1) ? "(Ev1)" : "");
+            printf("thread #%d idx %u %s\n", args->thread, idx, (ev1) ? "(Ev1)" : "");
             printf("current nt(%08x)  ar_enc(%08x)  at_enc(%08x)\n", nt, ar_enc, at_enc);
             printf("ks2:%08x\n", ks2);
             printf("ks3:%08x\n", ks3);
@@ -440,19 +451,19 @@ static void *brute_thread(void *arguments) {
             lfsr_rollback_word(revstate, uid ^ nt, 0);
             crypto1_get_lfsr(revstate, &key);
 
-            if (args->ev1) {
+            if (ev1) {
                 // if it was EV1,  we know for sure xxxAAAAAAAA recovery
                 printf("\nKey candidate [ " _YELLOW_("....%08" PRIx64)" ]\n\n", key & 0xFFFFFFFF);
-                __sync_fetch_and_add(&global_found_candidate, 1);
             } else {
                 printf("\nKey candidate [ " _GREEN_("....%08" PRIx64) " ]\n\n", key & 0xFFFFFFFF);
-                __sync_fetch_and_add(&global_found, 1);
+            }
+
+            if (idx < global_found_idx) {
+                global_candidate_key = key;
+                __atomic_store_n(&global_found_idx, idx, __ATOMIC_RELEASE);
             }
             //release lock
             pthread_mutex_unlock(&print_lock);
-            __sync_fetch_and_add(&global_candidate_key, key);
-            free(revstate);
-            break;
         }
         free(revstate);
     }
@@ -463,55 +474,105 @@ static void *brute_thread(void *arguments) {
 static void *brute_key_thread(void *arguments) {
 
     struct thread_key_args *args = (struct thread_key_args *) arguments;
-    uint64_t key = args->part_key;
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count <= 0xFFFF; count += thread_count) {
+    // the bitsliced cipher only looks at the first byte,  (cmd byte ^ enc) for every known command
+    uint8_t first_ks[ARRAYLEN(cmds)];
+    for (size_t c = 0; c < ARRAYLEN(cmds); c++) {
+        first_ks[c] = cmds[c][0] ^ local_enc[0];
+    }
 
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
+    bs_crypto1_t *bs = malloc(sizeof(bs_crypto1_t));
+    if (bs == NULL) {
+        free(args);
+        return NULL;
+    }
+
+    uint64_t keys[BS_CRYPTO1_LANES];
+    const bs_crypto1_vec_t zero = {0};
+
+    for (;;) {
+
+        uint32_t chunk = __atomic_fetch_add(&global_work, BS_CRYPTO1_LANES, __ATOMIC_RELAXED);
+
+        if (chunk > 0xFFFF || __atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
             break;
         }
 
-        key = args->part_key | (count << 32);
+        for (size_t l = 0; l < BS_CRYPTO1_LANES; l++) {
+            keys[l] = args->part_key | ((uint64_t)(chunk + l) << 32);
+        }
+
+        // NESTED decrypt nt with help of new key,  on all lanes
+        bs_crypto1_init(bs, keys);
+        bs_crypto1_word(bs, args->nt_enc ^ args->uid, true);
+        bs_crypto1_word(bs, args->nr_enc, true);
+        bs_crypto1_word(bs, 0, false);
+        bs_crypto1_word(bs, 0, false);
+
+        bs_crypto1_vec_t ks[8];
+        bs_crypto1_byte(bs, 0, false, ks);
+
+        // lanes where the first byte decrypts to a known command
+        bs_crypto1_vec_t hit = zero;
+        for (size_t c = 0; c < ARRAYLEN(cmds); c++) {
+            bs_crypto1_vec_t m = ~zero;
+            for (int b = 0; b < 8; b++) {
+                m &= ((first_ks[c] >> b) & 1) ? ks[b] : ~ks[b];
+            }
+            hit |= m;
+        }
 
-        // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+        for (size_t l = 0; l < BS_CRYPTO1_LANES; l++) {
 
-        // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
+            if (bs_crypto1_lane(&hit, l) == false) {
+                continue;
+            }
 
-        // decrypt 22 bytes
-        uint8_t dec[args->enc_len];
-        for (int i = 0; i < args->enc_len; i++)
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+            uint64_t key = keys[l];
 
-        crypto1_destroy(pcs);
+            struct Crypto1State pcs;
+            crypto1_init(&pcs, key);
+            crypto1_word(&pcs, args->nt_enc ^ args->uid, 1);
+            crypto1_word(&pcs, args->nr_enc, 1);
+            crypto1_word(&pcs, 0, 0);
+            crypto1_word(&pcs, 0, 0);
 
-        // check if cmd exists
-        if (checkValidCmdByte(dec, args->enc_len) == false) {
-            continue;
+            // decrypt 22 bytes
+            uint8_t dec[args->enc_len];
+            for (int i = 0; i < args->enc_len; i++)
+                dec[i] = crypto1_byte(&pcs, 0x00, 0) ^ local_enc[i];
+
+            // check if cmd exists
+            if (checkValidCmdByte(dec, args->enc_len) == false) {
+                continue;
+            }
+
+            // lock this section to avoid interlacing prints from different threats
+            pthread_mutex_lock(&print_lock);
+            if (global_found == 0) {
+                global_key = key;
+                __atomic_store_n(&global_found, 1, __ATOMIC_RELEASE);
+                printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
+                printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
+                printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
+            }
+            pthread_mutex_unlock(&print_lock);
+            break;
         }
-        __sync_fetch_and_add(&global_found, 1);
-
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
-        printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
-        printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
-        pthread_mutex_unlock(&print_lock);
-        break;
     }
+    free(bs);
     free(args);
     return NULL;
 }
 
 static int usage(void) {
     printf("\n");
-    printf("syntax:  mf_nonce_brute <uid> <nt> <nt_par_err> <nr> <ar> <ar_par_err> <at> <at_par_err> [<next_command>]\n\n");
+    printf("syntax:  mf_nonce_brute [-j] <uid> <nt> <nt_par_err> <nr> <ar> <ar_par_err> <at> <at_par_err> [<next_command>]\n");
+    printf("         mf_nonce_brute [-j] -f <file>\n\n");
+    printf("    -j, --json    print one JSON result line per auth on stdout,  all other output goes to stderr\n");
+    printf("    -f, --file    read auths from file,  one per line with the same parameters as above\n\n");
     printf("how to convert trace data to needed input:\n");
     printf("    nt in trace = 8c! 42 e6! 4e!\n");
     printf("             nt = 8c42e64e\n");
@@ -529,30 +590,36 @@ static int usage(void) {
     printf("enc:  A4F7F398EBDB4E484D1CB2B174B939D18B469F3FA5D9CAABBFA018EC7E0CC5721DE2E590F64BD0A5B4EFCE71\n");
     printf("dec:  30084A24302F8102F44CA5020500A60881010104763930084A24302F8102F44CA5020500A608810101047639\n");
     printf("Valid Key found: [3b7e4fd575ad]\n\n");
+    printf("  ./mf_nonce_brute -j -f auths.txt > keys.jsonl\n\n");
     return 1;
 }
 
-int main(int argc, char *argv[]) {
-    printf("\nMifare classic nested auth key recovery\n\n");
-
-    if (argc < 9) return usage();
-
-    sscanf(argv[1], "%x", &uid);
-    sscanf(argv[2], "%x", &nt_enc);
-    sscanf(argv[3], "%x", &nt_par_err);
-    sscanf(argv[4], "%x", &nr_enc);
-    sscanf(argv[5], "%x", &ar_enc);
-    sscanf(argv[6], "%x", &ar_par_err);
-    sscanf(argv[7], "%x", &at_enc);
-    sscanf(argv[8], "%x", &at_par_err);
-
-    int enc_len = 0;
-    uint8_t enc[ENC_LEN] = {0};  // next encrypted command + a full read/write
-    if (argc > 9) {
-//        sscanf(argv[9], "%x", &cmd_enc);
-        param_gethex_to_eol(argv[9], 0, enc, sizeof(enc), &enc_len);
-        cmd_enc = (enc[0] << 24 | enc[1] << 16 | enc[2] << 8 | enc[3]);
+static void print_json(const uint8_t *enc, int enc_len, uint64_t t1) {
+    if (json_out == NULL)
+        return;
+
+    const char *status = "failed";
+    if (global_found)
+        status = "found";
+    else if (global_found_idx != UINT32_MAX)
+        status = (global_found_idx < cand_ev1_start) ? "partial" : "candidate";
+
+    fprintf(json_out, "{\"uid\":\"%08x\",\"nt_enc\":\"%08x\",\"nt_par_err\":\"%04x\",\"nr_enc\":\"%08x\",\"ar_enc\":\"%08x\",\"ar_par_err\":\"%04x\",\"at_enc\":\"%08x\",\"at_par_err\":\"%04x\",\"next_cmd\":\"%s\"",
+            uid, nt_enc, nt_par_err, nr_enc, ar_enc, ar_par_err, at_enc, at_par_err, sprint_hex_inrow_ex(enc, enc_len, 0)
+           );
+    fprintf(json_out, ",\"status\":\"%s\"", status);
+    if (global_found_idx != UINT32_MAX) {
+        fprintf(json_out, ",\"ev1\":%s,\"partial_key\":\"%08" PRIx64 "\"", (global_found_idx >= cand_ev1_start) ? "true" : "false", global_candidate_key & 0xFFFFFFFF);
+    }
+    if (global_found) {
+        fprintf(json_out, ",\"key\":\"%012" PRIx64 "\"", global_key);
     }
+    fprintf(json_out, ",\"time_ms\":%" PRIu64 "}\n", t1);
+    fflush(json_out);
+}
+
+// recover the key of one nested auth,  taken from the globals
+static void recover(const uint8_t *enc, int enc_len) {
 
     printf("----------- " _CYAN_("Phase 1") " ------------------------\n");
     printf("uid.................. %08x\n", uid);
@@ -564,10 +631,15 @@ int main(int argc, char *argv[]) {
     printf("at encrypted......... %08x\n", at_enc);
     printf("at parity err........ %04x\n", at_par_err);
 
-    if (argc > 9) {
+    if (enc_len > 0) {
         printf("next encrypted cmd... %s\n", sprint_hex_inrow_ex(enc, enc_len, 0));
     }
 
+    cmd_enc = 0;
+    if (enc_len >= 4) {
+        cmd_enc = (enc[0] << 24 | enc[1] << 16 | enc[2] << 8 | enc[3]);
+    }
+
     uint64_t t1 = msclock();
     uint16_t nt_par = parity_from_err(nt_enc, nt_par_err);
     uint16_t ar_par = parity_from_err(ar_enc, ar_par_err);
@@ -576,47 +648,43 @@ int main(int argc, char *argv[]) {
     //calc (parity XOR corresponding nonce bit encoded with the same keystream bit)
     uint16_t xored = xored_bits(nt_par, nt_enc, ar_par, ar_enc, at_par, at_enc);
 
-#if !defined(_WIN32) || !defined(__WIN32__)
-    thread_count = sysconf(_SC_NPROCESSORS_CONF);
-    if (thread_count < 2)
-        thread_count = 2;
-#endif  /* _WIN32 */
+    // nonces passing all parity checks first,  then the ones which only pass on EV1 tags
+    cand_count = 0;
+    for (uint32_t count = 0; count <= 0xFFFF; count++) {
+        uint32_t nt = count << 16 | prng_successor(count, 16);
+        if (candidate_nonce(xored, nt, false))
+            cand_nt[cand_count++] = nt;
+    }
+    cand_ev1_start = cand_count;
+    for (uint32_t count = 0; count <= 0xFFFF; count++) {
+        uint32_t nt = count << 16 | prng_successor(count, 16);
+        if (candidate_nonce(xored, nt, true) && candidate_nonce(xored, nt, false) == false)
+            cand_nt[cand_count++] = nt;
+    }
 
     printf("\nBruteforce using " _YELLOW_("%d") " threads\n", thread_count);
-    printf("looking for the last bytes of the encrypted tagnonce\n");
+    printf("looking for the last bytes of the encrypted tagnonce,  " _YELLOW_("%u") " + " _YELLOW_("%u") " (EV1) candidates\n", cand_ev1_start, cand_count - cand_ev1_start);
 
     pthread_t threads[thread_count];
 
-    // create a mutex to avoid interlacing print commands from our different threads
-    pthread_mutex_init(&print_lock, NULL);
+    // reset thread signals
+    global_work = 0;
+    global_found = 0;
+    global_found_idx = UINT32_MAX;
 
-    // one thread T0 for none EV1.
-    struct thread_args *a = calloc(1, sizeof(struct thread_args));
-    a->xored = xored;
-    a->thread = 0;
-    a->idx = 0;
-    a->ev1 = false;
-    pthread_create(&threads[0], NULL, brute_thread, (void *)a);
-
-    // the rest of available threads to EV1 scenario
-    for (int i = 0; i < thread_count - 1; ++i) {
-        struct thread_args *b = calloc(1, sizeof(struct thread_args));
-        b->xored = xored;
-        b->thread = i + 1;
-        b->idx = i;
-        b->ev1 = true;
-        pthread_create(&threads[i + 1], NULL, brute_thread, (void *)b);
+    for (int i = 0; i < thread_count; ++i) {
+        struct thread_args *a = calloc(1, sizeof(struct thread_args));
+        a->thread = i;
+        pthread_create(&threads[i], NULL, brute_thread, (void *)a);
     }
 
     // wait for threads to terminate:
     for (int i = 0; i < thread_count; ++i)
         pthread_join(threads[i], NULL);
 
-    t1 = msclock() - t1;
-    printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
-
+    printf("execution time " _YELLOW_("%.2f") " sec\n", (float)(msclock() - t1) / 1000.0);
 
-    if (!global_found && !global_found_candidate) {
+    if (global_found_idx == UINT32_MAX) {
         printf("\nFailed to find a key\n\n");
         goto out;
     }
@@ -626,9 +694,7 @@ int main(int argc, char *argv[]) {
         goto out;
     }
 
-    // reset thread signals
-    global_found = 0;
-    global_found_candidate = 0;
+    global_work = 0;
 
     printf("\n----------- " _CYAN_("Phase 2") " ------------------------\n");
     printf("uid.................. %08x\n", uid);
@@ -643,7 +709,6 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < thread_count; ++i) {
         struct thread_key_args *b = malloc(sizeof(struct thread_key_args));
         b->thread = i;
-        b->idx = i;
         b->uid = uid;
         b->part_key = (uint32_t)(global_candidate_key & 0xFFFFFFFF);
         b->nt_enc = nt_enc;
@@ -657,12 +722,126 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < thread_count; ++i)
         pthread_join(threads[i], NULL);
 
-    if (!global_found && !global_found_candidate) {
+    if (!global_found) {
         printf("\nfailed to find a key\n\n");
     }
 
 out:
+    t1 = msclock() - t1;
+    print_json(enc, enc_len, t1);
+    fflush(stdout);
+}
+
+// sets the globals from the auth parameters,  params holds 8 or 9 strings
+static bool parse_auth(char **params, int count, uint8_t *enc, int *enc_len) {
+
+    if (count < 8) return false;
+
+    if (sscanf(params[0], "%x", &uid) != 1 ||
+            sscanf(params[1], "%x", &nt_enc) != 1 ||
+            sscanf(params[2], "%x", &nt_par_err) != 1 ||
+            sscanf(params[3], "%x", &nr_enc) != 1 ||
+            sscanf(params[4], "%x", &ar_enc) != 1 ||
+            sscanf(params[5], "%x", &ar_par_err) != 1 ||
+            sscanf(params[6], "%x", &at_enc) != 1 ||
+            sscanf(params[7], "%x", &at_par_err) != 1) {
+        return false;
+    }
+
+    *enc_len = 0;
+    memset(enc, 0, ENC_LEN);
+    if (count > 8) {
+        if (param_gethex_to_eol(params[8], 0, enc, ENC_LEN, enc_len))
+            return false;
+    }
+    return true;
+}
+
+static int recover_file(const char *filename) {
+
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        fprintf(stderr, "can't open %s\n", filename);
+        return 1;
+    }
+
+    char line[1024];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+
+        lineno++;
+
+        char *params[9];
+        int count = 0;
+        for (char *tok = strtok(line, " \t\r\n"); tok && count < 9; tok = strtok(NULL, " \t\r\n")) {
+            params[count++] = tok;
+        }
+
+        // empty lines and comments
+        if (count == 0 || params[0][0] == '#')
+            continue;
+
+        uint8_t enc[ENC_LEN];
+        int enc_len = 0;
+        if (parse_auth(params, count, enc, &enc_len) == false) {
+            fprintf(stderr, "%s:%d: invalid auth,  skipping\n", filename, lineno);
+            continue;
+        }
+
+        recover(enc, enc_len);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    const char *filename = NULL;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-j") == 0 || strcmp(argv[argi], "--json") == 0) {
+            json_mode = true;
+        } else if ((strcmp(argv[argi], "-f") == 0 || strcmp(argv[argi], "--file") == 0) && argi + 1 < argc) {
+            filename = argv[++argi];
+        } else {
+            return usage();
+        }
+    }
+
+    if (json_mode) {
+        // keep stdout for the JSON lines,  everything else goes to stderr
+        json_out = fdopen(dup(fileno(stdout)), "w");
+        dup2(fileno(stderr), fileno(stdout));
+    }
+
+    printf("\nMifare classic nested auth key recovery\n\n");
+
+    uint8_t enc[ENC_LEN] = {0};  // next encrypted command + a full read/write
+    int enc_len = 0;
+    if (filename == NULL && parse_auth(argv + argi, argc - argi, enc, &enc_len) == false) {
+        return usage();
+    }
+
+#if !defined(_WIN32) || !defined(__WIN32__)
+    thread_count = sysconf(_SC_NPROCESSORS_CONF);
+    if (thread_count < 1)
+        thread_count = 1;
+#endif  /* _WIN32 */
+
+    // create a mutex to avoid interlacing print commands from our different threads
+    pthread_mutex_init(&print_lock, NULL);
+
+    int res = 0;
+    if (filename)
+        res = recover_file(filename);
+    else
+        recover(enc, enc_len);
+
     // clean up mutex
     pthread_mutex_destroy(&print_lock);
-    return 0;
+
+    if (json_out)
+        fclose(json_out);
+    return res;
 }
@@ -6,6 +6,11 @@
 //  Assumption,  we get a read/write command after a nested auth,  we need 22 bytes of data.
 //  Iceman, 2021,
 //
+//  With -t it takes a whole `trace save` file instead.  Every auth in it is extracted,
+//  duplicates dropped,  and all of them are recovered on one thread pool.  First auths
+//  are solved directly (mfkey64),  nested ones by their weak PRNG nonce candidates,
+//  and every key found is tried against the remaining auths before any bruteforce.
+//
 
 #define __STDC_FORMAT_MACROS
 
@@ -20,6 +25,8 @@
 #include "crapto1/crapto1.h"
 #include "protocol.h"
 #include "iso14443crc.h"
+#include "parity.h"
+#include "pm3_cmd.h"      // tracelog_hdr_t
 #include <util_posix.h>
 
 #define AEND  "\x1b[0m"
@@ -59,6 +66,49 @@ uint8_t cmds[8][2] = {
 
 static int global_found = 0;
 static int thread_count = 2;
+// work counter shared by the threads
+static uint32_t global_work = 0;
+
+// one authentication extracted from a trace
+typedef struct {
+    uint32_t uid;
+    uint32_t nt;            // plain tag nonce,  first auth only
+    uint32_t nt_enc;
+    uint32_t nr_enc;
+    uint32_t ar_enc;
+    uint32_t at_enc;
+    uint8_t nt_enc_par;
+    uint8_t ar_enc_par;
+    uint8_t at_enc_par;
+    bool first_auth;
+    int16_t block;          // -1 until the auth command could be decrypted
+    uint8_t keytype;
+    uint8_t auth_enc[4];    // encrypted auth command,  nested only
+    int32_t parent;         // auth of the session the nested auth was sent in
+    uint32_t parent_bits;   // keystream bits used in that session before auth_enc
+    uint8_t cmd_len;
+    uint8_t cmd[32];        // first encrypted reader command after the auth
+    uint8_t cmd_par[4];
+    uint32_t record;        // trace record of the auth
+    uint32_t seen;
+    int solved;             // AUTH_*
+    uint64_t key;
+} trace_auth_t;
+
+enum {
+    AUTH_OPEN = 0,
+    AUTH_RECOVERED,
+    AUTH_KNOWN_KEY,
+};
+
+// nested auths are split in this many ranges of the 16 bit PRNG state
+#define NESTED_CHUNKS  16
+
+static trace_auth_t *auths = NULL;
+static uint32_t auth_count = 0;
+// work items,  auth index << 8 | chunk
+static uint32_t *work = NULL;
+static uint32_t work_count = 0;
 
 static int param_getptr(const char *line, int *bg, int *en, int paramnum) {
     int i;
@@ -199,29 +249,33 @@ static void *brute_thread(void *arguments) {
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count < 0xFFFF; count += thread_count) {
+    for (;;) {
+
+        uint64_t count = __atomic_fetch_add(&global_work, 1, __ATOMIC_RELAXED);
+        if (count > 0xFFFF) {
+            break;
+        }
 
         if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
             break;
         }
 
-        key |= count << 32;
+        key = (key & 0xFFFFFFFF) | count << 32;
 
         // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+        struct Crypto1State pcs;
+        crypto1_init(&pcs, key);
 
         // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
+        crypto1_word(&pcs, args->nt_enc ^ args->uid, 1);
+        crypto1_word(&pcs, args->nr_enc, 1);
+        crypto1_word(&pcs, 0, 0);
+        crypto1_word(&pcs, 0, 0);
 
         // decrypt 22 bytes
         uint8_t dec[args->enc_len];
         for (int i = 0; i < args->enc_len; i++)
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
-
-        crypto1_destroy(pcs);
+            dec[i] = crypto1_byte(&pcs, 0x00, 0) ^ local_enc[i];
 
         if (checkValidCmdByte(dec, args->enc_len) == false) {
             continue;
@@ -241,8 +295,499 @@ static void *brute_thread(void *arguments) {
     return NULL;
 }
 
+//------------------------------------------------------------------
+// trace mode
+
+static uint32_t be32(const uint8_t *d) {
+    return (uint32_t)d[0] << 24 | d[1] << 16 | d[2] << 8 | d[3];
+}
+
+// same checks as NTParityChk() in the client,  parity bits of nt,  ar and at against a nt candidate
+static bool nt_parity_check(const trace_auth_t *a, uint32_t ntx) {
+    if (
+        (oddparity8(ntx >> 8 & 0xff) ^ (ntx & 0x01) ^ ((a->nt_enc_par >> 5) & 0x01) ^ (a->nt_enc & 0x01)) ||
+        (oddparity8(ntx >> 16 & 0xff) ^ (ntx >> 8 & 0x01) ^ ((a->nt_enc_par >> 6) & 0x01) ^ (a->nt_enc >> 8 & 0x01)) ||
+        (oddparity8(ntx >> 24 & 0xff) ^ (ntx >> 16 & 0x01) ^ ((a->nt_enc_par >> 7) & 0x01) ^ (a->nt_enc >> 16 & 0x01))
+    )
+        return false;
+
+    uint32_t ar = prng_successor(ntx, 64);
+    if (
+        (oddparity8(ar >> 8 & 0xff) ^ (ar & 0x01) ^ ((a->ar_enc_par >> 5) & 0x01) ^ (a->ar_enc & 0x01)) ||
+        (oddparity8(ar >> 16 & 0xff) ^ (ar >> 8 & 0x01) ^ ((a->ar_enc_par >> 6) & 0x01) ^ (a->ar_enc >> 8 & 0x01)) ||
+        (oddparity8(ar >> 24 & 0xff) ^ (ar >> 16 & 0x01) ^ ((a->ar_enc_par >> 7) & 0x01) ^ (a->ar_enc >> 16 & 0x01))
+    )
+        return false;
+
+    uint32_t at = prng_successor(ntx, 96);
+    if (
+        (oddparity8(ar & 0xff) ^ (at >> 24 & 0x01) ^ ((a->ar_enc_par >> 4) & 0x01) ^ (a->at_enc >> 24 & 0x01)) ||
+        (oddparity8(at >> 8 & 0xff) ^ (at & 0x01) ^ ((a->at_enc_par >> 5) & 0x01) ^ (a->at_enc & 0x01)) ||
+        (oddparity8(at >> 16 & 0xff) ^ (at >> 8 & 0x01) ^ ((a->at_enc_par >> 6) & 0x01) ^ (a->at_enc >> 8 & 0x01)) ||
+        (oddparity8(at >> 24 & 0xff) ^ (at >> 16 & 0x01) ^ ((a->at_enc_par >> 7) & 0x01) ^ (a->at_enc >> 16 & 0x01))
+    )
+        return false;
+
+    return true;
+}
+
+// cipher state of the auth right after {at},  returns the plain tag nonce
+static uint32_t auth_session(const trace_auth_t *a, uint64_t key, struct Crypto1State *pcs) {
+    uint32_t nt = a->nt;
+    crypto1_init(pcs, key);
+    if (a->first_auth) {
+        crypto1_word(pcs, a->uid ^ nt, 0);
+    } else {
+        nt = crypto1_word(pcs, a->nt_enc ^ a->uid, 1) ^ a->nt_enc;
+    }
+    crypto1_word(pcs, a->nr_enc, 1);
+    crypto1_word(pcs, 0, 0);
+    crypto1_word(pcs, 0, 0);
+    return nt;
+}
+
+// {ar} and {at} give 64 bits of known plaintext,  enough to confirm a key from elsewhere
+static bool auth_check_key(const trace_auth_t *a, uint64_t key) {
+    struct Crypto1State pcs;
+    crypto1_init(&pcs, key);
+
+    uint32_t nt = a->nt;
+    if (a->first_auth) {
+        crypto1_word(&pcs, a->uid ^ nt, 0);
+    } else {
+        nt = crypto1_word(&pcs, a->nt_enc ^ a->uid, 1) ^ a->nt_enc;
+    }
+    crypto1_word(&pcs, a->nr_enc, 1);
+
+    if ((crypto1_word(&pcs, 0, 0) ^ a->ar_enc) != prng_successor(nt, 64))
+        return false;
+
+    return (crypto1_word(&pcs, 0, 0) ^ a->at_enc) == prng_successor(nt, 96);
+}
+
+// a key recovered from the auth itself always fits {ar} and {at},  the next command tells
+static bool auth_check_cmd(const trace_auth_t *a, uint64_t key) {
+    struct Crypto1State pcs;
+    auth_session(a, key, &pcs);
+
+    uint8_t dec[sizeof(a->cmd)];
+    for (int i = 0; i < a->cmd_len; i++) {
+        dec[i] = crypto1_byte(&pcs, 0x00, 0) ^ a->cmd[i];
+    }
+
+    for (int i = 0; i < a->cmd_len - 1; i++) {
+        if (oddparity8(dec[i]) ^ (dec[i + 1] & 0x01) ^ ((a->cmd_par[i / 8] >> (7 - i % 8)) & 0x01) ^ (a->cmd[i + 1] & 0x01))
+            return false;
+    }
+    return checkValidCmdByte(dec, a->cmd_len);
+}
+
+static void auth_found(uint32_t idx, uint64_t key) {
+
+    pthread_mutex_lock(&print_lock);
+
+    trace_auth_t *a = &auths[idx];
+    if (a->solved == AUTH_OPEN) {
+        a->key = key;
+        __atomic_store_n(&a->solved, AUTH_RECOVERED, __ATOMIC_RELEASE);
+        printf("auth #%-4u uid %08x key [ " _GREEN_("%012" PRIx64) " ] %s\n", idx, a->uid, key, (a->first_auth) ? "" : "(nested)");
+
+        // same key is often used for several sectors,  or cards
+        for (uint32_t i = 0; i < auth_count; i++) {
+            trace_auth_t *b = &auths[i];
+            if (b->solved == AUTH_OPEN && auth_check_key(b, key)) {
+                b->key = key;
+                __atomic_store_n(&b->solved, AUTH_KNOWN_KEY, __ATOMIC_RELEASE);
+                printf("auth #%-4u uid %08x key [ " _GREEN_("%012" PRIx64) " ] (known key)\n", i, b->uid, key);
+            }
+        }
+        fflush(stdout);
+    }
+    pthread_mutex_unlock(&print_lock);
+}
+
+static void recover_first_auth(uint32_t idx) {
+    const trace_auth_t *a = &auths[idx];
+
+    uint32_t ks2 = a->ar_enc ^ prng_successor(a->nt, 64);
+    uint32_t ks3 = a->at_enc ^ prng_successor(a->nt, 96);
+    struct Crypto1State *revstate = lfsr_recovery64(ks2, ks3);
+    if (revstate == NULL)
+        return;
+
+    lfsr_rollback_word(revstate, 0, 0);
+    lfsr_rollback_word(revstate, 0, 0);
+    lfsr_rollback_word(revstate, a->nr_enc, 1);
+    lfsr_rollback_word(revstate, a->uid ^ a->nt, 0);
+    uint64_t key = 0;
+    crypto1_get_lfsr(revstate, &key);
+    crypto1_destroy(revstate);
+
+    if (auth_check_key(a, key))
+        auth_found(idx, key);
+}
+
+// tag nonces from a range of the 16 bit PRNG state,  see mf_nonce_brute phase 1
+static void recover_nested_chunk(uint32_t idx, uint32_t chunk) {
+    const trace_auth_t *a = &auths[idx];
+    uint32_t from = chunk * (0x10000 / NESTED_CHUNKS);
+    uint32_t to = from + (0x10000 / NESTED_CHUNKS);
+
+    for (uint32_t count = from; count < to; count++) {
+
+        if (__atomic_load_n(&a->solved, __ATOMIC_ACQUIRE) != AUTH_OPEN)
+            return;
+
+        uint32_t nt = count << 16 | prng_successor(count, 16);
+        if (nt_parity_check(a, nt) == false)
+            continue;
+
+        uint32_t ks2 = a->ar_enc ^ prng_successor(nt, 64);
+        uint32_t ks3 = a->at_enc ^ prng_successor(nt, 96);
+        struct Crypto1State *revstate = lfsr_recovery64(ks2, ks3);
+        if (revstate == NULL)
+            continue;
+
+        lfsr_rollback_word(revstate, 0, 0);
+        lfsr_rollback_word(revstate, 0, 0);
+        lfsr_rollback_word(revstate, a->nr_enc, 1);
+        lfsr_rollback_word(revstate, a->uid ^ nt, 0);
+        uint64_t key = 0;
+        crypto1_get_lfsr(revstate, &key);
+        crypto1_destroy(revstate);
+
+        if (auth_check_cmd(a, key)) {
+            auth_found(idx, key);
+            return;
+        }
+    }
+}
+
+static void *trace_thread(void *arguments) {
+    (void)arguments;
+
+    for (;;) {
+        uint32_t w = __atomic_fetch_add(&global_work, 1, __ATOMIC_RELAXED);
+        if (w >= work_count)
+            break;
+
+        uint32_t idx = work[w] >> 8;
+        if (__atomic_load_n(&auths[idx].solved, __ATOMIC_ACQUIRE) != AUTH_OPEN)
+            continue;
+
+        if (auths[idx].first_auth)
+            recover_first_auth(idx);
+        else
+            recover_nested_chunk(idx, work[w] & 0xFF);
+    }
+    return NULL;
+}
+
+// returns the index of the auth,  an already known one when it is a duplicate
+static int32_t add_auth(const trace_auth_t *a) {
+
+    for (uint32_t i = 0; i < auth_count; i++) {
+        const trace_auth_t *b = &auths[i];
+        if (b->uid == a->uid &&
+                b->first_auth == a->first_auth &&
+                ((a->first_auth) ? b->nt == a->nt : b->nt_enc == a->nt_enc) &&
+                b->nr_enc == a->nr_enc &&
+                b->ar_enc == a->ar_enc) {
+            auths[i].seen++;
+            return i;
+        }
+    }
+
+    if ((auth_count & 0xFF) == 0) {
+        trace_auth_t *tmp = realloc(auths, (auth_count + 0x100) * sizeof(trace_auth_t));
+        if (tmp == NULL)
+            return -1;
+        auths = tmp;
+    }
+
+    auths[auth_count] = *a;
+    auths[auth_count].seen = 1;
+    return auth_count++;
+}
+
+// walks the trace the way annotateMifare() / DecodeMifareData() do
+static int parse_trace(const uint8_t *trace, size_t len, uint32_t *records) {
+
+    enum { ST_NONE, ST_NT, ST_NRAR, ST_AT, ST_DATA } state = ST_NONE;
+
+    trace_auth_t cur;
+    uint32_t uid = 0;
+    int32_t session = -1;
+    uint32_t session_bits = 0;
+    bool want_cmd = false;
+    const uint8_t *last_reader = NULL;
+
+    *records = 0;
+    size_t pos = 0;
+    while (pos + TRACELOG_HDR_LEN <= len) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + pos);
+        uint16_t n = hdr->data_len;
+        bool resp = hdr->isResponse;
+        if (n == 0 || pos + TRACELOG_HDR_LEN + n + TRACELOG_PARITY_LEN(hdr) > len)
+            break;
+
+        const uint8_t *frame = hdr->frame;
+        const uint8_t *par = hdr->frame + n;
+        pos += TRACELOG_HDR_LEN + n + TRACELOG_PARITY_LEN(hdr);
+        (*records)++;
+
+        // REQA / WUPA,  new card session
+        if (resp == false && n == 1 && (frame[0] == ISO14443A_CMD_REQA || frame[0] == ISO14443A_CMD_WUPA)) {
+            state = ST_NONE;
+            session = -1;
+            continue;
+        }
+
+        if (resp == false && n == 9 && frame[1] == 0x70 &&
+                (frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT || frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_2 || frame[0] == ISO14443A_CMD_ANTICOLL_OR_SELECT_3)) {
+            uid = be32(frame + 2);
+            state = ST_NONE;
+            session = -1;
+            continue;
+        }
+
+        switch (state) {
+            case ST_NONE:
+                if (resp == false && n == 4 && (frame[0] == MIFARE_AUTH_KEYA || frame[0] == MIFARE_AUTH_KEYB) && CheckCrc14443(CRC_14443_A, frame, 4)) {
+                    memset(&cur, 0, sizeof(cur));
+                    cur.uid = uid;
+                    cur.first_auth = true;
+                    cur.block = frame[1];
+                    cur.keytype = frame[0] & 1;
+                    cur.parent = -1;
+                    cur.record = *records - 1;
+                    state = ST_NT;
+                }
+                break;
+            case ST_NT:
+                if (resp && n == 4) {
+                    if (cur.first_auth) {
+                        cur.nt = be32(frame);
+                    } else {
+                        cur.nt_enc = be32(frame);
+                        cur.nt_enc_par = par[0] & 0xF0;
+                    }
+                    state = ST_NRAR;
+                } else {
+                    state = ST_NONE;
+                }
+                break;
+            case ST_NRAR:
+                if (resp == false && n == 8) {
+                    cur.nr_enc = be32(frame);
+                    cur.ar_enc = be32(frame + 4);
+                    cur.ar_enc_par = par[0] << 4;
+                    state = ST_AT;
+                } else {
+                    state = ST_NONE;
+                }
+                break;
+            case ST_AT:
+                if (resp && n == 4) {
+                    cur.at_enc = be32(frame);
+                    cur.at_enc_par = par[0] & 0xF0;
+                    session = add_auth(&cur);
+                    if (session < 0)
+                        return PM3_EMALLOC;
+                    session_bits = 0;
+                    last_reader = NULL;
+                    want_cmd = true;
+                    state = ST_DATA;
+                } else {
+                    state = ST_NONE;
+                }
+                break;
+            case ST_DATA:
+                if (resp == false && want_cmd) {
+                    trace_auth_t *a = &auths[session];
+                    if (a->cmd_len == 0) {
+                        a->cmd_len = (n > sizeof(a->cmd)) ? sizeof(a->cmd) : n;
+                        memcpy(a->cmd, frame, a->cmd_len);
+                        memcpy(a->cmd_par, par, (a->cmd_len - 1) / 8 + 1);
+                    }
+                    want_cmd = false;
+                }
+
+                // only a nested auth gets a 4 byte answer inside an encrypted session
+                if (resp && n == 4 && last_reader) {
+                    memset(&cur, 0, sizeof(cur));
+                    cur.uid = uid;
+                    cur.block = -1;
+                    cur.parent = session;
+                    cur.parent_bits = session_bits - 32;
+                    memcpy(cur.auth_enc, last_reader, sizeof(cur.auth_enc));
+                    cur.record = *records - 2;
+                    cur.nt_enc = be32(frame);
+                    cur.nt_enc_par = par[0] & 0xF0;
+                    state = ST_NRAR;
+                    break;
+                }
+
+                // ACK / NACK are 4 bits
+                session_bits += (resp && n == 1) ? 4 : n * 8;
+                last_reader = (resp == false && n == 4) ? frame : NULL;
+                break;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+// decrypts the auth commands of nested auths,  needs the key of their session
+static void resolve_blocks(void) {
+    for (uint32_t i = 0; i < auth_count; i++) {
+        trace_auth_t *a = &auths[i];
+        if (a->first_auth || a->parent < 0 || auths[a->parent].solved == AUTH_OPEN)
+            continue;
+
+        struct Crypto1State pcs;
+        auth_session(&auths[a->parent], auths[a->parent].key, &pcs);
+        for (uint32_t b = 0; b < a->parent_bits; b++)
+            crypto1_bit(&pcs, 0, 0);
+
+        uint8_t dec[4];
+        for (int j = 0; j < 4; j++)
+            dec[j] = crypto1_byte(&pcs, 0x00, 0) ^ a->auth_enc[j];
+
+        if ((dec[0] == MIFARE_AUTH_KEYA || dec[0] == MIFARE_AUTH_KEYB) && CheckCrc14443(CRC_14443_A, dec, 4)) {
+            a->block = dec[1];
+            a->keytype = dec[0] & 1;
+        }
+    }
+}
+
+static void paritybinstr(char *s, uint32_t val, uint8_t par) {
+    for (int i = 0; i < 4; i++) {
+        s[i] = (oddparity8(val >> (24 - 8 * i)) != ((par >> (7 - i)) & 0x01)) ? '1' : '0';
+    }
+    s[4] = 0;
+}
+
+static int trace_mode(const char *filename) {
+
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+        printf("Failed to open %s\n", filename);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *trace = malloc(fsize > 0 ? fsize : 1);
+    if (trace == NULL || fread(trace, 1, fsize, f) != (size_t)fsize) {
+        printf("Failed to read %s\n", filename);
+        free(trace);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    uint32_t records = 0;
+    int res = parse_trace(trace, fsize, &records);
+    free(trace);
+    if (res != PM3_SUCCESS) {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    uint32_t seen = 0, nested = 0;
+    for (uint32_t i = 0; i < auth_count; i++) {
+        seen += auths[i].seen;
+        if (auths[i].first_auth == false)
+            nested++;
+    }
+
+    printf("-------------------------------------------------\n");
+    printf("trace................ %s\n", filename);
+    printf("records.............. %u\n", records);
+    printf("authentications...... %u ( %u duplicates )\n", seen, seen - auth_count);
+    printf("first / nested....... %u / %u\n", auth_count - nested, nested);
+
+    if (auth_count == 0) {
+        printf("\nNo authentications found\n\n");
+        return 0;
+    }
+
+    // first auths are cheap and give keys to try on the others,  so they go first
+    work = calloc(auth_count - nested + nested * NESTED_CHUNKS, sizeof(uint32_t));
+    if (work == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < auth_count; i++) {
+        if (auths[i].first_auth)
+            work[work_count++] = i << 8;
+    }
+    for (uint32_t i = 0; i < auth_count; i++) {
+        if (auths[i].first_auth == false && auths[i].cmd_len >= 4) {
+            for (uint32_t c = 0; c < NESTED_CHUNKS; c++)
+                work[work_count++] = i << 8 | c;
+        }
+    }
+
+    printf("\nRecovering using " _YELLOW_("%d") " threads\n\n", thread_count);
+
+    uint64_t t1 = msclock();
+
+    pthread_t threads[thread_count];
+    global_work = 0;
+    for (int i = 0; i < thread_count; ++i)
+        pthread_create(&threads[i], NULL, trace_thread, NULL);
+
+    for (int i = 0; i < thread_count; ++i)
+        pthread_join(threads[i], NULL);
+
+    t1 = msclock() - t1;
+
+    resolve_blocks();
+
+    printf("\n  #  | record |   uid    | block | A/B | key\n");
+    printf("-----+--------+----------+-------+-----+-------------\n");
+    uint32_t solved = 0;
+    for (uint32_t i = 0; i < auth_count; i++) {
+        const trace_auth_t *a = &auths[i];
+        char block[8] = " ??";
+        if (a->block >= 0)
+            snprintf(block, sizeof(block), "%3d", a->block);
+
+        if (a->solved != AUTH_OPEN) {
+            solved++;
+            printf(" %3u | %6u | %08x |  %s  |  %c  | " _GREEN_("%012" PRIx64) "\n", i, a->record, a->uid, block, (a->block >= 0) ? 'A' + a->keytype : '?', a->key);
+        } else {
+            printf(" %3u | %6u | %08x |  %s  |  %c  | " _RED_("not found") "\n", i, a->record, a->uid, block, (a->block >= 0) ? 'A' + a->keytype : '?');
+        }
+    }
+
+    // left overs,  print the command line for a manual try
+    for (uint32_t i = 0; i < auth_count; i++) {
+        const trace_auth_t *a = &auths[i];
+        if (a->solved != AUTH_OPEN || a->first_auth)
+            continue;
+
+        char snt[5], sar[5], sat[5];
+        paritybinstr(snt, a->nt_enc, a->nt_enc_par);
+        paritybinstr(sar, a->ar_enc, a->ar_enc_par);
+        paritybinstr(sat, a->at_enc, a->at_enc_par);
+        printf("\nauth #%u: mf_nonce_brute %08x %08x %s %08x %08x %s %08x %s %s\n", i, a->uid, a->nt_enc, snt, a->nr_enc, a->ar_enc, sar, a->at_enc, sat, sprint_hex_inrow_ex(a->cmd, a->cmd_len, 0));
+    }
+
+    printf("\nRecovered " _YELLOW_("%u") " / " _YELLOW_("%u") " keys\n", solved, auth_count);
+    printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
+
+    free(work);
+    free(auths);
+    return 0;
+}
+
 static int usage(void) {
-    printf(" syntax: mf_trace_brute <uid> <partial key> <nt enc> <nr enc> [<next_command + 18 bytes>]\n\n");
+    printf(" syntax: mf_trace_brute <uid> <partial key> <nt enc> <nr enc> [<next_command + 18 bytes>]\n");
+    printf("         mf_trace_brute -t <trace file>\n\n");
+    printf("  -t, --trace <file>   recover the keys of all authentications in a `trace save` file\n\n");
     return 1;
 }
 
@@ -250,6 +795,23 @@ int main(int argc, char *argv[]) {
     printf("Mifare classic nested auth key recovery Phase 2\n");
     if (argc < 3) return usage();
 
+#if !defined(_WIN32) || !defined(__WIN32__)
+    thread_count = sysconf(_SC_NPROCESSORS_CONF);
+    if (thread_count < 2)
+        thread_count = 2;
+#endif  /* _WIN32 */
+
+    // create a mutex to avoid interlacing print commands from our different threads
+    pthread_mutex_init(&print_lock, NULL);
+
+    if (strcmp(argv[1], "-t") == 0 || strcmp(argv[1], "--trace") == 0) {
+        int res = trace_mode(argv[2]);
+        pthread_mutex_destroy(&print_lock);
+        return res;
+    }
+
+    if (argc < 5) return usage();
+
     uint32_t uid = 0;      // serial number
     uint32_t part_key = 0; // last 4 keys of key
     uint32_t nt_enc = 0;   // noncce tag
@@ -262,7 +824,8 @@ int main(int argc, char *argv[]) {
 
     int enc_len = 0;
     uint8_t enc[ENC_LEN] = {0};  // next encrypted command + a full read/write
-    param_gethex_to_eol(argv[5], 0, enc, sizeof(enc), &enc_len);
+    if (argc > 5)
+        param_gethex_to_eol(argv[5], 0, enc, sizeof(enc), &enc_len);
 
     printf("-------------------------------------------------\n");
     printf("uid.................. %08x\n", uid);
@@ -273,19 +836,10 @@ int main(int argc, char *argv[]) {
 
     uint64_t t1 = msclock();
 
-#if !defined(_WIN32) || !defined(__WIN32__)
-    thread_count = sysconf(_SC_NPROCESSORS_CONF);
-    if (thread_count < 2)
-        thread_count = 2;
-#endif  /* _WIN32 */
-
     printf("\nBruteforce using %d threads to find upper 16bits of key\n", thread_count);
 
     pthread_t threads[thread_count];
 
-    // create a mutex to avoid interlacing print commands from our different threads
-    pthread_mutex_init(&print_lock, NULL);
-
     // threads
     for (int i = 0; i < thread_count; ++i) {
         struct thread_args *a = calloc(1, sizeof(struct thread_args));
@@ -1,8 +1,13 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#define ISO14443A_CMD_REQA       0x26
+#define ISO14443A_CMD_WUPA       0x52
 #define ISO14443A_CMD_READBLOCK  0x30
 #define ISO14443A_CMD_WRITEBLOCK 0xA0
+#define ISO14443A_CMD_ANTICOLL_OR_SELECT   0x93
+#define ISO14443A_CMD_ANTICOLL_OR_SELECT_2 0x95
+#define ISO14443A_CMD_ANTICOLL_OR_SELECT_3 0x97
 
 #define MIFARE_AUTH_KEYA        0x60
 #define MIFARE_AUTH_KEYB        0x61
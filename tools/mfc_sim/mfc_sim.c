@@ -0,0 +1,971 @@
+//-----------------------------------------------------------------------------
+// This code is licensed to you under the terms of the GNU GPL, version 2 or,
+// at your option, any later version. See the LICENSE.txt file for the text of
+// the license.
+//-----------------------------------------------------------------------------
+// Bulk MIFARE Classic simulation on the host
+//
+// Runs reader command sequences against virtual cards of the card model in
+// common/mfc_model.c, the cards are spread over worker threads. The attacks use
+// the key recovery of the client (client/src/mifare/mfkey.c) and crapto1.
+//-----------------------------------------------------------------------------
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mfc_model.h"
+#include "crapto1/crapto1.h"
+#include "commonutil.h"
+#include "parity.h"
+#include "crc16.h"
+#include "protocols.h"
+#include "util_posix.h"
+#include "mfkey.h"
+
+#define MAX_THREADS        64
+
+// frame delay of the reader in bit periods, the weak PRNG runs on meanwhile
+#define READER_FDT         10
+
+#define DARKSIDE_TRIES     8
+#define NESTED_TRIES       16
+#define HARDNESTED_MAX     40000
+// the client needs a few thousand nonces for a reliable offline attack
+#define HARDNESTED_FILE    8000
+
+typedef enum {
+    SC_READ,
+    SC_FUZZ,
+    SC_DARKSIDE,
+    SC_NESTED,
+    SC_HARDNESTED,
+    SC_COUNT,
+} scenario_t;
+
+static const char *scenario_names[SC_COUNT] = { "read", "fuzz", "darkside", "nested", "hardnested" };
+
+typedef struct {
+    uint64_t frames;
+    uint64_t nonces;
+    uint32_t cards;
+    uint32_t ok;
+    char error[160];
+} result_t;
+
+typedef struct {
+    scenario_t scenario;
+    uint32_t cards;
+    uint32_t iterations;
+    uint64_t seed;
+    const char *nonce_file;
+    uint32_t next_card;
+    pthread_mutex_t lock;
+    result_t total;
+} job_t;
+
+typedef struct {
+    mfc_card_t *card;
+    struct Crypto1State cs;
+    uint32_t cuid;
+    uint64_t frames;
+    uint64_t rnd;
+} reader_t;
+
+static uint32_t rnd32(uint64_t *s) {
+    // xorshift64*
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return (*s * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static void set_par(mfc_frame_t *f, uint8_t i, uint8_t bit) {
+    if ((i & 0x07) == 0)
+        f->par[i >> 3] = 0;
+    f->par[i >> 3] |= (bit & 0x01) << (7 - (i & 0x07));
+}
+
+static uint8_t get_par(const mfc_frame_t *f, uint8_t i) {
+    return (f->par[i >> 3] >> (7 - (i & 0x07))) & 0x01;
+}
+
+//-----------------------------------------------------------------------------
+// Virtual cards
+//-----------------------------------------------------------------------------
+
+// access bits of a sector, c[b] = C1 C2 C3 of block b, block 3 is the trailer
+static void set_access(uint8_t *trailer, const uint8_t *c) {
+    uint8_t c1 = 0, c2 = 0, c3 = 0;
+    for (uint8_t b = 0; b < 4; b++) {
+        c1 |= ((c[b] >> 2) & 1) << b;
+        c2 |= ((c[b] >> 1) & 1) << b;
+        c3 |= ((c[b] >> 0) & 1) << b;
+    }
+    trailer[6] = ((~c2 & 0x0f) << 4) | (~c1 & 0x0f);
+    trailer[7] = (c1 << 4) | (~c3 & 0x0f);
+    trailer[8] = (c3 << 4) | c2;
+}
+
+// a 1k card with random UID, keys and data. Sector types by sector number % 3:
+// 0  transport access, key A does everything
+// 1  read A|B, write B, keys written with B
+// 2  block 0 a value block, increment B, decrement A|B
+static void card_setup(mfc_card_t *card, uint64_t *rng) {
+    uint8_t uid[4];
+    do {
+        num_to_bytes(rnd32(rng), 4, uid);
+    } while (uid[0] == 0x88);
+
+    mfc_card_init(card, 64, uid, sizeof(uid));
+
+    for (uint8_t s = 0; s < 16; s++) {
+        uint8_t first = mfc_first_block(s);
+        for (uint8_t b = (s == 0) ? 1 : 0; b < 3; b++) {
+            for (uint8_t i = 0; i < MFC_BLOCK_SIZE; i++)
+                card->mem[(first + b) * MFC_BLOCK_SIZE + i] = rnd32(rng);
+        }
+
+        uint8_t *trailer = card->mem + (first + 3) * MFC_BLOCK_SIZE;
+        num_to_bytes(((uint64_t)rnd32(rng) << 16) ^ rnd32(rng), 6, trailer);
+        num_to_bytes(((uint64_t)rnd32(rng) << 16) ^ rnd32(rng), 6, trailer + 10);
+
+        static const uint8_t access[3][4] = {
+            { 0, 0, 0, 1 },
+            { 4, 4, 4, 3 },
+            { 6, 4, 4, 3 },
+        };
+        set_access(trailer, access[s % 3]);
+
+        if (s % 3 == 2)
+            mfc_value_set(card->mem + first * MFC_BLOCK_SIZE, 100, first);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Reader, the host version of the firmware reader functions
+//-----------------------------------------------------------------------------
+
+static uint16_t xfer(reader_t *rd, const mfc_frame_t *tx, mfc_frame_t *rx) {
+    rd->frames++;
+    uint16_t bits = mfc_card_frame(rd->card, tx, rx);
+    mfc_card_idle(rd->card, READER_FDT);
+    return bits;
+}
+
+static void field_reset(reader_t *rd) {
+    mfc_card_field(rd->card, false);
+    mfc_card_field(rd->card, true);
+}
+
+// WUPA and the anticollision loop,  WUPA wakes halted cards too
+static bool rd_select(reader_t *rd) {
+    mfc_frame_t tx, rx;
+    tx.data[0] = ISO14443A_CMD_WUPA;
+    tx.bits = 7;
+    if (xfer(rd, &tx, &rx) != 16)
+        return false;
+
+    static const uint8_t sel[3] = { ISO14443A_CMD_ANTICOLL_OR_SELECT, ISO14443A_CMD_ANTICOLL_OR_SELECT_2, ISO14443A_CMD_ANTICOLL_OR_SELECT_3 };
+    for (uint8_t level = 0; level < 3; level++) {
+        uint8_t cmd[7] = { sel[level], 0x20 };
+        mfc_frame_plain(&tx, cmd, 2, false);
+        if (xfer(rd, &tx, &rx) != 40)
+            return false;
+        if ((rx.data[0] ^ rx.data[1] ^ rx.data[2] ^ rx.data[3]) != rx.data[4])
+            return false;
+
+        cmd[1] = 0x70;
+        memcpy(cmd + 2, rx.data, 5);
+        rd->cuid = bytes_to_num(rx.data, 4);
+        mfc_frame_plain(&tx, cmd, sizeof(cmd), true);
+        if (xfer(rd, &tx, &rx) != 24 || check_crc(CRC_14443_A, rx.data, 3) == false)
+            return false;
+        if ((rx.data[0] & 0x04) == 0)
+            return true;
+    }
+    return false;
+}
+
+// sends a frame,  encrypted with the reader cipher when `crypted`
+static uint16_t rd_send(reader_t *rd, bool crypted, const uint8_t *data, uint8_t len, mfc_frame_t *rx) {
+    mfc_frame_t tx;
+    if (crypted) {
+        for (uint8_t i = 0; i < len; i++) {
+            tx.data[i] = crypto1_byte(&rd->cs, 0x00, 0) ^ data[i];
+            set_par(&tx, i, filter(rd->cs.odd) ^ oddparity8(data[i]));
+        }
+        tx.bits = len * 8;
+    } else {
+        mfc_frame_plain(&tx, data, len, false);
+    }
+    return xfer(rd, &tx, rx);
+}
+
+static void rd_decrypt(reader_t *rd, mfc_frame_t *rx, uint16_t bits) {
+    if (bits == 4) {
+        uint8_t bt = 0;
+        for (uint8_t i = 0; i < 4; i++)
+            bt |= (crypto1_bit(&rd->cs, 0, 0) ^ BIT(rx->data[0], i)) << i;
+        rx->data[0] = bt;
+    } else {
+        for (uint8_t i = 0; i < bits / 8; i++)
+            rx->data[i] = crypto1_byte(&rd->cs, 0x00, 0) ^ rx->data[i];
+    }
+}
+
+// mifare_sendcmd_short()
+static uint16_t rd_cmd(reader_t *rd, bool crypted, uint8_t cmd, uint8_t arg, mfc_frame_t *rx) {
+    uint8_t data[4] = { cmd, arg };
+    compute_crc(CRC_14443_A, data, 2, &data[2], &data[3]);
+    return rd_send(rd, crypted, data, sizeof(data), rx);
+}
+
+// mifare_classic_authex(),  0 on success
+static int rd_auth(reader_t *rd, uint8_t blockNo, uint8_t keytype, uint64_t key, bool nested, uint32_t *ntptr) {
+    mfc_frame_t tx, rx;
+    if (rd_cmd(rd, nested, MIFARE_AUTH_KEYA + (keytype & 0x01), blockNo, &rx) != 32)
+        return 1;
+
+    uint32_t nt = bytes_to_num(rx.data, 4);
+
+    crypto1_deinit(&rd->cs);
+    crypto1_init(&rd->cs, key);
+    if (nested)
+        nt = crypto1_word(&rd->cs, nt ^ rd->cuid, 1) ^ nt;
+    else
+        crypto1_word(&rd->cs, nt ^ rd->cuid, 0);
+
+    if (ntptr)
+        *ntptr = nt;
+
+    uint8_t nr[4];
+    num_to_bytes(rnd32(&rd->rnd), 4, nr);
+    for (uint8_t i = 0; i < 4; i++) {
+        tx.data[i] = crypto1_byte(&rd->cs, nr[i], 0) ^ nr[i];
+        set_par(&tx, i, filter(rd->cs.odd) ^ oddparity8(nr[i]));
+    }
+
+    uint32_t ar = prng_successor(nt, 32);
+    for (uint8_t i = 4; i < 8; i++) {
+        ar = prng_successor(ar, 8);
+        tx.data[i] = crypto1_byte(&rd->cs, 0x00, 0) ^ (ar & 0xff);
+        set_par(&tx, i, filter(rd->cs.odd) ^ oddparity8(ar & 0xff));
+    }
+    tx.bits = 64;
+
+    if (xfer(rd, &tx, &rx) != 32)
+        return 2;
+
+    if ((prng_successor(nt, 96) ^ crypto1_word(&rd->cs, 0, 0)) != bytes_to_num(rx.data, 4))
+        return 3;
+    return 0;
+}
+
+static int rd_read(reader_t *rd, uint8_t blockNo, uint8_t *data) {
+    mfc_frame_t rx;
+    uint16_t bits = rd_cmd(rd, true, ISO14443A_CMD_READBLOCK, blockNo, &rx);
+    rd_decrypt(rd, &rx, bits);
+    if (bits != MFC_FRAME_SIZE * 8 || check_crc(CRC_14443_A, rx.data, MFC_FRAME_SIZE) == false)
+        return 1;
+    memcpy(data, rx.data, MFC_BLOCK_SIZE);
+    return 0;
+}
+
+static int rd_ack(reader_t *rd, uint16_t bits, mfc_frame_t *rx) {
+    rd_decrypt(rd, rx, bits);
+    return (bits == 4 && rx->data[0] == CARD_ACK) ? 0 : 1;
+}
+
+static int rd_write(reader_t *rd, uint8_t blockNo, const uint8_t *data) {
+    mfc_frame_t rx;
+    if (rd_ack(rd, rd_cmd(rd, true, ISO14443A_CMD_WRITEBLOCK, blockNo, &rx), &rx))
+        return 1;
+
+    uint8_t d[MFC_FRAME_SIZE];
+    memcpy(d, data, MFC_BLOCK_SIZE);
+    compute_crc(CRC_14443_A, d, MFC_BLOCK_SIZE, &d[16], &d[17]);
+    return rd_ack(rd, rd_send(rd, true, d, sizeof(d), &rx), &rx);
+}
+
+// INC / DEC / RESTORE followed by TRANSFER
+static int rd_value(reader_t *rd, uint8_t cmd, uint8_t blockNo, int32_t operand, uint8_t dstBlockNo) {
+    mfc_frame_t rx;
+    if (rd_ack(rd, rd_cmd(rd, true, cmd, blockNo, &rx), &rx))
+        return 1;
+
+    uint8_t d[6];
+    Uint4byteToMemLe(d, (uint32_t)operand);
+    compute_crc(CRC_14443_A, d, 4, &d[4], &d[5]);
+    if (rd_send(rd, true, d, sizeof(d), &rx) != 0)
+        return 2;
+
+    return rd_ack(rd, rd_cmd(rd, true, MIFARE_CMD_TRANSFER, dstBlockNo, &rx), &rx) ? 3 : 0;
+}
+
+static void rd_halt(reader_t *rd) {
+    mfc_frame_t rx;
+    rd_cmd(rd, true, ISO14443A_CMD_HALT, 0x00, &rx);
+}
+
+// select and authenticate
+static int rd_login(reader_t *rd, uint8_t blockNo, uint8_t keytype, uint64_t key) {
+    if (rd_select(rd) == false)
+        return 1;
+    return rd_auth(rd, blockNo, keytype, key, false, NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Scenarios,  each returns true when the card passed
+//-----------------------------------------------------------------------------
+
+#define FAIL(...) do { snprintf(res->error, sizeof(res->error), __VA_ARGS__); return false; } while (0)
+
+// authenticates every sector, reads it, writes, uses the value blocks
+static bool sc_read(reader_t *rd, uint64_t *rng, result_t *res) {
+    mfc_card_t *card = rd->card;
+
+    for (uint8_t s = 0; s < 16; s++) {
+        uint8_t first = mfc_first_block(s);
+        uint8_t *trailer = card->mem + (first + 3) * MFC_BLOCK_SIZE;
+        uint64_t keyA = mfc_card_key(card, s, AUTHKEYA);
+        uint64_t keyB = mfc_card_key(card, s, AUTHKEYB);
+
+        if (rd_login(rd, first, AUTHKEYA, keyA ^ 1) == 0)
+            FAIL("sector %u wrong key accepted", s);
+
+        if (rd_login(rd, first, AUTHKEYA, keyA))
+            FAIL("sector %u key A auth failed", s);
+
+        for (uint8_t b = 0; b < 4; b++) {
+            uint8_t data[MFC_BLOCK_SIZE];
+            uint8_t expect[MFC_BLOCK_SIZE];
+            memcpy(expect, card->mem + (first + b) * MFC_BLOCK_SIZE, MFC_BLOCK_SIZE);
+            mfc_read_mask(trailer, first + b, AUTHKEYA, expect);
+            if (rd_read(rd, first + b, data))
+                FAIL("block %u read failed", first + b);
+            if (memcmp(data, expect, MFC_BLOCK_SIZE))
+                FAIL("block %u read wrong data", first + b);
+        }
+
+        // blocks of another sector are refused
+        uint8_t data[MFC_BLOCK_SIZE];
+        if (rd_read(rd, (first + 4) % 64, data) == 0)
+            FAIL("block %u read from sector %u", (first + 4) % 64, s);
+
+        if (s % 3 == 1) {
+            uint8_t blockNo = first + 1;
+            uint8_t wr[MFC_BLOCK_SIZE];
+            for (uint8_t i = 0; i < MFC_BLOCK_SIZE; i++)
+                wr[i] = rnd32(rng);
+
+            if (rd_login(rd, blockNo, AUTHKEYA, keyA))
+                FAIL("sector %u key A auth failed", s);
+            if (rd_write(rd, blockNo, wr) == 0)
+                FAIL("block %u written with key A", blockNo);
+
+            if (rd_login(rd, blockNo, AUTHKEYB, keyB) || rd_write(rd, blockNo, wr))
+                FAIL("block %u write with key B failed", blockNo);
+            if (rd_read(rd, blockNo, data) || memcmp(data, wr, MFC_BLOCK_SIZE))
+                FAIL("block %u read back wrong", blockNo);
+        }
+
+        if (s % 3 == 2) {
+            int32_t value = 0;
+            if (rd_login(rd, first, AUTHKEYA, keyA) || rd_value(rd, MIFARE_CMD_INC, first, 7, first) == 0)
+                FAIL("block %u incremented with key A", first);
+
+            if (rd_login(rd, first, AUTHKEYB, keyB) || rd_value(rd, MIFARE_CMD_INC, first, 7, first))
+                FAIL("block %u increment failed", first);
+            if (rd_read(rd, first, data) || mfc_value_get(data, &value, NULL) == false || value != 107)
+                FAIL("block %u value %d after increment", first, value);
+
+            if (rd_login(rd, first, AUTHKEYA, keyA) || rd_value(rd, MIFARE_CMD_DEC, first, 10, first + 1) == 0)
+                FAIL("block %u transferred into a data block", first);
+
+            if (rd_login(rd, first, AUTHKEYA, keyA) || rd_value(rd, MIFARE_CMD_DEC, first, 10, first))
+                FAIL("block %u decrement failed", first);
+            if (rd_read(rd, first, data) || mfc_value_get(data, &value, NULL) == false || value != 97)
+                FAIL("block %u value %d after decrement", first, value);
+        }
+        rd_halt(rd);
+    }
+    return true;
+}
+
+// random frames, some of them on a selected or authenticated card. Without a
+// key the card memory must not change and the card must answer sane frames.
+static bool sc_fuzz(reader_t *rd, uint64_t *rng, uint32_t iterations, result_t *res) {
+    mfc_card_t *card = rd->card;
+    uint8_t *mem = malloc(sizeof(card->mem));
+    memcpy(mem, card->mem, sizeof(card->mem));
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        mfc_frame_t tx, rx;
+        uint32_t r = rnd32(rng);
+        uint16_t bits;
+
+        switch (r % 12) {
+            case 0:
+                field_reset(rd);
+                continue;
+            case 1:
+                tx.data[0] = (r & 0x100) ? ISO14443A_CMD_REQA : ISO14443A_CMD_WUPA;
+                tx.bits = 7;
+                bits = xfer(rd, &tx, &rx);
+                break;
+            case 2:
+            case 3:
+                rd_select(rd);
+                continue;
+            case 4:
+                // an authentication with a wrong key, the card must not accept it
+                if (rd_auth(rd, rnd32(rng) % 64, r & 1, ((uint64_t)rnd32(rng) << 16) ^ rnd32(rng), false, NULL) == 0) {
+                    free(mem);
+                    FAIL("random key accepted");
+                }
+                continue;
+            case 5: {
+                // a plain command with a valid CRC
+                uint8_t cmd[MFC_FRAME_SIZE];
+                uint8_t len = 2 + rnd32(rng) % 15;
+                for (uint8_t i = 0; i < len; i++)
+                    cmd[i] = rnd32(rng);
+                mfc_frame_plain(&tx, cmd, len, true);
+                bits = xfer(rd, &tx, &rx);
+                break;
+            }
+            default: {
+                uint8_t len = rnd32(rng) % (MFC_FRAME_SIZE + 1);
+                for (uint8_t i = 0; i < len; i++)
+                    tx.data[i] = rnd32(rng);
+                if (r & 0x300)
+                    mfc_frame_plain(&tx, tx.data, len, false);
+                else
+                    for (uint8_t i = 0; i < len; i++)
+                        set_par(&tx, i, rnd32(rng));
+                tx.bits = (r & 0x3c00) ? len * 8 : rnd32(rng) % (MFC_FRAME_SIZE * 8 + 1);
+                bits = xfer(rd, &tx, &rx);
+                break;
+            }
+        }
+
+        if (bits != 0 && bits != 4 && ((bits & 0x07) || bits > MFC_FRAME_SIZE * 8)) {
+            free(mem);
+            FAIL("answer of %u bits", bits);
+        }
+        if (card->auth_key != AUTHKEYNONE) {
+            free(mem);
+            FAIL("authenticated without key");
+        }
+    }
+
+    bool changed = memcmp(mem, card->mem, sizeof(card->mem)) != 0;
+    free(mem);
+    if (changed)
+        FAIL("memory changed");
+
+    // the card still works
+    uint8_t data[MFC_BLOCK_SIZE];
+    field_reset(rd);
+    if (rd_login(rd, 4, AUTHKEYA, mfc_card_key(card, 1, AUTHKEYA)) || rd_read(rd, 4, data))
+        FAIL("card dead after fuzzing");
+    return true;
+}
+
+// key check on a fresh field, the `hf mf chk` of the attacks
+static bool key_valid(reader_t *rd, uint8_t blockNo, uint8_t keytype, uint64_t key) {
+    field_reset(rd);
+    return rd_login(rd, blockNo, keytype, key) == 0;
+}
+
+// ReaderMifare() of the firmware. The PRNG restarts with the field and the
+// frames are the same on every try, so the tag nonce repeats without timing.
+static bool sc_darkside(reader_t *rd, result_t *res) {
+    uint8_t blockNo = 0;
+    uint8_t keytype = AUTHKEYA;
+    uint64_t real_key = mfc_card_key(rd->card, 0, keytype);
+
+    uint8_t mf_nr_ar3 = 0;
+    uint8_t par_low = 0;
+    bool first_try = true;
+
+    for (uint8_t attempt = 0; attempt < DARKSIDE_TRIES; attempt++) {
+        uint8_t mf_nr_ar[8] = {0};
+        uint8_t par_list[8] = {0};
+        uint8_t ks_list[8] = {0};
+        uint8_t par = 0;
+        uint8_t nt_diff = 0;
+        uint32_t nt = 0;
+
+        if (first_try == false) {
+            mf_nr_ar3++;
+            mf_nr_ar[3] = mf_nr_ar3;
+            par = par_low;
+        }
+
+        for (uint32_t i = 0; ; i++) {
+            mfc_frame_t tx, rx;
+            field_reset(rd);
+            if (rd_select(rd) == false)
+                FAIL("select failed");
+            if (rd_cmd(rd, false, MIFARE_AUTH_KEYA + keytype, blockNo, &rx) != 32)
+                FAIL("no tag nonce");
+            nt = bytes_to_num(rx.data, 4);
+
+            memcpy(tx.data, mf_nr_ar, sizeof(mf_nr_ar));
+            tx.par[0] = par;
+            tx.bits = 64;
+            if (xfer(rd, &tx, &rx) == 4) {
+                if (nt_diff == 0)
+                    par_low = par & 0xE0;
+
+                par_list[nt_diff] = reflect8(par);
+                ks_list[nt_diff] = rx.data[0] ^ 0x05;
+
+                if (nt_diff == 0x07)
+                    break;
+
+                nt_diff = (nt_diff + 1) & 0x07;
+                mf_nr_ar[3] = (mf_nr_ar[3] & 0x1F) | (nt_diff << 5);
+                par = par_low;
+            } else {
+                if (nt_diff == 0 && first_try) {
+                    par++;
+                    if (par == 0)
+                        FAIL("no NACK on any parity");
+                } else {
+                    par = ((par & 0x1F) + 1) | par_low;
+                }
+            }
+            res->nonces++;
+        }
+        first_try = false;
+        mf_nr_ar[3] &= 0x1F;
+
+        uint64_t *keys = NULL;
+        uint32_t keycount = nonce2key(rd->cuid, nt, bytes_to_num(mf_nr_ar, 4), bytes_to_num(mf_nr_ar + 4, 4),
+                                      bytes_to_num(par_list, 8), bytes_to_num(ks_list, 8), &keys);
+        for (uint32_t k = 0; k < keycount; k++) {
+            if (key_valid(rd, blockNo, keytype, keys[k])) {
+                uint64_t key = keys[k];
+                free(keys);
+                if (key != real_key)
+                    FAIL("darkside key %012" PRIx64 " is not the card key", key);
+                return true;
+            }
+        }
+        free(keys);
+    }
+    FAIL("darkside found no key in %u tries", DARKSIDE_TRIES);
+}
+
+// valid_nonce() of the firmware
+static bool valid_nonce(uint32_t Nt, uint32_t NtEnc, uint32_t Ks1, const uint8_t *parity) {
+    return (oddparity8((Nt >> 24) & 0xFF) == ((parity[0]) ^ oddparity8((NtEnc >> 24) & 0xFF) ^ BIT(Ks1, 16))) &&
+           (oddparity8((Nt >> 16) & 0xFF) == ((parity[1]) ^ oddparity8((NtEnc >> 16) & 0xFF) ^ BIT(Ks1, 8))) &&
+           (oddparity8((Nt >> 8) & 0xFF) == ((parity[2]) ^ oddparity8((NtEnc >> 8) & 0xFF) ^ BIT(Ks1, 0)));
+}
+
+static int compare16(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a & 0x00ff000000ff0000;
+    uint64_t y = *(const uint64_t *)b & 0x00ff000000ff0000;
+    return (x == y) ? 0 : (x < y) ? 1 : -1;
+}
+
+// the cipher states for one nonce, sorted like nested_worker_thread() of the client
+static struct Crypto1State *nested_states(uint32_t nt, uint32_t ks1, uint32_t cuid, size_t *len) {
+    struct Crypto1State *s = lfsr_recovery32(ks1, nt ^ cuid);
+    struct Crypto1State *p = s;
+    while (p->odd | p->even)
+        p++;
+    *len = p - s;
+    qsort(s, *len, sizeof(uint64_t), compare16);
+    return s;
+}
+
+// MifareNested() of the firmware and mfnested() of the client
+static bool sc_nested(reader_t *rd, result_t *res) {
+    mfc_card_t *card = rd->card;
+    uint64_t key = mfc_card_key(card, 0, AUTHKEYA);
+    uint8_t target = mfc_first_block(5);
+    uint64_t real_key = mfc_card_key(card, 5, AUTHKEYB);
+
+    // calibrate the nonce distance
+    uint32_t nt1, nt2;
+    field_reset(rd);
+    if (rd_select(rd) == false || rd_auth(rd, 0, AUTHKEYA, key, false, &nt1))
+        FAIL("auth with the known key failed");
+    if (rd_auth(rd, 0, AUTHKEYA, key, true, &nt2))
+        FAIL("nested auth with the known key failed");
+    int dist = nonce_distance(nt1, nt2);
+    if (dist < 0)
+        FAIL("nonce distance not found");
+
+    uint32_t target_nt[2] = {0}, target_ks[2] = {0};
+    for (uint8_t i = 0, tries = 0; i < 2; tries++) {
+        if (tries == NESTED_TRIES)
+            FAIL("no unambiguous nonces in %u tries", NESTED_TRIES);
+
+        rd_halt(rd);
+        if (rd_select(rd) == false || rd_auth(rd, 0, AUTHKEYA, key, false, &nt1))
+            FAIL("auth with the known key failed");
+
+        mfc_frame_t rx;
+        if (rd_cmd(rd, true, MIFARE_AUTH_KEYA + AUTHKEYB, target, &rx) != 32)
+            FAIL("no nested nonce");
+        res->nonces++;
+        uint32_t nt_enc = bytes_to_num(rx.data, 4);
+
+        uint8_t par_array[4];
+        for (uint8_t j = 0; j < 4; j++)
+            par_array[j] = (oddparity8(rx.data[j]) != get_par(&rx, j));
+
+        uint8_t ncount = 0;
+        uint32_t nttest = prng_successor(nt1, dist - 3);
+        for (int j = dist - 2; j <= dist + 2; j++) {
+            nttest = prng_successor(nttest, 1);
+            uint32_t ks1 = nt_enc ^ nttest;
+            if (valid_nonce(nttest, nt_enc, ks1, par_array)) {
+                target_nt[i] = nttest;
+                target_ks[i] = ks1;
+                ncount++;
+            }
+        }
+        if (ncount == 1 && (i == 0 || target_nt[1] != target_nt[0]))
+            i++;
+    }
+
+    size_t len[2];
+    struct Crypto1State *sl[2];
+    for (uint8_t i = 0; i < 2; i++)
+        sl[i] = nested_states(target_nt[i], target_ks[i], rd->cuid, &len[i]);
+
+    // intersect on the 16 bits of the state that hold key bits, then roll back to the keys
+    struct Crypto1State *p1 = sl[0], *p2 = sl[1], *p3 = sl[0], *p4 = sl[1];
+    struct Crypto1State *e1 = sl[0] + len[0], *e2 = sl[1] + len[1];
+    while (p1 < e1 && p2 < e2) {
+        if (compare16(p1, p2) == 0) {
+            struct Crypto1State save = *p1;
+            while (p1 < e1 && compare16(p1, &save) == 0) {
+                *p3 = *p1++;
+                lfsr_rollback_word(p3++, target_nt[0] ^ rd->cuid, 0);
+            }
+            save = *p2;
+            while (p2 < e2 && compare16(p2, &save) == 0) {
+                *p4 = *p2++;
+                lfsr_rollback_word(p4++, target_nt[1] ^ rd->cuid, 0);
+            }
+        } else {
+            while (p1 < e1 && compare16(p1, p2) == -1) p1++;
+            while (p2 < e2 && p1 < e1 && compare16(p1, p2) == 1) p2++;
+        }
+    }
+
+    uint64_t *k0 = (uint64_t *)sl[0], *k1 = (uint64_t *)sl[1];
+    size_t n0 = p3 - sl[0], n1 = p4 - sl[1];
+    // k0 and k1 overlay the states, crypto1_get_lfsr() clears its output first
+    uint64_t key64;
+    for (size_t i = 0; i < n0; i++) {
+        crypto1_get_lfsr(sl[0] + i, &key64);
+        k0[i] = key64;
+    }
+    for (size_t i = 0; i < n1; i++) {
+        crypto1_get_lfsr(sl[1] + i, &key64);
+        k1[i] = key64;
+    }
+    k0[n0] = UINT64_C(-1);
+    k1[n1] = UINT64_C(-1);
+    qsort(k0, n0, sizeof(uint64_t), compare_uint64);
+    qsort(k1, n1, sizeof(uint64_t), compare_uint64);
+    uint32_t keycnt = intersection(k0, k1);
+
+    bool found = false;
+    for (uint32_t i = 0; i < keycnt && found == false; i++)
+        found = (k0[i] == real_key) && key_valid(rd, target, AUTHKEYB, k0[i]);
+
+    free(sl[0]);
+    free(sl[1]);
+    if (found == false)
+        FAIL("nested key not among %u candidates", keycnt);
+    return true;
+}
+
+// MifareAcquireEncryptedNonces() on a hardened card. Collects until all 256
+// first bytes are seen, or HARDNESTED_FILE nonces for a nonce file. Checks every
+// encrypted nonce and its parity bits against the card key, that is what the
+// hardnested statistics rely on.
+static bool sc_hardnested(reader_t *rd, FILE *f, result_t *res) {
+    mfc_card_t *card = rd->card;
+    card->nt_mode = MFC_NT_HARD;
+    card->nack_bug = false;
+    card->nt_seed = rnd32(&rd->rnd) | 1;
+
+    uint64_t key = mfc_card_key(card, 0, AUTHKEYA);
+    uint8_t target = mfc_first_block(1);
+    uint8_t target_keytype = AUTHKEYA;
+    uint64_t target_key = mfc_card_key(card, 1, target_keytype);
+
+    uint8_t first_bytes[256] = {0};
+    uint16_t first_byte_num = 0;
+    uint8_t buf[9];
+    uint32_t n = 0;
+
+    field_reset(rd);
+    if (rd_select(rd) == false)
+        FAIL("select failed");
+
+    if (f) {
+        num_to_bytes(rd->cuid, 4, buf);
+        buf[4] = target;
+        buf[5] = target_keytype;
+        fwrite(buf, 1, 6, f);
+    }
+
+    while (first_byte_num < 256 || (f && n < HARDNESTED_FILE)) {
+        if (n == HARDNESTED_MAX)
+            FAIL("%u first bytes after %u nonces", first_byte_num, n);
+
+        if (rd_select(rd) == false || rd_auth(rd, 0, AUTHKEYA, key, false, NULL))
+            FAIL("auth with the known key failed");
+
+        mfc_frame_t rx;
+        if (rd_cmd(rd, true, MIFARE_AUTH_KEYA + target_keytype, target, &rx) != 32)
+            FAIL("no nested nonce");
+
+        uint32_t nt_enc = bytes_to_num(rx.data, 4);
+        uint8_t par_enc = rx.par[0] & 0xf0;
+
+        // what the card must have sent for this nonce
+        struct Crypto1State cs;
+        crypto1_init(&cs, target_key);
+        uint32_t nt = crypto1_word(&cs, nt_enc ^ rd->cuid, 1) ^ nt_enc;
+        crypto1_init(&cs, target_key);
+        uint8_t expect_par = 0;
+        for (uint8_t i = 0; i < 4; i++) {
+            uint8_t ntb = nt >> (24 - 8 * i);
+            crypto1_byte(&cs, (rd->cuid ^ nt) >> (24 - 8 * i), 0);
+            expect_par |= (filter(cs.odd) ^ oddparity8(ntb)) << (7 - i);
+        }
+        if (expect_par != par_enc)
+            FAIL("nonce %08x parity %02x, expected %02x", nt_enc, par_enc, expect_par);
+
+        if (first_bytes[nt_enc >> 24] == 0) {
+            first_bytes[nt_enc >> 24] = 1;
+            first_byte_num++;
+        }
+
+        if (f) {
+            if (n % 2) {
+                memcpy(buf + 4, rx.data, 4);
+                buf[8] |= par_enc >> 4;
+                fwrite(buf, 1, 9, f);
+            } else {
+                memcpy(buf, rx.data, 4);
+                buf[8] = par_enc;
+            }
+        }
+        n++;
+        res->nonces++;
+        rd_halt(rd);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Worker threads
+//-----------------------------------------------------------------------------
+
+static void *worker(void *arg) {
+    job_t *job = arg;
+    result_t res;
+    memset(&res, 0, sizeof(res));
+
+    mfc_card_t *card = malloc(sizeof(mfc_card_t));
+    if (card == NULL)
+        return NULL;
+
+    while (true) {
+        uint32_t idx = __atomic_fetch_add(&job->next_card, 1, __ATOMIC_RELAXED);
+        if (idx >= job->cards)
+            break;
+
+        // every card has its own generator, a run is the same with any number of threads
+        uint64_t rng = job->seed ^ ((uint64_t)(idx + 1) * 0x9E3779B97F4A7C15ULL);
+        rnd32(&rng);
+        card_setup(card, &rng);
+
+        reader_t rd;
+        memset(&rd, 0, sizeof(rd));
+        rd.card = card;
+        rd.rnd = rng ^ 0x5555;
+        field_reset(&rd);
+
+        FILE *f = NULL;
+        if (job->scenario == SC_HARDNESTED && job->nonce_file && idx == 0) {
+            f = fopen(job->nonce_file, "wb");
+            if (f == NULL)
+                fprintf(stderr, "can't create %s\n", job->nonce_file);
+        }
+
+        bool ok = false;
+        switch (job->scenario) {
+            case SC_READ:
+                ok = sc_read(&rd, &rng, &res);
+                break;
+            case SC_FUZZ:
+                ok = sc_fuzz(&rd, &rng, job->iterations, &res);
+                break;
+            case SC_DARKSIDE:
+                ok = sc_darkside(&rd, &res);
+                break;
+            case SC_NESTED:
+                ok = sc_nested(&rd, &res);
+                break;
+            case SC_HARDNESTED:
+                ok = sc_hardnested(&rd, f, &res);
+                break;
+            case SC_COUNT:
+                break;
+        }
+        if (f)
+            fclose(f);
+
+        res.cards++;
+        res.frames += rd.frames;
+        if (ok) {
+            res.ok++;
+        } else {
+            pthread_mutex_lock(&job->lock);
+            if (job->total.error[0] == 0)
+                snprintf(job->total.error, sizeof(job->total.error), "card %u uid %08x: %.120s", idx, card->cuid, res.error);
+            pthread_mutex_unlock(&job->lock);
+        }
+        res.error[0] = 0;
+    }
+    free(card);
+
+    pthread_mutex_lock(&job->lock);
+    job->total.cards += res.cards;
+    job->total.ok += res.ok;
+    job->total.frames += res.frames;
+    job->total.nonces += res.nonces;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n cards] [-t threads] [-s seed] [-i iterations] [-w nonces.bin] <scenario> ...\n", prog);
+    printf("\n");
+    printf("    -n   number of virtual cards,  default 1000\n");
+    printf("    -t   worker threads,  default one per CPU\n");
+    printf("    -s   seed of the card contents,  default 1\n");
+    printf("    -i   frames per card of the fuzzer,  default 2000\n");
+    printf("    -w   write the hardnested nonces of the first card, `hf mf hardnested -r` reads them as nonces.bin\n");
+    printf("\n");
+    printf("scenarios:\n");
+    printf("    read        authenticate, read, write and use value blocks in every sector\n");
+    printf("    fuzz        random frames without a key, the memory must stay untouched\n");
+    printf("    darkside    darkside nonce acquisition and key recovery (nonce2key)\n");
+    printf("    nested      nested nonce acquisition and key recovery\n");
+    printf("    hardnested  encrypted nonce acquisition on a hardened card, nonces checked against the key\n");
+    printf("\n");
+    printf("example: %s -n 10000 read fuzz\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t cards = 1000;
+    uint32_t threads = 0;
+    uint32_t iterations = 2000;
+    uint64_t seed = 1;
+    const char *nonce_file = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:s:i:w:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                cards = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                threads = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'i':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                nonce_file = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? cpus : 1;
+    }
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads > cards)
+        threads = cards ? cards : 1;
+
+    int failed = 0;
+    int passed = 0;
+    for (int a = optind; a < argc; a++) {
+        job_t job;
+        memset(&job, 0, sizeof(job));
+        job.scenario = SC_COUNT;
+        for (uint8_t s = 0; s < SC_COUNT; s++) {
+            if (strcmp(argv[a], scenario_names[s]) == 0)
+                job.scenario = s;
+        }
+        if (job.scenario == SC_COUNT) {
+            printf("unknown scenario %s\n", argv[a]);
+            return 1;
+        }
+        job.cards = cards;
+        job.iterations = iterations;
+        job.seed = seed;
+        job.nonce_file = nonce_file;
+        pthread_mutex_init(&job.lock, NULL);
+
+        uint64_t start = msclock();
+        pthread_t tid[MAX_THREADS];
+        for (uint32_t t = 0; t < threads; t++)
+            pthread_create(&tid[t], NULL, worker, &job);
+        for (uint32_t t = 0; t < threads; t++)
+            pthread_join(tid[t], NULL);
+        uint64_t ms = msclock() - start;
+        pthread_mutex_destroy(&job.lock);
+
+        bool ok = (job.total.ok == job.cards);
+        printf("%-11s cards %u/%u  frames %" PRIu64 "  nonces %" PRIu64 "  %" PRIu64 " ms  %.2f Mframes/s  ( %s )\n",
+               scenario_names[job.scenario], job.total.ok, job.cards, job.total.frames, job.total.nonces, ms,
+               ms ? (double)job.total.frames / ms / 1000.0 : 0.0, ok ? "ok" : "fail");
+        if (ok == false) {
+            printf("            first failure: %s\n", job.total.error);
+            failed++;
+        } else {
+            passed++;
+        }
+    }
+
+    if (failed) {
+        printf("%d of %d scenarios failed\n", failed, failed + passed);
+        return 1;
+    }
+    printf("all %d scenarios passed\n", passed);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env bash
+
+# pm3_lf_bench.sh
+# Times the LF signal commands over the traces/lf_*.pm3 corpus.  All traces
+# are concatenated into one graph buffer,  every command runs --runs times on
+# it and the time of the load alone is subtracted.  With --out the graph after
+# one run of every command is saved,  so two client builds can be diffed.
+
+PM3PATH="$(dirname "$0")/.."
+cd "$PM3PATH" || exit 1
+
+CLIENTBIN="./client/proxmark3"
+RUNS=10
+OUTDIR=""
+COMMANDS=("data hpf" "data norm" "data iir -n 3")
+
+show_usage()
+{
+    echo """
+Usage: $0 [--clientbin /path/to/proxmark3] [--runs n] [--command \"data ...\"]... [--out dir]
+    --clientbin ...: Specify path to proxmark3 binary to benchmark
+    --runs n:        Run every command n times on the loaded signal (def $RUNS)
+    --command ...:   Command to time,  repeat for several (def \"data hpf\" \"data norm\" \"data iir -n 3\")
+    --out dir:       Keep the graph after one run of every command in dir,  to compare two builds
+"""
+    exit 0
+}
+
+CUSTOM=()
+while (( "$#" )); do
+  case "$1" in
+    -h|--help)
+      show_usage
+      ;;
+    -c|--clientbin)
+      CLIENTBIN=$2
+      shift 2
+      ;;
+    -r|--runs)
+      RUNS=$2
+      shift 2
+      ;;
+    -m|--command)
+      CUSTOM+=("$2")
+      shift 2
+      ;;
+    -o|--out)
+      OUTDIR=$2
+      shift 2
+      ;;
+    *)
+      echo "Error: Unsupported argument $1" >&2
+      exit 1
+      ;;
+  esac
+done
+[ ${#CUSTOM[@]} -gt 0 ] && COMMANDS=("${CUSTOM[@]}")
+
+if [ ! -x "$CLIENTBIN" ]; then
+    echo "Error: $CLIENTBIN not found" >&2
+    exit 1
+fi
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+[ -n "$OUTDIR" ] && mkdir -p "$OUTDIR"
+
+INPUT="$TMPDIR/lf_all.pm3"
+cat traces/lf_*.pm3 > "$INPUT"
+SAMPLES=$(wc -l < "$INPUT")
+
+# run a script,  prints the wall time in ms
+run_ms()
+{
+    local START END
+    START=$(date +%s%N)
+    "$CLIENTBIN" -s "$1" > /dev/null 2>&1
+    END=$(date +%s%N)
+    echo $(( (END - START) / 1000000 ))
+}
+
+echo "data load -f $INPUT" > "$TMPDIR/load.cmd"
+LOAD_MS=$(run_ms "$TMPDIR/load.cmd")
+printf "%-24s %8d samples %8d ms\n" "data load" "$SAMPLES" "$LOAD_MS"
+
+TOTAL=0
+for CMD in "${COMMANDS[@]}"; do
+    {
+        echo "data load -f $INPUT"
+        for ((i = 0; i < RUNS; i++)); do echo "$CMD"; done
+    } > "$TMPDIR/bench.cmd"
+
+    MS=$(( $(run_ms "$TMPDIR/bench.cmd") - LOAD_MS ))
+    (( MS < 0 )) && MS=0
+    TOTAL=$(( TOTAL + MS ))
+    printf "%-24s %8d runs    %8d ms\n" "$CMD" "$RUNS" "$MS"
+
+    if [ -n "$OUTDIR" ]; then
+        NAME=$(echo "$CMD" | tr -c 'a-zA-Z0-9\n' '_')
+        printf "data load -f %s\n%s\ndata save -f %s\n" "$INPUT" "$CMD" "$OUTDIR/$NAME" > "$TMPDIR/out.cmd"
+        "$CLIENTBIN" -s "$TMPDIR/out.cmd" > /dev/null 2>&1
+    fi
+done
+printf "%-24s %25d ms\n" "total" "$TOTAL"
@@ -12,7 +12,9 @@ TESTALL=true
 TESTMFKEY=false
 TESTNONCE2KEY=false
 TESTMFNONCEBRUTE=false
+TESTMFCSIM=false
 TESTHITAG2CRACK=false
+TESTHFDECODERS=false
 TESTFPGACOMPRESS=false
 TESTBOOTROM=false
 TESTARMSRC=false
@@ -26,7 +28,7 @@ while (( "$#" )); do
   case "$1" in
     -h|--help)
       echo """
-Usage: $0 [--long] [--gpu] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_nonce_brute|fpga_compress|bootrom|armsrc|client|recovery|common]
+Usage: $0 [--long] [--gpu] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_nonce_brute|mfc_sim|fpga_compress|hf_decoders|bootrom|armsrc|client|recovery|common]
     --long:          Enable slow tests
     --gpu:           Enable tests requiring GPU
     --clientbin ...: Specify path to proxmark3 binary to test
@@ -66,6 +68,11 @@ Usage: $0 [--long] [--gpu] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_
       TESTMFNONCEBRUTE=true
       shift
       ;;
+    mfc_sim)
+      TESTALL=false
+      TESTMFCSIM=true
+      shift
+      ;;
     fpga_compress)
       TESTALL=false
       TESTFPGACOMPRESS=true
@@ -76,6 +83,11 @@ Usage: $0 [--long] [--gpu] [--clientbin /path/to/proxmark3] [mfkey|nonce2key|mf_
       TESTHITAG2CRACK=true
       shift
       ;;
+    hf_decoders)
+      TESTALL=false
+      TESTHFDECODERS=true
+      shift
+      ;;
     bootrom)
       TESTALL=false
       TESTBOOTROM=true
@@ -277,6 +289,16 @@ while true; do
       if ! CheckFileExist "mf_nonce_brute exists"          "$MFNONCEBRUTEBIN"; then break; fi
       if ! CheckExecute slow "mf_nonce_brute test 1/2"         "$MFNONCEBRUTEBIN 9c599b32 5a920d85 1011 98d76b77 d6c6e870 0000 ca7e0b63 0111 3e709c8a" "Key found \[.*ffffffffffff.*\]"; then break; fi
       if ! CheckExecute slow "mf_nonce_brute test 2/2"         "$MFNONCEBRUTEBIN 96519578 d7e3c6ac 0011 cd311951 9da49e49 0010 2bb22e00 0100 a4f7f398" "Key found \[.*3b7e4fd575ad.*\]"; then break; fi
+      if ! CheckExecute slow "mf_nonce_brute json output"      "$MFNONCEBRUTEBIN -j 96519578 d7e3c6ac 0011 cd311951 9da49e49 0010 2bb22e00 0100 a4f7f398 2>/dev/null" "\"key\":\"3b7e4fd575ad\""; then break; fi
+      if ! CheckFileExist "mf_trace_brute exists"          "${MFTRACEBRUTEBIN:=./tools/mf_nonce_brute/mf_trace_brute}"; then break; fi
+      if ! CheckExecute slow "mf_trace_brute trace file"       "$MFTRACEBRUTEBIN -t traces/hf_mf_nested_sniff.trace" "Recovered .*3.* / .*3.* keys"; then break; fi
+    fi
+    if $TESTALL || $TESTMFCSIM; then
+      echo -e "\n${C_BLUE}Testing mfc_sim:${C_NC} ${MFCSIMBIN:=./tools/mfc_sim/mfc_sim}"
+      if ! CheckFileExist "mfc_sim exists"                 "$MFCSIMBIN"; then break; fi
+      if ! CheckExecute "mfc_sim read and fuzz"            "$MFCSIMBIN -n 64 read fuzz" "all 2 scenarios passed"; then break; fi
+      if ! CheckExecute "mfc_sim hardnested acquisition"   "$MFCSIMBIN -n 8 hardnested" "all 1 scenarios passed"; then break; fi
+      if ! CheckExecute slow "mfc_sim darkside and nested"     "$MFCSIMBIN -n 8 darkside nested" "all 2 scenarios passed"; then break; fi
     fi
     # hitag2crack not yet part of "all"
     # if $TESTALL || $TESTHITAG2CRACK; then
@@ -341,6 +363,13 @@ while true; do
       # Order of magnitude to crack it: ~15s -> tagged as "slow"
       if ! CheckExecute slow gpu "ht2crack5opencl test"        "cd $HT2CRACK5OPENCLPATH; ./ht2crack5opencl $HT2CRACK5OPENCLUID $HT2CRACK5OPENCLNRAR" "Key found.*: $HT2CRACK5OPENCLKEY"; then break; fi
     fi
+    # hf_decoders needs -fsanitize-coverage, not part of "all"
+    if $TESTHFDECODERS; then
+      echo -e "\n${C_BLUE}Testing hf_decoders:${C_NC} ${HFDECODERSBIN:=./tools/hf_decoders/hf_decoders}"
+      if ! CheckFileExist "hf_decoders exists"             "$HFDECODERSBIN"; then break; fi
+      if ! CheckExecute "hf_decoders golden vectors"       "$HFDECODERSBIN tools/hf_decoders/vectors/*.txt" "all 3 vectors passed"; then break; fi
+      if ! CheckExecute "hf_decoders raw replay"           "$HFDECODERSBIN -w /tmp/pm3_hf15.raw tools/hf_decoders/vectors/iso15693.txt && $HFDECODERSBIN -r /tmp/pm3_hf15.raw tools/hf_decoders/vectors/iso15693.txt; rm /tmp/pm3_hf15.raw" "frames 4/4 decoded 4"; then break; fi
+    fi
     if $TESTALL || $TESTCLIENT; then
       echo -e "\n${C_BLUE}Testing client:${C_NC} ${CLIENTBIN:=./client/proxmark3}"
       if ! CheckFileExist "proxmark3 exists"               "$CLIENTBIN"; then break; fi
@@ -365,8 +394,14 @@ while true; do
       if ! CheckExecute "mfu pwdgen test"         "$CLIENTBIN -c 'hf mfu pwdgen -t'" "Selftest OK"; then break; fi
       if ! CheckExecute "mfu keygen test"         "$CLIENTBIN -c 'hf mfu keygen --uid 11223344556677'" "80 B1 C2 71 D8 A0"; then break; fi
       if ! CheckExecute "jooki encode test"       "$CLIENTBIN -c 'hf jooki encode -t'" "04 28 F4 DA F0 4A 81  ( ok )"; then break; fi
+      if ! CheckExecute "asn1 oid description"    "$CLIENTBIN -c 'data asn1 -d 300d06035504030c0654657374434e; data asn1 -d 06092a864886f70d010101'" "rsaEncryption (PKCS #1)"; then break; fi
       if ! CheckExecute "trace load/list 14a"     "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -1 -t 14a;'" "READBLOCK(8)"; then break; fi
       if ! CheckExecute "trace load/list x"       "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -x1 -t 14a;'" "0.0101840425"; then break; fi
+      if ! CheckExecute "trace list paging"       "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -1 -t 14a --first 10 --count 2;'" "Listed 2 of 22 records"; then break; fi
+      if ! CheckExecute "trace decode 14a"        "$CLIENTBIN -c 'trace decode -f traces/hf_14a_sniff -t 14a; trace list -1 -t 14a;'" "READBLOCK(4)"; then break; fi
+      if ! CheckExecute "trace decode 14b"        "$CLIENTBIN -c 'trace decode -f traces/hf_14b_sniff -t 14b; trace list -1 -t 14b;'" "ATTRIB"; then break; fi
+      if ! CheckExecute "trace decode 15"         "$CLIENTBIN -c 'trace decode -f traces/hf_15_sniff -t 15; trace list -1 -t 15;'" "READBLOCK(0)"; then break; fi
+      if ! CheckExecute "trace decode segments"   "for i in \$(seq 200); do cat traces/hf_15_sniff.raw; done > /tmp/pm3_tests_hf_15_sniff.raw; $CLIENTBIN -c 'trace decode -f /tmp/pm3_tests_hf_15_sniff.raw -t 15 --threads 4'" "reader frames 400  tag frames 400"; then break; fi
       if ! CheckExecute "nfc decode test - oob"           "$CLIENTBIN -c 'nfc decode -d DA2010016170706C69636174696F6E2F766E642E626C7565746F6F74682E65702E6F6F62301000649201B96DFB0709466C65782032'" "Flex 2"; then break; fi
       if ! CheckExecute "nfc decode test - device info"   "$CLIENTBIN -c 'nfc decode -d d1025744690004536f6e79010752432d533338300220426c61636b204e46432052656164657220636f6e6e656374656420746f2050430310123e4567e89b12d3a45642665544000004124e464320506f72742d3130302076312e3032'" "NFC Port-100 v1.02"; then break; fi
       if ! CheckExecute "nfc decode test - vcard"         "$CLIENTBIN -c 'nfc decode -d d20ca3746578742f782d7643617264424547494e3a56434152440a56455253494f4e3a332e300a4e3a43687269733b4963656d616e3b3b3b0a464e3a476f7468656e627572670a5245563a323032312d30362d32345432303a31353a30385a0a6974656d322e582d4142444154453b747970653d707265663a323032302d30362d32340a4954454d322e582d41424c4142454c3a5f24213c416e6e69766572736172793e21245f0a454e443a56434152440a'" "END:VCARD"; then break; fi
@@ -389,6 +424,10 @@ while true; do
       if ! CheckExecute "lf PARADOX test"       "$CLIENTBIN -c 'data load -f traces/lf_Paradox-96_40426-APJN08.pm3;lf search -1'" "Paradox ID found"; then break; fi
       if ! CheckExecute "lf VIKING test"        "$CLIENTBIN -c 'data load -f traces/lf_Transit999-best.pm3;lf search -1'" "Viking ID found"; then break; fi
       if ! CheckExecute "lf VISA2000 test"      "$CLIENTBIN -c 'data load -f traces/lf_VISA2000.pm3;lf search -1'" "Visa2000 ID found"; then break; fi
+      if ! CheckExecute "lf batch test"         "$CLIENTBIN -c 'lf batch -d traces -w 2'" "lf_EM4102-1.pm3.*found.*em410x.*EM 410x ID 010872E77C"; then break; fi
+      if ! CheckExecute "lf HITAG2 crack test"  "echo 'ht2crack5 49435769 656E457228DC8031 010203049F868CBE 211000 524288' > /tmp/pm3_ht2crack.txt; \
+                                                 $CLIENTBIN -c 'lf hitag crack --uid 49435769 --nrar 656E457228DC8031 --nrar 010203049F868CBE -f /tmp/pm3_ht2crack.txt'" \
+                                                 "found valid key \[ 4F4E4D494B52 \]"; then break; fi
 
       if ! CheckExecute slow "lf T55 awid 26 test"               "$CLIENTBIN -c 'data load -f traces/lf_ATA5577_awid_26.pm3; lf search -1'" "AWID ID found"; then break; fi
       if ! CheckExecute slow "lf T55 awid 26 test2"              "$CLIENTBIN -c 'data load -f traces/lf_ATA5577_awid_26.pm3; lf awid demod'" \
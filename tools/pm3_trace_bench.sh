@@ -0,0 +1,87 @@
+#!/usr/bin/env bash
+
+# pm3_trace_bench.sh
+# Times `trace list` over the traces/*.trace corpus.  Every trace is repeated
+# to build a larger input,  then listed with a few protocols.  With --out the
+# listings are kept,  one file per trace,  so two client builds can be diffed.
+
+PM3PATH="$(dirname "$0")/.."
+cd "$PM3PATH" || exit 1
+
+CLIENTBIN="./client/proxmark3"
+REPEAT=10
+OUTDIR=""
+PROTOCOLS="raw 14a mf des 14b 7816 15 iclass topaz"
+
+show_usage()
+{
+    echo """
+Usage: $0 [--clientbin /path/to/proxmark3] [--repeat n] [--protocols \"p1 p2\"] [--out dir]
+    --clientbin ...: Specify path to proxmark3 binary to benchmark
+    --repeat n:      Concatenate every trace n times (def $REPEAT)
+    --protocols ...: Protocols to list (def \"$PROTOCOLS\")
+    --out dir:       Keep the listings in dir,  to compare two builds
+"""
+    exit 0
+}
+
+while (( "$#" )); do
+  case "$1" in
+    -h|--help)
+      show_usage
+      ;;
+    -c|--clientbin)
+      CLIENTBIN=$2
+      shift 2
+      ;;
+    -r|--repeat)
+      REPEAT=$2
+      shift 2
+      ;;
+    -p|--protocols)
+      PROTOCOLS=$2
+      shift 2
+      ;;
+    -o|--out)
+      OUTDIR=$2
+      shift 2
+      ;;
+    *)
+      echo "Error: Unsupported argument $1" >&2
+      exit 1
+      ;;
+  esac
+done
+
+if [ ! -x "$CLIENTBIN" ]; then
+    echo "Error: $CLIENTBIN not found" >&2
+    exit 1
+fi
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+[ -n "$OUTDIR" ] && mkdir -p "$OUTDIR"
+
+TOTAL=0
+for TRACE in traces/*.trace; do
+    NAME=$(basename "$TRACE" .trace)
+    INPUT="$TMPDIR/$NAME.trace"
+    for ((i = 0; i < REPEAT; i++)); do cat "$TRACE"; done > "$INPUT"
+
+    CMDS="trace load -f $INPUT"
+    for PROTO in $PROTOCOLS; do
+        CMDS="$CMDS; trace list -1 -t $PROTO"
+    done
+
+    OUT=/dev/null
+    [ -n "$OUTDIR" ] && OUT="$OUTDIR/$NAME.txt"
+
+    START=$(date +%s%N)
+    "$CLIENTBIN" -c "$CMDS" 2>&1 | grep -v "Session log\|Loaded\|Recorded Activity" > "$OUT"
+    END=$(date +%s%N)
+
+    MS=$(( (END - START) / 1000000 ))
+    TOTAL=$(( TOTAL + MS ))
+    printf "%-32s %8d bytes %8d ms\n" "$NAME" "$(stat -c %s "$INPUT")" "$MS"
+done
+printf "%-32s %23d ms\n" "total" "$TOTAL"